@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace imterm::bench {
+
+// Deterministic generator so benchmark inputs are identical across runs and
+// machines.
+class Lcg {
+public:
+    explicit Lcg(uint32_t seed) : mState(seed) { }
+
+    uint32_t Next()
+    {
+        mState = mState * 1664525u + 1013904223u;
+        return mState >> 8;
+    }
+
+    uint32_t Below(uint32_t limit) { return Next() % limit; }
+
+private:
+    uint32_t mState;
+};
+
+// ESP-IDF style log output: "\x1b[0;32mI (1234) tag: message\x1b[0m\r\n" with
+// info, warning, and error levels in their usual colors. With colored false the
+// SGR sequences are left out, as with CONFIG_LOG_COLORS disabled.
+inline std::vector<uint8_t> LogCorpus(size_t size, uint32_t seed, bool colored)
+{
+    static const char* const tags[] = {
+        "wifi", "esp_netif_handlers", "phy_init", "cpu_start", "heap_init",
+        "spi_flash", "app_main", "mqtt_client", "nvs", "gpio"};
+    static const char* const words[] = {
+        "connected", "ap", "channel", "rssi", "free", "heap", "bytes", "ok",
+        "init", "done", "sta", "ip", "mask", "gw", "retry", "timeout",
+        "0x3ffb2c10", "partition", "size", "task"};
+
+    Lcg random(seed);
+    std::vector<uint8_t> corpus;
+    corpus.reserve(size + 256);
+    uint32_t uptime = 0;
+
+    while (corpus.size() < size) {
+        const uint32_t level = random.Below(20);
+        const char* prefix = level == 0 ? "\x1b[0;31mE"
+            : level < 3 ? "\x1b[0;33mW"
+            : "\x1b[0;32mI";
+        if (!colored) {
+            prefix += 7;
+        }
+        uptime += 1 + random.Below(50);
+
+        std::string line = prefix;
+        line += " (" + std::to_string(uptime) + ") ";
+        line += tags[random.Below(std::size(tags))];
+        line += ":";
+        const uint32_t wordCount = 3 + random.Below(10);
+        for (uint32_t word = 0; word < wordCount; ++word) {
+            line += ' ';
+            line += words[random.Below(std::size(words))];
+        }
+        line += colored ? "\x1b[0m\r\n" : "\r\n";
+        corpus.insert(corpus.end(), line.begin(), line.end());
+    }
+
+    corpus.resize(size);
+    return corpus;
+}
+
+inline std::vector<uint8_t> ColoredLogCorpus(size_t size, uint32_t seed = 1)
+{
+    return LogCorpus(size, seed, true);
+}
+
+inline std::vector<uint8_t> PlainLogCorpus(size_t size, uint32_t seed = 1)
+{
+    return LogCorpus(size, seed, false);
+}
+
+// Full-screen menu redraws like those of an embedded configuration console: each
+// frame clears the screen, places every item with a cursor position sequence,
+// shows the selected item in inverse video, and erases to the end of each line.
+inline std::vector<uint8_t> MenuCorpus(size_t size, uint32_t seed = 1)
+{
+    static const char* const items[] = {
+        "Serial flasher config", "Partition Table", "Compiler options",
+        "Component config", "Bootloader config", "Security features",
+        "Wi-Fi", "Bluetooth", "FreeRTOS", "Log output", "Power Management",
+        "LWIP", "mbedTLS", "ESP System Settings", "Heap memory debugging"};
+    constexpr uint32_t itemCount = static_cast<uint32_t>(std::size(items));
+
+    Lcg random(seed);
+    std::vector<uint8_t> corpus;
+    corpus.reserve(size + 4096);
+
+    while (corpus.size() < size) {
+        const uint32_t selected = random.Below(itemCount);
+        std::string frame = "\x1b[2J\x1b[H\x1b[1;1H\x1b[0;34m  Espressif IoT Development Framework Configuration\x1b[0m\x1b[K";
+        for (uint32_t item = 0; item < itemCount; ++item) {
+            frame += "\x1b[" + std::to_string(item + 3) + ";5H";
+            frame += item == selected ? "\x1b[7m" : "";
+            frame += std::string("  ") + items[item] + "  --->";
+            frame += item == selected ? "\x1b[0m" : "";
+            frame += "\x1b[K";
+        }
+        frame += "\x1b[24;1H<Select>  < Exit >  < Help >  < Save >  < Load >\x1b[K";
+        frame += "\x1b[" + std::to_string(selected + 3) + ";7H";
+        corpus.insert(corpus.end(), frame.begin(), frame.end());
+    }
+
+    corpus.resize(size);
+    return corpus;
+}
+
+// Uniformly random bytes, as received at the wrong baud rate or from a port
+// carrying a binary protocol.
+inline std::vector<uint8_t> BinaryCorpus(size_t size, uint32_t seed = 1)
+{
+    Lcg random(seed);
+    std::vector<uint8_t> corpus(size);
+    for (uint8_t& byte : corpus) {
+        byte = static_cast<uint8_t>(random.Next());
+    }
+    return corpus;
+}
+
+} // namespace imterm::bench
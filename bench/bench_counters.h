@@ -0,0 +1,20 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+
+#include "allocation_counter.h"
+
+namespace imterm::bench {
+
+// Reports the heap allocations counted over one iteration, normalized to the
+// bytes that iteration processed. Steady-state paths should report close to 0.
+inline void ReportAllocations(benchmark::State& state, const test::AllocationCounts& counts, size_t bytes)
+{
+    const double processed = static_cast<double>(bytes);
+    state.counters["allocs_per_byte"] = static_cast<double>(counts.mAllocations) / processed;
+    state.counters["alloc_bytes_per_byte"] = static_cast<double>(counts.mAllocatedBytes) / processed;
+}
+
+} // namespace imterm::bench
@@ -0,0 +1,142 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "block_codec.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+
+namespace {
+
+struct EncodedBlock {
+    std::vector<uint8_t> mEncoded;
+    std::vector<uint8_t> mCompressed;
+    size_t mLines;
+};
+
+// Runs 16 MB of colored log through TerminalState and encodes the lines in
+// blocks of aBlockLines, the way LineStore spills them.
+std::vector<EncodedBlock> EncodeLogBlocks(size_t aBlockLines)
+{
+    const std::vector<uint8_t> capture = imterm::bench::ColoredLogCorpus(16 << 20);
+    auto data = std::make_shared<imterm::TerminalData>();
+    imterm::TerminalState terminal(data, imterm::TerminalState::NewLineMode::Strict);
+    terminal.SetViewportSize(24, 256);
+    terminal.Input(capture);
+
+    std::vector<EncodedBlock> blocks;
+    const imterm::Lines& lines = data->GetLines();
+    for (size_t first = 0; first + aBlockLines <= lines.size(); first += aBlockLines) {
+        EncodedBlock& block = blocks.emplace_back();
+        block.mLines = aBlockLines;
+        for (size_t line = first; line < first + aBlockLines; ++line) {
+            lines[line].Encode(block.mEncoded);
+        }
+        imterm::CompressBlock(block.mEncoded, block.mCompressed);
+    }
+    return blocks;
+}
+
+void ReportBlockShape(benchmark::State& state, const std::vector<EncodedBlock>& blocks)
+{
+    size_t encoded = 0;
+    size_t compressed = 0;
+    for (const EncodedBlock& block : blocks) {
+        encoded += block.mEncoded.size();
+        compressed += block.mCompressed.size();
+    }
+    state.counters["compression_ratio"] = static_cast<double>(encoded) / static_cast<double>(compressed);
+    state.counters["encoded_kb_per_block"] = static_cast<double>(encoded) / 1024.0 / static_cast<double>(blocks.size());
+}
+
+// Compresses one spilled block per iteration.
+void BM_BlockCompress(benchmark::State& state)
+{
+    const std::vector<EncodedBlock> blocks = EncodeLogBlocks(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> out;
+    size_t next = 0;
+    int64_t bytes = 0;
+
+    for (auto _ : state) {
+        const EncodedBlock& block = blocks[next];
+        next = (next + 1) % blocks.size();
+        out.clear();
+        imterm::CompressBlock(block.mEncoded, out);
+        benchmark::DoNotOptimize(out.data());
+        bytes += static_cast<int64_t>(block.mEncoded.size());
+    }
+    ReportBlockShape(state, blocks);
+    state.SetBytesProcessed(bytes);
+}
+
+// Decompresses one spilled block per iteration; the time per iteration is
+// the decompression latency per block.
+void BM_BlockDecompress(benchmark::State& state)
+{
+    const std::vector<EncodedBlock> blocks = EncodeLogBlocks(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> encoded;
+    size_t next = 0;
+    int64_t bytes = 0;
+
+    for (auto _ : state) {
+        const EncodedBlock& block = blocks[next];
+        next = (next + 1) % blocks.size();
+        encoded.resize(block.mEncoded.size());
+        imterm::DecompressBlock(block.mCompressed, encoded);
+        benchmark::DoNotOptimize(encoded.data());
+        bytes += static_cast<int64_t>(block.mEncoded.size());
+    }
+    ReportBlockShape(state, blocks);
+    state.SetBytesProcessed(bytes);
+}
+
+// Brings one spilled block back to lines per iteration, as a cache miss in
+// LineStore does.
+void BM_BlockReadBack(benchmark::State& state)
+{
+    const std::vector<EncodedBlock> blocks = EncodeLogBlocks(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> encoded;
+    std::vector<imterm::Line> lines;
+    size_t next = 0;
+    int64_t bytes = 0;
+
+    for (auto _ : state) {
+        const EncodedBlock& block = blocks[next];
+        next = (next + 1) % blocks.size();
+        encoded.resize(block.mEncoded.size());
+        imterm::DecompressBlock(block.mCompressed, encoded);
+        std::span<const uint8_t> input(encoded);
+        lines.clear();
+        for (size_t line = 0; line < block.mLines; ++line) {
+            lines.push_back(imterm::Line::Decode(input));
+        }
+        benchmark::DoNotOptimize(lines.data());
+        bytes += static_cast<int64_t>(block.mEncoded.size());
+    }
+    ReportBlockShape(state, blocks);
+    state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_BlockCompress)
+    ->Arg(1024)
+    ->Arg(4096)
+    ->Arg(16384)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BlockDecompress)
+    ->Arg(1024)
+    ->Arg(4096)
+    ->Arg(16384)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BlockReadBack)
+    ->Arg(1024)
+    ->Arg(4096)
+    ->Arg(16384)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "bench_corpus.h"
+#include "bench_counters.h"
+#include "escape_sequence_parser.h"
+
+namespace {
+
+// Runs a capture through EscapeSequenceParser::Parse(uint8_t), one call per
+// byte, the way TerminalState::Input used to.
+void ParseByteAtATime(benchmark::State& state, const std::vector<uint8_t>& capture)
+{
+    for (auto _ : state) {
+        EscapeSequenceParser parser;
+        size_t sequences = 0;
+        for (const uint8_t byte : capture) {
+            const auto& result = parser.Parse(byte);
+            sequences += result.mIdentifier != EscapeSequenceParser::EscapeIdentifier::Undefined;
+        }
+        benchmark::DoNotOptimize(sequences);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * capture.size()));
+}
+
+// Runs the same capture through the batch Parse() with the token buffer size
+// TerminalState uses. Parsing should never allocate.
+void ParseBatch(benchmark::State& state, const std::vector<uint8_t>& capture)
+{
+    std::array<EscapeSequenceParser::Token, 64> tokens;
+
+    for (auto _ : state) {
+        imterm::test::AllocationScope scope;
+        EscapeSequenceParser parser;
+        size_t tokenTotal = 0;
+        std::span<const uint8_t> remaining(capture);
+        while (!remaining.empty()) {
+            size_t count = 0;
+            remaining = remaining.subspan(parser.Parse(remaining, tokens, count));
+            tokenTotal += count;
+        }
+        benchmark::DoNotOptimize(tokenTotal);
+
+        imterm::bench::ReportAllocations(state, scope.Elapsed(), capture.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * capture.size()));
+}
+
+void BM_ParseByteAtATimePlainLog(benchmark::State& state)
+{
+    ParseByteAtATime(state, imterm::bench::PlainLogCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_ParseByteAtATimeColoredLog(benchmark::State& state)
+{
+    ParseByteAtATime(state, imterm::bench::ColoredLogCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_ParseBatchPlainLog(benchmark::State& state)
+{
+    ParseBatch(state, imterm::bench::PlainLogCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_ParseBatchColoredLog(benchmark::State& state)
+{
+    ParseBatch(state, imterm::bench::ColoredLogCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_ParseBatchMenu(benchmark::State& state)
+{
+    ParseBatch(state, imterm::bench::MenuCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_ParseBatchBinary(benchmark::State& state)
+{
+    ParseBatch(state, imterm::bench::BinaryCorpus(static_cast<size_t>(state.range(0))));
+}
+
+BENCHMARK(BM_ParseByteAtATimePlainLog)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseByteAtATimeColoredLog)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseBatchPlainLog)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseBatchColoredLog)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseBatchMenu)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParseBatchBinary)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
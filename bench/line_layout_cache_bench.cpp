@@ -0,0 +1,106 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "line_layout_cache.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+
+namespace {
+
+constexpr int ScreenLines = 60;
+constexpr int ScreenColumns = 200;
+
+// A full screen of text whose color changes every one to three characters,
+// with the occasional space: close to the worst case for run splitting.
+std::shared_ptr<imterm::TerminalData> ColoredScreen()
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    imterm::TerminalState terminal(data, imterm::TerminalState::NewLineMode::Strict);
+    terminal.SetViewportSize(ScreenLines, ScreenColumns);
+
+    imterm::bench::Lcg random(7);
+    std::string screen;
+    for (int line = 0; line < ScreenLines; ++line) {
+        if (line > 0) {
+            screen += "\r\n";
+        }
+        for (int column = 0; column < ScreenColumns;) {
+            screen += "\x1b[" + std::to_string(31 + random.Below(7)) + "m";
+            const int length = 1 + static_cast<int>(random.Below(3));
+            for (int i = 0; i < length && column < ScreenColumns; ++i, ++column) {
+                screen += random.Below(8) == 0 ? ' ' : static_cast<char>('!' + random.Below(94));
+            }
+        }
+    }
+    const std::vector<uint8_t> bytes(screen.begin(), screen.end());
+    terminal.Input(bytes);
+    return data;
+}
+
+// Stands in for ImFont::CalcTextSizeA, which looks up the advance of every
+// character it measures.
+float MeasureText(std::string_view aText)
+{
+    static const std::array<float, 256> advances = [] {
+        std::array<float, 256> table{};
+        for (size_t i = 0; i < table.size(); ++i) {
+            table[i] = 7.0f + static_cast<float>(i % 3) * 0.001f;
+        }
+        return table;
+    }();
+    float width = 0.0f;
+    for (const char c : aText) {
+        width += advances[static_cast<uint8_t>(c)];
+    }
+    return width;
+}
+
+// Lays out every line of a full, heavily colored screen per iteration, as a
+// terminal view frame does. range(0) is 0 to build every layout from scratch,
+// as the view did before the cache, and 1 to go through LineLayoutCache with
+// nothing changed since the previous frame.
+void BM_LineLayoutFrame(benchmark::State& state)
+{
+    const bool cached = state.range(0) != 0;
+    auto data = ColoredScreen();
+    const imterm::Lines& lines = data->GetLines();
+    const imterm::LineLayoutMetrics metrics{ 13.0f, 7.0f, 4 };
+    const imterm::LineLayoutCache::MeasureText measure = MeasureText;
+    imterm::LineLayoutCache cache;
+    imterm::LineLayout layout;
+    size_t runs = 0;
+
+    for (auto _ : state) {
+        runs = 0;
+        if (cached) {
+            cache.BeginFrame(metrics);
+        }
+        for (size_t line = 0; line < lines.size(); ++line) {
+            if (cached) {
+                runs += cache.Get(lines[line], measure).mRuns.size();
+            }
+            else {
+                imterm::LineLayoutCache::Build(lines[line], metrics, measure, layout);
+                runs += layout.mRuns.size();
+            }
+        }
+        benchmark::DoNotOptimize(runs);
+    }
+    state.counters["runs_per_frame"] = static_cast<double>(runs);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_LineLayoutFrame)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "line_store.h"
+
+namespace {
+
+// Appends N empty lines one at a time and reports the slowest single append
+// next to the mean. A std::vector of lines copies the whole buffer each time
+// it grows, so its worst case scales with the scrollback; LineStore's is
+// bounded by one block.
+template <typename Container>
+void AppendLines(benchmark::State& state)
+{
+    const size_t lineCount = static_cast<size_t>(state.range(0));
+    using Clock = std::chrono::steady_clock;
+
+    for (auto _ : state) {
+        Container lines;
+        int64_t worstNanoseconds = 0;
+        // Log2 histogram of append latencies in nanoseconds.
+        std::vector<size_t> histogram(64, 0);
+
+        const auto begin = Clock::now();
+        for (size_t i = 0; i < lineCount; ++i) {
+            const auto start = Clock::now();
+            lines.emplace_back();
+            const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+            worstNanoseconds = std::max(worstNanoseconds, elapsed);
+            size_t bucket = 0;
+            while ((int64_t{ 1 } << bucket) < elapsed && bucket + 1 < histogram.size()) {
+                ++bucket;
+            }
+            ++histogram[bucket];
+        }
+        const double totalNanoseconds = static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+        benchmark::DoNotOptimize(lines.size());
+
+        // Upper bound of the bucket holding the 99.99th percentile append.
+        const size_t target = lineCount - lineCount / 10000;
+        size_t seen = 0;
+        size_t p9999Bucket = 0;
+        for (; p9999Bucket < histogram.size(); ++p9999Bucket) {
+            seen += histogram[p9999Bucket];
+            if (seen >= target) {
+                break;
+            }
+        }
+
+        state.counters["worst_append_us"] = static_cast<double>(worstNanoseconds) / 1000.0;
+        state.counters["p99.99_append_ns_le"] = static_cast<double>(int64_t{ 1 } << p9999Bucket);
+        state.counters["mean_append_ns"] = totalNanoseconds / static_cast<double>(lineCount);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * lineCount));
+}
+
+void BM_LineStoreAppend(benchmark::State& state)
+{
+    AppendLines<imterm::LineStore>(state);
+}
+
+void BM_VectorAppend(benchmark::State& state)
+{
+    AppendLines<std::vector<imterm::Line>>(state);
+}
+
+// 50M lines is the scrollback size the store is designed for; it needs about
+// 3 GB of memory per container.
+BENCHMARK(BM_LineStoreAppend)
+    ->Arg(1 << 20)
+    ->Arg(50'000'000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_VectorAppend)
+    ->Arg(1 << 20)
+    ->Arg(50'000'000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,96 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "terminal_data.h"
+#include "terminal_state.h"
+
+namespace {
+
+// One JSON telemetry record of at least size bytes with no line break. With
+// utf8 set, every value carries a two-byte degree sign, so byte offsets and
+// columns differ along the whole line.
+std::vector<uint8_t> JsonLine(size_t size, bool utf8)
+{
+    std::string line = "{\"samples\":[";
+    for (size_t sample = 0; line.size() < size; ++sample) {
+        line += "{\"id\":" + std::to_string(sample) + ",\"t\":\"" + std::to_string(20 + sample % 7);
+        line += utf8 ? "\xC2\xB0" "C\"}," : " C\"},";
+    }
+    line.resize(size);
+    return std::vector<uint8_t>(line.begin(), line.end());
+}
+
+// Feeds the line through TerminalState in 64-byte reads, the size a serial
+// port typically delivers at 115200 baud. Bytes per second should not drop
+// as the line grows.
+void InputLongLine(benchmark::State& state, bool utf8)
+{
+    const std::vector<uint8_t> line = JsonLine(static_cast<size_t>(state.range(0)), utf8);
+    constexpr size_t chunkSize = 64;
+
+    for (auto _ : state) {
+        auto data = std::make_shared<imterm::TerminalData>();
+        imterm::TerminalState terminal(data, imterm::TerminalState::NewLineMode::Strict);
+        terminal.SetViewportSize(24, static_cast<int>(line.size()) + 1);
+
+        for (size_t offset = 0; offset < line.size(); offset += chunkSize) {
+            const size_t count = std::min(chunkSize, line.size() - offset);
+            terminal.Input(std::span<const uint8_t>(line.data() + offset, count));
+        }
+        benchmark::DoNotOptimize(data->GetLineSize(0));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * line.size()));
+}
+
+void BM_LongLineAsciiInput(benchmark::State& state)
+{
+    InputLongLine(state, false);
+}
+
+void BM_LongLineUtf8Input(benchmark::State& state)
+{
+    InputLongLine(state, true);
+}
+
+// Writes the line one character at a time through TerminalData::InputBytes,
+// the path taken for characters that arrive split across reads.
+void BM_LongLineCharacterInput(benchmark::State& state)
+{
+    const std::vector<uint8_t> line = JsonLine(static_cast<size_t>(state.range(0)), true);
+
+    for (auto _ : state) {
+        imterm::TerminalData data;
+        int column = 0;
+        for (size_t offset = 0; offset < line.size();) {
+            const size_t length = static_cast<size_t>(
+                imterm::TerminalData::UTF8CharLength(line[offset], line.size() - offset));
+            data.InputBytes(0, column, imterm::PaletteIndex::Default,
+                std::span<const uint8_t>(line.data() + offset, length));
+            offset += length;
+        }
+        benchmark::DoNotOptimize(data.GetLineSize(0));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * line.size()));
+}
+
+BENCHMARK(BM_LongLineAsciiInput)
+    ->Arg(16 << 10)
+    ->Arg(64 << 10)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LongLineUtf8Input)
+    ->Arg(16 << 10)
+    ->Arg(64 << 10)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LongLineCharacterInput)
+    ->Arg(16 << 10)
+    ->Arg(64 << 10)
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "receive_journal.h"
+
+namespace {
+
+std::filesystem::path JournalPath()
+{
+    return std::filesystem::temp_directory_path() / "imterm-bench.journal";
+}
+
+// Records 256 MB in appends of the sizes a serial port delivers, the work
+// the journal adds to Pump().
+void BM_JournalAppend(benchmark::State& state)
+{
+    const std::vector<uint8_t> bytes(static_cast<size_t>(state.range(0)), 'x');
+    constexpr uint64_t total = uint64_t{ 256 } << 20;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        imterm::ReceiveJournal journal(JournalPath());
+        state.ResumeTiming();
+        for (uint64_t written = 0; written < total; written += bytes.size()) {
+            journal.Append(bytes);
+        }
+        benchmark::DoNotOptimize(journal.GetSize());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * total));
+}
+
+// Reads a screen of rows at random offsets of a 1 GB journal, as the hex
+// view does when it is scrolled around.
+void BM_JournalRandomPageRead(benchmark::State& state)
+{
+    imterm::ReceiveJournal journal(JournalPath());
+    const std::vector<uint8_t> block(1 << 20, 'x');
+    for (int i = 0; i < 1024; ++i) {
+        journal.Append(block);
+    }
+
+    imterm::bench::Lcg random(3);
+    std::vector<uint8_t> page(16 * 64);
+    for (auto _ : state) {
+        const uint64_t offset = (uint64_t{ random.Below(1024) } << 20) + random.Below(1 << 20);
+        benchmark::DoNotOptimize(journal.Read(offset, page));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_JournalAppend)
+    ->Arg(64)
+    ->Arg(4096)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_JournalRandomPageRead)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
@@ -0,0 +1,215 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "bench_corpus.h"
+#include "bench_counters.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+
+namespace {
+
+// A buffer holding the given number of lines of colored log output.
+std::shared_ptr<imterm::TerminalData> FilledBuffer(size_t lineCount)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    imterm::TerminalState terminal(data, imterm::TerminalState::NewLineMode::Strict);
+    terminal.SetViewportSize(24, 256);
+
+    const std::vector<uint8_t> capture = imterm::bench::ColoredLogCorpus(lineCount * 80);
+    terminal.Input(capture);
+    while (data->GetLineCount() < lineCount) {
+        data->InsertLine(static_cast<int>(data->GetLineCount()));
+    }
+    if (data->GetLineCount() > lineCount) {
+        data->RemoveLine(static_cast<int>(lineCount), static_cast<int>(data->GetLineCount()));
+    }
+    return data;
+}
+
+// Appends a line to a buffer of range(0) lines and drops the oldest one: the
+// path every received newline takes once the scrollback is full.
+void BM_TerminalDataAppendLine(benchmark::State& state)
+{
+    const size_t lineCount = static_cast<size_t>(state.range(0));
+    auto data = FilledBuffer(lineCount);
+
+    for (auto _ : state) {
+        data->InsertLine(static_cast<int>(data->GetLineCount()));
+        data->RemoveLine(0);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// Inserts a line in the middle of a buffer of range(0) lines, as a cursor
+// addressed program scrolling part of the screen does.
+void BM_TerminalDataInsertLineInMiddle(benchmark::State& state)
+{
+    const size_t lineCount = static_cast<size_t>(state.range(0));
+    auto data = FilledBuffer(lineCount);
+
+    for (auto _ : state) {
+        data->InsertLine(static_cast<int>(data->GetLineCount() / 2));
+        data->RemoveLine(static_cast<int>(data->GetLineCount() / 2));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// Drops the oldest 1000 lines of a buffer of range(0) lines, as trimming the
+// scrollback does, and appends them again.
+void BM_TerminalDataTrimScrollback(benchmark::State& state)
+{
+    const size_t lineCount = static_cast<size_t>(state.range(0));
+    constexpr int trimmed = 1000;
+    auto data = FilledBuffer(lineCount);
+
+    for (auto _ : state) {
+        data->RemoveLine(0, trimmed);
+        state.PauseTiming();
+        for (int i = 0; i < trimmed; ++i) {
+            data->InsertLine(static_cast<int>(data->GetLineCount()));
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * trimmed);
+}
+
+// Copies the whole buffer out as text, as Copy All and Save do.
+void BM_TerminalDataGetText(benchmark::State& state)
+{
+    auto data = FilledBuffer(static_cast<size_t>(state.range(0)));
+    size_t textSize = 0;
+
+    for (auto _ : state) {
+        imterm::test::AllocationScope scope;
+        const std::string text = data->GetText();
+        textSize = text.size();
+        benchmark::DoNotOptimize(text.data());
+        imterm::bench::ReportAllocations(state, scope.Elapsed(), textSize);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * textSize));
+}
+
+// A buffer of lineCount log lines with cold blocks compressed into a spill
+// file, so 100M lines fit in memory. Lines are written directly rather than
+// parsed, but 100M lines still take a minute or two.
+std::shared_ptr<imterm::TerminalData> SpilledBuffer(size_t lineCount)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    imterm::LineStore::SpillOptions options;
+    options.Path = std::filesystem::temp_directory_path() / "imterm-bench-frame.scrollback";
+    options.Compress = true;
+    data->EnableSpill(options);
+
+    std::vector<std::vector<uint8_t>> templates(1);
+    for (const uint8_t byte : imterm::bench::PlainLogCorpus(4096 * 80)) {
+        if (byte == '\n') {
+            templates.emplace_back();
+        }
+        else if (byte != '\r') {
+            templates.back().push_back(byte);
+        }
+    }
+
+    for (size_t line = 0; line < lineCount; ++line) {
+        data->EnsureLineExists(line);
+        const auto& text = templates[line % templates.size()];
+        int column = 0;
+        const auto color = text.empty() || text[0] == 'I' ? imterm::PaletteIndex::Green : imterm::PaletteIndex::Yellow;
+        data->InputCharacters(line, column, color, text);
+    }
+    return data;
+}
+
+// The buffer work of one frame of the terminal view: the rows of a 60-line
+// window, their timestamps and color runs, and the widest line for the
+// horizontal scroll extent. range(1) selects scrolling three lines per frame
+// or jumping to a random line each frame, which decodes a spilled block. The
+// time per frame should not depend on range(0), the number of lines.
+void BM_TerminalDataVisibleFrame(benchmark::State& state)
+{
+    const size_t lineCount = static_cast<size_t>(state.range(0));
+    const bool jump = state.range(1) != 0;
+    constexpr size_t rows = 60;
+    auto data = SpilledBuffer(lineCount);
+    const imterm::TerminalData& buffer = *data;
+
+    imterm::bench::Lcg random(5);
+    size_t top = lineCount / 2;
+    for (auto _ : state) {
+        top = jump
+            ? ((size_t{ random.Below(1 << 16) } << 16) + random.Below(1 << 16)) % (lineCount - rows)
+            : (top + 3) % (lineCount - rows);
+
+        size_t runs = 0;
+        int64_t newest = 0;
+        for (size_t row = top; row < top + rows; ++row) {
+            const imterm::Line& line = buffer.GetLine(row);
+            runs += line.GetAttributeRuns().size();
+            newest = std::max<int64_t>(newest, line.GetTimestamp().time_since_epoch().count());
+        }
+        benchmark::DoNotOptimize(runs);
+        benchmark::DoNotOptimize(newest);
+        benchmark::DoNotOptimize(buffer.GetWidestLineColumn());
+    }
+    state.counters["lines"] = static_cast<double>(lineCount);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// Appends 64 lines to a buffer of range(0) lines and publishes a snapshot,
+// as a frame that hands the buffer to a background reader does. The snapshot
+// copies the last block and shares the rest, so the time should not grow
+// with the buffer.
+void BM_TerminalDataPublishSnapshot(benchmark::State& state)
+{
+    auto data = FilledBuffer(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        for (int i = 0; i < 64; ++i) {
+            data->InsertLine(static_cast<int>(data->GetLineCount()));
+        }
+        data->PublishSnapshot();
+        benchmark::DoNotOptimize(data->GetPublishedSnapshot()->GetLineCount());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+BENCHMARK(BM_TerminalDataAppendLine)
+    ->Arg(10'000)
+    ->Arg(1'000'000);
+BENCHMARK(BM_TerminalDataInsertLineInMiddle)
+    ->Arg(10'000)
+    ->Arg(1'000'000);
+BENCHMARK(BM_TerminalDataTrimScrollback)
+    ->Arg(10'000)
+    ->Arg(1'000'000);
+BENCHMARK(BM_TerminalDataGetText)
+    ->Arg(10'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TerminalDataPublishSnapshot)
+    ->Arg(10'000)
+    ->Arg(1'000'000)
+    ->Unit(benchmark::kMicrosecond);
+// Fixed iterations: filling the buffer dominates, and 100M lines take
+// a minute or two, so it should happen once per case.
+BENCHMARK(BM_TerminalDataVisibleFrame)
+    ->Args({ 1'000'000, 0 })
+    ->Args({ 100'000'000, 0 })
+    ->Iterations(100'000)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TerminalDataVisibleFrame)
+    ->Args({ 1'000'000, 1 })
+    ->Args({ 100'000'000, 1 })
+    ->Iterations(1000)
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
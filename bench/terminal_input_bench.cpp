@@ -0,0 +1,75 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "bench_corpus.h"
+#include "bench_counters.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+
+namespace {
+
+// Feeds a capture through TerminalState in receive-sized chunks and reports
+// ingest throughput in bytes per second and heap allocations per byte.
+void InputCorpus(benchmark::State& state, const std::vector<uint8_t>& capture)
+{
+    constexpr size_t chunkSize = 4096;
+
+    for (auto _ : state) {
+        imterm::test::AllocationScope scope;
+
+        auto data = std::make_shared<imterm::TerminalData>();
+        imterm::TerminalState terminal(data, imterm::TerminalState::NewLineMode::Strict);
+        terminal.SetViewportSize(24, 256);
+
+        for (size_t offset = 0; offset < capture.size(); offset += chunkSize) {
+            const size_t count = std::min(chunkSize, capture.size() - offset);
+            terminal.Input(std::span<const uint8_t>(capture.data() + offset, count));
+        }
+        benchmark::DoNotOptimize(data->GetLineCount());
+
+        imterm::bench::ReportAllocations(state, scope.Elapsed(), capture.size());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * capture.size()));
+}
+
+void BM_InputPlainLog(benchmark::State& state)
+{
+    InputCorpus(state, imterm::bench::PlainLogCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_InputColoredLog(benchmark::State& state)
+{
+    InputCorpus(state, imterm::bench::ColoredLogCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_InputMenu(benchmark::State& state)
+{
+    InputCorpus(state, imterm::bench::MenuCorpus(static_cast<size_t>(state.range(0))));
+}
+
+void BM_InputBinary(benchmark::State& state)
+{
+    InputCorpus(state, imterm::bench::BinaryCorpus(static_cast<size_t>(state.range(0))));
+}
+
+BENCHMARK(BM_InputPlainLog)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_InputColoredLog)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_InputMenu)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_InputBinary)
+    ->Arg(8 << 20)
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
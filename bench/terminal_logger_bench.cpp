@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "allocation_counter.h"
+#include "bench_counters.h"
+#include "terminal_data.h"
+#include "terminal_logger.h"
+#include "test_support.h"
+
+namespace {
+
+// Logs 80-character lines to a file in a temporary directory. range(0)
+// selects whether each line is prefixed with its timestamp, range(1) whether
+// the logger writes from its background thread. The asynchronous case times
+// only Log() itself; queued lines are written by the final Close().
+void BM_TerminalLoggerLog(benchmark::State& state)
+{
+    imterm::test::TemporaryDirectory directory;
+    imterm::TerminalLogger::Options options;
+    options.LineNumbers = true;
+    options.TimeStamps = state.range(0) != 0;
+    options.Asynchronous = state.range(1) != 0;
+    imterm::TerminalLogger logger(false, "bench", ".log", directory.Path(), options);
+
+    imterm::TerminalData data;
+    data.SetText("I (123456) wifi: connected to ap channel 6 rssi -42 free heap 182344 bytes ok");
+    const imterm::Line line = data.GetLine(0);
+    // Open the file outside the measured loop.
+    logger.Log(line, 0);
+
+    constexpr int linesPerIteration = 1000;
+    int lineNumber = 1;
+    for (auto _ : state) {
+        imterm::test::AllocationScope scope;
+        for (int i = 0; i < linesPerIteration; ++i) {
+            logger.Log(line, lineNumber++);
+        }
+        imterm::bench::ReportAllocations(state, scope.Elapsed(), line.size() * linesPerIteration);
+    }
+    logger.Close();
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * line.size() * linesPerIteration));
+}
+
+BENCHMARK(BM_TerminalLoggerLog)
+    ->Args({ 0, 0 })
+    ->Args({ 1, 0 })
+    ->Args({ 0, 1 })
+    ->Args({ 1, 1 })
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
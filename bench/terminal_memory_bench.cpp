@@ -0,0 +1,125 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "bench_corpus.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+
+namespace {
+
+// Layout of the cell and line types used before packed line storage, kept
+// here only to report the old cost alongside the new one.
+struct LegacyGlyph {
+    imterm::Char mChar;
+    int mColorIndex;
+    bool mPreprocessor : 1;
+};
+
+struct LegacyLine {
+    std::vector<LegacyGlyph> mGlyphs;
+    std::chrono::system_clock::time_point mTimestamp;
+};
+
+// Feeds a capture through TerminalState the way the capture session does and
+// reports the heap held by the resulting buffer per received byte.
+void BM_CaptureMemory(benchmark::State& state)
+{
+    const size_t captureSize = static_cast<size_t>(state.range(0));
+    const std::vector<uint8_t> capture = imterm::bench::ColoredLogCorpus(captureSize);
+    constexpr size_t chunkSize = 4096;
+
+    for (auto _ : state) {
+        imterm::test::AllocationScope scope;
+
+        auto data = std::make_shared<imterm::TerminalData>();
+        imterm::TerminalState terminal(data, imterm::TerminalState::NewLineMode::Strict);
+        terminal.SetViewportSize(24, 256);
+
+        for (size_t offset = 0; offset < capture.size(); offset += chunkSize) {
+            const size_t count = std::min(chunkSize, capture.size() - offset);
+            terminal.Input(std::span<const uint8_t>(capture.data() + offset, count));
+        }
+
+        const double received = static_cast<double>(capture.size());
+        const double liveBytes = static_cast<double>(scope.Elapsed().mLiveBytes);
+
+        size_t storedBytes = 0;
+        for (const imterm::Line& line : data->GetLines()) {
+            storedBytes += line.size();
+        }
+        const size_t legacyBytes = data->GetLineCount() * sizeof(LegacyLine)
+            + storedBytes * sizeof(LegacyGlyph);
+
+        state.counters["lines"] = static_cast<double>(data->GetLineCount());
+        state.counters["heap_bytes_per_received_byte"] = liveBytes / received;
+        state.counters["buffer_bytes_per_received_byte"] =
+            static_cast<double>(data->GetApproximateMemoryUsage()) / received;
+        // Lower bound for the previous Glyph layout: no vector growth slack.
+        state.counters["legacy_glyph_bytes_per_received_byte"] =
+            static_cast<double>(legacyBytes) / received;
+
+        benchmark::DoNotOptimize(data);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(captureSize));
+}
+
+// The same capture with cold scrollback spilled to a file in the system
+// temporary directory, uncompressed and compressed: the heap should stop
+// growing once the in-memory window is full, and the file should cost less
+// than the lines did in memory.
+void BM_CaptureMemorySpilled(benchmark::State& state)
+{
+    const size_t captureSize = static_cast<size_t>(state.range(0));
+    const std::vector<uint8_t> capture = imterm::bench::ColoredLogCorpus(captureSize);
+    constexpr size_t chunkSize = 4096;
+
+    for (auto _ : state) {
+        imterm::test::AllocationScope scope;
+
+        auto data = std::make_shared<imterm::TerminalData>();
+        imterm::LineStore::SpillOptions options;
+        options.Path = std::filesystem::temp_directory_path() / "imterm-bench.scrollback";
+        options.Compress = state.range(1) != 0;
+        data->EnableSpill(options);
+        imterm::TerminalState terminal(data, imterm::TerminalState::NewLineMode::Strict);
+        terminal.SetViewportSize(24, 256);
+
+        for (size_t offset = 0; offset < capture.size(); offset += chunkSize) {
+            const size_t count = std::min(chunkSize, capture.size() - offset);
+            terminal.Input(std::span<const uint8_t>(capture.data() + offset, count));
+        }
+
+        const double received = static_cast<double>(capture.size());
+        state.counters["lines"] = static_cast<double>(data->GetLineCount());
+        state.counters["heap_bytes_per_received_byte"] =
+            static_cast<double>(scope.Elapsed().mLiveBytes) / received;
+        state.counters["spill_file_bytes_per_received_byte"] =
+            static_cast<double>(data->GetLines().GetSpillFileSize()) / received;
+
+        benchmark::DoNotOptimize(data);
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(captureSize));
+}
+
+BENCHMARK(BM_CaptureMemory)
+    ->Arg(1 << 20)
+    ->Arg(100 << 20)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CaptureMemorySpilled)
+    ->Args({ 100 << 20, 0 })
+    ->Args({ 100 << 20, 1 })
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
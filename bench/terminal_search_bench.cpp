@@ -0,0 +1,132 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_corpus.h"
+#include "terminal_data.h"
+#include "terminal_search.h"
+
+namespace {
+
+// A buffer of lineCount log lines. One line in 100,000 reports a watchdog
+// reset, the kind of rare event a search over a long capture looks for.
+std::shared_ptr<imterm::TerminalData> LogBuffer(size_t lineCount)
+{
+    static const char* const tags[] = {
+        "wifi", "esp_netif_handlers", "phy_init", "app_main", "mqtt_client", "nvs"};
+    static const char* const words[] = {
+        "connected", "rssi", "free", "heap", "bytes", "ok", "retry", "timeout", "0x3ffb2c10"};
+
+    imterm::bench::Lcg random(1);
+    std::vector<std::string> lines;
+    lines.reserve(lineCount);
+    for (size_t i = 0; i < lineCount; ++i) {
+        std::string line = "I (";
+        line += std::to_string(i * 17);
+        line += ") ";
+        line += tags[random.Below(std::size(tags))];
+        line += ":";
+        for (uint32_t word = 3 + random.Below(8); word > 0; --word) {
+            line += " ";
+            line += words[random.Below(std::size(words))];
+        }
+        if (i % 100'000 == 50'000) {
+            line += " rst:0x8 (TG1WDT_SYS_RESET)";
+        }
+        lines.push_back(std::move(line));
+    }
+
+    auto data = std::make_shared<imterm::TerminalData>();
+    data->SetTextLines(lines);
+    return data;
+}
+
+// Builds the index for a full buffer from scratch, the work done in
+// Update() slices after a search is first opened.
+void BM_SearchIndexCatchUp(benchmark::State& state)
+{
+    const auto data = LogBuffer(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        imterm::TerminalSearch search(data);
+        while (!search.Update()) {
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * data->GetLineCount()));
+}
+
+// Runs a query over the whole buffer and reports how long the first match
+// took to be published next to the time to finish. The search runs on its
+// own thread, so these are timed in real time.
+void SearchBuffer(benchmark::State& state, const imterm::TerminalSearch::Query& query)
+{
+    const auto data = LogBuffer(static_cast<size_t>(state.range(0)));
+    imterm::TerminalSearch search(data);
+    while (!search.Update()) {
+    }
+
+    using Clock = std::chrono::steady_clock;
+    for (auto _ : state) {
+        const auto start = Clock::now();
+        search.Start(query);
+        double firstMatchMs = -1;
+        for (imterm::TerminalSearch::Progress progress = search.GetProgress(); !progress.mFinished;
+            progress = search.GetProgress()) {
+            if (firstMatchMs < 0 && progress.mMatches > 0) {
+                firstMatchMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            }
+            std::this_thread::yield();
+        }
+        const auto progress = search.GetProgress();
+        if (firstMatchMs < 0 && progress.mMatches > 0) {
+            firstMatchMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+        state.counters["first_match_ms"] = firstMatchMs;
+        state.counters["matches"] = static_cast<double>(progress.mMatches);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * data->GetLineCount()));
+}
+
+void BM_SearchRareSubstring(benchmark::State& state)
+{
+    SearchBuffer(state, { "WDT_SYS_RESET" });
+}
+
+void BM_SearchCommonSubstring(benchmark::State& state)
+{
+    SearchBuffer(state, { "timeout" });
+}
+
+void BM_SearchRareRegex(benchmark::State& state)
+{
+    SearchBuffer(state, { R"(rst:0x[0-9a-f]+ \(\w+\))", true });
+}
+
+// 10M lines needs about 2 GB for the buffer and its index.
+BENCHMARK(BM_SearchIndexCatchUp)
+    ->Arg(1'000'000)
+    ->Arg(10'000'000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SearchRareSubstring)
+    ->Arg(1'000'000)
+    ->Arg(10'000'000)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SearchCommonSubstring)
+    ->Arg(1'000'000)
+    ->Arg(10'000'000)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SearchRareRegex)
+    ->Arg(1'000'000)
+    ->Arg(10'000'000)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
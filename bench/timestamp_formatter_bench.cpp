@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
+#include "timestamp_formatter.h"
+
+namespace {
+
+// Timestamps of lines arriving every 100 us, as in a busy boot log, so most
+// lines share their second with the previous one.
+std::vector<imterm::TimestampFormatter::Timestamp> LineTimes()
+{
+    std::vector<imterm::TimestampFormatter::Timestamp> times(1 << 16);
+    auto time = std::chrono::system_clock::now();
+    for (auto& entry : times) {
+        entry = time;
+        time += std::chrono::microseconds(100);
+    }
+    return times;
+}
+
+// The margin and log formatting before TimestampFormatter.
+void BM_TimestampLocaltime(benchmark::State& state)
+{
+    const auto times = LineTimes();
+    char text[16];
+    for (auto _ : state) {
+        for (const auto& time : times) {
+            const std::time_t t = std::chrono::system_clock::to_time_t(time);
+            benchmark::DoNotOptimize(std::strftime(text, sizeof(text), "%H:%M:%S", std::localtime(&t)));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * times.size()));
+}
+
+// range(0) is the TimestampResolution.
+void BM_TimestampFormatter(benchmark::State& state)
+{
+    const auto times = LineTimes();
+    const auto resolution = static_cast<imterm::TimestampResolution>(state.range(0));
+    imterm::TimestampFormatter formatter;
+    char text[imterm::TimestampFormatter::MaxLength];
+    for (auto _ : state) {
+        for (const auto& time : times) {
+            benchmark::DoNotOptimize(formatter.Format(time, resolution, text));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * times.size()));
+}
+
+BENCHMARK(BM_TimestampLocaltime);
+BENCHMARK(BM_TimestampFormatter)->Arg(0)->Arg(1)->Arg(2);
+
+} // namespace
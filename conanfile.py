@@ -25,6 +25,7 @@ class ImGuiExample(ConanFile):
 
     def build_requirements(self):
         self.test_requires("gtest/1.17.0")
+        self.test_requires("benchmark/1.9.1")
 
     def generate(self):
 
@@ -140,6 +140,9 @@ public:
   string
   getPort () const;
 
+  int
+  getFileDescriptor () const;
+
   void
   setTimeout (Timeout &timeout);
 
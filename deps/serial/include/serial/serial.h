@@ -230,6 +230,14 @@ public:
   bool
   waitReadable ();
 
+#if !defined(_WIN32)
+  /*! Returns the file descriptor of the open port, or -1 when it is closed,
+   * so the port can be waited on with poll() or epoll together with other
+   * descriptors. Reads and writes must still go through this object. */
+  int
+  getFileDescriptor () const;
+#endif
+
   /*! Block for a period of time corresponding to the transmission time of
    * count characters at present serial settings. This may be used in con-
    * junction with waitReadable to read larger blocks of data from the
@@ -724,6 +724,12 @@ Serial::SerialImpl::getPort () const
   return port_;
 }
 
+int
+Serial::SerialImpl::getFileDescriptor () const
+{
+  return is_open_ ? fd_ : -1;
+}
+
 void
 Serial::SerialImpl::setTimeout (serial::Timeout &timeout)
 {
@@ -298,6 +298,14 @@ Serial::getPort () const
   return pimpl_->getPort ();
 }
 
+#if !defined(_WIN32)
+int
+Serial::getFileDescriptor () const
+{
+  return pimpl_->getFileDescriptor ();
+}
+#endif
+
 void
 Serial::setTimeout (serial::Timeout &timeout)
 {
@@ -0,0 +1,168 @@
+#include "block_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace imterm {
+
+	namespace {
+
+		constexpr size_t MinMatch = 4;
+		constexpr size_t MaxDistance = 65535;
+		constexpr unsigned HashBits = 14;
+
+		uint32_t Load32(const uint8_t* aBytes)
+		{
+			uint32_t value;
+			std::memcpy(&value, aBytes, sizeof(value));
+			return value;
+		}
+
+		size_t Hash(uint32_t aValue)
+		{
+			return (aValue * 2654435761u) >> (32 - HashBits);
+		}
+
+		void PutLength(std::vector<uint8_t>& aOut, size_t aLength)
+		{
+			for (; aLength >= 255; aLength -= 255) {
+				aOut.push_back(255);
+			}
+			aOut.push_back(static_cast<uint8_t>(aLength));
+		}
+
+		// A match length of zero writes the final, literal-only sequence.
+		void PutSequence(std::vector<uint8_t>& aOut, std::span<const uint8_t> aLiterals, size_t aMatchLength, size_t aDistance)
+		{
+			const size_t literalCount = aLiterals.size();
+			const size_t matchCode = aMatchLength == 0 ? 0 : aMatchLength - MinMatch;
+			aOut.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+			if (literalCount >= 15) {
+				PutLength(aOut, literalCount - 15);
+			}
+			aOut.insert(aOut.end(), aLiterals.begin(), aLiterals.end());
+			if (aMatchLength != 0) {
+				aOut.push_back(static_cast<uint8_t>(aDistance & 0xff));
+				aOut.push_back(static_cast<uint8_t>(aDistance >> 8));
+				if (matchCode >= 15) {
+					PutLength(aOut, matchCode - 15);
+				}
+			}
+		}
+
+		[[noreturn]] void Malformed()
+		{
+			throw std::out_of_range("Compressed block is malformed");
+		}
+
+	}
+
+	void CompressBlock(std::span<const uint8_t> aInput, std::vector<uint8_t>& aOut)
+	{
+		const uint8_t* bytes = aInput.data();
+		const size_t size = aInput.size();
+		size_t anchor = 0;
+
+		if (size >= MinMatch) {
+			// Position + 1 of the last place each hash was seen; zero for none.
+			std::vector<size_t> table(size_t{ 1 } << HashBits, 0);
+			size_t position = 0;
+			while (position + MinMatch <= size) {
+				const uint32_t value = Load32(bytes + position);
+				size_t& slot = table[Hash(value)];
+				const size_t candidate = slot;
+				slot = position + 1;
+
+				if (candidate == 0 || position - (candidate - 1) > MaxDistance || Load32(bytes + candidate - 1) != value) {
+					// Step faster through input that is not compressing.
+					position += 1 + ((position - anchor) >> 6);
+					continue;
+				}
+
+				size_t match = candidate - 1;
+				while (position > anchor && match > 0 && bytes[position - 1] == bytes[match - 1]) {
+					--position;
+					--match;
+				}
+				size_t length = MinMatch;
+				while (position + length < size && bytes[match + length] == bytes[position + length]) {
+					++length;
+				}
+
+				PutSequence(aOut, aInput.subspan(anchor, position - anchor), length, position - match);
+				position += length;
+				anchor = position;
+			}
+		}
+
+		PutSequence(aOut, aInput.subspan(anchor), 0, 0);
+	}
+
+	void DecompressBlock(std::span<const uint8_t> aInput, std::span<uint8_t> aOut)
+	{
+		size_t in = 0;
+		size_t out = 0;
+		const auto readLength = [&](size_t aLength) {
+			if (aLength == 15) {
+				uint8_t more;
+				do {
+					if (in >= aInput.size()) {
+						Malformed();
+					}
+					more = aInput[in++];
+					aLength += more;
+				} while (more == 255);
+			}
+			return aLength;
+		};
+
+		while (true) {
+			if (in >= aInput.size()) {
+				Malformed();
+			}
+			const uint8_t token = aInput[in++];
+
+			const size_t literalCount = readLength(token >> 4);
+			if (literalCount > aInput.size() - in || literalCount > aOut.size() - out) {
+				Malformed();
+			}
+			if (literalCount != 0) {
+				std::memcpy(aOut.data() + out, aInput.data() + in, literalCount);
+				in += literalCount;
+				out += literalCount;
+			}
+			if (in == aInput.size()) {
+				break;
+			}
+
+			if (aInput.size() - in < 2) {
+				Malformed();
+			}
+			const size_t distance = aInput[in] | (size_t{ aInput[in + 1] } << 8);
+			in += 2;
+			const size_t length = readLength(token & 15) + MinMatch;
+			if (distance == 0 || distance > out || length > aOut.size() - out) {
+				Malformed();
+			}
+
+			uint8_t* target = aOut.data() + out;
+			const uint8_t* source = target - distance;
+			if (distance >= length) {
+				std::memcpy(target, source, length);
+			}
+			else {
+				// The match overlaps the bytes it is producing, as in a run.
+				for (size_t index = 0; index < length; ++index) {
+					target[index] = source[index];
+				}
+			}
+			out += length;
+		}
+
+		if (out != aOut.size()) {
+			Malformed();
+		}
+	}
+
+}
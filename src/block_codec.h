@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace imterm {
+
+	// A small LZ77 compressor in the style of LZ4, for scrollback blocks that
+	// repeat the same log prefixes, tags and color runs line after line.
+	//
+	// Compressed data is a series of sequences. Each starts with a token byte
+	// whose high nibble is a literal count and low nibble a match length less
+	// four; a nibble of 15 means length bytes follow, each adding up to 255,
+	// ending with the first byte below 255. The literals come next, then the
+	// match as a two-byte little-endian distance back into the output and any
+	// match length bytes. The last sequence has literals only. The compressed
+	// data does not record its own length; callers keep it.
+
+	// Appends the compressed form of aInput to aOut.
+	void CompressBlock(std::span<const uint8_t> aInput, std::vector<uint8_t>& aOut);
+
+	// Decompresses aInput, which must expand to exactly aOut.size() bytes.
+	// Throws std::out_of_range if it is malformed.
+	void DecompressBlock(std::span<const uint8_t> aInput, std::span<uint8_t> aOut);
+
+}
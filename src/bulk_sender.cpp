@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <stdexcept>
+
+#include "bulk_sender.h"
+
+namespace imterm {
+
+	namespace {
+
+		// One past the end of the first line in aBytes from aOffset up to
+		// aEnd, or aEnd when no line ends there. A CR at aEnd - 1 takes the LF
+		// after it along, so CR LF is never split into two lines.
+		size_t LineEnd(std::span<const uint8_t> aBytes, size_t aOffset, size_t aEnd)
+		{
+			for (size_t i = aOffset; i < aEnd; ++i) {
+				if (aBytes[i] == '\n') {
+					return i + 1;
+				}
+				if (aBytes[i] == '\r') {
+					return i + 1 < aBytes.size() && aBytes[i + 1] == '\n' ? i + 2 : i + 1;
+				}
+			}
+			return aEnd;
+		}
+
+		bool EndsLine(std::span<const uint8_t> aBytes, size_t aEnd)
+		{
+			return aEnd > 0 && (aBytes[aEnd - 1] == '\n'
+				|| (aBytes[aEnd - 1] == '\r' && (aEnd == aBytes.size() || aBytes[aEnd] != '\n')));
+		}
+
+	}
+
+	BulkSender::BulkSender(std::shared_ptr<Transport> aTransport)
+		: mTransport(std::move(aTransport))
+	{
+	}
+
+	BulkSender::~BulkSender()
+	{
+		Cancel();
+	}
+
+	bool BulkSender::Start(std::vector<uint8_t> aBytes, const Pacing& aPacing)
+	{
+		if (IsRunning()) {
+			return false;
+		}
+		Cancel();
+		mFile.reset();
+		mBytes = std::move(aBytes);
+		mSource = mBytes;
+		return Launch(aPacing);
+	}
+
+	bool BulkSender::Start(const std::filesystem::path& aPath, const Pacing& aPacing)
+	{
+		if (IsRunning()) {
+			return false;
+		}
+		auto file = std::make_unique<MappedFile>(aPath);
+		Cancel();
+		mBytes = {};
+		mFile = std::move(file);
+		mSource = mFile->GetBytes();
+		return Launch(aPacing);
+	}
+
+	bool BulkSender::Launch(const Pacing& aPacing)
+	{
+		{
+			// Observe() reads the pacing under the lock, and may still be
+			// finishing a call for the last send.
+			std::lock_guard<std::mutex> lock(mMutex);
+			mPacing = aPacing;
+			mPacing.ChunkSize = std::max<size_t>(mPacing.ChunkSize, 1);
+
+			// Knuth-Morris-Pratt, so a prompt is found however the reads cut it.
+			const std::string& prompt = mPacing.Prompt;
+			mPromptFallback.assign(prompt.size() + 1, 0);
+			for (size_t i = 1, matched = 0; i < prompt.size(); ++i) {
+				while (matched > 0 && prompt[i] != prompt[matched]) {
+					matched = mPromptFallback[matched];
+				}
+				if (prompt[i] == prompt[matched]) {
+					++matched;
+				}
+				mPromptFallback[i + 1] = matched;
+			}
+
+			mCancelRequested = false;
+			mXoff = false;
+			mPromptMatched = 0;
+			mPromptsSeen = 0;
+			mError.reset();
+		}
+		mBytesSent.store(0, std::memory_order_relaxed);
+		mElapsed.store(0, std::memory_order_relaxed);
+		mHeldByDevice.store(false, std::memory_order_relaxed);
+		mWaitingForPrompt.store(false, std::memory_order_relaxed);
+		mObserving.store(!mPacing.Prompt.empty() || mPacing.HonorXonXoff, std::memory_order_release);
+		mStartTime = Clock::now();
+		mOutcome.store(Outcome::Running, std::memory_order_release);
+		mThread = std::thread([this] { Run(); });
+		return true;
+	}
+
+	void BulkSender::Cancel()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mCancelRequested = true;
+		}
+		mWake.notify_all();
+		if (mThread.joinable()) {
+			mThread.join();
+		}
+	}
+
+	template<typename Predicate>
+	bool BulkSender::WaitUntil(Clock::duration aDuration, Predicate aDone)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mWake.wait_for(lock, aDuration, [&] { return mCancelRequested || aDone(); });
+		return !mCancelRequested;
+	}
+
+	bool BulkSender::WriteAll(std::span<const uint8_t> aChunk)
+	{
+		while (!aChunk.empty()) {
+			if (mPacing.HonorXonXoff) {
+				std::unique_lock<std::mutex> lock(mMutex);
+				if (mXoff) {
+					mHeldByDevice.store(true, std::memory_order_relaxed);
+					mWake.wait(lock, [this] { return mCancelRequested || !mXoff; });
+				}
+				if (mCancelRequested) {
+					return false;
+				}
+			}
+
+			const std::array<std::span<const uint8_t>, 1> buffers{ aChunk };
+			const size_t count = mTransport->Write(buffers);
+			if (count == 0) {
+				mHeldByDevice.store(true, std::memory_order_relaxed);
+				if (!WaitUntil(RetryInterval, [] { return false; })) {
+					return false;
+				}
+				continue;
+			}
+
+			mHeldByDevice.store(false, std::memory_order_relaxed);
+			mBytesSent.fetch_add(count, std::memory_order_relaxed);
+			aChunk = aChunk.subspan(count);
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mCancelRequested) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void BulkSender::Run()
+	{
+		const std::span<const uint8_t> source = mSource;
+		const bool perLine = mPacing.LineDelay.count() > 0 || !mPacing.Prompt.empty();
+		const double rate = mPacing.BytesPerMillisecond;
+		// Token bucket, refilled at the rate and holding at most RateBurst of
+		// it, so pauses for lines and prompts do not turn into bursts.
+		const double burst = std::max(1.0, rate * static_cast<double>(RateBurst.count()));
+		double tokens = 0.0;
+		Clock::time_point refilled = Clock::now();
+
+		Outcome outcome = Outcome::Finished;
+		try {
+			size_t offset = 0;
+			uint64_t promptsBefore = 0;
+			while (offset < source.size()) {
+
+				size_t end = std::min(source.size(), offset + mPacing.ChunkSize);
+				if (perLine) {
+					end = LineEnd(source, offset, end);
+				}
+
+				if (rate > 0.0) {
+					const Clock::time_point now = Clock::now();
+					tokens = std::min(burst, tokens + rate * std::chrono::duration<double, std::milli>(now - refilled).count());
+					refilled = now;
+					if (tokens < 1.0) {
+						const auto wait = std::chrono::duration<double, std::milli>((1.0 - tokens) / rate);
+						if (!WaitUntil(std::chrono::duration_cast<Clock::duration>(wait), [] { return false; })) {
+							outcome = Outcome::Cancelled;
+							break;
+						}
+						continue;
+					}
+					end = std::min(end, offset + static_cast<size_t>(tokens));
+					tokens -= static_cast<double>(end - offset);
+				}
+
+				if (!WriteAll(source.subspan(offset, end - offset))) {
+					outcome = Outcome::Cancelled;
+					break;
+				}
+				offset = end;
+
+				if (!perLine || !EndsLine(source, end) || offset == source.size()) {
+					continue;
+				}
+
+				if (!mPacing.Prompt.empty()) {
+					mWaitingForPrompt.store(true, std::memory_order_relaxed);
+					bool prompted = false;
+					const bool running = WaitUntil(mPacing.PromptTimeout, [&] {
+						prompted = mPromptsSeen > promptsBefore;
+						return prompted;
+					});
+					mWaitingForPrompt.store(false, std::memory_order_relaxed);
+					if (!running) {
+						outcome = Outcome::Cancelled;
+						break;
+					}
+					if (!prompted) {
+						throw std::runtime_error("The device did not print its prompt within "
+							+ std::to_string(mPacing.PromptTimeout.count()) + " ms");
+					}
+					std::lock_guard<std::mutex> lock(mMutex);
+					promptsBefore = mPromptsSeen;
+				}
+				if (mPacing.LineDelay.count() > 0 && !WaitUntil(mPacing.LineDelay, [] { return false; })) {
+					outcome = Outcome::Cancelled;
+					break;
+				}
+			}
+		}
+		catch (const std::exception& ex) {
+			std::lock_guard<std::mutex> lock(mMutex);
+			mError = ex.what();
+			outcome = Outcome::Failed;
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mMutex);
+			mError = "Unknown send error";
+			outcome = Outcome::Failed;
+		}
+
+		Finish(outcome);
+	}
+
+	void BulkSender::Finish(Outcome aOutcome)
+	{
+		mObserving.store(false, std::memory_order_relaxed);
+		mHeldByDevice.store(false, std::memory_order_relaxed);
+		mElapsed.store(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mStartTime).count(),
+			std::memory_order_relaxed);
+		mOutcome.store(aOutcome, std::memory_order_release);
+	}
+
+	void BulkSender::Observe(std::span<const uint8_t> aBytes)
+	{
+		if (!mObserving.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		bool wake = false;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			const std::string& prompt = mPacing.Prompt;
+			for (const uint8_t byte : aBytes) {
+				if (mPacing.HonorXonXoff && (byte == Xon || byte == Xoff)) {
+					mXoff = byte == Xoff;
+					wake = wake || !mXoff;
+				}
+				if (prompt.empty()) {
+					continue;
+				}
+				while (mPromptMatched > 0 && static_cast<char>(byte) != prompt[mPromptMatched]) {
+					mPromptMatched = mPromptFallback[mPromptMatched];
+				}
+				if (static_cast<char>(byte) == prompt[mPromptMatched] && ++mPromptMatched == prompt.size()) {
+					++mPromptsSeen;
+					mPromptMatched = mPromptFallback[mPromptMatched];
+					wake = true;
+				}
+			}
+		}
+		if (wake) {
+			mWake.notify_all();
+		}
+	}
+
+	BulkSender::Progress BulkSender::GetProgress() const
+	{
+		Progress progress;
+		progress.mOutcome = mOutcome.load(std::memory_order_acquire);
+		progress.mBytesSent = mBytesSent.load(std::memory_order_relaxed);
+		progress.mTotalBytes = mSource.size();
+		if (progress.mOutcome == Outcome::Running) {
+			progress.mElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mStartTime);
+		}
+		else {
+			progress.mElapsed = std::chrono::nanoseconds(mElapsed.load(std::memory_order_relaxed));
+		}
+		const double seconds = std::chrono::duration<double>(progress.mElapsed).count();
+		if (seconds > 0.0) {
+			progress.mBytesPerSecond = static_cast<double>(progress.mBytesSent) / seconds;
+		}
+		progress.mHeldByDevice = mHeldByDevice.load(std::memory_order_relaxed);
+		progress.mWaitingForPrompt = mWaitingForPrompt.load(std::memory_order_relaxed);
+		return progress;
+	}
+
+	std::optional<std::string> BulkSender::TakeError()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::optional<std::string> error = std::move(mError);
+		mError.reset();
+		return error;
+	}
+
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+#include "transport.h"
+
+namespace imterm {
+
+	// Streams a paste or a file to a Transport on a dedicated thread, in
+	// chunks rather than a byte per write, optionally paced for devices with
+	// small receive buffers, and reports its progress.
+	//
+	// Without pacing each write is a whole chunk, so the link runs at full
+	// speed when the device keeps up. With hardware flow control the port
+	// driver holds writes while CTS is off; a write that takes nothing is
+	// retried rather than treated as an error, until the send is cancelled.
+	// XON/XOFF from the device can be honored here too, for ports that are
+	// not configured for software flow control; Observe() must then see the
+	// received bytes, which CaptureSession arranges.
+	//
+	// Writes go to the transport directly, alongside the session's
+	// SendWorker, so keystrokes and terminal replies are still sent during a
+	// long upload, between chunks.
+	class BulkSender {
+
+	public:
+
+		using Clock = std::chrono::steady_clock;
+
+		// At 115200 baud a chunk takes about 90 ms to go out, which bounds
+		// how long Cancel() waits for a write in progress.
+		static constexpr size_t DefaultChunkSize = 1024;
+		// How long the sender waits before retrying a write that took nothing.
+		static constexpr std::chrono::milliseconds RetryInterval{ 1 };
+		// A rate-limited sender writes at most this much of its rate at once.
+		static constexpr std::chrono::milliseconds RateBurst{ 10 };
+
+		static constexpr uint8_t Xon = 0x11;
+		static constexpr uint8_t Xoff = 0x13;
+
+		struct Pacing {
+			size_t ChunkSize = DefaultChunkSize;
+			// Most bytes written per millisecond; 0 for no limit.
+			double BytesPerMillisecond = 0.0;
+			// Pause after each line, CR, LF or CR LF, but the last.
+			std::chrono::milliseconds LineDelay{ 0 };
+			// After each line, wait until the device prints this, usually its
+			// command prompt. Empty to not wait. The send fails when the prompt
+			// does not come within PromptTimeout.
+			std::string Prompt;
+			std::chrono::milliseconds PromptTimeout{ 5000 };
+			// Stop writing on XOFF from the device until XON.
+			bool HonorXonXoff = false;
+		};
+
+		enum class Outcome {
+			None,       // nothing sent yet
+			Running,
+			Finished,
+			Cancelled,
+			Failed      // see TakeError()
+		};
+
+		struct Progress {
+			uint64_t mBytesSent = 0;
+			uint64_t mTotalBytes = 0;
+			// Since the send started, up to when it ended.
+			std::chrono::nanoseconds mElapsed{ 0 };
+			double mBytesPerSecond = 0.0;
+			Outcome mOutcome = Outcome::None;
+			// The device holds the send off with XOFF, or the transport takes
+			// nothing, as with CTS off.
+			bool mHeldByDevice = false;
+			bool mWaitingForPrompt = false;
+		};
+
+		explicit BulkSender(std::shared_ptr<Transport> aTransport);
+		~BulkSender();
+
+		BulkSender(const BulkSender&) = delete;
+		BulkSender& operator=(const BulkSender&) = delete;
+
+		// Starts sending aBytes. Returns false, and does nothing, while an
+		// earlier send is running.
+		bool Start(std::vector<uint8_t> aBytes, const Pacing& aPacing);
+		// Starts sending the file at aPath, mapped rather than read in. Throws
+		// std::system_error if it cannot be opened.
+		bool Start(const std::filesystem::path& aPath, const Pacing& aPacing);
+
+		// Stops the send after the write in progress and waits for it.
+		void Cancel();
+
+		bool IsRunning() const { return mOutcome.load(std::memory_order_acquire) == Outcome::Running; }
+
+		Progress GetProgress() const;
+
+		// Returns the message of the error that failed the last send, once.
+		std::optional<std::string> TakeError();
+
+		// Called with received bytes, on any one thread. Watches for the
+		// prompt and XON/XOFF while a send runs and returns at once otherwise.
+		void Observe(std::span<const uint8_t> aBytes);
+
+	private:
+
+		bool Launch(const Pacing& aPacing);
+		void Run();
+		// Writes aChunk, retrying while the transport takes nothing. Returns
+		// false when cancelled.
+		bool WriteAll(std::span<const uint8_t> aChunk);
+		// Waits for aDuration or until aDone returns true, with mMutex held
+		// while aDone runs. Returns false when cancelled first.
+		template<typename Predicate>
+		bool WaitUntil(Clock::duration aDuration, Predicate aDone);
+		void Finish(Outcome aOutcome);
+
+		std::shared_ptr<Transport> mTransport;
+
+		// The source; set before the thread starts.
+		std::vector<uint8_t> mBytes;
+		std::unique_ptr<MappedFile> mFile;
+		std::span<const uint8_t> mSource;
+		Pacing mPacing;
+		// Prompt matching state: the longest prefix of the prompt that is
+		// also a suffix of the prompt's first i bytes, for each i.
+		std::vector<size_t> mPromptFallback;
+
+		std::thread mThread;
+		Clock::time_point mStartTime;
+		std::atomic<int64_t> mElapsed{ 0 };
+		std::atomic<uint64_t> mBytesSent{ 0 };
+		std::atomic<Outcome> mOutcome{ Outcome::None };
+		std::atomic<bool> mHeldByDevice{ false };
+		std::atomic<bool> mWaitingForPrompt{ false };
+		// Whether Observe() has anything to watch for.
+		std::atomic<bool> mObserving{ false };
+
+		// Guards the rest, which Observe() and the sender share.
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		bool mCancelRequested = false;
+		bool mXoff = false;
+		size_t mPromptMatched = 0;
+		uint64_t mPromptsSeen = 0;
+		std::optional<std::string> mError;
+	};
+
+}
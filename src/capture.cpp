@@ -1,5 +1,6 @@
 #include <vector>
 #include <algorithm>
+#include <array>
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -10,11 +11,21 @@
 #include <string>
 #include <string_view>
 #include <filesystem>
+#include <utility>
 #include <memory>
+#include <cctype>
+#include <functional>
+#include <optional>
+#include <span>
 
 #include "imgui.h"
+#include "bulk_sender.h"
 #include "capture.h"
+#include "capture_replay.h"
+#include "capture_session.h"
+#include "receive_reactor.h"
 #include "serial/serial.h"
+#include "serial_transport.h"
 #include "terminal_view.h"
 #include "ImGuiFileDialog.h"
 
@@ -30,123 +41,867 @@ namespace imterm {
         not_connected = 0,
         connected = 1,
         reconnecting = 2,
-        reconfiguring = 3
+        reconfiguring = 3,
+        replaying = 4
     };
 
-    static ConnectionStage serial_init = ConnectionStage::not_connected;
-    static Serial * serial;
+    // One capture: a port, or a recording being replayed, with the terminal
+    // that shows it and everything that logs, records and sends. With more
+    // than one, each is a tab.
+    struct Capture {
+        // Names the tab, so it keeps its place when the port changes.
+        uint32_t id = 0;
+        ConnectionStage stage = ConnectionStage::not_connected;
+        std::unique_ptr<Serial> serial;
+        std::string error_message;
+        bool render_view = false;
+        bool dtr = false;
+        bool rts = false;
+        system_clock::time_point last_reconnect_attempt;
+
+        std::shared_ptr<TerminalLogger> term_log;
+        std::shared_ptr<TerminalData> term_data;
+        std::shared_ptr<TerminalState> term_state;
+        std::shared_ptr<TerminalView> term_view;
+        std::shared_ptr<ReceiveJournal> term_journal;
+        // Stopped before the port closes, as the members go in reverse.
+        std::unique_ptr<CaptureSession> capture_session;
+        std::unique_ptr<CaptureReplay> term_replay;
+        bool replay_indexing = false;
+
+        // Cleared by the tab's close button.
+        bool open = true;
+        // Selects the tab on the next frame.
+        bool select = false;
+    };
+
+    static std::vector<std::unique_ptr<Capture>> captures;
+    // The selected tab, which the menus, dialogs and setup windows act on.
+    static size_t current_capture = 0;
+    static uint32_t next_capture_id = 1;
+    // The capture a file chosen in the send dialog goes to.
+    static uint32_t send_file_capture = 0;
+
     static std::string serial_name = "[Not Connected]";
     static std::string connection_message = "";
-    static std::string capture_error_message = "";
     static bool auto_reconnect = true;
-    static bool render_view = false;
     static bool enable_logging = false;
     static bool auto_scroll = true;
-    
-    static std::shared_ptr<TerminalLogger> term_log(nullptr);
-    static std::shared_ptr<TerminalData> term_data(nullptr);
-    static std::shared_ptr<TerminalState> term_state(nullptr);
-    static std::shared_ptr<TerminalView> term_view(nullptr);
+
+    static double replay_speed = 1.0;
+    static std::function<void()> wake_main_loop;
+    static BulkSender::Pacing send_pacing;
+    static bool send_wait_for_prompt = false;
+    static std::array<char, 32> send_prompt{ "> " };
+    // Reads every port on one thread; see GetReceiveReactor().
+    static std::shared_ptr<ReceiveReactor> receive_reactor;
 
     static auto settings = CaptureSettings();
 
     constexpr std::chrono::seconds port_cache_duration = 1s;
 
-    void CaptureWindowCreate(void) {
+    static Capture& AddCapture() {
+        captures.push_back(std::make_unique<Capture>());
+        captures.back()->id = next_capture_id++;
+        return *captures.back();
+    }
 
-        static bool capture_window_init = false;
+    static Capture& CurrentCapture() {
+        if (captures.empty()) {
+            AddCapture();
+        }
+        current_capture = std::min(current_capture, captures.size() - 1);
+        return *captures[current_capture];
+    }
 
-        if (!capture_window_init) {
-            capture_window_init = true;
+    static Capture* FindCapture(uint32_t id) {
+        for (auto& capture : captures) {
+            if (capture->id == id) {
+                return capture.get();
+            }
         }
+        return nullptr;
+    }
 
+    // Whether a capture other than aExcept holds aPort open, or is trying to
+    // reopen it.
+    static bool PortInUse(const std::string& aPort, const Capture* aExcept) {
+        return std::any_of(captures.begin(), captures.end(), [&](const std::unique_ptr<Capture>& capture) {
+            return capture.get() != aExcept
+                && capture->serial
+                && (capture->serial->isOpen() || capture->stage == ConnectionStage::reconnecting)
+                && capture->serial->getPort() == aPort;
+        });
+    }
 
-        ImGui::Begin(serial_name.c_str(), nullptr, ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoTitleBar);
+    // A file in the temp directory named like the log for aPort.
+    static std::filesystem::path TemporaryCapturePath(const std::string& aPort, const std::string& aExtension) {
+        std::string name = "imterm-" + aPort + "-" + std::to_string(system_clock::to_time_t(system_clock::now())) + aExtension;
+        std::replace_if(name.begin(), name.end(), [](char c) {
+            return !std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '.';
+        }, '_');
+        return std::filesystem::temp_directory_path() / name;
+    }
 
-        Menu();
+    // Menu items for the timestamp resolutions and for which line times are
+    // shown. Returns true when either was changed.
+    static bool TimestampFormatMenu(TimestampResolution& aResolution, LineTimestampKind& aKind) {
+        static constexpr std::pair<const char*, TimestampResolution> resolutions[] = {
+            { "Seconds", TimestampResolution::Seconds },
+            { "Milliseconds", TimestampResolution::Milliseconds },
+            { "Microseconds", TimestampResolution::Microseconds },
+        };
+        static constexpr std::pair<const char*, LineTimestampKind> kinds[] = {
+            { "Last Byte", LineTimestampKind::LastByte },
+            { "First Byte", LineTimestampKind::FirstByte },
+            { "First and Last Byte", LineTimestampKind::FirstAndLastByte },
+        };
+        bool changed = false;
+        for (const auto& [label, resolution] : resolutions) {
+            if (ImGui::MenuItem(label, NULL, aResolution == resolution) && aResolution != resolution) {
+                aResolution = resolution;
+                changed = true;
+            }
+        }
+        ImGui::Separator();
+        for (const auto& [label, kind] : kinds) {
+            if (ImGui::MenuItem(label, NULL, aKind == kind) && aKind != kind) {
+                aKind = kind;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    // The thread that reads every open port, so a bench of UARTs costs one
+    // thread and an idle port costs nothing. Null where it is not supported
+    // or could not start; each session then reads on a thread of its own.
+    static std::shared_ptr<ReceiveReactor> GetReceiveReactor() {
+        if (!receive_reactor && ReceiveReactor::IsSupported()) {
+            try {
+                receive_reactor = std::make_shared<ReceiveReactor>();
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Could not start the receive reactor. " << e.what() << "\n";
+            }
+        }
+        return receive_reactor;
+    }
 
-        if (term_view && render_view) {
-            term_view->Render("TerminalView");
+    // The name of the capture: its port or recording.
+    static std::string CaptureLabel(const Capture& capture) {
+        if (capture.term_replay) {
+            return "Replay " + capture.term_replay->GetRecording().GetPath().filename().string();
+        }
+        else if (capture.serial) {
+            return capture.serial->getPort();
         }
+        return "No Connection";
+    }
 
-        if (!capture_error_message.empty()) {
-            ImGui::TextColored(
-                ImVec4(1.0f, 0.35f, 0.35f, 1.0f),
-                "%s", capture_error_message.c_str());
+    // Sends the keystrokes typed into aView this frame to aSession's writer
+    // thread, in batches; a device that is slow to take them never stalls
+    // the frame.
+    static void SendKeyboardInput(TerminalView& aView, CaptureSession& aSession) {
+        std::array<uint8_t, 64> keyboard_input;
+        while (aView.KeyboardInputAvailable()) {
+            size_t keyboard_input_count = 0;
+            while (keyboard_input_count < keyboard_input.size() && aView.KeyboardInputAvailable()) {
+                ImWchar keyboard_input_wide = aView.GetKeyboardInput();
+                keyboard_input[keyboard_input_count++] = static_cast<uint8_t>(keyboard_input_wide);
+            }
+            aSession.Send(std::span(keyboard_input).first(keyboard_input_count));
         }
+    }
 
-        ImGui::End();
+    static BulkSender* GetBulkSender(const Capture& capture) {
+        return capture.capture_session ? capture.capture_session->GetBulkSender() : nullptr;
+    }
+
+    static BulkSender::Pacing SendPacing() {
+        BulkSender::Pacing pacing = send_pacing;
+        pacing.Prompt = send_wait_for_prompt ? std::string(send_prompt.data()) : std::string();
+        return pacing;
+    }
+
+    // Streams a paste to the capture's port in chunks. Returns false while
+    // another send runs, so the paste is typed instead.
+    static bool SendPaste(const Capture& capture, std::string_view text) {
+        BulkSender* sender = GetBulkSender(capture);
+        return sender && sender->Start(std::vector<uint8_t>(text.begin(), text.end()), SendPacing());
+    }
 
-        if (term_view && term_state) {
-            if (serial && serial->isOpen()) {
+    static std::string FormatRate(double bytes_per_second) {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(1);
+        if (bytes_per_second >= 1024.0) {
+            oss << bytes_per_second / 1024.0 << " KB/s";
+        }
+        else {
+            oss << bytes_per_second << " B/s";
+        }
+        return oss.str();
+    }
+
+    // Stops the capture's session and closes its port. Returns the port if
+    // it was open.
+    static std::optional<std::string> ClosePort(Capture& capture) {
 
+        std::optional<std::string> returnValue = std::nullopt;
+
+        try {
+
+            bool was_open = false;
+
+            if (capture.capture_session) {
+                // The reader thread must not touch the port while it closes.
+                capture.capture_session->Stop();
+            }
+
+            if (capture.serial) {
+                
+                if (capture.serial->isOpen()) {
+                    was_open = true;
+                    returnValue = capture.serial->getPort();
+                }
+                capture.serial->close();
+            }
+
+            if (auto_reconnect && was_open) {
+                capture.stage = ConnectionStage::reconnecting;
+            }
+            else {
+                capture.stage = ConnectionStage::not_connected;
+            }
+
+        }
+        catch (const serial::IOException& ex) {
+            std::cerr << "Error occurred: " << ex.what() << std::endl;
+        }
+
+        return returnValue;
+    }
+
+    // Opens aPort for the capture. A capture of another port starts a new
+    // terminal, log and journal; reopening the same port keeps them. On
+    // failure connection_message says why.
+    static void OpenPort(Capture& capture, const std::string& port, uint32_t baudrate, serial::Timeout timeout,
+        bytesize_t bytesize, parity_t parity, stopbits_t stopbits,
+        flowcontrol_t flowcontrol) {
+        
+        std::optional<std::string> oldPort = ClosePort(capture);
+
+        capture.capture_session.reset();
+        capture.term_replay.reset();
+
+        try {
+            capture.serial = std::make_unique<Serial>(
+                port,
+                baudrate,
+                timeout,
+                bytesize,
+                parity,
+                stopbits,
+                flowcontrol
+            );
+
+            if (!oldPort || oldPort.value() != port) {
+                capture.term_log.reset();
+                capture.term_data.reset();
+                capture.term_state.reset();
+                capture.term_view.reset();
+                capture.term_journal.reset();
+            }
+
+            if (!capture.term_log) {
+                auto ops = TerminalLogger::Options();
+                ops.Enabled = enable_logging;
+                ops.Asynchronous = true;
+                capture.term_log = std::make_shared<TerminalLogger>(port, ops);
+            }
+            if (!capture.term_data) {
+                capture.term_data = std::make_shared<TerminalData>(capture.term_log);
+                // Old scrollback goes to disk so long captures don't grow without bound.
+                LineStore::SpillOptions spill;
+                spill.Path = TemporaryCapturePath(port, ".scrollback");
+                spill.Compress = true;
                 try {
+                    capture.term_data->EnableSpill(spill);
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Could not create scrollback file. " << e.what() << "\n";
+                }
+            }
+            if (!capture.term_state) capture.term_state = std::make_shared<TerminalState> (capture.term_data, TerminalState::NewLineMode::Strict);
+            if (!capture.term_view) {
+                capture.term_view = std::make_shared<TerminalView> (capture.term_data, capture.term_state, TerminalView::Options());
+                // The view belongs to the capture, so it never outlives it.
+                capture.term_view->SetPasteHandler([&capture](std::string_view text) { return SendPaste(capture, text); });
+            }
+            if (!capture.term_journal) {
+                // The raw bytes for the hex view.
+                try {
+                    capture.term_journal = std::make_shared<ReceiveJournal>(TemporaryCapturePath(port, ".journal"));
+                }
+                catch (const std::exception& e) {
+                    std::cerr << "Could not create receive journal. " << e.what() << "\n";
+                }
+                capture.term_view->SetJournal(capture.term_journal);
+            }
 
-                    while (term_view->KeyboardInputAvailable()) {
-                        ImWchar keyboard_input_wide = term_view->GetKeyboardInput();
-                        uint8_t keyboard_input = static_cast<uint8_t>(keyboard_input_wide);
-                        serial->write(&keyboard_input, 1);
-                    }
+            capture.capture_session = std::make_unique<CaptureSession>(
+                std::make_shared<SerialTransport>(*capture.serial), capture.term_state);
+            capture.capture_session->SetJournal(capture.term_journal);
+            capture.capture_session->SetReactor(GetReceiveReactor());
+            capture.capture_session->SetReceiveNotifier(wake_main_loop);
+            capture.capture_session->Start();
 
-                    size_t available = serial->available();
 
-                    if (available > 0) {
+            capture.stage = ConnectionStage::connected;
+            capture.render_view = true;
+            
+            
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Could not open port. " << e.what() << "\n";
+            connection_message = "** Unable to open " + port + " **";
+        }
 
-                        std::vector<uint8_t> buffer(available);
-                        serial->read(buffer, available);
-                        term_state->Input(buffer);
+    }
 
-                        if (auto_scroll) {
-                            term_view->SetCursorToEnd();
-                        }
-                    }
+    // Opens aPort with the parameters and new line mode of aFrom, in a new
+    // tab that is then selected.
+    static void OpenPortTab(Capture& aFrom, const std::string& aPort) {
+
+        Capture& tab = AddCapture();
+        const std::string message = connection_message;
+        OpenPort(tab, aPort,
+            aFrom.serial->getBaudrate(),
+            aFrom.serial->getTimeout(),
+            aFrom.serial->getBytesize(),
+            aFrom.serial->getParity(),
+            aFrom.serial->getStopbits(),
+            aFrom.serial->getFlowcontrol()
+        );
+
+        if (tab.stage != ConnectionStage::connected) {
+            aFrom.error_message = "Could not open " + aPort + ".";
+            connection_message = message;
+            captures.pop_back();
+            return;
+        }
+
+        tab.term_state->SetNewLineMode(aFrom.term_state->GetNewLineMode());
+        tab.select = true;
+    }
+
+    // Replaces the capture with a replay of the recording at aPath.
+    static void StartReplay(Capture& capture, const std::filesystem::path& aPath) {
+
+        std::shared_ptr<const CaptureRecording> recording;
+        try {
+            recording = std::make_shared<const CaptureRecording>(aPath);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Could not open recording. " << e.what() << "\n";
+            connection_message = "** Unable to open " + aPath.filename().string() + " **";
+            return;
+        }
 
-                    while (term_state->TerminalOutputAvailable()) {
-                        auto output = term_state->GetTerminalOutput();
-                        serial->write(output);
+        ClosePort(capture);
+        capture.capture_session.reset();
+        capture.term_replay.reset();
+        capture.term_journal.reset();
+        capture.term_view.reset();
+        capture.term_state.reset();
+        capture.term_data.reset();
+        capture.term_log.reset();
+
+        auto ops = TerminalLogger::Options();
+        ops.Enabled = enable_logging;
+        ops.Asynchronous = true;
+        capture.term_log = std::make_shared<TerminalLogger>(aPath.filename().string(), ops);
+        capture.term_data = std::make_shared<TerminalData>(capture.term_log);
+        LineStore::SpillOptions spill;
+        spill.Path = TemporaryCapturePath(aPath.filename().string(), ".scrollback");
+        spill.Compress = true;
+        try {
+            capture.term_data->EnableSpill(spill);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Could not create scrollback file. " << e.what() << "\n";
+        }
+        capture.term_state = std::make_shared<TerminalState>(capture.term_data, TerminalState::NewLineMode::Strict);
+        capture.term_view = std::make_shared<TerminalView>(capture.term_data, capture.term_state, TerminalView::Options());
+        capture.term_replay = std::make_unique<CaptureReplay>(recording, capture.term_data, capture.term_state);
+        // The snapshots are taken at the viewport size, which is known once
+        // the view has been drawn.
+        capture.replay_indexing = false;
+        capture.term_replay->Play(replay_speed);
+
+        capture.stage = ConnectionStage::replaying;
+        capture.render_view = true;
+        connection_message = "";
+    }
+
+    // Applies the replay bytes that are due. Returns true when the capture
+    // window changed.
+    static bool ReplayPoll(Capture& capture, bool shown) {
+
+        const bool was_playing = capture.term_replay->IsPlaying();
+        const uint64_t indexed = capture.term_replay->GetIndexedSize();
+
+        if (!capture.replay_indexing && capture.term_state->GetViewportSize().mRows > 1) {
+            capture.replay_indexing = true;
+            capture.term_replay->StartIndexing();
+        }
+
+        try {
+            if (capture.term_replay->Update() > 0 && auto_scroll) {
+                capture.term_view->SetCursorToEnd();
+            }
+        }
+        catch (const std::exception& ex) {
+            capture.error_message = std::string("Terminal input error: ") + ex.what();
+            std::cerr << capture.error_message << std::endl;
+            capture.term_replay->Pause();
+        }
+
+        if (auto spill_error = capture.term_data->TakeSpillError()) {
+            std::cerr << "Scrollback stopped spilling to disk. " << *spill_error << "\n";
+        }
+
+        return (capture.render_view && shown && capture.term_view->TakeRedrawRequest())
+            || was_playing != capture.term_replay->IsPlaying()
+            || indexed != capture.term_replay->GetIndexedSize();
+    }
+
+    // Play/pause, speed and position of the replay, above the terminal.
+    static void ReplayControls(Capture& capture) {
+
+        static constexpr std::pair<const char*, double> speeds[] = {
+            { "0.5x", 0.5 },
+            { "1x", 1.0 },
+            { "2x", 2.0 },
+            { "10x", 10.0 },
+            { "100x", 100.0 },
+            { "Fastest", 0.0 },
+        };
+
+        CaptureReplay& replay = *capture.term_replay;
+
+        if (ImGui::Button(replay.IsPlaying() ? "Pause" : "Play", ImVec2(ImGui::CalcTextSize("Pause").x + ImGui::GetStyle().FramePadding.x * 2, 0))) {
+            if (replay.IsPlaying()) {
+                replay.Pause();
+            }
+            else {
+                if (replay.AtEnd()) {
+                    replay.Seek(0);
+                }
+                replay.Play(replay_speed);
+            }
+        }
+
+        ImGui::SameLine();
+        const char* speed_label = "Fastest";
+        for (const auto& [label, speed] : speeds) {
+            if (speed == replay_speed) speed_label = label;
+        }
+        ImGui::SetNextItemWidth(ImGui::CalcTextSize("Fastest").x + ImGui::GetFrameHeight() + ImGui::GetStyle().FramePadding.x * 2);
+        if (ImGui::BeginCombo("##replay_speed", speed_label)) {
+            for (const auto& [label, speed] : speeds) {
+                if (ImGui::Selectable(label, speed == replay_speed)) {
+                    replay_speed = speed;
+                    if (replay.IsPlaying()) {
+                        replay.Play(replay_speed);
                     }
+                }
+            }
+            ImGui::EndCombo();
+        }
+        if (!replay.GetRecording().HasTimes() && ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("This recording has no receive times,\nso it replays as fast as possible.");
+        }
+
+        const uint64_t size = replay.GetSize();
+        if (replay.GetIndexedSize() < size) {
+            ImGui::SameLine();
+            ImGui::Text("Indexing %d%%", static_cast<int>(100 * replay.GetIndexedSize() / std::max<uint64_t>(size, 1)));
+        }
+
+        // Seeks when the slider is let go, rather than on every frame of a
+        // drag. Only the shown tab has a slider to drag.
+        static std::optional<uint64_t> dragged_position;
+        uint64_t position = dragged_position.value_or(replay.GetPosition());
+        const uint64_t start = 0;
+
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(1) << position / 1048576.0 << " of " << size / 1048576.0 << " MiB";
+        const auto& recording = replay.GetRecording();
+        if (recording.HasTimes() && size > 0) {
+            const auto time = recording.GetTime(std::min(position, size - 1));
+            if (time) {
+                oss << std::setprecision(3) << ", " << duration<double>(*time - recording.GetTimeMarks().front().mTime).count() << " s";
+            }
+        }
+        const std::string position_text = oss.str();
+
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(-FLT_MIN);
+        if (ImGui::SliderScalar("##replay_position", ImGuiDataType_U64, &position, &start, &size, position_text.c_str())) {
+            dragged_position = position;
+        }
+        if (ImGui::IsItemDeactivated() && dragged_position) {
+            replay.Seek(*dragged_position);
+            dragged_position.reset();
+            if (auto_scroll) {
+                capture.term_view->SetCursorToEnd();
+            }
+        }
+    }
 
+    void SetCaptureWakeCallback(std::function<void()> callback) {
+        wake_main_loop = std::move(callback);
+        for (auto& capture : captures) {
+            if (capture->capture_session) {
+                capture->capture_session->SetReceiveNotifier(wake_main_loop);
+            }
+        }
+    }
+
+    // Tries to reopen the port of a capture that lost it, once a second.
+    // Returns true when it is open again.
+    static bool Reconnect(Capture& capture) {
+
+        if (!capture.serial || system_clock::now() - capture.last_reconnect_attempt < 1s) {
+            return false;
+        }
+        capture.last_reconnect_attempt = system_clock::now();
+
+        try {
+            capture.serial->open();
+            capture.stage = ConnectionStage::connected;
+            if (capture.capture_session) capture.capture_session->Start();
+            return true;
+        }
+        catch (const std::exception& ex) {
+            std::cerr << "Error occurred: " << ex.what() << std::endl;
+        }
+        return false;
+    }
+
+    // Applies what the capture received, or the replay bytes that are due.
+    // Returns true when the capture window changed.
+    static bool PollCapture(Capture& capture, bool shown) {
+
+        if (capture.term_replay && capture.term_view) {
+            return ReplayPoll(capture, shown);
+        }
+
+        if (capture.stage == ConnectionStage::reconnecting) {
+            return Reconnect(capture);
+        }
+
+        if (!capture.term_view || !capture.term_state || !capture.capture_session || !capture.serial || !capture.serial->isOpen()) {
+            return false;
+        }
+
+        const ConnectionStage stage = capture.stage;
+        const std::string error_message = capture.error_message;
+
+        try {
+
+            if (auto receive_error = capture.capture_session->TakeReceiveError()) {
+                throw serial::IOException(__FILE__, __LINE__, receive_error->c_str());
+            }
+            if (auto send_error = capture.capture_session->TakeSendError()) {
+                throw serial::IOException(__FILE__, __LINE__, send_error->c_str());
+            }
+            if (BulkSender* sender = GetBulkSender(capture)) {
+                if (auto bulk_error = sender->TakeError()) {
+                    capture.error_message = "Send stopped. " + *bulk_error;
+                    std::cerr << capture.error_message << std::endl;
                 }
-                catch (const serial::IOException& ex) {
-                    std::cerr << "Error occurred: " << ex.what() << std::endl;
-                    CloseSerialPort();
+            }
+
+            if (capture.capture_session->Pump() > 0 && auto_scroll) {
+                capture.term_view->SetCursorToEnd();
+            }
+
+            if (capture.term_journal) {
+                if (auto journal_error = capture.term_journal->TakeError()) {
+                    std::cerr << "Receive journal stopped. " << *journal_error << "\n";
                 }
-                catch (const std::exception& ex) {
-                    capture_error_message =
-                        std::string("Terminal input error: ") + ex.what();
-                    std::cerr << capture_error_message << std::endl;
+            }
+
+            if (auto spill_error = capture.term_data->TakeSpillError()) {
+                std::cerr << "Scrollback stopped spilling to disk. " << *spill_error << "\n";
+            }
+
+        }
+        catch (const serial::IOException& ex) {
+            std::cerr << "Error occurred: " << ex.what() << std::endl;
+            ClosePort(capture);
+        }
+        catch (const std::exception& ex) {
+            capture.error_message =
+                std::string("Terminal input error: ") + ex.what();
+            std::cerr << capture.error_message << std::endl;
+        }
+        catch (...) {
+            capture.error_message = "Unknown terminal input error";
+            std::cerr << capture.error_message << std::endl;
+        }
+
+        // A hidden view is not drawn, so it is not asked to be either.
+        return (capture.render_view && shown && capture.term_view->TakeRedrawRequest())
+            || capture.stage != stage
+            || capture.error_message != error_message;
+    }
+
+    bool CapturePoll(void) {
+        bool changed = false;
+        for (size_t i = 0; i < captures.size(); ++i) {
+            if (PollCapture(*captures[i], i == current_capture)) {
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    std::optional<double> CaptureIdleTimeout(void) {
+
+        std::optional<double> timeout;
+        const auto at_most = [&timeout](double seconds) {
+            timeout = timeout ? std::min(*timeout, seconds) : seconds;
+        };
+
+        for (size_t i = 0; i < captures.size(); ++i) {
+            const Capture& capture = *captures[i];
+
+            if (capture.capture_session && capture.capture_session->HasPendingInput()) {
+                // More than one Pump() budget arrived.
+                at_most(0.0);
+            }
+            if (GetBulkSender(capture) && GetBulkSender(capture)->IsRunning()) {
+                // The send progress.
+                at_most(0.25);
+            }
+            if (capture.term_replay) {
+                if (auto due = capture.term_replay->GetTimeUntilDue()) {
+                    at_most(duration<double>(*due).count());
                 }
-                catch (...) {
-                    capture_error_message = "Unknown terminal input error";
-                    std::cerr << capture_error_message << std::endl;
+                if (capture.replay_indexing && capture.term_replay->GetIndexedSize() < capture.term_replay->GetSize()) {
+                    // The indexing progress.
+                    at_most(0.25);
+                }
+            }
+            if (capture.stage != ConnectionStage::connected && capture.stage != ConnectionStage::replaying) {
+                // The port list and reconnection attempts refresh every second.
+                at_most(duration<double>(port_cache_duration).count());
+            }
+            if (i == current_capture && capture.term_view && capture.render_view) {
+                if (auto deadline = capture.term_view->GetRedrawDeadline()) {
+                    at_most(duration<double>(*deadline).count());
+                }
+            }
+        }
+        if (ImGui::GetIO().WantTextInput) {
+            // The text cursor of an active input box blinks.
+            at_most(0.5);
+        }
+        return timeout;
+    }
+
+    void CaptureWindowCreate(void) {
+
+        static bool capture_window_init = false;
+
+        if (!capture_window_init) {
+            capture_window_init = true;
+        }
+
+
+        ImGui::Begin(serial_name.c_str(), nullptr, ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoTitleBar);
+
+        Menu();
+
+        // With further ports open, each capture is a tab.
+        CurrentCapture();
+        const bool tabbed = captures.size() > 1 && ImGui::BeginTabBar("Captures");
+
+        for (size_t i = 0; i < captures.size(); ++i) {
+
+            Capture& capture = *captures[i];
+            bool shown = !tabbed;
+
+            if (tabbed) {
+                // The ### keeps the tab when the port or recording changes.
+                const std::string label = CaptureLabel(capture) + "###Capture" + std::to_string(capture.id);
+                shown = ImGui::BeginTabItem(label.c_str(), &capture.open, capture.select ? ImGuiTabItemFlags_SetSelected : 0);
+                capture.select = false;
+                if (shown) {
+                    current_capture = i;
                 }
             }
+
+            if (!shown) {
+                continue;
+            }
+
+            if (capture.term_replay) {
+                ReplayControls(capture);
+            }
+
+            if (capture.term_view && capture.render_view) {
+                capture.term_view->Render(("TerminalView##" + std::to_string(capture.id)).c_str());
+            }
+
+            if (!capture.error_message.empty()) {
+                ImGui::TextColored(
+                    ImVec4(1.0f, 0.35f, 0.35f, 1.0f),
+                    "%s", capture.error_message.c_str());
+            }
+
+            if (tabbed) {
+                ImGui::EndTabItem();
+            }
+        }
+
+        if (tabbed) {
+            ImGui::EndTabBar();
+        }
+
+        ImGui::End();
+
+        // Closing a tab stops its session and closes its port. The selection
+        // stays on the same capture.
+        const uint32_t current_id = CurrentCapture().id;
+        std::erase_if(captures, [](const std::unique_ptr<Capture>& capture) { return !capture->open; });
+        for (size_t i = 0; i < captures.size(); ++i) {
+            if (captures[i]->id == current_id) {
+                current_capture = i;
+            }
+        }
+
+        if (ImGuiFileDialog::Instance()->Display("SendFileDlgKey"))
+        {
+            Capture* target = FindCapture(send_file_capture);
+            BulkSender* sender = target ? GetBulkSender(*target) : nullptr;
+            if (ImGuiFileDialog::Instance()->IsOk() && sender)
+            {
+                try {
+                    sender->Start(std::filesystem::path(ImGuiFileDialog::Instance()->GetFilePathName()), SendPacing());
+                }
+                catch (const std::exception& e) {
+                    target->error_message = std::string("Could not send file. ") + e.what();
+                    std::cerr << target->error_message << std::endl;
+                }
+            }
+            ImGuiFileDialog::Instance()->Close();
+        }
+
+        for (auto& capture : captures) {
+            if (capture->term_view && capture->capture_session && capture->serial && capture->serial->isOpen()) {
+                SendKeyboardInput(*capture->term_view, *capture->capture_session);
+            }
         }
 
         ImGuiViewport* viewport = ImGui::GetMainViewport();
+        const ConnectionStage stage = CurrentCapture().stage;
         
-        if (serial_init == ConnectionStage::reconnecting) {
+        if (stage == ConnectionStage::reconnecting) {
             ReconnectionWindow(viewport->ID);
         }
-        else if ((serial_init == ConnectionStage::not_connected) || (serial_init == ConnectionStage::reconfiguring)) {
+        else if ((stage == ConnectionStage::not_connected) || (stage == ConnectionStage::reconfiguring)) {
             PortSelectionWindow(viewport->ID);
         }
 
     }
 
+    static void SendMenu(Capture& capture) {
+
+        BulkSender* sender = GetBulkSender(capture);
+        if (!sender || !ImGui::BeginMenu("Send")) {
+            return;
+        }
+
+        const auto progress = sender->GetProgress();
+        const bool running = progress.mOutcome == BulkSender::Outcome::Running;
+
+        if (ImGui::MenuItem("Send File...", NULL, false, !running)) {
+            send_file_capture = capture.id;
+            ImGuiFileDialog::Instance()->OpenDialog(
+                "SendFileDlgKey", "Choose File to Send", ".*", ".", "",
+                1,
+                nullptr,
+                ImGuiFileDialogFlags_Modal
+            );
+        }
+        if (ImGui::MenuItem("Cancel Send", NULL, false, running)) {
+            sender->Cancel();
+        }
+
+        if (progress.mOutcome != BulkSender::Outcome::None) {
+            std::ostringstream oss;
+            oss << progress.mBytesSent << " / " << progress.mTotalBytes << " bytes, "
+                << FormatRate(progress.mBytesPerSecond);
+            if (progress.mHeldByDevice) {
+                oss << ", held by device";
+            }
+            if (progress.mWaitingForPrompt) {
+                oss << ", waiting for prompt";
+            }
+            if (progress.mOutcome == BulkSender::Outcome::Cancelled) {
+                oss << ", cancelled";
+            }
+            ImGui::MenuItem(oss.str().c_str(), NULL, false, false);
+        }
+
+        ImGui::Separator();
+        ImGui::MenuItem("Pacing", NULL, false, false);
+
+        if (ImGui::BeginMenu("Rate")) {
+            const std::array<std::pair<const char*, double>, 4> rates{ {
+                { "Full Speed", 0.0 }, { "10 KB/s", 10.0 }, { "1 KB/s", 1.0 }, { "100 B/s", 0.1 } } };
+            for (const auto& [label, rate] : rates) {
+                if (ImGui::MenuItem(label, NULL, send_pacing.BytesPerMillisecond == rate)) {
+                    send_pacing.BytesPerMillisecond = rate;
+                }
+            }
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("Line Delay")) {
+            for (const int delay : { 0, 10, 50, 100, 500 }) {
+                const std::string label = delay == 0 ? std::string("None") : std::to_string(delay) + " ms";
+                if (ImGui::MenuItem(label.c_str(), NULL, send_pacing.LineDelay.count() == delay)) {
+                    send_pacing.LineDelay = std::chrono::milliseconds(delay);
+                }
+            }
+            ImGui::EndMenu();
+        }
+        if (ImGui::MenuItem("Wait for Prompt", NULL, send_wait_for_prompt)) {
+            send_wait_for_prompt = !send_wait_for_prompt;
+        }
+        if (send_wait_for_prompt) {
+            ImGui::SetNextItemWidth(120.0f);
+            ImGui::InputText("Prompt", send_prompt.data(), send_prompt.size());
+        }
+        if (ImGui::MenuItem("XON/XOFF", NULL, send_pacing.HonorXonXoff)) {
+            send_pacing.HonorXonXoff = !send_pacing.HonorXonXoff;
+        }
+
+        ImGui::EndMenu();
+    }
+
     void Menu() {
 
         if (ImGui::BeginMenuBar())
         {
 
-            std::string menu_port_string;
+            Capture& capture = CurrentCapture();
 
-            if (serial) {
-                menu_port_string = serial->getPort();
-            }
-            else {
-                menu_port_string = "No Connection";
-            }
+            std::string menu_port_string = CaptureLabel(capture);
 
             if (ImGui::BeginMenu(menu_port_string.c_str()))
             {
@@ -161,7 +916,7 @@ namespace imterm {
 
                 std::ostringstream oss;
 
-                if (serial == nullptr) {
+                if (capture.serial == nullptr) {
 
                     auto serial_node = settings.get_serial_settings();
 
@@ -178,7 +933,7 @@ namespace imterm {
 
                 } else {
 
-                    uint32_t baud = serial->getBaudrate();
+                    Serial* serial = capture.serial.get();
 
                     // TODO: Flow control and Timeouts
 
@@ -216,10 +971,10 @@ namespace imterm {
                 }
 
                 if (ImGui::MenuItem(oss.str().c_str(), NULL, false)) {
-                    serial_init = ConnectionStage::reconfiguring;
+                    capture.stage = ConnectionStage::reconfiguring;
                 }
 
-                if (serial) {
+                if (capture.serial && !capture.term_replay) {
                     ImGui::Separator();
 
                     ImGui::MenuItem("Select New Port", NULL, false, false);
@@ -227,23 +982,35 @@ namespace imterm {
                     auto port_infos_tuple = serial::list_ports_cached(port_cache_duration);
                     auto port_infos = std::get<1>(port_infos_tuple);
                     for (serial::PortInfo& info : port_infos) {
-                        bool current_port = (info.port == serial->getPort());
-                        if (ImGui::MenuItem(info.port.c_str(), NULL, current_port, true)) {
+                        bool current_port = (info.port == capture.serial->getPort());
+                        // A port another tab holds cannot be opened twice.
+                        if (ImGui::MenuItem(info.port.c_str(), NULL, current_port, current_port || !PortInUse(info.port, &capture))) {
                             if (!current_port) {
                                 try {
-                                    term_log->SetPostfix(info.port.c_str());
-                                    serial->setPort(info.port.c_str());
+                                    if (capture.capture_session) capture.capture_session->Stop();
+                                    capture.term_log->SetPostfix(info.port.c_str());
+                                    capture.serial->setPort(info.port.c_str());
+                                    if (capture.capture_session) capture.capture_session->Start();
                                 }
                                 catch (const serial::IOException& ex) {
                                     std::cerr << "Error occurred: " << ex.what() << std::endl;
-                                    CloseSerialPort();
-                                    serial_init = ConnectionStage::reconfiguring;
+                                    ClosePort(capture);
+                                    capture.stage = ConnectionStage::reconfiguring;
                                     connection_message = "** Unable to open " + info.port + " **";
                                 }
 
                             }
                         }
                     }
+
+                    if (ImGui::BeginMenu("Open in New Tab")) {
+                        for (serial::PortInfo& info : port_infos) {
+                            if (ImGui::MenuItem(info.port.c_str(), NULL, false, !PortInUse(info.port, nullptr))) {
+                                OpenPortTab(capture, info.port);
+                            }
+                        }
+                        ImGui::EndMenu();
+                    }
                 }
 
                 ImGui::EndMenu();
@@ -251,6 +1018,12 @@ namespace imterm {
 
             
 
+            if (capture.term_view && ImGui::MenuItem("Find", "Ctrl+Shift+F")) {
+                capture.term_view->OpenSearch();
+            }
+
+            SendMenu(capture);
+
             const char * autoScrollOn = "Auto Scroll On";
             const char * autoScrollOff = "Auto Scroll Off";
 
@@ -258,13 +1031,15 @@ namespace imterm {
                 auto_scroll = !auto_scroll;
             }
             
-            if (ImGui::BeginMenu("Options")) {
+            if (capture.term_view && ImGui::BeginMenu("Options")) {
 
+                TerminalState& term_state = *capture.term_state;
+                TerminalView& term_view = *capture.term_view;
 
                 if (ImGui::BeginMenu("New Line Mode"))
                 {
 
-                    auto new_line_mode = term_state->GetNewLineMode();
+                    auto new_line_mode = term_state.GetNewLineMode();
                     const char* line_mode_text;
                     if (new_line_mode == TerminalState::NewLineMode::AddCrToLf) {
                         line_mode_text = "+LF   ";
@@ -280,13 +1055,13 @@ namespace imterm {
                     //ImGui::MenuItem("New Line Mode", NULL, false, false);
 
                     if (ImGui::MenuItem("Strict", NULL, (new_line_mode == TerminalState::NewLineMode::Strict))) {
-                        term_state->SetNewLineMode(TerminalState::NewLineMode::Strict);
+                        term_state.SetNewLineMode(TerminalState::NewLineMode::Strict);
                     }
                     if (ImGui::MenuItem("Add CR to LF", NULL, (new_line_mode == TerminalState::NewLineMode::AddCrToLf))) {
-                        term_state->SetNewLineMode(TerminalState::NewLineMode::AddCrToLf);
+                        term_state.SetNewLineMode(TerminalState::NewLineMode::AddCrToLf);
                     }
                     if (ImGui::MenuItem("ADD LF to CR", NULL, (new_line_mode == TerminalState::NewLineMode::AddLfToCr))) {
-                        term_state->SetNewLineMode(TerminalState::NewLineMode::AddLfToCr);
+                        term_state.SetNewLineMode(TerminalState::NewLineMode::AddLfToCr);
                     }
 
                     ImGui::EndMenu();
@@ -294,14 +1069,49 @@ namespace imterm {
 
                 if (ImGui::BeginMenu("View"))
                 {
-                    auto ops = term_view->GetOptions();
+                    auto ops = term_view.GetOptions();
                     if (ImGui::MenuItem("Line Numbers", NULL, ops.LineNumbers, true)) {
                         ops.LineNumbers = !ops.LineNumbers;
-                        term_view->SetOptions(ops);
+                        term_view.SetOptions(ops);
                     }
                     if (ImGui::MenuItem("Timestamps", NULL, ops.TimeStamps, true)) {
                         ops.TimeStamps = !ops.TimeStamps;
-                        term_view->SetOptions(ops);
+                        term_view.SetOptions(ops);
+                    }
+                    if (ImGui::BeginMenu("Timestamp Format", ops.TimeStamps)) {
+                        if (TimestampFormatMenu(ops.TimeStampResolution, ops.TimeStampKind)) {
+                            term_view.SetOptions(ops);
+                        }
+                        ImGui::EndMenu();
+                    }
+                    if (ImGui::MenuItem("Hex View", NULL, ops.HexView, capture.term_journal != nullptr)) {
+                        ops.HexView = !ops.HexView;
+                        term_view.SetOptions(ops);
+                    }
+                    if (ImGui::MenuItem("Render Time", NULL, ops.RenderTime, true)) {
+                        ops.RenderTime = !ops.RenderTime;
+                        term_view.SetOptions(ops);
+                    }
+
+                    ImGui::EndMenu();
+                }
+
+                if (capture.capture_session && ImGui::BeginMenu("Receive Statistics"))
+                {
+                    auto stats = capture.capture_session->GetReceiveStatistics();
+                    std::string received = "Received: " + std::to_string(stats.mBytesReceived);
+                    std::string dropped = "Dropped: " + std::to_string(stats.mBytesDropped)
+                        + " (" + std::to_string(stats.mOverflowEvents) + " overflows)";
+                    std::string buffered = "Buffered: " + std::to_string(stats.mBuffered)
+                        + " / " + std::to_string(stats.mCapacity);
+                    std::string high_water = "High water: " + std::to_string(stats.mHighWaterMark);
+
+                    ImGui::MenuItem(received.c_str(), NULL, false, false);
+                    ImGui::MenuItem(dropped.c_str(), NULL, false, false);
+                    ImGui::MenuItem(buffered.c_str(), NULL, false, false);
+                    ImGui::MenuItem(high_water.c_str(), NULL, false, false);
+                    if (ImGui::MenuItem("Reset High Water")) {
+                        capture.capture_session->ResetHighWaterMark();
                     }
 
                     ImGui::EndMenu();
@@ -309,19 +1119,26 @@ namespace imterm {
 
                 if (ImGui::BeginMenu("Log"))
                 {
-                    auto ops = term_log->GetOptions();
+                    TerminalLogger& term_log = *capture.term_log;
+                    auto ops = term_log.GetOptions();
                     if (ImGui::MenuItem("Enabled", NULL, ops.Enabled, true)) {
                         ops.Enabled = !ops.Enabled;
                         enable_logging = ops.Enabled;
-                        term_log->SetOptions(ops);
+                        term_log.SetOptions(ops);
                     }
                     if (ImGui::MenuItem("Line Numbers", NULL, ops.LineNumbers, true)) {
                         ops.LineNumbers = !ops.LineNumbers;
-                        term_log->SetOptions(ops);
+                        term_log.SetOptions(ops);
                     }
                     if (ImGui::MenuItem("Timestamps", NULL, ops.TimeStamps, true)) {
                         ops.TimeStamps = !ops.TimeStamps;
-                        term_log->SetOptions(ops);
+                        term_log.SetOptions(ops);
+                    }
+                    if (ImGui::BeginMenu("Timestamp Format", ops.TimeStamps)) {
+                        if (TimestampFormatMenu(ops.TimeStampResolution, ops.TimeStampKind)) {
+                            term_log.SetOptions(ops);
+                        }
+                        ImGui::EndMenu();
                     }
 
                     ImGui::EndMenu();
@@ -332,29 +1149,26 @@ namespace imterm {
             
             
 
-            if (serial && serial->isOpen()) {
-
-                static bool dtr = false;
-                static bool rts = false;
+            if (capture.serial && capture.serial->isOpen()) {
 
                 try {
 
-                    if (ImGui::MenuItem(dtr ? "DTR=1" : "DTR=0", NULL, false, true)) {
-                        dtr = !dtr;
-                        serial->setDTR(dtr);
+                    if (ImGui::MenuItem(capture.dtr ? "DTR=1" : "DTR=0", NULL, false, true)) {
+                        capture.dtr = !capture.dtr;
+                        capture.serial->setDTR(capture.dtr);
                     }
-                    if (ImGui::MenuItem(rts ? "RTS=1" : "RTS=0", NULL, false, true)) {
-                        rts = !rts;
-                        serial->setRTS(rts);
+                    if (ImGui::MenuItem(capture.rts ? "RTS=1" : "RTS=0", NULL, false, true)) {
+                        capture.rts = !capture.rts;
+                        capture.serial->setRTS(capture.rts);
                     }
-                    ImGui::MenuItem(serial->getCTS() ? "CTS=1" : "CTS=0", NULL, false, false);
-                    ImGui::MenuItem(serial->getDSR() ? "DSR=1" : "DSR=0", NULL, false, false);
-                    ImGui::MenuItem(serial->getCD() ? "DCD=1" : "DCD=0", NULL, false, false);
+                    ImGui::MenuItem(capture.serial->getCTS() ? "CTS=1" : "CTS=0", NULL, false, false);
+                    ImGui::MenuItem(capture.serial->getDSR() ? "DSR=1" : "DSR=0", NULL, false, false);
+                    ImGui::MenuItem(capture.serial->getCD() ? "DCD=1" : "DCD=0", NULL, false, false);
 
                 }
                 catch (const std::exception& ex) {
                     std::cerr << "Error occurred: " << ex.what() << std::endl;
-                    CloseSerialPort();
+                    ClosePort(capture);
                 }
             }
 
@@ -363,81 +1177,13 @@ namespace imterm {
     }
 
     std::optional<std::string> CloseSerialPort() {
-
-        std::optional<std::string> returnValue = std::nullopt;
-
-        try {
-
-            bool was_open = false;
-
-            if (serial) {
-                
-                if (serial->isOpen()) {
-                    was_open = true;
-                    returnValue = serial->getPort();
-                }
-                serial->close();
-            }
-
-            if (auto_reconnect && was_open) {
-                serial_init = ConnectionStage::reconnecting;
-            }
-            else {
-                serial_init = ConnectionStage::not_connected;
-            }
-
-        }
-        catch (const serial::IOException& ex) {
-            std::cerr << "Error occurred: " << ex.what() << std::endl;
-        }
-
-        return returnValue;
+        return ClosePort(CurrentCapture());
     }
 
     void OpenSerialPort(const std::string& port, uint32_t baudrate, serial::Timeout timeout,
         bytesize_t bytesize, parity_t parity, stopbits_t stopbits,
         flowcontrol_t flowcontrol) {
-        
-        std::optional<std::string> oldPort = CloseSerialPort();
-
-        try {
-            serial = new Serial(
-                port,
-                baudrate,
-                timeout,
-                bytesize,
-                parity,
-                stopbits,
-                flowcontrol
-            );
-
-            if (!oldPort || oldPort.value() != port) {
-                term_log.reset();
-                term_data.reset();
-                term_state.reset();
-                term_view.reset();
-            }
-
-            if (!term_log) {
-                auto ops = TerminalLogger::Options();
-                ops.Enabled = enable_logging;
-                term_log = std::make_shared<TerminalLogger>(port, ops);
-            }
-            if (!term_data) term_data = std::make_shared<TerminalData>(term_log);
-            if (!term_state) term_state = std::make_shared<TerminalState> (term_data, TerminalState::NewLineMode::Strict);
-            if (!term_view) term_view = std::make_shared<TerminalView> (term_data, term_state, TerminalView::Options());
-
-
-            serial_init = ConnectionStage::connected;
-            render_view = true;
-            
-            
-        }
-        catch (const std::exception& e) {
-            std::cerr << "Could not open port. " << e.what() << "\n";
-            connection_message = "** Unable to open " + port + " **";
-        }
-
+        OpenPort(CurrentCapture(), port, baudrate, timeout, bytesize, parity, stopbits, flowcontrol);
     }
 
     template<typename T>
@@ -731,17 +1477,24 @@ namespace imterm {
                     baud_int = -1;
                 }
 
+                Capture& capture = CurrentCapture();
+
                 if (baud_int != -1) {
 
-                    serial_init = ConnectionStage::not_connected;
+                    capture.stage = ConnectionStage::not_connected;
 
-                    if (cbo_port_selection_data.item_is_selected()) {
+                    if (cbo_port_selection_data.item_is_selected()
+                        && PortInUse(cbo_port_selection_data.get_selected_data().port, &capture)) {
+                        connection_message = "** " + cbo_port_selection_data.get_selected_data().port + " is open in another tab **";
+                    }
+                    else if (cbo_port_selection_data.item_is_selected()) {
 
                         connection_message = "";
 
                         serial_name = cbo_port_selection_data.get_selected_data().port;
 
-                        OpenSerialPort(
+                        OpenPort(
+                            capture,
                             serial_name, 
                             baud_int,
                             serial::Timeout(
@@ -758,7 +1511,7 @@ namespace imterm {
                         );
                     }
 
-                    if (serial_init == ConnectionStage::connected) {
+                    if (capture.stage == ConnectionStage::connected) {
 
                         auto serial_node_tbl = settings.get_serial_settings().as_table();
                         cbo_port_selection_data.put_selected_item(serial_node_tbl);
@@ -773,7 +1526,7 @@ namespace imterm {
 
                         settings.write();
 
-                        term_state->SetNewLineMode(cbo_new_line_mode_data.get_selected_data());
+                        capture.term_state->SetNewLineMode(cbo_new_line_mode_data.get_selected_data());
 
                         ImGui::CloseCurrentPopup();
 
@@ -781,6 +1534,43 @@ namespace imterm {
                 }
             }
 
+            ImGui::SameLine();
+
+            if (ImGui::Button("Replay...", ImVec2(120, 0))) {
+                ImGuiFileDialog::Instance()->OpenDialog(
+                    "ReplayFileDlgKey", "Choose Recording", ".*", ".", "",
+                    1,
+                    nullptr,
+                    ImGuiFileDialogFlags_Modal
+                );
+            }
+
+            if (ImGuiFileDialog::Instance()->Display("ReplayFileDlgKey"))
+            {
+                if (ImGuiFileDialog::Instance()->IsOk())
+                {
+                    Capture& capture = CurrentCapture();
+                    StartReplay(capture, ImGuiFileDialog::Instance()->GetFilePathName());
+                    if (capture.stage == ConnectionStage::replaying) {
+                        capture.term_state->SetNewLineMode(cbo_new_line_mode_data.get_selected_data());
+                        ImGui::CloseCurrentPopup();
+                    }
+                }
+
+                ImGuiFileDialog::Instance()->Close();
+            }
+
+            // The other tabs are behind this window, so a tab that is not
+            // set up can be closed from it.
+            if (captures.size() > 1) {
+                ImGui::SameLine();
+                if (ImGui::Button("Close Tab", ImVec2(120, 0))) {
+                    CurrentCapture().open = false;
+                    connection_message = "";
+                    ImGui::CloseCurrentPopup();
+                }
+            }
+
             ImGui::EndPopup();
         }
     }
@@ -850,35 +1640,21 @@ namespace imterm {
 
         if (ImGui::BeginPopupModal("Reconnecting...", NULL, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove)) {
 
-            static system_clock::time_point last_attempt_time = system_clock::now() - 1s;
+            Capture& capture = CurrentCapture();
 
-            // We should not have gotten here if serial is null
-            assert(serial);
-            assert(!serial->isOpen());
+            // We should not have gotten here if serial is null. The attempts
+            // are made by CapturePoll(), for tabs in the background too.
+            assert(capture.serial);
 
-            std::string attempt_string = std::string("Attempting to reconnect to " + serial->getPort());
+            std::string attempt_string = std::string("Attempting to reconnect to " + capture.serial->getPort());
             ImGui::SetCursorPosX((window_size.x - ImGui::CalcTextSize(attempt_string.c_str()).x) * 0.5f);
             ImGui::TextUnformatted(attempt_string.c_str());
 
-            if ((system_clock::now() - last_attempt_time) > 1s) {
-
-                last_attempt_time = system_clock::now();
-
-                try {
-                    serial->open();
-                    serial_init = ConnectionStage::connected;
-                }
-                catch (const std::exception& ex) {
-                    std::cerr << "Error occurred: " << ex.what() << std::endl;
-                }
-
-            }
-
             ImGui::Spacing();
             ImGui::Spacing();
 
             if (ImGui::Button("Cancel", ImVec2(window_size.x - (style.WindowPadding.x * 2), 0))) {
-                serial_init = ConnectionStage::not_connected;
+                capture.stage = ConnectionStage::not_connected;
             }
 
             ImGui::EndPopup();
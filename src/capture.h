@@ -6,6 +6,8 @@
 #include <stdexcept>
 #include <chrono>
 #include <filesystem>
+#include <functional>
+#include <optional>
 #include "serial/serial.h"
 
 using namespace std::chrono;
@@ -20,6 +22,18 @@ namespace imterm {
 
     void CaptureWindowCreate(void);
 
+    // Called on the receive thread when data arrives, to wake a main loop
+    // that waits for events.
+    void SetCaptureWakeCallback(std::function<void()> callback);
+
+    // Applies received data to the terminal; call before starting a frame.
+    // Returns true when the capture window changed and should be drawn.
+    bool CapturePoll(void);
+
+    // Seconds until the capture window changes without input or received
+    // data, or nullopt when it will not.
+    std::optional<double> CaptureIdleTimeout(void);
+
     void PortSelectionWindow(ImGuiID id);
 
     void ReconnectionWindow(ImGuiID id);
@@ -0,0 +1,44 @@
+#include "capture_recording.h"
+
+#include <algorithm>
+
+namespace imterm {
+
+	CaptureRecording::CaptureRecording(const std::filesystem::path& aPath)
+		: mFile(aPath), mTimeMarks(ReceiveJournal::LoadTimeMarks(aPath))
+	{
+		// Marks past the end belong to bytes the journal never kept.
+		while (!mTimeMarks.empty() && mTimeMarks.back().mOffset >= mFile.GetSize()) {
+			mTimeMarks.pop_back();
+		}
+	}
+
+	std::optional<CaptureRecording::Clock::time_point> CaptureRecording::GetTime(uint64_t aOffset) const
+	{
+		if (aOffset >= GetSize()) {
+			return std::nullopt;
+		}
+		if (const TimeMark* mark = ReceiveJournal::FindTimeMark(mTimeMarks, aOffset)) {
+			return mark->mTime;
+		}
+		return std::nullopt;
+	}
+
+	uint64_t CaptureRecording::GetOffsetAfter(Clock::time_point aTime) const
+	{
+		if (mTimeMarks.empty()) {
+			return 0;
+		}
+		const auto next = std::upper_bound(mTimeMarks.begin(), mTimeMarks.end(), aTime,
+			[](Clock::time_point aValue, const TimeMark& aMark) { return aValue < aMark.mTime; });
+		return next == mTimeMarks.end() ? GetSize() : next->mOffset;
+	}
+
+	uint64_t CaptureRecording::GetTimeRunEnd(uint64_t aOffset) const
+	{
+		const auto next = std::upper_bound(mTimeMarks.begin(), mTimeMarks.end(), aOffset,
+			[](uint64_t aValue, const TimeMark& aMark) { return aValue < aMark.mOffset; });
+		return next == mTimeMarks.end() ? GetSize() : next->mOffset;
+	}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "mapped_file.h"
+#include "receive_journal.h"
+
+namespace imterm {
+
+	// A recorded byte stream to replay: any file of raw received bytes, such
+	// as a kept ReceiveJournal. The bytes are memory-mapped. If a journal left
+	// its time marks next to the file, every byte has the time it was
+	// received, to the journal's time resolution; otherwise there are no
+	// times and a replay can only run as fast as it is driven.
+	//
+	// Immutable once constructed, so it may be shared between threads.
+	class CaptureRecording {
+
+	public:
+
+		using Clock = ReceiveJournal::Clock;
+		using TimeMark = ReceiveJournal::TimeMark;
+
+		// Throws std::system_error if aPath cannot be opened or mapped.
+		explicit CaptureRecording(const std::filesystem::path& aPath);
+
+		std::span<const uint8_t> GetBytes() const { return mFile.GetBytes(); }
+		uint64_t GetSize() const { return mFile.GetSize(); }
+		const std::filesystem::path& GetPath() const { return mFile.GetPath(); }
+
+		bool HasTimes() const { return !mTimeMarks.empty(); }
+		const std::vector<TimeMark>& GetTimeMarks() const { return mTimeMarks; }
+
+		// When the byte at aOffset was received.
+		std::optional<Clock::time_point> GetTime(uint64_t aOffset) const;
+		// The first byte received after aTime; GetSize() if there is none, 0
+		// without times.
+		uint64_t GetOffsetAfter(Clock::time_point aTime) const;
+		// The end of the run of bytes from aOffset that share its time: the
+		// offset of the next time mark, or GetSize().
+		uint64_t GetTimeRunEnd(uint64_t aOffset) const;
+
+	private:
+
+		MappedFile mFile;
+		std::vector<TimeMark> mTimeMarks;
+	};
+
+}
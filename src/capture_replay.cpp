@@ -0,0 +1,248 @@
+#include "capture_replay.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace imterm {
+
+	namespace {
+
+		// Lines the indexer's terminal may hold above its screen before they
+		// are trimmed; trimming in batches keeps the cost per byte low.
+		constexpr size_t IndexerTrimSlack = 4096;
+
+	}
+
+	CaptureReplay::CaptureReplay(
+		std::shared_ptr<const CaptureRecording> aRecording,
+		std::shared_ptr<TerminalData> aData,
+		std::shared_ptr<TerminalState> aState)
+		: CaptureReplay(std::move(aRecording), std::move(aData), std::move(aState), Options())
+	{
+	}
+
+	CaptureReplay::CaptureReplay(
+		std::shared_ptr<const CaptureRecording> aRecording,
+		std::shared_ptr<TerminalData> aData,
+		std::shared_ptr<TerminalState> aState,
+		Options aOptions)
+		: mRecording(std::move(aRecording)), mData(std::move(aData)), mState(std::move(aState)), mOptions(aOptions)
+	{
+		mOptions.SnapshotInterval = std::max<uint64_t>(mOptions.SnapshotInterval, 1);
+		mState->SetBellEnabled(false);
+		AddSnapshot(0, TakeSnapshot(*mData, *mState));
+	}
+
+	CaptureReplay::~CaptureReplay()
+	{
+		StopIndexing();
+	}
+
+	void CaptureReplay::Play(double aSpeed)
+	{
+		mSpeed = std::max(aSpeed, 0.0);
+		mPlaying = !AtEnd();
+		Anchor();
+	}
+
+	void CaptureReplay::Pause()
+	{
+		mPlaying = false;
+	}
+
+	size_t CaptureReplay::Update(size_t aBudget)
+	{
+		if (!mPlaying) {
+			return 0;
+		}
+		const uint64_t start = mPosition;
+		const uint64_t end = std::min({ GetSize(), mPosition + aBudget, GetDueEnd(std::chrono::steady_clock::now()) });
+		if (end > mPosition) {
+			mPosition = Apply(*mData, *mState, mPosition, end);
+		}
+		// A replay never answers the device.
+		mState->ClearTerminalOutput();
+		if (AtEnd()) {
+			mPlaying = false;
+		}
+		return static_cast<size_t>(mPosition - start);
+	}
+
+	std::optional<std::chrono::nanoseconds> CaptureReplay::GetTimeUntilDue() const
+	{
+		if (!mPlaying || AtEnd()) {
+			return std::nullopt;
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if (GetDueEnd(now) > mPosition) {
+			return std::chrono::nanoseconds(0);
+		}
+		const auto next = GetPositionTime();
+		if (!next) {
+			return std::chrono::nanoseconds(0);
+		}
+		const auto due = mAnchorTime + std::chrono::duration_cast<Clock::duration>((now - mAnchorSteady) * mSpeed);
+		return std::chrono::duration_cast<std::chrono::nanoseconds>((*next - due) / mSpeed)
+			+ std::chrono::nanoseconds(1);
+	}
+
+	void CaptureReplay::Seek(uint64_t aOffset)
+	{
+		aOffset = std::min(aOffset, GetSize());
+
+		std::shared_ptr<const Snapshot> base;
+		uint64_t baseOffset;
+		{
+			std::lock_guard lock(mSnapshotMutex);
+			// There is always one at 0.
+			const auto at = std::prev(mSnapshots.upper_bound(aOffset));
+			baseOffset = at->first;
+			base = at->second;
+		}
+		if (aOffset < mPosition || baseOffset > mPosition) {
+			Restore(*base);
+			mPosition = baseOffset;
+		}
+		if (aOffset > mPosition) {
+			mPosition = Apply(*mData, *mState, mPosition, aOffset);
+		}
+		mState->ClearTerminalOutput();
+		if (AtEnd()) {
+			mPlaying = false;
+		}
+		Anchor();
+	}
+
+	void CaptureReplay::SeekToTime(Clock::time_point aTime)
+	{
+		Seek(mRecording->GetOffsetAfter(aTime));
+	}
+
+	void CaptureReplay::StartIndexing()
+	{
+		if (mIndexer.joinable()) {
+			return;
+		}
+		mStopIndexing.store(false, std::memory_order_relaxed);
+		mIndexer = std::thread(&CaptureReplay::RunIndexer, this, mState->GetViewportSize(), mState->GetNewLineMode());
+	}
+
+	void CaptureReplay::StopIndexing()
+	{
+		mStopIndexing.store(true, std::memory_order_relaxed);
+		if (mIndexer.joinable()) {
+			mIndexer.join();
+		}
+	}
+
+	size_t CaptureReplay::GetSnapshotCount() const
+	{
+		std::lock_guard lock(mSnapshotMutex);
+		return mSnapshots.size();
+	}
+
+	uint64_t CaptureReplay::Apply(TerminalData& aData, TerminalState& aState, uint64_t aPosition, uint64_t aEnd)
+	{
+		const auto bytes = mRecording->GetBytes();
+		while (aPosition < aEnd) {
+			const uint64_t boundary = (aPosition / mOptions.SnapshotInterval + 1) * mOptions.SnapshotInterval;
+			const uint64_t stop = std::min({ aEnd, boundary, mRecording->GetTimeRunEnd(aPosition) });
+			const auto run = bytes.subspan(static_cast<size_t>(aPosition), static_cast<size_t>(stop - aPosition));
+			if (const auto time = mRecording->GetTime(aPosition)) {
+				aState.Input(run, *time);
+			}
+			else {
+				aState.Input(run);
+			}
+			aPosition = stop;
+			if (aPosition == boundary && !HasSnapshot(boundary)) {
+				AddSnapshot(boundary, TakeSnapshot(aData, aState));
+			}
+		}
+		return aPosition;
+	}
+
+	std::shared_ptr<const CaptureReplay::Snapshot> CaptureReplay::TakeSnapshot(const TerminalData& aData, const TerminalState& aState) const
+	{
+		auto snapshot = std::make_shared<Snapshot>();
+		snapshot->mState = aState.TakeSnapshot();
+		const size_t count = aData.GetLineCount();
+		const size_t rows = static_cast<size_t>(std::max(aState.GetViewportSize().mRows, 1));
+		snapshot->mScreen.reserve(std::min(count, rows));
+		for (size_t line = count > rows ? count - rows : 0; line < count; ++line) {
+			snapshot->mScreen.push_back(aData.GetLine(line));
+		}
+		return snapshot;
+	}
+
+	bool CaptureReplay::HasSnapshot(uint64_t aOffset) const
+	{
+		std::lock_guard lock(mSnapshotMutex);
+		return mSnapshots.contains(aOffset);
+	}
+
+	void CaptureReplay::AddSnapshot(uint64_t aOffset, std::shared_ptr<const Snapshot> aSnapshot)
+	{
+		std::lock_guard lock(mSnapshotMutex);
+		mSnapshots.try_emplace(aOffset, std::move(aSnapshot));
+	}
+
+	void CaptureReplay::Restore(const Snapshot& aSnapshot)
+	{
+		mData->SetLines(aSnapshot.mScreen);
+		mState->RestoreSnapshot(aSnapshot.mState);
+	}
+
+	void CaptureReplay::Anchor()
+	{
+		mAnchorSteady = std::chrono::steady_clock::now();
+		if (const auto time = GetPositionTime()) {
+			mAnchorTime = *time;
+		}
+		else if (mRecording->HasTimes()) {
+			mAnchorTime = mRecording->GetTimeMarks().back().mTime;
+		}
+	}
+
+	uint64_t CaptureReplay::GetDueEnd(std::chrono::steady_clock::time_point aNow) const
+	{
+		if (mSpeed <= 0.0 || !mRecording->HasTimes()) {
+			return GetSize();
+		}
+		const auto due = mAnchorTime + std::chrono::duration_cast<Clock::duration>((aNow - mAnchorSteady) * mSpeed);
+		return mRecording->GetOffsetAfter(due);
+	}
+
+	void CaptureReplay::RunIndexer(ViewportSize aViewportSize, TerminalState::NewLineMode aNewLineMode)
+	{
+		std::shared_ptr<const Snapshot> start;
+		{
+			std::lock_guard lock(mSnapshotMutex);
+			start = mSnapshots.at(0);
+		}
+
+		auto data = std::make_shared<TerminalData>();
+		TerminalState state(data, aNewLineMode);
+		state.SetBellEnabled(false);
+		data->SetLines(start->mScreen);
+		state.RestoreSnapshot(start->mState);
+		state.SetViewportSize(aViewportSize.mRows, aViewportSize.mColumns);
+
+		const uint64_t size = GetSize();
+		const size_t rows = static_cast<size_t>(aViewportSize.mRows);
+		uint64_t position = 0;
+		while (position < size && !mStopIndexing.load(std::memory_order_relaxed)) {
+			position = Apply(*data, state, position, std::min<uint64_t>(size, position + DefaultBudget));
+			mIndexed.store(position, std::memory_order_relaxed);
+
+			state.ClearTerminalOutput();
+			// Only the screen goes into a snapshot.
+			const size_t count = data->GetLineCount();
+			if (count > rows + IndexerTrimSlack) {
+				data->RemoveLine(0, static_cast<int>(count - rows));
+			}
+		}
+	}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "capture_recording.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+
+namespace imterm {
+
+	// Feeds a CaptureRecording through a TerminalState, either as fast as it
+	// is driven or following the recorded receive times, and seeks within it.
+	//
+	// Seeking restores a snapshot: the terminal state and the screen lines, as
+	// they were after a multiple of SnapshotInterval bytes. Playback takes a
+	// snapshot at each such offset it passes, and StartIndexing() takes all
+	// of them on a background thread through a terminal of its own, so a seek
+	// replays at most SnapshotInterval bytes once the index has passed the
+	// target. Lines that had scrolled above the screen are not part of a
+	// snapshot, so after a seek backwards, or forwards past the position, the
+	// scrollback starts at the restored screen.
+	//
+	// Everything except the indexer runs on the thread that owns the terminal.
+	class CaptureReplay {
+
+	public:
+
+		using Clock = CaptureRecording::Clock;
+
+		// Bytes applied per Update() call by default.
+		static constexpr size_t DefaultBudget = 64 * 1024;
+
+		struct Options {
+			uint64_t SnapshotInterval = 4 << 20;
+		};
+
+		// Restores aData and aState to how they are now when seeking to the
+		// start. Turns off aState's bell.
+		CaptureReplay(
+			std::shared_ptr<const CaptureRecording> aRecording,
+			std::shared_ptr<TerminalData> aData,
+			std::shared_ptr<TerminalState> aState);
+		CaptureReplay(
+			std::shared_ptr<const CaptureRecording> aRecording,
+			std::shared_ptr<TerminalData> aData,
+			std::shared_ptr<TerminalState> aState,
+			Options aOptions);
+		~CaptureReplay();
+
+		CaptureReplay(const CaptureReplay&) = delete;
+		CaptureReplay& operator=(const CaptureReplay&) = delete;
+
+		// At aSpeed 1 bytes are applied when they are due by the recorded
+		// times, at 2 twice as fast. At aSpeed 0, or for a recording without
+		// times, each Update() applies its whole budget.
+		void Play(double aSpeed = 1.0);
+		void Pause();
+		bool IsPlaying() const { return mPlaying; }
+		double GetSpeed() const { return mSpeed; }
+
+		// While playing, applies up to aBudget of the bytes that are due and
+		// returns the number applied. Playback pauses at the end.
+		size_t Update(size_t aBudget = DefaultBudget);
+		// How long until Update() has bytes to apply: zero when some are due,
+		// nullopt when paused or at the end.
+		std::optional<std::chrono::nanoseconds> GetTimeUntilDue() const;
+
+		// Shows the terminal as it was after the first aOffset bytes.
+		void Seek(uint64_t aOffset);
+		// Seeks past the bytes received up to aTime. Without times, seeks to
+		// the start.
+		void SeekToTime(Clock::time_point aTime);
+
+		uint64_t GetPosition() const { return mPosition; }
+		uint64_t GetSize() const { return mRecording->GetSize(); }
+		bool AtEnd() const { return mPosition >= GetSize(); }
+		// When the next byte to apply was received.
+		std::optional<Clock::time_point> GetPositionTime() const { return mRecording->GetTime(mPosition); }
+		const CaptureRecording& GetRecording() const { return *mRecording; }
+
+		// Takes every snapshot on a background thread, with the terminal's
+		// current viewport size and newline mode. Has no effect while it is
+		// running.
+		void StartIndexing();
+		void StopIndexing();
+		// Bytes the indexer has applied so far.
+		uint64_t GetIndexedSize() const { return mIndexed.load(std::memory_order_relaxed); }
+		size_t GetSnapshotCount() const;
+
+	private:
+
+		struct Snapshot {
+			TerminalState::Snapshot mState;
+			std::vector<Line> mScreen;
+		};
+
+		// Applies the bytes from aPosition to aEnd to aState, stamped with
+		// their recorded times, and stores a snapshot at each interval
+		// boundary on the way that does not have one yet. Returns aEnd.
+		uint64_t Apply(TerminalData& aData, TerminalState& aState, uint64_t aPosition, uint64_t aEnd);
+		std::shared_ptr<const Snapshot> TakeSnapshot(const TerminalData& aData, const TerminalState& aState) const;
+		bool HasSnapshot(uint64_t aOffset) const;
+		void AddSnapshot(uint64_t aOffset, std::shared_ptr<const Snapshot> aSnapshot);
+		void Restore(const Snapshot& aSnapshot);
+		void Anchor();
+		// One past the last byte due at aNow.
+		uint64_t GetDueEnd(std::chrono::steady_clock::time_point aNow) const;
+		void RunIndexer(ViewportSize aViewportSize, TerminalState::NewLineMode aNewLineMode);
+
+		std::shared_ptr<const CaptureRecording> mRecording;
+		std::shared_ptr<TerminalData> mData;
+		std::shared_ptr<TerminalState> mState;
+		Options mOptions;
+
+		uint64_t mPosition = 0;
+		bool mPlaying = false;
+		double mSpeed = 1.0;
+		// Playback time: the recording was at mAnchorTime at mAnchorSteady.
+		std::chrono::steady_clock::time_point mAnchorSteady;
+		Clock::time_point mAnchorTime;
+
+		mutable std::mutex mSnapshotMutex;
+		std::map<uint64_t, std::shared_ptr<const Snapshot>> mSnapshots;
+
+		std::thread mIndexer;
+		std::atomic<bool> mStopIndexing{ false };
+		std::atomic<uint64_t> mIndexed{ 0 };
+	};
+
+}
@@ -0,0 +1,60 @@
+#include "capture_session.h"
+
+namespace imterm {
+
+	CaptureSession::CaptureSession(
+		std::shared_ptr<Transport> aTransport,
+		std::shared_ptr<TerminalState> aTerminalState,
+		size_t aReceiveCapacity)
+		: mTerminalState(std::move(aTerminalState)), mReceiver(aTransport, aReceiveCapacity)
+	{
+		if (aTransport->CanWrite()) {
+			mSender = std::make_unique<SendWorker>(aTransport);
+			mBulkSender = std::make_unique<BulkSender>(std::move(aTransport));
+			mReceiver.SetReceiveObserver([bulk = mBulkSender.get()](std::span<const uint8_t> aBytes) {
+				bulk->Observe(aBytes);
+			});
+		}
+	}
+
+	CaptureSession::~CaptureSession()
+	{
+		Stop();
+	}
+
+	void CaptureSession::Start()
+	{
+		mReceiver.Start();
+		if (mSender) {
+			mSender->Start();
+		}
+	}
+
+	void CaptureSession::Stop()
+	{
+		mReceiver.Stop();
+		if (mSender) {
+			mSender->Stop();
+			mBulkSender->Cancel();
+		}
+	}
+
+	size_t CaptureSession::Pump(size_t aBudget)
+	{
+		const size_t count = mReceiver.Drain(aBudget, [this](std::span<const uint8_t> aBytes, ReceiveWorker::Timestamp aTime) {
+			if (mJournal) {
+				mJournal->Append(aBytes, aTime);
+			}
+			mTerminalState->Input(aBytes, aTime);
+		});
+
+		if (mTerminalState->TerminalOutputAvailable()) {
+			if (mSender) {
+				mSender->Send(mTerminalState->PeekTerminalOutput());
+			}
+			mTerminalState->ClearTerminalOutput();
+		}
+		return count;
+	}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+#include "bulk_sender.h"
+#include "receive_journal.h"
+#include "receive_worker.h"
+#include "send_worker.h"
+#include "terminal_state.h"
+#include "transport.h"
+
+namespace imterm {
+
+	// Connects a Transport to a TerminalState. Received bytes are read on a
+	// background thread and applied to the terminal on the thread that calls
+	// Pump(), so the terminal core itself stays single-threaded.
+	//
+	// When the transport can write, keystrokes passed to Send() and the
+	// terminal's replies to device reports are written by a second background
+	// thread, so that thread never waits for the device either. Send() and
+	// Pump() must be called from the same thread. Pastes and files go through
+	// GetBulkSender(), which sees received bytes as they are read, for its
+	// prompt and XON/XOFF pacing.
+	class CaptureSession {
+
+	public:
+
+		// Bytes applied per Pump() call by default. Large enough to keep up with
+		// 3 Mbaud at 30 frames per second while bounding the work done per frame.
+		static constexpr size_t DefaultPumpBudget = 64 * 1024;
+
+		CaptureSession(
+			std::shared_ptr<Transport> aTransport,
+			std::shared_ptr<TerminalState> aTerminalState,
+			size_t aReceiveCapacity = ReceiveWorker::DefaultCapacity);
+		~CaptureSession();
+
+		CaptureSession(const CaptureSession&) = delete;
+		CaptureSession& operator=(const CaptureSession&) = delete;
+
+		// Starts or stops reading and writing the transport. Stop() must be
+		// called before the underlying port is closed or reconfigured.
+		void Start();
+		void Stop();
+		bool IsReceiving() const { return mReceiver.IsRunning(); }
+
+		// Applies up to aBudget received bytes to the terminal state and returns the
+		// number applied. Queues the terminal's replies for sending, or drops
+		// them when the transport cannot write.
+		size_t Pump(size_t aBudget = DefaultPumpBudget);
+
+		// Queues aBytes for the transport and returns the number queued; see
+		// SendWorker::Send(). Returns 0 when the transport cannot write.
+		size_t Send(std::span<const uint8_t> aBytes) { return mSender ? mSender->Send(aBytes) : 0; }
+		bool CanSend() const { return mSender != nullptr; }
+
+		// Streams pastes and files; nullptr when the transport cannot write.
+		// Stop() cancels a send in progress.
+		BulkSender* GetBulkSender() const { return mBulkSender.get(); }
+
+		// True when received bytes are still waiting for Pump().
+		bool HasPendingInput() const { return mReceiver.HasPendingBytes(); }
+
+		// Called on the reader thread when bytes arrive, at most once between
+		// Pump() calls; see ReceiveWorker::SetReceiveNotifier(). Set before
+		// Start().
+		void SetReceiveNotifier(ReceiveWorker::ReceiveNotifier aNotifier) { mReceiver.SetReceiveNotifier(std::move(aNotifier)); }
+
+		// Reads on aReactor's thread, shared with other sessions, rather than
+		// a thread of the session's own; see ReceiveWorker::SetReactor(). Set
+		// before Start().
+		void SetReactor(std::shared_ptr<ReceiveReactor> aReactor) { mReceiver.SetReactor(std::move(aReactor)); }
+
+		// What the reader does when Pump() falls behind; see
+		// ReceiveWorker::OverflowPolicy. Set before Start().
+		void SetOverflowPolicy(ReceiveWorker::OverflowPolicy aPolicy) { mReceiver.SetOverflowPolicy(aPolicy); }
+
+		ReceiveWorker::Statistics GetReceiveStatistics() const { return mReceiver.GetStatistics(); }
+		void ResetHighWaterMark() { mReceiver.ResetHighWaterMark(); }
+
+		// The error that stopped the reader thread, if any. Reported once.
+		std::optional<std::string> TakeReceiveError() { return mReceiver.TakeError(); }
+
+		// Empty when the transport cannot write.
+		SendWorker::Statistics GetSendStatistics() const { return mSender ? mSender->GetStatistics() : SendWorker::Statistics(); }
+
+		// The error that stopped the writer thread, if any. Reported once.
+		std::optional<std::string> TakeSendError() { return mSender ? mSender->TakeError() : std::nullopt; }
+
+		std::shared_ptr<TerminalState> GetTerminalState() const { return mTerminalState; }
+
+		// Records every pumped byte, before the terminal interprets it, in
+		// aJournal. Bytes are stamped with the time they were read. Pass
+		// nullptr to stop recording.
+		void SetJournal(std::shared_ptr<ReceiveJournal> aJournal) { mJournal = std::move(aJournal); }
+		std::shared_ptr<ReceiveJournal> GetJournal() const { return mJournal; }
+
+	private:
+
+		std::shared_ptr<TerminalState> mTerminalState;
+		std::shared_ptr<ReceiveJournal> mJournal;
+		ReceiveWorker mReceiver;
+		std::unique_ptr<SendWorker> mSender;
+		std::unique_ptr<BulkSender> mBulkSender;
+	};
+
+}
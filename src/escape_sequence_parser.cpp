@@ -2,6 +2,162 @@
 
 #include "escape_sequence_parser.h"
 
+#include <cstring>
+
+namespace {
+
+	// Byte classes of the batch parser. Every byte in a class has the same
+	// transition in every stage.
+	enum class ByteClass : uint8_t {
+		Text,       // Printable ASCII without a role in sequences, and 0x80-0xFF
+		Execute,    // NUL, BEL, BS, LF, CR: acted on even inside a sequence
+		Control,    // Other C0 controls and DEL
+		Escape,
+		Bracket,
+		ModeMark,   // '=' and '?'
+		Digit,
+		Separator,
+		Final,      // A-Z and a-z
+		Count
+	};
+
+	enum class Action : uint8_t {
+		Print,
+		Execute,
+		StartSequence,
+		EnterCsi,
+		SetMode,
+		Digit,
+		Separator,
+		Final,
+		FailBadCsi,
+		FailBadData
+	};
+
+	constexpr std::size_t StageCount = 5;
+	constexpr std::size_t ClassCount = static_cast<std::size_t>(ByteClass::Count);
+
+	constexpr std::array<ByteClass, 256> MakeByteClasses()
+	{
+		std::array<ByteClass, 256> classes{};
+		for (std::size_t value = 0; value < classes.size(); ++value) {
+			ByteClass byteClass = ByteClass::Text;
+			if (value == 0x00 || value == '\a' || value == '\b' || value == '\n' || value == '\r') {
+				byteClass = ByteClass::Execute;
+			}
+			else if (value == 0x1B) {
+				byteClass = ByteClass::Escape;
+			}
+			else if (value < 0x20 || value == 0x7F) {
+				byteClass = ByteClass::Control;
+			}
+			else if (value == '[') {
+				byteClass = ByteClass::Bracket;
+			}
+			else if (value == '=' || value == '?') {
+				byteClass = ByteClass::ModeMark;
+			}
+			else if (value >= '0' && value <= '9') {
+				byteClass = ByteClass::Digit;
+			}
+			else if (value == ';') {
+				byteClass = ByteClass::Separator;
+			}
+			else if ((value >= 'A' && value <= 'Z') || (value >= 'a' && value <= 'z')) {
+				byteClass = ByteClass::Final;
+			}
+			classes[value] = byteClass;
+		}
+		return classes;
+	}
+
+	// Rows are indexed by EscapeSequenceParser::Stage, columns by ByteClass.
+	// The next stage follows from the action, so the table holds only actions.
+	constexpr std::array<std::array<Action, ClassCount>, StageCount> MakeTransitions()
+	{
+		using enum ByteClass;
+		std::array<std::array<Action, ClassCount>, StageCount> table{};
+		const auto set = [&table](std::size_t aStage, ByteClass aClass, Action aAction) {
+			table[aStage][static_cast<std::size_t>(aClass)] = aAction;
+		};
+
+		for (std::size_t stage = 0; stage < StageCount; ++stage) {
+			const bool idle = stage <= 1;
+			const bool csi = stage == 2;
+			const bool data = stage == 4;
+			for (std::size_t column = 0; column < ClassCount; ++column) {
+				table[stage][column] = idle ? Action::Print : csi ? Action::FailBadCsi : Action::FailBadData;
+			}
+			set(stage, Execute, Action::Execute);
+			set(stage, Escape, Action::StartSequence);
+			if (idle) {
+				set(stage, Control, Action::Execute);
+			}
+			else if (csi) {
+				set(stage, Bracket, Action::EnterCsi);
+			}
+			else {
+				set(stage, ModeMark, data ? Action::FailBadData : Action::SetMode);
+				set(stage, Digit, Action::Digit);
+				set(stage, Separator, Action::Separator);
+				set(stage, Final, Action::Final);
+			}
+		}
+		return table;
+	}
+
+	constexpr std::array<ByteClass, 256> ByteClasses = MakeByteClasses();
+	constexpr auto Transitions = MakeTransitions();
+
+	constexpr Action Transition(EscapeSequenceParser::Stage aStage, uint8_t aInput)
+	{
+		return Transitions[static_cast<std::size_t>(aStage)][static_cast<std::size_t>(ByteClasses[aInput])];
+	}
+
+	static_assert(Transition(EscapeSequenceParser::Stage::Inactive, 'a') == Action::Print);
+	static_assert(Transition(EscapeSequenceParser::Stage::GetCsi, '[') == Action::EnterCsi);
+	static_assert(Transition(EscapeSequenceParser::Stage::GetMode, '?') == Action::SetMode);
+	static_assert(Transition(EscapeSequenceParser::Stage::GetData, '?') == Action::FailBadData);
+	static_assert(Transition(EscapeSequenceParser::Stage::GetData, '\n') == Action::Execute);
+
+	constexpr uint64_t EveryByte(uint8_t aValue)
+	{
+		return 0x0101'0101'0101'0101ULL * aValue;
+	}
+
+	// True when any byte of aWord is outside the printable ASCII range
+	// 0x20-0x7E. Each test sets the high bit of a byte that fails it; the
+	// borrow and carry between bytes can only produce false positives in
+	// bytes above one that already failed, which does not change the result.
+	constexpr bool HasNonPrintableAscii(uint64_t aWord)
+	{
+		const uint64_t highBits = EveryByte(0x80);
+		const uint64_t below = (aWord - EveryByte(0x20)) & ~aWord;
+		const uint64_t above = (aWord + EveryByte(0x01)) | aWord;
+		return ((below | above) & highBits) != 0;
+	}
+
+	// End of the run of Text bytes starting at aOffset. Printable ASCII is
+	// always text outside a sequence, so it is skipped a word at a time.
+	std::size_t EndOfText(std::span<const uint8_t> aInput, std::size_t aOffset)
+	{
+		while (aInput.size() - aOffset >= sizeof(uint64_t)) {
+			uint64_t word;
+			std::memcpy(&word, aInput.data() + aOffset, sizeof(word));
+			if (HasNonPrintableAscii(word)) {
+				break;
+			}
+			aOffset += sizeof(word);
+		}
+		while (aOffset < aInput.size()
+			&& Transition(EscapeSequenceParser::Stage::Inactive, aInput[aOffset]) == Action::Print) {
+			++aOffset;
+		}
+		return aOffset;
+	}
+
+}
+
 EscapeSequenceParser::EscapeSequenceParser()
     : mStage(Stage::Inactive),
       mError(Error::NotReady),
@@ -35,10 +191,7 @@ const EscapeSequenceParser::ParseResult& EscapeSequenceParser::Parse(uint8_t inp
 	}
 
 	if (mStage != Stage::GetEsc && input == ESC) {
-		ResetForNextByte();
-		mStage = Stage::GetCsi;
-		mSequenceLength = 1;
-		mParseResult.mStage = mStage;
+		StartSequence();
 		return mParseResult;
 	}
 
@@ -87,40 +240,17 @@ const EscapeSequenceParser::ParseResult& EscapeSequenceParser::Parse(uint8_t inp
 
 	case Stage::GetData:
 		if (input >= '0' && input <= '9') {
-			if (mDataElementDigits >= MaxArgumentDigits) {
-				Fail(Error::ArgumentTooLong);
-				break;
-			}
-
-			const int digit = input - '0';
-			if (mDataElementInProcess > (MaxNumericValue - digit) / 10) {
-				Fail(Error::NumericOverflow);
-				break;
-			}
-
-			mDataElementInProcess = (mDataElementInProcess * 10) + digit;
-			++mDataElementDigits;
+			AddDigit(input);
 		}
 		else if (input == ';') {
 			mSawDataSeparator = true;
 			StageDataElement(true);
 		}
+		else if ((input >= 'A' && input <= 'Z') || (input >= 'a' && input <= 'z')) {
+			CompleteSequence(input);
+		}
 		else {
-			if ((input >= 'A' && input <= 'Z') || (input >= 'a' && input <= 'z')) {
-				if (!StageDataElement(true)) {
-					break;
-				}
-				mIdentifier = static_cast<EscapeIdentifier>(input);
-				mError = Error::None;
-				mParseResult.mIdentifier = mIdentifier;
-				mParseResult.mCommandData = mDataStaged;
-				mParseResult.mMode = mMode;
-			}
-			else {
-				Fail(Error::BadData);
-				break;
-			}
-			mStage = Stage::Inactive;
+			Fail(Error::BadData);
 		}
 		break;
 
@@ -134,6 +264,128 @@ const EscapeSequenceParser::ParseResult& EscapeSequenceParser::Parse(uint8_t inp
 	return mParseResult;
 }
 
+std::size_t EscapeSequenceParser::Parse(std::span<const uint8_t> aInput, std::span<Token> aTokens, std::size_t& aTokenCount)
+{
+	aTokenCount = 0;
+	std::size_t offset = 0;
+
+	const auto emit = [&](TokenKind aKind, std::size_t aStart, std::size_t aLength) {
+		aTokens[aTokenCount++] = Token{ aKind, aKind == TokenKind::Malformed ? mError : Error::None,
+			static_cast<uint32_t>(aStart), static_cast<uint32_t>(aLength) };
+	};
+
+	while (offset < aInput.size() && aTokenCount < aTokens.size()) {
+		const uint8_t input = aInput[offset];
+		const Action action = Transition(mStage, input);
+
+		if (action == Action::Print) {
+			const std::size_t start = offset;
+			offset = EndOfText(aInput, offset + 1);
+			emit(TokenKind::Text, start, offset - start);
+			continue;
+		}
+		if (action == Action::Execute) {
+			emit(TokenKind::Control, offset++, 1);
+			continue;
+		}
+		if (action == Action::StartSequence) {
+			StartSequence();
+			++offset;
+			continue;
+		}
+
+		const std::size_t start = offset++;
+		bool failed = false;
+		if (++mSequenceLength > MaxSequenceLength) {
+			Fail(Error::SequenceTooLong);
+			failed = true;
+		}
+		else {
+			switch (action) {
+			case Action::EnterCsi:
+				mStage = Stage::GetMode;
+				break;
+			case Action::SetMode:
+				mStage = Stage::GetData;
+				mMode = input == '=' ? Mode::Screen : Mode::Private;
+				break;
+			case Action::Digit:
+				mStage = Stage::GetData;
+				failed = !AddDigit(input);
+				break;
+			case Action::Separator:
+				mStage = Stage::GetData;
+				mSawDataSeparator = true;
+				failed = !StageDataElement(true);
+				break;
+			case Action::Final:
+				if (!CompleteSequence(input)) {
+					failed = true;
+					break;
+				}
+				emit(TokenKind::Sequence, start, 1);
+				return offset;
+			case Action::FailBadCsi:
+				Fail(Error::BadCsi);
+				failed = true;
+				break;
+			default:
+				Fail(Error::BadData);
+				failed = true;
+				break;
+			}
+		}
+
+		if (failed) {
+			emit(TokenKind::Malformed, start, 1);
+		}
+	}
+
+	return offset;
+}
+
+void EscapeSequenceParser::StartSequence()
+{
+	ResetForNextByte();
+	mStage = Stage::GetCsi;
+	mSequenceLength = 1;
+	mParseResult.mStage = mStage;
+}
+
+bool EscapeSequenceParser::AddDigit(uint8_t aInput)
+{
+	if (mDataElementDigits >= MaxArgumentDigits) {
+		Fail(Error::ArgumentTooLong);
+		return false;
+	}
+
+	const int digit = aInput - '0';
+	if (mDataElementInProcess > (MaxNumericValue - digit) / 10) {
+		Fail(Error::NumericOverflow);
+		return false;
+	}
+
+	mDataElementInProcess = (mDataElementInProcess * 10) + digit;
+	++mDataElementDigits;
+	return true;
+}
+
+bool EscapeSequenceParser::CompleteSequence(uint8_t aInput)
+{
+	if (!StageDataElement(true)) {
+		return false;
+	}
+	mIdentifier = static_cast<EscapeIdentifier>(aInput);
+	mError = Error::None;
+	mStage = Stage::Inactive;
+	mParseResult.mIdentifier = mIdentifier;
+	mParseResult.mCommandData = mDataStaged;
+	mParseResult.mMode = mMode;
+	mParseResult.mStage = mStage;
+	mParseResult.mError = mError;
+	return true;
+}
+
 bool EscapeSequenceParser::StageDataElement(bool aIsFinalElement)
 {
 	if (mDataElementDigits == 0 && (!aIsFinalElement || !mSawDataSeparator)) {
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstddef>
-#include <vector>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
 
 #include "coordinates.h"
 
@@ -85,7 +89,48 @@ public:
 		Screen,
 		Private
 	};
-	
+
+	static constexpr std::size_t MaxSequenceLength = 128;
+	static constexpr std::size_t MaxArgumentDigits = 6;
+	static constexpr std::size_t MaxArguments = 16;
+	static constexpr int MaxNumericValue = 65535;
+
+	/**
+	 * @brief The numeric arguments of one sequence. Storage is inline and
+	 * bounded by MaxArguments, so parsing and decoding a sequence never
+	 * allocates.
+	*/
+	class Arguments {
+	public:
+		Arguments() = default;
+		Arguments(std::initializer_list<int> aValues) {
+			for (int value : aValues) {
+				push_back(value);
+			}
+		}
+
+		std::size_t size() const { return mCount; }
+		bool empty() const { return mCount == 0; }
+		int operator[](std::size_t aIndex) const { return mValues[aIndex]; }
+		const int* begin() const { return mValues.data(); }
+		const int* end() const { return mValues.data() + mCount; }
+
+		void push_back(int aValue) {
+			if (mCount == MaxArguments) {
+				throw std::length_error("EscapeSequenceParser::Arguments is full");
+			}
+			mValues[mCount++] = aValue;
+		}
+		void clear() { mCount = 0; }
+
+		friend bool operator==(const Arguments& aLeft, const Arguments& aRight) {
+			return std::equal(aLeft.begin(), aLeft.end(), aRight.begin(), aRight.end());
+		}
+
+	private:
+		std::array<int, MaxArguments> mValues{};
+		std::size_t mCount = 0;
+	};
 
 	struct ParseResult {
 		uint8_t mOutputChar;
@@ -93,18 +138,55 @@ public:
 		Error mError;
 		EscapeIdentifier mIdentifier;
 		Mode mMode;
-		std::vector<int> mCommandData;
+		Arguments mCommandData;
 	};
 
-	EscapeSequenceParser();
+	/**
+	 * @brief What one token of the batch parser covers.
+	*/
+	enum class TokenKind : uint8_t {
+		Text,      // A run of bytes to draw: printable ASCII and bytes >= 0x80
+		Control,   // One control byte or DEL to act on or draw
+		Sequence,  // A completed CSI sequence, see GetSequence()
+		Malformed  // An abandoned sequence; mError says why
+	};
 
-	static constexpr std::size_t MaxSequenceLength = 128;
-	static constexpr std::size_t MaxArgumentDigits = 6;
-	static constexpr std::size_t MaxArguments = 16;
-	static constexpr int MaxNumericValue = 65535;
+	/**
+	 * @brief One entry of the token stream produced by the batch Parse().
+	 * mOffset and mLength locate the token's bytes in the span passed to
+	 * that call; for Sequence and Malformed tokens they cover only the byte
+	 * that ended the sequence.
+	*/
+	struct Token {
+		TokenKind mKind;
+		Error mError;
+		uint32_t mOffset;
+		uint32_t mLength;
+	};
+
+	EscapeSequenceParser();
 
 	const ParseResult& Parse(uint8_t input);
 
+	/**
+	 * @brief Parses as much of aInput as possible, writing tokens to aTokens.
+	 *
+	 * Stops after a Sequence token, so its arguments can be read from
+	 * GetSequence() before they are overwritten, when aTokens is full, or at
+	 * the end of the input. Sequences may span calls, and the two Parse()
+	 * overloads share state. NUL, BEL, BS, LF and CR are reported as Control
+	 * tokens even inside a sequence, which continues afterwards.
+	 *
+	 * @return The number of bytes consumed. aTokenCount receives the number
+	 * of tokens written.
+	*/
+	std::size_t Parse(std::span<const uint8_t> aInput, std::span<Token> aTokens, std::size_t& aTokenCount);
+
+	/**
+	 * @brief The sequence completed by the last Sequence token.
+	*/
+	const ParseResult& GetSequence() const { return mParseResult; }
+
 
 private:
 
@@ -119,7 +201,7 @@ private:
 	int mDataElementInProcess = 0;
 	std::size_t mDataElementDigits = 0;
 	bool mSawDataSeparator = false;
-	std::vector<int> mDataStaged;
+	Arguments mDataStaged;
 	std::size_t mSequenceLength = 0;
 
 	ParseResult mParseResult;
@@ -127,4 +209,7 @@ private:
 	bool StageDataElement(bool aIsFinalElement = false);
 	void ResetForNextByte();
 	void Fail(Error error);
+	void StartSequence();
+	bool AddDigit(uint8_t aInput);
+	bool CompleteSequence(uint8_t aInput);
 };
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "file_transport.h"
+
+namespace imterm {
+
+	namespace {
+
+		bool IsRegularFile(int aDescriptor)
+		{
+#if defined(_WIN32)
+			struct _stat64 status;
+			return _fstat64(aDescriptor, &status) == 0 && (status.st_mode & _S_IFREG) != 0;
+#else
+			struct stat status;
+			return fstat(aDescriptor, &status) == 0 && S_ISREG(status.st_mode);
+#endif
+		}
+
+	}
+
+	FileTransport::FileTransport(int aDescriptor, Options aOptions)
+		: mDescriptor(aDescriptor), mOwned(false), mOptions(aOptions), mRegular(IsRegularFile(aDescriptor))
+	{
+	}
+
+	FileTransport::FileTransport(const std::filesystem::path& aPath, Options aOptions)
+		: mOwned(true), mOptions(aOptions)
+	{
+#if defined(_WIN32)
+		mDescriptor = _wopen(aPath.c_str(), _O_RDONLY | _O_BINARY);
+#else
+		// O_NOCTTY keeps a pseudo-terminal from becoming our controlling
+		// terminal.
+		mDescriptor = open(aPath.c_str(), O_RDONLY | O_NOCTTY | O_CLOEXEC);
+#endif
+		if (mDescriptor < 0) {
+			throw std::system_error(errno, std::generic_category(), "FileTransport could not open " + aPath.string());
+		}
+		mRegular = IsRegularFile(mDescriptor);
+	}
+
+	FileTransport::~FileTransport()
+	{
+		if (mOwned) {
+#if defined(_WIN32)
+			_close(mDescriptor);
+#else
+			close(mDescriptor);
+#endif
+		}
+	}
+
+	bool FileTransport::WaitReadable()
+	{
+		if (AtEnd() || mIdle) {
+			// Nothing to wait for, or a followed file that has not grown;
+			// regular files are always readable, so polling would not block.
+			mIdle = false;
+			std::this_thread::sleep_for(mOptions.PollInterval);
+			return !AtEnd();
+		}
+#if defined(_WIN32)
+		return true;
+#else
+		pollfd descriptor{ mDescriptor, POLLIN, 0 };
+		const int ready = poll(&descriptor, 1, static_cast<int>(mOptions.PollInterval.count()));
+		if (ready < 0) {
+			if (errno == EINTR) {
+				return false;
+			}
+			throw std::system_error(errno, std::generic_category(), "FileTransport could not poll");
+		}
+		// A hang-up or error is reported by the following read.
+		return ready > 0;
+#endif
+	}
+
+	int FileTransport::GetPollDescriptor() const
+	{
+#if defined(_WIN32)
+		return -1;
+#else
+		return mRegular ? -1 : mDescriptor;
+#endif
+	}
+
+	size_t FileTransport::Read(std::span<uint8_t> aBuffer)
+	{
+		if (AtEnd() || aBuffer.empty()) {
+			return 0;
+		}
+#if defined(_WIN32)
+		const int count = _read(mDescriptor, aBuffer.data(), static_cast<unsigned int>(std::min<size_t>(aBuffer.size(), INT_MAX)));
+#else
+		const ssize_t count = read(mDescriptor, aBuffer.data(), aBuffer.size());
+#endif
+		if (count > 0) {
+			return static_cast<size_t>(count);
+		}
+		if (count == 0) {
+			if (mRegular && mOptions.Follow) {
+				mIdle = true;
+			}
+			else {
+				mAtEnd.store(true, std::memory_order_release);
+			}
+			return 0;
+		}
+		if (errno == EINTR || errno == EAGAIN) {
+			return 0;
+		}
+		if (errno == EIO) {
+			// The other side of a pseudo-terminal was closed.
+			mAtEnd.store(true, std::memory_order_release);
+			return 0;
+		}
+		throw std::system_error(errno, std::generic_category(), "FileTransport could not read");
+	}
+
+}
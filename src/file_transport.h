@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+#include "transport.h"
+
+namespace imterm {
+
+	// Transport over a file descriptor: standard input, a pipe or FIFO, a
+	// pseudo-terminal, or a regular file.
+	//
+	// Reading stops at the end of the input, which is when a regular file has
+	// been read to the end, every writer of a pipe has closed it, or the other
+	// side of a pseudo-terminal has hung up. AtEnd() then turns true and
+	// WaitReadable() only waits out its timeout. With Follow set, reading a
+	// regular file continues as it grows, like tail -f.
+	//
+	// On Windows Read() blocks until bytes arrive, so a stop request is only
+	// noticed after the next read.
+	class FileTransport : public Transport {
+
+	public:
+
+		struct Options {
+			bool Follow = false;
+			// How long WaitReadable() blocks without input.
+			std::chrono::milliseconds PollInterval{ 100 };
+		};
+
+		// Reads aDescriptor, which is left open.
+		explicit FileTransport(int aDescriptor) : FileTransport(aDescriptor, Options()) { }
+		FileTransport(int aDescriptor, Options aOptions);
+		// Opens aPath for reading. Throws std::system_error if it cannot be
+		// opened.
+		explicit FileTransport(const std::filesystem::path& aPath) : FileTransport(aPath, Options()) { }
+		FileTransport(const std::filesystem::path& aPath, Options aOptions);
+		~FileTransport();
+
+		FileTransport(const FileTransport&) = delete;
+		FileTransport& operator=(const FileTransport&) = delete;
+
+		bool WaitReadable() override;
+		size_t Read(std::span<uint8_t> aBuffer) override;
+		// Pipes, FIFOs and pseudo-terminals only; regular files are always
+		// readable, so there is nothing to wait on.
+		int GetPollDescriptor() const override;
+
+		// True once the end of the input has been read. Set on the reader
+		// thread after the last bytes were returned by Read().
+		bool AtEnd() const noexcept override { return mAtEnd.load(std::memory_order_acquire); }
+
+	private:
+
+		int mDescriptor;
+		bool mOwned;
+		Options mOptions;
+		bool mRegular = false;
+		std::atomic<bool> mAtEnd = false;
+		// Read() returned nothing although the descriptor was readable.
+		bool mIdle = false;
+	};
+
+}
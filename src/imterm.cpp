@@ -26,6 +26,7 @@
 #include <algorithm>
 #include <cmath>
 #include <filesystem>
+#include <optional>
 #define GLFW_INCLUDE_NONE
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -56,6 +57,9 @@ static VkDescriptorPool         g_DescriptorPool = VK_NULL_HANDLE;
 static ImGui_ImplVulkanH_Window g_MainWindowData;
 static int                      g_MinImageCount = 2;
 static bool                     g_SwapChainRebuild = false;
+// Set by any window or input event; the main loop only draws while idle when
+// something happened.
+static bool                     g_WindowEvent = true;
 
 static void check_vk_result(VkResult err)
 {
@@ -371,6 +375,22 @@ static void glfw_framebuffer_size_callback(GLFWwindow*, int width, int height)
     // scaled copy of the old framebuffer after a window resize.
     if (width > 0 && height > 0)
         g_SwapChainRebuild = true;
+    g_WindowEvent = true;
+}
+
+// Installed before the ImGui backend's callbacks, which chain to these, so the
+// main loop can tell input from a wake-up posted for received data.
+static void InstallWindowEventCallbacks(GLFWwindow* window)
+{
+    glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { g_WindowEvent = true; });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { g_WindowEvent = true; });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { g_WindowEvent = true; });
+    glfwSetCursorPosCallback(window, [](GLFWwindow*, double, double) { g_WindowEvent = true; });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { g_WindowEvent = true; });
+    glfwSetScrollCallback(window, [](GLFWwindow*, double, double) { g_WindowEvent = true; });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { g_WindowEvent = true; });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { g_WindowEvent = true; });
+    glfwSetWindowIconifyCallback(window, [](GLFWwindow*, int) { g_WindowEvent = true; });
 }
 
 static std::filesystem::path GetExecutableDirectory()
@@ -519,6 +539,7 @@ int __stdcall WinMain(
     }
 
     // Setup Platform/Renderer backends
+    InstallWindowEventCallbacks(window);
     ImGui_ImplGlfw_InitForVulkan(window, true);
     ImGui_ImplVulkan_InitInfo init_info = {};
     init_info.Instance = g_Instance;
@@ -556,6 +577,17 @@ int __stdcall WinMain(
 
     bool once = true;
 
+    // The receive thread wakes the loop when data arrives.
+    imterm::SetCaptureWakeCallback(glfwPostEmptyEvent);
+
+    // ImGui settles hover and popup state over a couple of frames after an
+    // event, and shows tooltips after a hover delay, so a few frames follow
+    // every event before the loop goes back to waiting.
+    constexpr int frames_after_event = 3;
+    constexpr double settle_delay = 0.6;
+    int frames_to_draw = frames_after_event;
+    double settle_time = 0.0;
+
     // Main loop
     while (!glfwWindowShouldClose(window))
     {
@@ -564,7 +596,51 @@ int __stdcall WinMain(
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-        glfwPollEvents();
+        //
+        // While nothing changes, sleep until an event, received data, or the
+        // next time the capture window changes by itself (cursor blink).
+        double redraw_time = 0.0;
+        if (frames_to_draw > 0)
+        {
+            glfwPollEvents();
+        }
+        else
+        {
+            const double now = glfwGetTime();
+            std::optional<double> timeout = imterm::CaptureIdleTimeout();
+            if (settle_time > now)
+                timeout = std::min(timeout.value_or(settle_time - now), settle_time - now);
+            if (timeout)
+            {
+                // GLFW requires a positive timeout.
+                redraw_time = now + *timeout;
+                if (*timeout > 0.0)
+                    glfwWaitEventsTimeout(*timeout);
+                else
+                    glfwPollEvents();
+            }
+            else
+            {
+                redraw_time = INFINITY;
+                glfwWaitEvents();
+            }
+        }
+
+        // Received data only costs a frame when it changes what is on screen.
+        const bool capture_changed = imterm::CapturePoll();
+        if (g_WindowEvent)
+        {
+            g_WindowEvent = false;
+            frames_to_draw = frames_after_event;
+            settle_time = glfwGetTime() + settle_delay;
+        }
+        else if (capture_changed || glfwGetTime() >= redraw_time)
+        {
+            frames_to_draw = std::max(frames_to_draw, 1);
+        }
+        if (frames_to_draw == 0)
+            continue;
+        --frames_to_draw;
 
         // Resize the swap chain as soon as GLFW reports a new framebuffer
         // size.  The Vulkan out-of-date result remains a fallback, but it may
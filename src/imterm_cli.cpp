@@ -0,0 +1,725 @@
+// Headless capture: reads a serial port, standard input, a pseudo-terminal or
+// a file into the terminal core and logs the lines, without a window or GPU.
+// Can also record the raw bytes with their receive times, and replay such a
+// recording. Prints throughput statistics when the input ends or on Ctrl+C.
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "serial/serial.h"
+
+#include "capture_recording.h"
+#include "capture_replay.h"
+#include "bulk_sender.h"
+#include "capture_session.h"
+#include "file_transport.h"
+#include "receive_journal.h"
+#include "serial_transport.h"
+#include "terminal_data.h"
+#include "terminal_logger.h"
+#include "terminal_state.h"
+
+using namespace imterm;
+using namespace std::chrono;
+
+namespace {
+
+    enum class SourceKind { Auto, Serial, File };
+
+    struct CliOptions {
+        std::string source;
+        SourceKind kind = SourceKind::Auto;
+        uint32_t baudrate = 115200;
+        bool follow = false;
+        bool logging = true;
+        std::filesystem::path log_directory = TerminalLogger::GetDefaultLogPath();
+        TimestampResolution resolution = TimestampResolution::Milliseconds;
+        LineTimestampKind timestamp_kind = LineTimestampKind::LastByte;
+        size_t receive_capacity = ReceiveWorker::DefaultCapacity;
+        // The terminal does not wrap: text past the last column overwrites
+        // it. With no window to fit, the default is wide enough for long log
+        // lines.
+        int rows = 24;
+        int columns = 1024;
+        // For devices that end lines with only LF or only CR.
+        TerminalState::NewLineMode new_line_mode = TerminalState::NewLineMode::Strict;
+        std::optional<seconds> duration;
+        seconds status_interval{ 0 };
+        // Keep the raw bytes and their receive times here.
+        std::filesystem::path record;
+        // Replay <source> as a recording instead of capturing it.
+        bool replay = false;
+        // 0 replays as fast as possible, 1 with the recorded timing.
+        double speed = 0.0;
+        // Seconds into the recording to start the replay at.
+        std::optional<double> seek;
+        // Send this file to the serial port, paced by send_pacing.
+        std::filesystem::path send;
+        BulkSender::Pacing send_pacing;
+    };
+
+    // How long the main thread sleeps without input before it checks for a
+    // stop request, the duration and the status interval.
+    constexpr milliseconds idle_wait{ 100 };
+
+    volatile std::sig_atomic_t stop_requested = 0;
+
+    extern "C" void RequestStop(int) {
+        stop_requested = 1;
+    }
+
+    void PrintUsage(std::ostream& out) {
+        out <<
+            "Usage: imterm-cli [options] <source>\n"
+            "       imterm-cli --replay [options] <recording>\n"
+            "\n"
+            "Captures <source> into the terminal and logs its lines. <source> is a\n"
+            "serial port, a file, a FIFO or pseudo-terminal, or - for standard input.\n"
+            "Stops at the end of the input, after --duration, or on Ctrl+C, and then\n"
+            "prints throughput statistics.\n"
+            "\n"
+            "With --replay, feeds a file recorded with --record, or any file of raw\n"
+            "bytes, through the terminal instead.\n"
+            "\n"
+            "Options:\n"
+            "  -b, --baud <rate>         Serial baud rate (default 115200)\n"
+            "      --serial              Open <source> as a serial port\n"
+            "      --file                Read <source> as a file, FIFO or pseudo-terminal\n"
+            "                            (default: regular files and FIFOs are files,\n"
+            "                            anything else is a serial port)\n"
+            "  -f, --follow              Keep reading a file as it grows\n"
+            "  -l, --log-dir <dir>       Directory for the log file\n"
+            "      --no-log              Do not write a log\n"
+            "  -t, --timestamps <res>    s, ms or us (default ms)\n"
+            "      --timestamp-kind <k>  last, first or both (default last)\n"
+            "      --newline <mode>      strict, add-cr (CR before each LF) or add-lf\n"
+            "                            (LF after each CR) (default strict)\n"
+            "      --rows <n>            Terminal rows (default 24)\n"
+            "      --columns <n>         Terminal columns; longer lines are cut (default 1024)\n"
+            "      --buffer <KiB>        Receive buffer, a power of two (default 1024)\n"
+            "  -d, --duration <seconds>  Stop after this long\n"
+            "  -s, --status <seconds>    Print statistics at this interval\n"
+            "      --record <file>       Keep the received bytes and their times in <file>\n"
+            "      --replay              Replay <source> as a recording\n"
+            "      --speed <x>           Replay at x times the recorded timing; 0 replays\n"
+            "                            as fast as possible (default 0)\n"
+            "      --seek <seconds>      Start the replay this far into the recording\n"
+            "      --send <file>         Send <file> to the serial port once capturing\n"
+            "      --send-rate <n>       Send at most n bytes per millisecond\n"
+            "      --line-delay <ms>     Pause after each line sent\n"
+            "      --prompt <text>       Wait for the device to print <text> after each\n"
+            "                            line sent\n"
+            "      --xonxoff             Pause sending on XOFF from the device until XON\n"
+            "  -h, --help                Show this help\n";
+    }
+
+    std::optional<uint64_t> ParseNumber(std::string_view text) {
+        if (text.empty() || text.size() > 18) {
+            return std::nullopt;
+        }
+        uint64_t value = 0;
+        for (const char c : text) {
+            if (c < '0' || c > '9') {
+                return std::nullopt;
+            }
+            value = value * 10 + static_cast<uint64_t>(c - '0');
+        }
+        return value;
+    }
+
+    // A finite, non-negative decimal number.
+    std::optional<double> ParseDecimal(std::string_view text) {
+        const std::string value(text);
+        char* end = nullptr;
+        const double parsed = std::strtod(value.c_str(), &end);
+        if (value.empty() || end != value.c_str() + value.size() || !std::isfinite(parsed) || parsed < 0.0) {
+            return std::nullopt;
+        }
+        return parsed;
+    }
+
+    // Parses the command line into aOptions. Returns an exit code when the
+    // program should stop without capturing.
+    std::optional<int> ParseArguments(int argc, char** argv, CliOptions& aOptions) {
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view argument = argv[i];
+
+            const auto value = [&]() -> std::optional<std::string_view> {
+                if (i + 1 >= argc) {
+                    std::cerr << "imterm-cli: " << argument << " needs a value\n";
+                    return std::nullopt;
+                }
+                return std::string_view(argv[++i]);
+            };
+            const auto number = [&](uint64_t aMin, uint64_t aMax) -> std::optional<uint64_t> {
+                const auto text = value();
+                if (!text) {
+                    return std::nullopt;
+                }
+                const auto parsed = ParseNumber(*text);
+                if (!parsed || *parsed < aMin || *parsed > aMax) {
+                    std::cerr << "imterm-cli: invalid value for " << argument << ": " << *text << "\n";
+                    return std::nullopt;
+                }
+                return parsed;
+            };
+
+            if (argument == "-h" || argument == "--help") {
+                PrintUsage(std::cout);
+                return EXIT_SUCCESS;
+            }
+            else if (argument == "-b" || argument == "--baud") {
+                const auto baud = number(1, UINT32_MAX);
+                if (!baud) return EXIT_FAILURE;
+                aOptions.baudrate = static_cast<uint32_t>(*baud);
+            }
+            else if (argument == "--serial") {
+                aOptions.kind = SourceKind::Serial;
+            }
+            else if (argument == "--file") {
+                aOptions.kind = SourceKind::File;
+            }
+            else if (argument == "-f" || argument == "--follow") {
+                aOptions.follow = true;
+            }
+            else if (argument == "-l" || argument == "--log-dir") {
+                const auto directory = value();
+                if (!directory) return EXIT_FAILURE;
+                aOptions.log_directory = std::filesystem::path(*directory);
+            }
+            else if (argument == "--no-log") {
+                aOptions.logging = false;
+            }
+            else if (argument == "-t" || argument == "--timestamps") {
+                const auto resolution = value();
+                if (!resolution) return EXIT_FAILURE;
+                if (*resolution == "s") aOptions.resolution = TimestampResolution::Seconds;
+                else if (*resolution == "ms") aOptions.resolution = TimestampResolution::Milliseconds;
+                else if (*resolution == "us") aOptions.resolution = TimestampResolution::Microseconds;
+                else {
+                    std::cerr << "imterm-cli: invalid timestamp resolution: " << *resolution << "\n";
+                    return EXIT_FAILURE;
+                }
+            }
+            else if (argument == "--timestamp-kind") {
+                const auto kind = value();
+                if (!kind) return EXIT_FAILURE;
+                if (*kind == "last") aOptions.timestamp_kind = LineTimestampKind::LastByte;
+                else if (*kind == "first") aOptions.timestamp_kind = LineTimestampKind::FirstByte;
+                else if (*kind == "both") aOptions.timestamp_kind = LineTimestampKind::FirstAndLastByte;
+                else {
+                    std::cerr << "imterm-cli: invalid timestamp kind: " << *kind << "\n";
+                    return EXIT_FAILURE;
+                }
+            }
+            else if (argument == "--newline") {
+                const auto mode = value();
+                if (!mode) return EXIT_FAILURE;
+                if (*mode == "strict") aOptions.new_line_mode = TerminalState::NewLineMode::Strict;
+                else if (*mode == "add-cr") aOptions.new_line_mode = TerminalState::NewLineMode::AddCrToLf;
+                else if (*mode == "add-lf") aOptions.new_line_mode = TerminalState::NewLineMode::AddLfToCr;
+                else {
+                    std::cerr << "imterm-cli: invalid newline mode: " << *mode << "\n";
+                    return EXIT_FAILURE;
+                }
+            }
+            else if (argument == "--rows" || argument == "--columns") {
+                const auto size = number(1, 1 << 16);
+                if (!size) return EXIT_FAILURE;
+                (argument == "--rows" ? aOptions.rows : aOptions.columns) = static_cast<int>(*size);
+            }
+            else if (argument == "--buffer") {
+                const auto kib = number(1, 1 << 20);
+                if (!kib) return EXIT_FAILURE;
+                if ((*kib & (*kib - 1)) != 0) {
+                    std::cerr << "imterm-cli: --buffer must be a power of two\n";
+                    return EXIT_FAILURE;
+                }
+                aOptions.receive_capacity = static_cast<size_t>(*kib) << 10;
+            }
+            else if (argument == "-d" || argument == "--duration") {
+                const auto duration = number(1, UINT32_MAX);
+                if (!duration) return EXIT_FAILURE;
+                aOptions.duration = seconds(*duration);
+            }
+            else if (argument == "-s" || argument == "--status") {
+                const auto interval = number(1, UINT32_MAX);
+                if (!interval) return EXIT_FAILURE;
+                aOptions.status_interval = seconds(*interval);
+            }
+            else if (argument == "--record") {
+                const auto path = value();
+                if (!path) return EXIT_FAILURE;
+                aOptions.record = std::filesystem::path(*path);
+            }
+            else if (argument == "--replay") {
+                aOptions.replay = true;
+            }
+            else if (argument == "--speed" || argument == "--seek") {
+                const auto text = value();
+                if (!text) return EXIT_FAILURE;
+                const auto parsed = ParseDecimal(*text);
+                if (!parsed) {
+                    std::cerr << "imterm-cli: invalid value for " << argument << ": " << *text << "\n";
+                    return EXIT_FAILURE;
+                }
+                if (argument == "--speed") aOptions.speed = *parsed;
+                else aOptions.seek = *parsed;
+            }
+            else if (argument == "--send") {
+                const auto path = value();
+                if (!path) return EXIT_FAILURE;
+                aOptions.send = std::filesystem::path(*path);
+            }
+            else if (argument == "--send-rate") {
+                const auto text = value();
+                if (!text) return EXIT_FAILURE;
+                const auto parsed = ParseDecimal(*text);
+                if (!parsed) {
+                    std::cerr << "imterm-cli: invalid value for " << argument << ": " << *text << "\n";
+                    return EXIT_FAILURE;
+                }
+                aOptions.send_pacing.BytesPerMillisecond = *parsed;
+            }
+            else if (argument == "--line-delay") {
+                const auto delay = number(0, UINT32_MAX);
+                if (!delay) return EXIT_FAILURE;
+                aOptions.send_pacing.LineDelay = milliseconds(*delay);
+            }
+            else if (argument == "--prompt") {
+                const auto prompt = value();
+                if (!prompt) return EXIT_FAILURE;
+                aOptions.send_pacing.Prompt = std::string(*prompt);
+            }
+            else if (argument == "--xonxoff") {
+                aOptions.send_pacing.HonorXonXoff = true;
+            }
+            else if (argument.size() > 1 && argument[0] == '-') {
+                std::cerr << "imterm-cli: unknown option " << argument << "\n";
+                PrintUsage(std::cerr);
+                return EXIT_FAILURE;
+            }
+            else if (aOptions.source.empty()) {
+                aOptions.source = argument;
+            }
+            else {
+                std::cerr << "imterm-cli: more than one source given\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (aOptions.source.empty()) {
+            PrintUsage(std::cerr);
+            return EXIT_FAILURE;
+        }
+        if (aOptions.replay && !aOptions.record.empty()) {
+            std::cerr << "imterm-cli: --record cannot be used with --replay\n";
+            return EXIT_FAILURE;
+        }
+        if (!aOptions.replay && (aOptions.speed != 0.0 || aOptions.seek)) {
+            std::cerr << "imterm-cli: --speed and --seek need --replay\n";
+            return EXIT_FAILURE;
+        }
+        if (aOptions.replay && !aOptions.send.empty()) {
+            std::cerr << "imterm-cli: --send cannot be used with --replay\n";
+            return EXIT_FAILURE;
+        }
+        return std::nullopt;
+    }
+
+    bool IsFileSource(const CliOptions& aOptions) {
+        if (aOptions.source == "-" || aOptions.kind == SourceKind::File) {
+            return true;
+        }
+        if (aOptions.kind == SourceKind::Serial) {
+            return false;
+        }
+        std::error_code error;
+        const auto type = std::filesystem::status(aOptions.source, error).type();
+        return type == std::filesystem::file_type::regular || type == std::filesystem::file_type::fifo;
+    }
+
+    // The log file name part for a source: the port or file name without its
+    // directory.
+    std::string LogPostfix(const CliOptions& aOptions) {
+        if (aOptions.source == "-") {
+            return "stdin";
+        }
+        std::string name = std::filesystem::path(aOptions.source).filename().string();
+        std::replace_if(name.begin(), name.end(), [](char c) {
+            return !std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '.';
+        }, '_');
+        return name;
+    }
+
+    // User plus system time of the whole process, all threads included.
+    duration<double> ProcessCpuTime() {
+#if defined(_WIN32)
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+            return duration<double>(0);
+        }
+        const auto ticks = [](const FILETIME& aTime) {
+            return (static_cast<uint64_t>(aTime.dwHighDateTime) << 32) | aTime.dwLowDateTime;
+        };
+        // FILETIME counts 100 ns intervals.
+        return duration<double>((ticks(kernel) + ticks(user)) * 1e-7);
+#else
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return duration<double>(0);
+        }
+        const auto time = [](const timeval& aTime) {
+            return static_cast<double>(aTime.tv_sec) + static_cast<double>(aTime.tv_usec) * 1e-6;
+        };
+        return duration<double>(time(usage.ru_utime) + time(usage.ru_stime));
+#endif
+    }
+
+    // aReceive is null for a replay, which has no receive buffer.
+    void PrintStatistics(std::ostream& out, uint64_t aBytes, size_t aLines,
+        duration<double> aElapsed, duration<double> aCpuTime, const ReceiveWorker::Statistics* aReceive) {
+
+        const double elapsed = std::max(aElapsed.count(), 1e-9);
+        const double mib = static_cast<double>(aBytes) / (1 << 20);
+        char text[256];
+
+        std::snprintf(text, sizeof(text), "%.3f MiB in %zu lines over %.1f s: %.3f MiB/s, %.0f bytes/s\n",
+            mib, aLines, aElapsed.count(), mib / elapsed, static_cast<double>(aBytes) / elapsed);
+        out << text;
+        if (aReceive) {
+            std::snprintf(text, sizeof(text), "Received %llu bytes, dropped %llu in %llu overflows; buffer peak %zu of %zu bytes\n",
+                static_cast<unsigned long long>(aReceive->mBytesReceived),
+                static_cast<unsigned long long>(aReceive->mBytesDropped),
+                static_cast<unsigned long long>(aReceive->mOverflowEvents),
+                aReceive->mHighWaterMark, aReceive->mCapacity);
+            out << text;
+        }
+        std::snprintf(text, sizeof(text), "CPU time %.3f s, %.2f%% of one core\n",
+            aCpuTime.count(), 100.0 * aCpuTime.count() / elapsed);
+        out << text;
+    }
+
+    int Replay(const CliOptions& aOptions, std::shared_ptr<const CaptureRecording> aRecording,
+        std::shared_ptr<TerminalData> aData, std::shared_ptr<TerminalState> aState) {
+
+        CaptureReplay replay(aRecording, aData, aState);
+        if (aOptions.seek) {
+            if (aRecording->HasTimes()) {
+                replay.SeekToTime(aRecording->GetTimeMarks().front().mTime
+                    + duration_cast<CaptureRecording::Clock::duration>(duration<double>(*aOptions.seek)));
+            }
+            else {
+                std::cerr << "imterm-cli: " << aOptions.source << " has no receive times to seek by\n";
+            }
+        }
+        if (aOptions.speed > 0.0 && !aRecording->HasTimes()) {
+            std::cerr << "imterm-cli: " << aOptions.source << " has no receive times; replaying as fast as possible\n";
+        }
+        const uint64_t first = replay.GetPosition();
+
+        const auto start = steady_clock::now();
+        const auto cpu_start = ProcessCpuTime();
+        auto next_status = start + aOptions.status_interval;
+
+        replay.Play(aOptions.speed);
+        while (!stop_requested && replay.IsPlaying()) {
+
+            if (replay.Update() == 0) {
+                if (const auto wait = replay.GetTimeUntilDue()) {
+                    std::this_thread::sleep_for(std::min<nanoseconds>(*wait, idle_wait));
+                }
+            }
+
+            if (auto spill_error = aData->TakeSpillError()) {
+                std::cerr << "Scrollback stopped spilling to disk. " << *spill_error << "\n";
+            }
+
+            const auto now = steady_clock::now();
+            if (aOptions.duration && now - start >= *aOptions.duration) {
+                break;
+            }
+            if (aOptions.status_interval.count() > 0 && now >= next_status) {
+                PrintStatistics(std::cerr, replay.GetPosition() - first, aData->GetLineCount(),
+                    now - start, ProcessCpuTime() - cpu_start, nullptr);
+                next_status += aOptions.status_interval;
+            }
+        }
+
+        PrintStatistics(std::cerr, replay.GetPosition() - first, aData->GetLineCount(),
+            steady_clock::now() - start, ProcessCpuTime() - cpu_start, nullptr);
+        return EXIT_SUCCESS;
+    }
+
+}
+
+int main(int argc, char** argv) {
+
+    CliOptions options;
+    if (const auto exit_code = ParseArguments(argc, argv, options)) {
+        return *exit_code;
+    }
+
+    std::unique_ptr<serial::Serial> serial;
+    std::shared_ptr<FileTransport> file;
+    std::shared_ptr<Transport> transport;
+    std::shared_ptr<const CaptureRecording> recording;
+    std::shared_ptr<ReceiveJournal> journal;
+
+    try {
+        if (options.replay) {
+            recording = std::make_shared<const CaptureRecording>(std::filesystem::path(options.source));
+        }
+        else if (IsFileSource(options)) {
+            FileTransport::Options file_options;
+            file_options.Follow = options.follow;
+            if (options.source == "-") {
+#if defined(_WIN32)
+                _setmode(_fileno(stdin), _O_BINARY);
+#endif
+                file = std::make_shared<FileTransport>(0, file_options);
+            }
+            else {
+                file = std::make_shared<FileTransport>(std::filesystem::path(options.source), file_options);
+            }
+            transport = file;
+        }
+        else {
+            serial = std::make_unique<serial::Serial>(
+                options.source,
+                options.baudrate,
+                serial::Timeout(
+                    50, /* inter_byte_timeout_ */
+                    100, /* read_timeout_constant_ */
+                    10, /* read_timeout_multiplier_ */
+                    50, /* write_timeout_constant_ */
+                    10  /* write_timeout_multiplier_ */
+                ));
+            transport = std::make_shared<SerialTransport>(*serial);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "imterm-cli: could not open " << options.source << ". " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if (!options.record.empty()) {
+        ReceiveJournal::Options journal_options;
+        journal_options.KeepFile = true;
+        try {
+            journal = std::make_shared<ReceiveJournal>(options.record, journal_options);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "imterm-cli: could not create " << options.record.string() << ". " << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::shared_ptr<TerminalLogger> term_log;
+    if (options.logging) {
+        auto ops = TerminalLogger::Options();
+        ops.TimeStampResolution = options.resolution;
+        ops.TimeStampKind = options.timestamp_kind;
+        ops.Asynchronous = true;
+        term_log = std::make_shared<TerminalLogger>(true, LogPostfix(options), ".log", options.log_directory, ops);
+    }
+    auto term_data = std::make_shared<TerminalData>(term_log);
+    // Keeps a long capture's scrollback on disk rather than in memory.
+    LineStore::SpillOptions spill;
+    spill.Path = std::filesystem::temp_directory_path()
+        / ("imterm-cli-" + LogPostfix(options) + "-" + std::to_string(system_clock::to_time_t(system_clock::now())) + ".scrollback");
+    spill.Compress = true;
+    try {
+        term_data->EnableSpill(spill);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Could not create scrollback file. " << e.what() << "\n";
+    }
+    auto term_state = std::make_shared<TerminalState>(term_data, options.new_line_mode);
+    term_state->SetViewportSize(options.rows, options.columns);
+    // Nobody is listening.
+    term_state->SetBellEnabled(false);
+
+    if (recording) {
+        const int exit_code = Replay(options, recording, term_data, term_state);
+        term_state.reset();
+        term_data.reset();
+        term_log.reset();
+        return exit_code;
+    }
+
+    auto session = std::make_unique<CaptureSession>(transport, term_state, options.receive_capacity);
+    if (file) {
+        // A file or pipe waits for us; there is no reason to lose its bytes.
+        session->SetOverflowPolicy(ReceiveWorker::OverflowPolicy::Wait);
+    }
+    session->SetJournal(journal);
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    bool woken = false;
+    session->SetReceiveNotifier([&] {
+        {
+            std::lock_guard lock(wake_mutex);
+            woken = true;
+        }
+        wake.notify_one();
+    });
+
+    std::signal(SIGINT, RequestStop);
+    std::signal(SIGTERM, RequestStop);
+
+    const auto start = steady_clock::now();
+    const auto cpu_start = ProcessCpuTime();
+    auto next_status = start + options.status_interval;
+    int exit_code = EXIT_SUCCESS;
+
+    session->Start();
+
+    BulkSender* sender = nullptr;
+    if (!options.send.empty()) {
+        sender = session->GetBulkSender();
+        try {
+            if (!sender) {
+                throw std::runtime_error("only a serial port can be sent to");
+            }
+            sender->Start(options.send, options.send_pacing);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "imterm-cli: could not send " << options.send.string() << ". " << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    while (!stop_requested) {
+
+        if (auto receive_error = session->TakeReceiveError()) {
+            std::cerr << "imterm-cli: read failed. " << *receive_error << "\n";
+            exit_code = EXIT_FAILURE;
+            break;
+        }
+        if (auto send_error = session->TakeSendError()) {
+            std::cerr << "imterm-cli: write failed. " << *send_error << "\n";
+            exit_code = EXIT_FAILURE;
+            break;
+        }
+
+        try {
+            // Replies to device reports go out through the session.
+            while (!stop_requested && session->Pump() > 0) {
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "imterm-cli: " << e.what() << "\n";
+            exit_code = EXIT_FAILURE;
+            break;
+        }
+
+        if (auto spill_error = term_data->TakeSpillError()) {
+            std::cerr << "Scrollback stopped spilling to disk. " << *spill_error << "\n";
+        }
+
+        if (sender && !sender->IsRunning()) {
+            const auto progress = sender->GetProgress();
+            char text[128];
+            std::snprintf(text, sizeof(text), "Sent %llu of %llu bytes in %.1f s: %.0f bytes/s\n",
+                static_cast<unsigned long long>(progress.mBytesSent),
+                static_cast<unsigned long long>(progress.mTotalBytes),
+                duration<double>(progress.mElapsed).count(), progress.mBytesPerSecond);
+            std::cerr << text;
+            auto send_error = sender->TakeError();
+            sender = nullptr;
+            if (send_error) {
+                std::cerr << "imterm-cli: send failed. " << *send_error << "\n";
+                exit_code = EXIT_FAILURE;
+                break;
+            }
+        }
+
+        const auto now = steady_clock::now();
+        if (file && file->AtEnd()) {
+            // Everything read before the end was queued; stop once it is applied.
+            const auto stats = session->GetReceiveStatistics();
+            if (stats.mBytesDelivered + stats.mBytesDropped == stats.mBytesReceived) {
+                break;
+            }
+        }
+        if (options.duration && now - start >= *options.duration) {
+            break;
+        }
+        if (options.status_interval.count() > 0 && now >= next_status) {
+            const auto stats = session->GetReceiveStatistics();
+            PrintStatistics(std::cerr, stats.mBytesDelivered, term_data->GetLineCount(),
+                now - start, ProcessCpuTime() - cpu_start, &stats);
+            next_status += options.status_interval;
+        }
+
+        std::unique_lock lock(wake_mutex);
+        wake.wait_for(lock, idle_wait, [&] { return woken; });
+        woken = false;
+    }
+
+    session->Stop();
+    if (!stop_requested && exit_code == EXIT_SUCCESS) {
+        // Bytes read before the reader stopped.
+        try {
+            while (session->Pump() > 0) {
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << "imterm-cli: " << e.what() << "\n";
+            exit_code = EXIT_FAILURE;
+        }
+    }
+    const auto elapsed = steady_clock::now() - start;
+    const auto stats = session->GetReceiveStatistics();
+    const size_t lines = term_data->GetLineCount();
+
+    // The last line is logged as the terminal data goes, then the log is
+    // flushed as the logger goes.
+    session.reset();
+    term_state.reset();
+    term_data.reset();
+    term_log.reset();
+
+    if (journal) {
+        if (auto journal_error = journal->TakeError()) {
+            std::cerr << "imterm-cli: recording stopped. " << *journal_error << "\n";
+        }
+        else if (journal->GetDroppedBytes() > 0) {
+            std::cerr << "imterm-cli: " << journal->GetDroppedBytes() << " bytes were not recorded\n";
+        }
+        journal.reset();
+    }
+
+    PrintStatistics(std::cerr, stats.mBytesDelivered, lines, elapsed, ProcessCpuTime() - cpu_start, &stats);
+    return exit_code;
+}
@@ -0,0 +1,101 @@
+#include "line_layout_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace imterm {
+
+	void LineLayoutCache::BeginFrame(const LineLayoutMetrics& aMetrics)
+	{
+		if (aMetrics != mMetrics) {
+			mMetrics = aMetrics;
+			mLayouts.clear();
+		}
+		else if (mLayouts.size() > 2 * mUsedThisFrame + 64) {
+			// Sweeping only once unused layouts outnumber used ones keeps the
+			// cost per frame proportional to the lines drawn.
+			std::erase_if(mLayouts, [this](const auto& aEntry) { return aEntry.second.mFrame != mFrame; });
+		}
+		++mFrame;
+		mUsedThisFrame = 0;
+	}
+
+	const LineLayout& LineLayoutCache::Get(const Line& aLine, const MeasureText& aMeasure)
+	{
+		const uint64_t generation = aLine.GetGeneration();
+		if (generation == 0) {
+			Build(aLine, mMetrics, aMeasure, mUncached);
+			return mUncached;
+		}
+
+		auto [it, inserted] = mLayouts.try_emplace(generation);
+		Entry& entry = it->second;
+		if (inserted) {
+			Build(aLine, mMetrics, aMeasure, entry.mLayout);
+		}
+		if (entry.mFrame != mFrame) {
+			entry.mFrame = mFrame;
+			++mUsedThisFrame;
+		}
+		return entry.mLayout;
+	}
+
+	void LineLayoutCache::Build(const Line& aLine, const LineLayoutMetrics& aMetrics, const MeasureText& aMeasure, LineLayout& aOut)
+	{
+		aOut.mText.clear();
+		aOut.mRuns.clear();
+		aOut.mBlanks.clear();
+
+		const std::span<const Char> bytes = aLine.GetBytes();
+		const std::span<const AttributeRun> colors = aLine.GetAttributeRuns();
+		const float tabWidth = static_cast<float>(aMetrics.mTabSize) * aMetrics.mSpaceWidth;
+
+		float x = 0.0f;
+		size_t runBegin = 0;
+		PaletteIndex runColor = colors.empty() ? PaletteIndex::Default : colors.front().mColorIndex;
+		const auto flush = [&]() {
+			if (aOut.mText.size() == runBegin) {
+				return;
+			}
+			const std::string_view text(aOut.mText.data() + runBegin, aOut.mText.size() - runBegin);
+			aOut.mRuns.push_back(LineLayout::Run{ x, static_cast<uint32_t>(runBegin), static_cast<uint32_t>(aOut.mText.size()), runColor });
+			x += aMeasure(text);
+			runBegin = aOut.mText.size();
+		};
+
+		size_t colorRun = 0;
+		for (size_t index = 0; index < bytes.size();) {
+			while (colorRun + 1 < colors.size() && colors[colorRun + 1].mStart <= index) {
+				++colorRun;
+			}
+			const PaletteIndex color = colors.empty() ? PaletteIndex::Default : colors[colorRun].mColorIndex;
+			const Char byte = bytes[index];
+
+			if (color != runColor || byte == '\t' || byte == ' ') {
+				flush();
+			}
+			runColor = color;
+
+			if (byte == '\t') {
+				const float start = x;
+				x = (1.0f + std::floor((1.0f + x) / tabWidth)) * tabWidth;
+				aOut.mBlanks.push_back(LineLayout::Blank{ start, x - start, true });
+				++index;
+			}
+			else if (byte == ' ') {
+				aOut.mBlanks.push_back(LineLayout::Blank{ x, aMetrics.mSpaceWidth, false });
+				x += aMetrics.mSpaceWidth;
+				++index;
+			}
+			else {
+				const size_t length = std::min(static_cast<size_t>(UTF8SequenceLength(byte)), bytes.size() - index);
+				aOut.mText.append(std::next(bytes.begin(), static_cast<std::ptrdiff_t>(index)),
+					std::next(bytes.begin(), static_cast<std::ptrdiff_t>(index + length)));
+				index += length;
+			}
+		}
+		flush();
+	}
+
+}
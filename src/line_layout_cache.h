@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "terminal_types.h"
+
+namespace imterm {
+
+	// What a line is drawn as: runs of text in one color, each starting at an
+	// offset from the left edge of the line, and the spaces and tabs between
+	// them. Runs break at color changes and whitespace, as the view has always
+	// drawn them.
+	struct LineLayout
+	{
+		struct Run
+		{
+			float mX;
+			// Range of mText holding the run.
+			uint32_t mBegin;
+			uint32_t mEnd;
+			PaletteIndex mColorIndex;
+		};
+
+		struct Blank
+		{
+			float mX;
+			float mWidth;
+			bool mTab;
+		};
+
+		// The text of every run, without the whitespace.
+		std::string mText;
+		std::vector<Run> mRuns;
+		std::vector<Blank> mBlanks;
+	};
+
+	// Font measurements a layout depends on.
+	struct LineLayoutMetrics
+	{
+		float mFontSize = 0.0f;
+		float mSpaceWidth = 0.0f;
+		int mTabSize = 4;
+
+		bool operator==(const LineLayoutMetrics&) const = default;
+	};
+
+	// Layouts of recently drawn lines, keyed on TerminalLine::GetGeneration(),
+	// so a line that has not changed since it was last drawn is emitted again
+	// without measuring its text. A generation names one version of one line,
+	// so the cache needs no invalidation as lines scroll, move or are removed;
+	// layouts that go unused are dropped at the start of a later frame.
+	//
+	// Text is measured through a callback, which keeps the cache independent of
+	// the font and of ImGui.
+	class LineLayoutCache
+	{
+	public:
+		// Width of a run of text, which never holds spaces or tabs.
+		using MeasureText = std::function<float(std::string_view)>;
+
+		// Starts a frame. Drops every layout when aMetrics differ from the
+		// previous frame's, and layouts not used in the previous frame once
+		// they outnumber the used ones.
+		void BeginFrame(const LineLayoutMetrics& aMetrics);
+
+		// The layout of aLine, built with aMeasure if it is not cached. The
+		// reference stays valid until the next BeginFrame(), or for a line that
+		// was never written, until the next Get().
+		const LineLayout& Get(const Line& aLine, const MeasureText& aMeasure);
+
+		size_t size() const noexcept { return mLayouts.size(); }
+		void clear() noexcept { mLayouts.clear(); }
+
+		static void Build(const Line& aLine, const LineLayoutMetrics& aMetrics, const MeasureText& aMeasure, LineLayout& aOut);
+
+	private:
+		struct Entry
+		{
+			LineLayout mLayout;
+			uint64_t mFrame = 0;
+		};
+
+		std::unordered_map<uint64_t, Entry> mLayouts;
+		LineLayout mUncached;
+		LineLayoutMetrics mMetrics;
+		uint64_t mFrame = 0;
+		size_t mUsedThisFrame = 0;
+	};
+
+}
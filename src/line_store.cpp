@@ -0,0 +1,628 @@
+#include "line_store.h"
+
+#include <algorithm>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "block_codec.h"
+#include "mapped_append_file.h"
+
+namespace imterm {
+
+	namespace {
+
+		// The encoding buffers are kept between spills, unless a block of very
+		// long lines made them this large.
+		constexpr size_t SpillBufferRetained = 4 << 20;
+
+		void TrimBuffer(std::vector<uint8_t>& aBuffer)
+		{
+			if (aBuffer.capacity() > SpillBufferRetained) {
+				std::vector<uint8_t>().swap(aBuffer);
+			}
+		}
+
+	}
+
+	// The spill file outlives the store while snapshots still read from it,
+	// and its reads and appends take turns.
+	struct LineStore::SpillFile
+	{
+		std::mutex mMutex;
+		MappedAppendFile mFile;
+
+		SpillFile(const std::filesystem::path& aPath, size_t aChunkSize)
+			: mFile(aPath, aChunkSize)
+		{
+		}
+	};
+
+	struct LineStore::SpillState
+	{
+		struct CachedBlock
+		{
+			uint64_t mId;
+			std::vector<Line> mLines;
+		};
+
+		SpillOptions mOptions;
+		std::shared_ptr<SpillFile> mFile;
+		// Blocks before this one have been spilled, or paged back in since.
+		size_t mCursor = 0;
+		size_t mSpilledBlocks = 0;
+		uint64_t mNextId = 0;
+		// Encoded lines, and their compressed form or the bytes read back.
+		std::vector<uint8_t> mBuffer;
+		std::vector<uint8_t> mStored;
+		// Decoded spilled blocks, most recently read first.
+		std::vector<CachedBlock> mCache;
+		SpillStatistics mStatistics;
+
+		explicit SpillState(SpillOptions aOptions)
+			: mOptions(std::move(aOptions))
+		{
+			if (!mOptions.Path.empty()) {
+				mFile = std::make_shared<SpillFile>(mOptions.Path, mOptions.ChunkSize);
+			}
+		}
+	};
+
+	LineStore::LineStore() = default;
+
+	LineStore::LineStore(size_t aCount)
+	{
+		resize(aCount);
+	}
+
+	LineStore::~LineStore() = default;
+	LineStore::LineStore(LineStore&&) noexcept = default;
+	LineStore& LineStore::operator=(LineStore&&) noexcept = default;
+
+	Line& LineStore::at(size_t aIndex)
+	{
+		if (aIndex >= mSize) {
+			throw std::out_of_range("LineStore::at index");
+		}
+		return (*this)[aIndex];
+	}
+
+	const Line& LineStore::at(size_t aIndex) const
+	{
+		if (aIndex >= mSize) {
+			throw std::out_of_range("LineStore::at index");
+		}
+		return (*this)[aIndex];
+	}
+
+	LineStore::Location LineStore::Locate(size_t aIndex) const
+	{
+		// Most lookups are near the end of the buffer.
+		const size_t last = mBlocks.size() - 1;
+		if (aIndex >= mStarts[last]) {
+			return { last, aIndex - mStarts[last] };
+		}
+
+		// While every block before the last is full, the block follows directly
+		// from the index.
+		const size_t guess = aIndex / BlockCapacity;
+		if (guess < last && mStarts[guess] <= aIndex && aIndex < mStarts[guess + 1]) {
+			return { guess, aIndex - mStarts[guess] };
+		}
+
+		const auto it = std::upper_bound(mStarts.begin(), mStarts.end(), aIndex);
+		const size_t block = static_cast<size_t>(it - mStarts.begin()) - 1;
+		return { block, aIndex - mStarts[block] };
+	}
+
+	LineStore::Block& LineStore::AppendBlock()
+	{
+		if (mSpill) {
+			SpillColdBlocks();
+		}
+
+		mStarts.push_back(mSize);
+		// A short buffer should not pay for a whole block up front, so the first
+		// block grows on demand. Later blocks are reserved in full and never
+		// reallocate.
+		const bool first = mBlocks.empty();
+		Block& block = mBlocks.emplace_back();
+		if (!first) {
+			block.mLines.reserve(BlockCapacity);
+		}
+		return block;
+	}
+
+	void LineStore::UpdateStarts(size_t aFromBlock)
+	{
+		mStarts.resize(mBlocks.size());
+		size_t start = aFromBlock == 0 ? 0 : mStarts[aFromBlock - 1] + mBlocks[aFromBlock - 1].size();
+		for (size_t block = aFromBlock; block < mBlocks.size(); ++block) {
+			mStarts[block] = start;
+			start += mBlocks[block].size();
+		}
+	}
+
+	Line& LineStore::push_back(Line&& aLine)
+	{
+		if (mBlocks.empty() || mBlocks.back().size() == BlockCapacity) {
+			AppendBlock();
+		}
+		else if (mBlocks.back().mSealed) {
+			// Removing lines from the end left a sealed block last.
+			Unseal(mBlocks.back());
+		}
+		Line& line = mBlocks.back().mLines.emplace_back(std::move(aLine));
+		++mSize;
+		return line;
+	}
+
+	void LineStore::insert(size_t aIndex, Line&& aLine)
+	{
+		if (aIndex > mSize) {
+			throw std::out_of_range("LineStore::insert index");
+		}
+		if (aIndex == mSize) {
+			push_back(std::move(aLine));
+			return;
+		}
+
+		Location location = Locate(aIndex);
+		Own(location.mBlock);
+		if (mBlocks[location.mBlock].size() == BlockCapacity) {
+			// Split the full block in half so inserts stay bounded by the block
+			// size rather than the buffer size.
+			Block tail;
+			tail.mLines.reserve(BlockCapacity);
+			std::vector<Line>& full = mBlocks[location.mBlock].mLines;
+			const auto middle = full.begin() + static_cast<std::ptrdiff_t>(BlockCapacity / 2);
+			tail.mLines.insert(tail.mLines.end(), std::make_move_iterator(middle), std::make_move_iterator(full.end()));
+			full.erase(middle, full.end());
+			mBlocks.insert(mBlocks.begin() + static_cast<std::ptrdiff_t>(location.mBlock + 1), std::move(tail));
+			if (mSpill) {
+				mSpill->mCursor = std::min(mSpill->mCursor, location.mBlock);
+			}
+
+			if (location.mOffset >= BlockCapacity / 2) {
+				location.mOffset -= BlockCapacity / 2;
+				++location.mBlock;
+			}
+		}
+
+		std::vector<Line>& lines = mBlocks[location.mBlock].mLines;
+		lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(location.mOffset), std::move(aLine));
+		++mSize;
+		UpdateStarts(location.mBlock);
+	}
+
+	void LineStore::erase(size_t aFirst, size_t aLast)
+	{
+		if (aFirst > aLast || aLast > mSize) {
+			throw std::out_of_range("LineStore::erase range");
+		}
+		if (aFirst == aLast) {
+			return;
+		}
+
+		const Location first = Locate(aFirst);
+		size_t remaining = aLast - aFirst;
+		size_t block = first.mBlock;
+		size_t offset = first.mOffset;
+
+		while (remaining > 0) {
+			Block& current = mBlocks[block];
+			const size_t count = std::min(remaining, current.size() - offset);
+			if (current.mSpill && count == current.size()) {
+				// A whole spilled block goes without being read back.
+				DropSpilled(current);
+			}
+			else if (current.mSealed && count == current.size()) {
+				// Snapshots keep the lines of a whole sealed block.
+				current.mSealed.reset();
+			}
+			else {
+				Own(block);
+				current.mLines.erase(
+					current.mLines.begin() + static_cast<std::ptrdiff_t>(offset),
+					current.mLines.begin() + static_cast<std::ptrdiff_t>(offset + count));
+			}
+			remaining -= count;
+			offset = 0;
+			++block;
+		}
+
+		mSize -= aLast - aFirst;
+		mBlocks.erase(
+			std::remove_if(
+				mBlocks.begin() + static_cast<std::ptrdiff_t>(first.mBlock),
+				mBlocks.begin() + static_cast<std::ptrdiff_t>(block),
+				[](const Block& aBlock) { return aBlock.size() == 0; }),
+			mBlocks.begin() + static_cast<std::ptrdiff_t>(block));
+		UpdateStarts(std::min(first.mBlock, mBlocks.size()));
+		if (mSpill) {
+			mSpill->mCursor = std::min(mSpill->mCursor, first.mBlock);
+		}
+	}
+
+	void LineStore::clear() noexcept
+	{
+		std::vector<Block>().swap(mBlocks);
+		std::vector<size_t>().swap(mStarts);
+		mSize = 0;
+		if (mSpill) {
+			mSpill->mCursor = 0;
+			mSpill->mSpilledBlocks = 0;
+			mSpill->mCache.clear();
+		}
+	}
+
+	void LineStore::resize(size_t aCount)
+	{
+		if (aCount < mSize) {
+			erase(aCount, mSize);
+			return;
+		}
+		while (mSize < aCount) {
+			emplace_back();
+		}
+	}
+
+	void LineStore::EnableSpill(SpillOptions aOptions)
+	{
+		if (mSpill) {
+			throw std::logic_error("LineStore spilling is already enabled");
+		}
+		aOptions.HotLines = std::max(aOptions.HotLines, BlockCapacity);
+		aOptions.CachedBlocks = std::max<size_t>(aOptions.CachedBlocks, 1);
+		mSpill = std::make_unique<SpillState>(std::move(aOptions));
+	}
+
+	size_t LineStore::SpilledBlockCount() const noexcept
+	{
+		return mSpill ? mSpill->mSpilledBlocks : 0;
+	}
+
+	uint64_t LineStore::GetSpillFileSize() const noexcept
+	{
+		return mSpill && mSpill->mFile ? mSpill->mFile->mFile.GetSize() : 0;
+	}
+
+	LineStore::SpillStatistics LineStore::GetSpillStatistics() const noexcept
+	{
+		return mSpill ? mSpill->mStatistics : SpillStatistics();
+	}
+
+	std::optional<std::string> LineStore::TakeSpillError()
+	{
+		return mSpill && mSpill->mFile ? mSpill->mFile->mFile.TakeError() : std::nullopt;
+	}
+
+	void LineStore::SpillColdBlocks()
+	{
+		SpillState& spill = *mSpill;
+		if ((spill.mFile && spill.mFile->mFile.HasFailed()) || mSize <= spill.mOptions.HotLines) {
+			return;
+		}
+		const size_t coldEnd = mSize - spill.mOptions.HotLines;
+		for (; spill.mCursor < mBlocks.size(); ++spill.mCursor) {
+			Block& block = mBlocks[spill.mCursor];
+			if (mStarts[spill.mCursor] + block.size() > coldEnd) {
+				break;
+			}
+			if (!block.mSpill && !Spill(block)) {
+				break;
+			}
+		}
+	}
+
+	bool LineStore::Spill(Block& aBlock)
+	{
+		SpillState& spill = *mSpill;
+		const std::vector<Line>& lines = aBlock.mSealed ? *aBlock.mSealed : aBlock.mLines;
+		spill.mBuffer.clear();
+		for (const Line& line : lines) {
+			line.Encode(spill.mBuffer);
+		}
+
+		// Keep the encoded bytes when compression does not make them smaller.
+		std::span<const uint8_t> stored(spill.mBuffer);
+		bool compressed = false;
+		if (spill.mOptions.Compress) {
+			spill.mStored.clear();
+			CompressBlock(spill.mBuffer, spill.mStored);
+			if (spill.mStored.size() < spill.mBuffer.size()) {
+				stored = spill.mStored;
+				compressed = true;
+			}
+		}
+
+		uint64_t offset = 0;
+		bool written = true;
+		if (spill.mFile) {
+			const std::lock_guard lock(spill.mFile->mMutex);
+			offset = spill.mFile->mFile.GetSize();
+			written = spill.mFile->mFile.Append(stored) == stored.size();
+		}
+		else {
+			aBlock.mPacked = std::make_shared<const std::vector<uint8_t>>(stored.begin(), stored.end());
+		}
+
+		if (written) {
+			aBlock.mSpill = SpillLocation{ spill.mNextId++, offset, stored.size(), spill.mBuffer.size(), lines.size(), compressed };
+			std::vector<Line>().swap(aBlock.mLines);
+			aBlock.mSealed.reset();
+			++spill.mSpilledBlocks;
+			++spill.mStatistics.SpilledBlocks;
+			spill.mStatistics.EncodedBytes += spill.mBuffer.size();
+			spill.mStatistics.StoredBytes += stored.size();
+		}
+		TrimBuffer(spill.mBuffer);
+		TrimBuffer(spill.mStored);
+		return written;
+	}
+
+	const std::vector<Line>& LineStore::ReadSpilled(const Block& aBlock) const
+	{
+		SpillState& spill = *mSpill;
+		const SpillLocation& location = *aBlock.mSpill;
+		auto& cache = spill.mCache;
+
+		const auto cached = std::find_if(cache.begin(), cache.end(),
+			[&location](const SpillState::CachedBlock& aCached) { return aCached.mId == location.mId; });
+		if (cached != cache.end()) {
+			std::rotate(cache.begin(), cached, std::next(cached));
+			return cache.front().mLines;
+		}
+
+		using Clock = std::chrono::steady_clock;
+		const auto start = Clock::now();
+
+		std::span<const uint8_t> stored;
+		if (spill.mFile) {
+			spill.mStored.resize(location.mBytes);
+			const std::lock_guard lock(spill.mFile->mMutex);
+			spill.mFile->mFile.Read(location.mOffset, spill.mStored);
+			stored = spill.mStored;
+		}
+		else {
+			stored = *aBlock.mPacked;
+		}
+		std::vector<Line> lines = DecodeBlock(location, stored, spill.mBuffer);
+		TrimBuffer(spill.mBuffer);
+		TrimBuffer(spill.mStored);
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+		++spill.mStatistics.ReadBlocks;
+		spill.mStatistics.ReadTime += elapsed;
+		spill.mStatistics.WorstReadTime = std::max(spill.mStatistics.WorstReadTime, elapsed);
+
+		if (cache.size() >= spill.mOptions.CachedBlocks) {
+			cache.pop_back();
+		}
+		cache.insert(cache.begin(), SpillState::CachedBlock{ location.mId, std::move(lines) });
+		return cache.front().mLines;
+	}
+
+	std::vector<Line> LineStore::DecodeBlock(const SpillLocation& aLocation, std::span<const uint8_t> aStored, std::vector<uint8_t>& aBuffer)
+	{
+		std::span<const uint8_t> encoded = aStored;
+		if (aLocation.mCompressed) {
+			aBuffer.resize(aLocation.mEncodedBytes);
+			DecompressBlock(aStored, aBuffer);
+			encoded = aBuffer;
+		}
+
+		std::vector<Line> lines;
+		lines.reserve(aLocation.mLines);
+		for (size_t line = 0; line < aLocation.mLines; ++line) {
+			lines.push_back(Line::Decode(encoded));
+		}
+		return lines;
+	}
+
+	void LineStore::PageIn(size_t aBlock)
+	{
+		Block& block = mBlocks[aBlock];
+		ReadSpilled(block);
+		// Moving the vector keeps references to its lines valid.
+		block.mLines = std::move(mSpill->mCache.front().mLines);
+		mSpill->mCache.erase(mSpill->mCache.begin());
+		block.mSpill.reset();
+		block.mPacked.reset();
+		--mSpill->mSpilledBlocks;
+		mSpill->mCursor = std::min(mSpill->mCursor, aBlock);
+	}
+
+	void LineStore::DropSpilled(Block& aBlock)
+	{
+		auto& cache = mSpill->mCache;
+		cache.erase(std::remove_if(cache.begin(), cache.end(),
+			[&aBlock](const SpillState::CachedBlock& aCached) { return aCached.mId == aBlock.mSpill->mId; }),
+			cache.end());
+		aBlock.mSpill.reset();
+		aBlock.mPacked.reset();
+		--mSpill->mSpilledBlocks;
+	}
+
+	void LineStore::Own(size_t aBlock)
+	{
+		Block& block = mBlocks[aBlock];
+		if (block.mSpill) {
+			PageIn(aBlock);
+		}
+		else if (block.mSealed) {
+			Unseal(block);
+		}
+	}
+
+	void LineStore::Unseal(Block& aBlock)
+	{
+		// The acquire load orders the reads of every destroyed snapshot before
+		// the lines are taken back.
+		if (mLiveSnapshots->load(std::memory_order_acquire) == 0) {
+			// Only the store holds the lines now, and they were created
+			// non-const. Moving the vector keeps references to its lines valid.
+			aBlock.mLines = std::move(const_cast<std::vector<Line>&>(*aBlock.mSealed));
+		}
+		else {
+			aBlock.mLines.reserve(BlockCapacity);
+			aBlock.mLines.assign(aBlock.mSealed->begin(), aBlock.mSealed->end());
+		}
+		aBlock.mSealed.reset();
+	}
+
+	LineStore::Snapshot LineStore::TakeSnapshot()
+	{
+		if (!mLiveSnapshots) {
+			mLiveSnapshots = std::make_shared<std::atomic<size_t>>(0);
+		}
+
+		Snapshot snapshot;
+		snapshot.mLive = mLiveSnapshots;
+		snapshot.mLive->fetch_add(1, std::memory_order_relaxed);
+		snapshot.mStarts = mStarts;
+		snapshot.mSize = mSize;
+		if (mSpill) {
+			snapshot.mFile = mSpill->mFile;
+		}
+
+		snapshot.mBlocks.reserve(mBlocks.size());
+		for (size_t index = 0; index < mBlocks.size(); ++index) {
+			Block& block = mBlocks[index];
+			Snapshot::Block& shared = snapshot.mBlocks.emplace_back();
+			if (block.mSpill) {
+				shared.mSpill = block.mSpill;
+				shared.mPacked = block.mPacked;
+			}
+			else if (block.mSealed) {
+				shared.mLines = block.mSealed;
+			}
+			else if (index + 1 == mBlocks.size()) {
+				shared.mLines = std::make_shared<const std::vector<Line>>(block.mLines);
+			}
+			else {
+				block.mSealed = std::make_shared<std::vector<Line>>(std::move(block.mLines));
+				block.mLines = std::vector<Line>();
+				shared.mLines = block.mSealed;
+			}
+		}
+		return snapshot;
+	}
+
+	size_t LineStore::SealedBlockCount() const noexcept
+	{
+		return static_cast<size_t>(std::count_if(mBlocks.begin(), mBlocks.end(),
+			[](const Block& aBlock) { return aBlock.mSealed != nullptr; }));
+	}
+
+	LineStore::Snapshot::~Snapshot()
+	{
+		if (mLive) {
+			// Pairs with the acquire load in Unseal(): everything read through
+			// this snapshot happens before the store takes sealed lines back.
+			mLive->fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+	LineStore::Snapshot::Snapshot(Snapshot&& aOther) noexcept
+		: mBlocks(std::move(aOther.mBlocks))
+		, mStarts(std::move(aOther.mStarts))
+		, mSize(std::exchange(aOther.mSize, 0))
+		, mFile(std::move(aOther.mFile))
+		, mLive(std::move(aOther.mLive))
+	{
+	}
+
+	LineStore::Snapshot& LineStore::Snapshot::operator=(Snapshot&& aOther) noexcept
+	{
+		if (this != &aOther) {
+			Snapshot released(std::move(*this));
+			mBlocks = std::move(aOther.mBlocks);
+			mStarts = std::move(aOther.mStarts);
+			mSize = std::exchange(aOther.mSize, 0);
+			mFile = std::move(aOther.mFile);
+			mLive = std::move(aOther.mLive);
+		}
+		return *this;
+	}
+
+	Line LineStore::Snapshot::GetLine(size_t aIndex) const
+	{
+		if (aIndex >= mSize) {
+			throw std::out_of_range("LineStore::Snapshot::GetLine index");
+		}
+		std::vector<Line> decoded;
+		const size_t block = LocateBlock(aIndex);
+		return ReadBlock(block, decoded)[aIndex - mStarts[block]];
+	}
+
+	size_t LineStore::Snapshot::LocateBlock(size_t aIndex) const
+	{
+		const auto it = std::upper_bound(mStarts.begin(), mStarts.end(), aIndex);
+		return static_cast<size_t>(it - mStarts.begin()) - 1;
+	}
+
+	const std::vector<Line>& LineStore::Snapshot::ReadBlock(size_t aBlock, std::vector<Line>& aDecoded) const
+	{
+		const Block& block = mBlocks[aBlock];
+		if (!block.mSpill) {
+			return *block.mLines;
+		}
+
+		const SpillLocation& location = *block.mSpill;
+		std::vector<uint8_t> buffer;
+		if (!mFile) {
+			aDecoded = LineStore::DecodeBlock(location, *block.mPacked, buffer);
+			return aDecoded;
+		}
+
+		std::vector<uint8_t> stored(location.mBytes);
+		{
+			const std::lock_guard lock(mFile->mMutex);
+			mFile->mFile.Read(location.mOffset, stored);
+		}
+		aDecoded = LineStore::DecodeBlock(location, stored, buffer);
+		return aDecoded;
+	}
+
+	size_t LineStore::GetHeapUsage() const noexcept
+	{
+		size_t total = mBlocks.capacity() * sizeof(Block) + mStarts.capacity() * sizeof(size_t);
+		for (const Block& block : mBlocks) {
+			total += block.mLines.capacity() * sizeof(Line);
+			if (block.mSealed) {
+				total += block.mSealed->capacity() * sizeof(Line);
+			}
+			if (block.mPacked) {
+				total += block.mPacked->capacity();
+			}
+		}
+		if (mSpill) {
+			total += sizeof(SpillState) + mSpill->mBuffer.capacity() + mSpill->mStored.capacity();
+			for (const SpillState::CachedBlock& cached : mSpill->mCache) {
+				total += cached.mLines.capacity() * sizeof(Line);
+			}
+		}
+		return total;
+	}
+
+	size_t LineStore::GetLineHeapUsage() const noexcept
+	{
+		size_t total = 0;
+		for (const Block& block : mBlocks) {
+			for (const Line& line : block.mSealed ? *block.mSealed : block.mLines) {
+				total += line.GetHeapUsage();
+			}
+		}
+		if (mSpill) {
+			for (const SpillState::CachedBlock& cached : mSpill->mCache) {
+				for (const Line& line : cached.mLines) {
+					total += line.GetHeapUsage();
+				}
+			}
+		}
+		return total;
+	}
+
+}
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "terminal_types.h"
+
+namespace imterm {
+
+	// Scrollback storage made of fixed-capacity blocks of lines.
+	//
+	// Appending moves at most one block's worth of lines: a new block is started
+	// when the last one is full, so push_back() is O(1) with a bounded worst
+	// case instead of the occasional whole-buffer reallocation of a std::vector.
+	// Lookup by index is O(1) while every block but the last is full (the
+	// append-only case) and O(log blocks) after insertions or removals in the
+	// middle.
+	//
+	// The interface mirrors the subset of std::vector the terminal buffer uses;
+	// insert() and erase() take line indices rather than iterators.
+	//
+	// With spilling enabled, blocks that lie entirely before the last HotLines
+	// lines are encoded, optionally compressed with CompressBlock(), and moved
+	// into an append-only MappedAppendFile, so resident memory stays bounded
+	// however long the capture runs. Without a file the encoded blocks stay in
+	// memory, which already takes about half the space of the lines. Reading a
+	// spilled line decodes its block into a small cache of recently read
+	// blocks; a reference to such a line stays valid until CachedBlocks other
+	// spilled blocks have been read. Writing to a spilled line, through the
+	// non-const accessors, insert() or a partial erase(), pages its block back
+	// in for good until it is spilled again. Space in the file is not reused.
+	//
+	// TakeSnapshot() returns an immutable view of the store that other threads
+	// may read while it keeps changing. Every block but the last is sealed:
+	// its lines move into a reference-counted vector shared with the snapshot,
+	// and the first write to a sealed block copies it back, or takes it back
+	// without copying once no snapshot is left. The last block, where lines
+	// are appended and edited, is copied into the snapshot.
+	class LineStore
+	{
+	public:
+		static constexpr size_t BlockCapacity = 4096;
+
+		struct SpillOptions {
+			// File for the spilled blocks; empty keeps them in memory.
+			std::filesystem::path Path;
+			// Compress each block as it is spilled.
+			bool Compress = false;
+			// Lines at the end of the buffer that always stay in memory; at
+			// least one block.
+			size_t HotLines = 16 * BlockCapacity;
+			// Spilled blocks kept decoded after they are read.
+			size_t CachedBlocks = 8;
+			// Granularity of the file's growth and mappings.
+			size_t ChunkSize = 16 << 20;
+		};
+
+		// Totals since spilling was enabled, for tuning the block size.
+		struct SpillStatistics {
+			size_t SpilledBlocks = 0;
+			// Bytes of encoded lines, and the bytes stored for them after
+			// compression.
+			uint64_t EncodedBytes = 0;
+			uint64_t StoredBytes = 0;
+			// Spilled blocks read back on a cache miss, and the time spent
+			// reading, decompressing and decoding them.
+			size_t ReadBlocks = 0;
+			std::chrono::nanoseconds ReadTime{ 0 };
+			std::chrono::nanoseconds WorstReadTime{ 0 };
+		};
+
+		template <bool Const>
+		class Iterator
+		{
+		public:
+			using Store = std::conditional_t<Const, const LineStore, LineStore>;
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = Line;
+			using difference_type = std::ptrdiff_t;
+			using pointer = std::conditional_t<Const, const Line*, Line*>;
+			using reference = std::conditional_t<Const, const Line&, Line&>;
+
+			Iterator() = default;
+			Iterator(Store* aStore, size_t aIndex) : mStore(aStore), mIndex(aIndex) {}
+			operator Iterator<true>() const requires (!Const) { return Iterator<true>(mStore, mIndex); }
+
+			reference operator*() const { return (*mStore)[mIndex]; }
+			pointer operator->() const { return &(*mStore)[mIndex]; }
+			reference operator[](difference_type aOffset) const { return (*mStore)[mIndex + aOffset]; }
+
+			Iterator& operator++() { ++mIndex; return *this; }
+			Iterator operator++(int) { auto copy = *this; ++mIndex; return copy; }
+			Iterator& operator--() { --mIndex; return *this; }
+			Iterator operator--(int) { auto copy = *this; --mIndex; return copy; }
+			Iterator& operator+=(difference_type aOffset) { mIndex += aOffset; return *this; }
+			Iterator& operator-=(difference_type aOffset) { mIndex -= aOffset; return *this; }
+			friend Iterator operator+(Iterator aIt, difference_type aOffset) { return aIt += aOffset; }
+			friend Iterator operator+(difference_type aOffset, Iterator aIt) { return aIt += aOffset; }
+			friend Iterator operator-(Iterator aIt, difference_type aOffset) { return aIt -= aOffset; }
+			friend difference_type operator-(const Iterator& aLeft, const Iterator& aRight) {
+				return static_cast<difference_type>(aLeft.mIndex) - static_cast<difference_type>(aRight.mIndex);
+			}
+			friend bool operator==(const Iterator& aLeft, const Iterator& aRight) { return aLeft.mIndex == aRight.mIndex; }
+			friend auto operator<=>(const Iterator& aLeft, const Iterator& aRight) { return aLeft.mIndex <=> aRight.mIndex; }
+
+		private:
+			Store* mStore = nullptr;
+			size_t mIndex = 0;
+		};
+
+	private:
+		struct SpillLocation {
+			// Names the block in the cache of decoded blocks.
+			uint64_t mId;
+			// Where the stored bytes are in the file, if there is one.
+			uint64_t mOffset;
+			size_t mBytes;
+			size_t mEncodedBytes;
+			size_t mLines;
+			bool mCompressed;
+		};
+		struct SpillFile;
+
+	public:
+		// The lines of a LineStore at one moment. Any number of threads may
+		// read one snapshot at the same time, and the store it came from may
+		// change or be destroyed meanwhile. Lines are read with their bytes,
+		// colors, timestamps and generation; column lookups (StopAtColumn(),
+		// StopAtByte(), EndStop()) cache an index inside the line, so they are
+		// not safe on a reader thread.
+		class Snapshot
+		{
+		public:
+			Snapshot() = default;
+			~Snapshot();
+			Snapshot(Snapshot&& aOther) noexcept;
+			Snapshot& operator=(Snapshot&& aOther) noexcept;
+			Snapshot(const Snapshot&) = delete;
+			Snapshot& operator=(const Snapshot&) = delete;
+
+			size_t size() const noexcept { return mSize; }
+			bool empty() const noexcept { return mSize == 0; }
+
+			// Calls aVisit(index, line) for the lines [aFirst, aLast) in order.
+			// A spilled block is read back and decoded once per call.
+			template <typename Visit>
+			void ForEach(size_t aFirst, size_t aLast, Visit&& aVisit) const
+			{
+				aLast = std::min(aLast, mSize);
+				std::vector<Line> decoded;
+				for (size_t index = aFirst; index < aLast;) {
+					const size_t block = LocateBlock(index);
+					const std::vector<Line>& lines = ReadBlock(block, decoded);
+					const size_t end = std::min(aLast, mStarts[block] + lines.size());
+					for (; index < end; ++index) {
+						aVisit(index, lines[index - mStarts[block]]);
+					}
+				}
+			}
+
+			// A copy of line aIndex. Throws std::out_of_range.
+			Line GetLine(size_t aIndex) const;
+
+		private:
+			friend class LineStore;
+
+			struct Block {
+				std::shared_ptr<const std::vector<Line>> mLines;
+				std::optional<SpillLocation> mSpill;
+				std::shared_ptr<const std::vector<uint8_t>> mPacked;
+			};
+
+			size_t LocateBlock(size_t aIndex) const;
+			const std::vector<Line>& ReadBlock(size_t aBlock, std::vector<Line>& aDecoded) const;
+
+			std::vector<Block> mBlocks;
+			std::vector<size_t> mStarts;
+			size_t mSize = 0;
+			std::shared_ptr<SpillFile> mFile;
+			// The store's count of live snapshots.
+			std::shared_ptr<std::atomic<size_t>> mLive;
+		};
+
+		using iterator = Iterator<false>;
+		using const_iterator = Iterator<true>;
+		using size_type = size_t;
+		using value_type = Line;
+
+		LineStore();
+		explicit LineStore(size_t aCount);
+		~LineStore();
+		LineStore(LineStore&&) noexcept;
+		LineStore& operator=(LineStore&&) noexcept;
+
+		size_t size() const noexcept { return mSize; }
+		bool empty() const noexcept { return mSize == 0; }
+
+		Line& operator[](size_t aIndex) {
+			const Location location = Locate(aIndex);
+			Block& block = mBlocks[location.mBlock];
+			if (block.mSpill || block.mSealed) {
+				Own(location.mBlock);
+			}
+			return block.mLines[location.mOffset];
+		}
+		const Line& operator[](size_t aIndex) const {
+			const Location location = Locate(aIndex);
+			const Block& block = mBlocks[location.mBlock];
+			if (block.mSpill) {
+				return ReadSpilled(block)[location.mOffset];
+			}
+			if (block.mSealed) {
+				return (*block.mSealed)[location.mOffset];
+			}
+			return block.mLines[location.mOffset];
+		}
+		Line& at(size_t aIndex);
+		const Line& at(size_t aIndex) const;
+
+		Line& front() { return (*this)[0]; }
+		const Line& front() const { return (*this)[0]; }
+		Line& back() { return (*this)[mSize - 1]; }
+		const Line& back() const { return (*this)[mSize - 1]; }
+
+		iterator begin() noexcept { return iterator(this, 0); }
+		iterator end() noexcept { return iterator(this, mSize); }
+		const_iterator begin() const noexcept { return const_iterator(this, 0); }
+		const_iterator end() const noexcept { return const_iterator(this, mSize); }
+
+		Line& push_back(Line&& aLine);
+		Line& emplace_back() { return push_back(Line()); }
+
+		// Inserts aLine before index aIndex (aIndex == size() appends).
+		void insert(size_t aIndex, Line&& aLine);
+
+		// Removes lines [aFirst, aLast).
+		void erase(size_t aFirst, size_t aLast);
+
+		// Removes every line and frees the blocks and their index.
+		void clear() noexcept;
+		void resize(size_t aCount);
+
+		size_t BlockCount() const noexcept { return mBlocks.size(); }
+
+		// Seals every block but the last and shares them with the snapshot.
+		Snapshot TakeSnapshot();
+		// Blocks currently shared with snapshots.
+		size_t SealedBlockCount() const noexcept;
+
+		// Starts spilling cold blocks, to a file created at aOptions.Path if it
+		// is set, which is removed with the store. Throws std::system_error if
+		// the file cannot be created and std::logic_error if spilling is already
+		// enabled. If the file later cannot grow, spilling stops and the error
+		// is reported by TakeSpillError(); the lines stay in memory.
+		void EnableSpill(SpillOptions aOptions);
+		bool IsSpillEnabled() const noexcept { return mSpill != nullptr; }
+		size_t SpilledBlockCount() const noexcept;
+		uint64_t GetSpillFileSize() const noexcept;
+		SpillStatistics GetSpillStatistics() const noexcept;
+		std::optional<std::string> TakeSpillError();
+
+		// Bytes reserved for resident and cached line objects and for spilled
+		// blocks kept in memory, excluding each line's own heap usage.
+		size_t GetHeapUsage() const noexcept;
+		// Heap bytes owned by the resident and cached lines themselves.
+		size_t GetLineHeapUsage() const noexcept;
+
+	private:
+		struct Block {
+			std::vector<Line> mLines;
+			// Set while the lines are shared with snapshots; mLines is empty
+			// then.
+			std::shared_ptr<const std::vector<Line>> mSealed;
+			// Set while the lines are spilled; mLines is empty then.
+			std::optional<SpillLocation> mSpill;
+			// The stored bytes of a block spilled without a file, shared with
+			// snapshots.
+			std::shared_ptr<const std::vector<uint8_t>> mPacked;
+
+			size_t size() const noexcept { return mSpill ? mSpill->mLines : mSealed ? mSealed->size() : mLines.size(); }
+		};
+
+		struct SpillState;
+
+		struct Location {
+			size_t mBlock;
+			size_t mOffset;
+		};
+
+		Location Locate(size_t aIndex) const;
+		Block& AppendBlock();
+		void UpdateStarts(size_t aFromBlock);
+
+		void SpillColdBlocks();
+		bool Spill(Block& aBlock);
+		const std::vector<Line>& ReadSpilled(const Block& aBlock) const;
+		// Decodes the lines of a spilled block from its stored bytes,
+		// decompressing them into aBuffer first if needed.
+		static std::vector<Line> DecodeBlock(const SpillLocation& aLocation, std::span<const uint8_t> aStored, std::vector<uint8_t>& aBuffer);
+		void PageIn(size_t aBlock);
+		void DropSpilled(Block& aBlock);
+		// Makes a spilled or sealed block's lines writable in mLines.
+		void Own(size_t aBlock);
+		void Unseal(Block& aBlock);
+
+		std::vector<Block> mBlocks;
+		// mStarts[i] is the index of the first line in mBlocks[i].
+		std::vector<size_t> mStarts;
+		size_t mSize = 0;
+		std::unique_ptr<SpillState> mSpill;
+		// Snapshots taken and not yet destroyed; created by the first one.
+		std::shared_ptr<std::atomic<size_t>> mLiveSnapshots;
+	};
+
+
+	using Lines = LineStore;
+
+}
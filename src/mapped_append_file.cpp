@@ -0,0 +1,243 @@
+#include "mapped_append_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace imterm {
+
+	namespace {
+
+		// Chunks other than the one being written that stay mapped for reading.
+		constexpr size_t ReadChunkCacheSize = 2;
+
+#if defined(_WIN32)
+		using FileHandle = HANDLE;
+
+		std::system_error LastError(const std::string& aWhat)
+		{
+			return std::system_error(static_cast<int>(GetLastError()), std::system_category(), aWhat);
+		}
+#else
+		using FileHandle = int;
+
+		std::system_error LastError(const std::string& aWhat)
+		{
+			return std::system_error(errno, std::generic_category(), aWhat);
+		}
+#endif
+
+	}
+
+	// One chunk of the journal file mapped into memory.
+	class MappedAppendFile::MappedChunk {
+
+	public:
+
+		MappedChunk(FileHandle aFile, uint64_t aIndex, size_t aSize, bool aWritable)
+			: mIndex(aIndex), mSize(aSize)
+		{
+			const uint64_t offset = aIndex * aSize;
+#if defined(_WIN32)
+			const uint64_t end = offset + aSize;
+			HANDLE mapping = CreateFileMappingW(aFile, nullptr, aWritable ? PAGE_READWRITE : PAGE_READONLY,
+				static_cast<DWORD>(end >> 32), static_cast<DWORD>(end), nullptr);
+			if (mapping == nullptr) {
+				throw LastError("MappedAppendFile could not map the file");
+			}
+			// The view keeps the mapping object alive.
+			mData = static_cast<uint8_t*>(MapViewOfFile(mapping, aWritable ? FILE_MAP_WRITE : FILE_MAP_READ,
+				static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), aSize));
+			const DWORD error = GetLastError();
+			CloseHandle(mapping);
+			if (mData == nullptr) {
+				throw std::system_error(static_cast<int>(error), std::system_category(), "MappedAppendFile could not map a chunk");
+			}
+#else
+			void* data = mmap(nullptr, aSize, aWritable ? PROT_READ | PROT_WRITE : PROT_READ,
+				MAP_SHARED, aFile, static_cast<off_t>(offset));
+			if (data == MAP_FAILED) {
+				throw LastError("MappedAppendFile could not map a chunk");
+			}
+			mData = static_cast<uint8_t*>(data);
+#endif
+		}
+
+		~MappedChunk()
+		{
+#if defined(_WIN32)
+			UnmapViewOfFile(mData);
+#else
+			munmap(mData, mSize);
+#endif
+		}
+
+		MappedChunk(const MappedChunk&) = delete;
+		MappedChunk& operator=(const MappedChunk&) = delete;
+
+		uint64_t GetIndex() const { return mIndex; }
+		uint8_t* GetData() const { return mData; }
+
+	private:
+
+		uint64_t mIndex;
+		size_t mSize;
+		uint8_t* mData = nullptr;
+	};
+
+	MappedAppendFile::MappedAppendFile(std::filesystem::path aPath, size_t aChunkSize, bool aKeepFile)
+		: mPath(std::move(aPath)), mKeepFile(aKeepFile)
+	{
+		const size_t chunkSize = std::max<size_t>(aChunkSize, 1);
+		mChunkSize = (chunkSize + MappingGranularity - 1) / MappingGranularity * MappingGranularity;
+
+#if defined(_WIN32)
+		mFile = CreateFileW(mPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (mFile == INVALID_HANDLE_VALUE) {
+			throw LastError("MappedAppendFile could not create " + mPath.string());
+		}
+#else
+		mFile = open(mPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (mFile < 0) {
+			throw LastError("MappedAppendFile could not create " + mPath.string());
+		}
+#endif
+	}
+
+	MappedAppendFile::~MappedAppendFile()
+	{
+		mWriteChunk.reset();
+		mReadChunks.clear();
+
+		// Drop the unused end of the last chunk.
+#if defined(_WIN32)
+		LARGE_INTEGER size;
+		size.QuadPart = static_cast<LONGLONG>(mSize);
+		if (SetFilePointerEx(mFile, size, nullptr, FILE_BEGIN)) {
+			SetEndOfFile(mFile);
+		}
+		CloseHandle(mFile);
+#else
+		if (ftruncate(mFile, static_cast<off_t>(mSize)) != 0) {
+			// Only the file's length is wrong; the recorded bytes are intact.
+		}
+		close(mFile);
+#endif
+
+		if (!mKeepFile) {
+			std::error_code error;
+			std::filesystem::remove(mPath, error);
+		}
+	}
+
+	bool MappedAppendFile::StartChunk(uint64_t aIndex)
+	{
+		// Reserve the whole chunk up front: running out of disk space then
+		// fails here rather than as a fault while copying into the mapping.
+		const uint64_t end = (aIndex + 1) * mChunkSize;
+		try {
+#if defined(_WIN32)
+			LARGE_INTEGER size;
+			size.QuadPart = static_cast<LONGLONG>(end);
+			if (!SetFilePointerEx(mFile, size, nullptr, FILE_BEGIN) || !SetEndOfFile(mFile)) {
+				throw LastError("MappedAppendFile could not grow " + mPath.string());
+			}
+#elif defined(__APPLE__)
+			if (ftruncate(mFile, static_cast<off_t>(end)) != 0) {
+				throw LastError("MappedAppendFile could not grow " + mPath.string());
+			}
+#else
+			const int error = posix_fallocate(mFile, static_cast<off_t>(end - mChunkSize), static_cast<off_t>(mChunkSize));
+			if (error != 0) {
+				throw std::system_error(error, std::generic_category(), "MappedAppendFile could not grow " + mPath.string());
+			}
+#endif
+			auto chunk = std::make_unique<MappedChunk>(mFile, aIndex, mChunkSize, true);
+			if (mWriteChunk) {
+				// The chunk just filled is the one most likely to be read next.
+				mReadChunks.insert(mReadChunks.begin(), std::move(mWriteChunk));
+				if (mReadChunks.size() > ReadChunkCacheSize) {
+					mReadChunks.pop_back();
+				}
+			}
+			mWriteChunk = std::move(chunk);
+			return true;
+		}
+		catch (const std::system_error& error) {
+			mFailed = true;
+			mError = error.what();
+			return false;
+		}
+	}
+
+	size_t MappedAppendFile::Append(std::span<const uint8_t> aBytes)
+	{
+		size_t written = 0;
+		while (written < aBytes.size() && !mFailed) {
+			const uint64_t index = mSize / mChunkSize;
+			const size_t offset = static_cast<size_t>(mSize % mChunkSize);
+			if ((!mWriteChunk || mWriteChunk->GetIndex() != index) && !StartChunk(index)) {
+				break;
+			}
+			const size_t length = std::min(aBytes.size() - written, mChunkSize - offset);
+			std::memcpy(mWriteChunk->GetData() + offset, aBytes.data() + written, length);
+			written += length;
+			mSize += length;
+		}
+		return written;
+	}
+
+	const MappedAppendFile::MappedChunk& MappedAppendFile::GetReadableChunk(uint64_t aIndex) const
+	{
+		if (mWriteChunk && mWriteChunk->GetIndex() == aIndex) {
+			return *mWriteChunk;
+		}
+
+		const auto cached = std::find_if(mReadChunks.begin(), mReadChunks.end(),
+			[aIndex](const std::unique_ptr<MappedChunk>& aChunk) { return aChunk->GetIndex() == aIndex; });
+		if (cached != mReadChunks.end()) {
+			std::rotate(mReadChunks.begin(), cached, std::next(cached));
+			return *mReadChunks.front();
+		}
+
+		mReadChunks.insert(mReadChunks.begin(), std::make_unique<MappedChunk>(mFile, aIndex, mChunkSize, false));
+		if (mReadChunks.size() > ReadChunkCacheSize) {
+			mReadChunks.pop_back();
+		}
+		return *mReadChunks.front();
+	}
+
+	size_t MappedAppendFile::Read(uint64_t aOffset, std::span<uint8_t> aBuffer) const
+	{
+		size_t copied = 0;
+		while (copied < aBuffer.size() && aOffset + copied < mSize) {
+			const uint64_t position = aOffset + copied;
+			const size_t offset = static_cast<size_t>(position % mChunkSize);
+			const size_t length = static_cast<size_t>(std::min<uint64_t>(
+				std::min(aBuffer.size() - copied, mChunkSize - offset), mSize - position));
+			const MappedChunk& chunk = GetReadableChunk(position / mChunkSize);
+			std::memcpy(aBuffer.data() + copied, chunk.GetData() + offset, length);
+			copied += length;
+		}
+		return copied;
+	}
+
+	std::optional<std::string> MappedAppendFile::TakeError()
+	{
+		return std::exchange(mError, std::nullopt);
+	}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace imterm {
+
+	// A file that only grows at the end, written and read through memory
+	// mappings.
+	//
+	// The file grows one chunk at a time; each chunk is reserved on disk before
+	// it is mapped, so running out of space fails an append instead of faulting
+	// while copying into the mapping. Only the chunk being written and the last
+	// chunks read stay mapped, so a file of many gigabytes costs the process a
+	// few chunks of address space and resident memory, and the page cache holds
+	// the rest.
+	//
+	// Not thread-safe.
+	class MappedAppendFile {
+
+	public:
+
+		// Windows maps views at multiples of 64 KiB; POSIX page sizes divide it.
+		static constexpr size_t MappingGranularity = 64 << 10;
+
+		// Creates or truncates the file at aPath. aChunkSize is rounded up to a
+		// multiple of MappingGranularity. The file is removed on destruction
+		// unless aKeepFile is set. Throws std::system_error if the file cannot
+		// be created.
+		MappedAppendFile(std::filesystem::path aPath, size_t aChunkSize, bool aKeepFile = false);
+		~MappedAppendFile();
+
+		MappedAppendFile(const MappedAppendFile&) = delete;
+		MappedAppendFile& operator=(const MappedAppendFile&) = delete;
+
+		// Appends as much of aBytes as the file can take and returns how much
+		// that was. Once the file fails to grow it takes nothing more; the
+		// error is reported by TakeError().
+		size_t Append(std::span<const uint8_t> aBytes);
+
+		// Copies the bytes from aOffset into aBuffer and returns how many were
+		// copied, fewer than requested at the end of the file. Throws
+		// std::system_error if a chunk cannot be mapped.
+		size_t Read(uint64_t aOffset, std::span<uint8_t> aBuffer) const;
+
+		uint64_t GetSize() const { return mSize; }
+		size_t GetChunkSize() const { return mChunkSize; }
+		const std::filesystem::path& GetPath() const { return mPath; }
+		bool HasFailed() const { return mFailed; }
+
+		// Returns the message of the error that stopped appends, once.
+		std::optional<std::string> TakeError();
+
+	private:
+
+		class MappedChunk;
+
+		bool StartChunk(uint64_t aIndex);
+		const MappedChunk& GetReadableChunk(uint64_t aIndex) const;
+
+		std::filesystem::path mPath;
+		size_t mChunkSize;
+		bool mKeepFile;
+
+#if defined(_WIN32)
+		void* mFile;
+#else
+		int mFile;
+#endif
+
+		uint64_t mSize = 0;
+		bool mFailed = false;
+		std::optional<std::string> mError;
+
+		std::unique_ptr<MappedChunk> mWriteChunk;
+		// Recently read chunks other than the one being written, most recent
+		// first.
+		mutable std::vector<std::unique_ptr<MappedChunk>> mReadChunks;
+	};
+
+}
@@ -0,0 +1,100 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace imterm {
+
+	MappedFile::MappedFile(const std::filesystem::path& aPath)
+		: mPath(aPath)
+	{
+#if defined(_WIN32)
+		const auto lastError = [this](const char* aWhat) {
+			return std::system_error(static_cast<int>(GetLastError()), std::system_category(),
+				std::string("MappedFile could not ") + aWhat + " " + mPath.string());
+		};
+		HANDLE file = CreateFileW(mPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+			OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			throw lastError("open");
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)) {
+			const auto error = lastError("read the size of");
+			CloseHandle(file);
+			throw error;
+		}
+		mSize = static_cast<size_t>(size.QuadPart);
+		if (mSize > 0) {
+			HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping != nullptr) {
+				// The view keeps the mapping object alive.
+				mData = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			}
+			const auto error = lastError("map");
+			if (mapping != nullptr) {
+				CloseHandle(mapping);
+			}
+			if (mData == nullptr) {
+				CloseHandle(file);
+				throw error;
+			}
+		}
+		CloseHandle(file);
+#else
+		const auto lastError = [this](const char* aWhat) {
+			return std::system_error(errno, std::generic_category(),
+				std::string("MappedFile could not ") + aWhat + " " + mPath.string());
+		};
+		const int file = open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0) {
+			throw lastError("open");
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0) {
+			const auto error = lastError("read the size of");
+			close(file);
+			throw error;
+		}
+		mSize = static_cast<size_t>(status.st_size);
+		if (mSize > 0) {
+			void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+			if (data == MAP_FAILED) {
+				const auto error = lastError("map");
+				close(file);
+				throw error;
+			}
+			// Replays read front to back.
+			madvise(data, mSize, MADV_SEQUENTIAL);
+			mData = static_cast<const uint8_t*>(data);
+		}
+		// The mapping keeps the file open.
+		close(file);
+#endif
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (mData == nullptr) {
+			return;
+		}
+#if defined(_WIN32)
+		UnmapViewOfFile(mData);
+#else
+		munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+	}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace imterm {
+
+	// An existing file mapped read-only into memory as a whole, so a recording
+	// of many gigabytes can be read at any offset without copying it in; the
+	// page cache holds what has been touched. The file must not shrink while
+	// it is mapped.
+	class MappedFile {
+
+	public:
+
+		// Throws std::system_error if aPath cannot be opened or mapped.
+		explicit MappedFile(const std::filesystem::path& aPath);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		std::span<const uint8_t> GetBytes() const { return { mData, mSize }; }
+		uint64_t GetSize() const { return mSize; }
+		const std::filesystem::path& GetPath() const { return mPath; }
+
+	private:
+
+		std::filesystem::path mPath;
+		const uint8_t* mData = nullptr;
+		size_t mSize = 0;
+	};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+
+namespace imterm {
+
+	// Times received bytes on the reader thread. Readings come from
+	// steady_clock, so they never go backwards and are cheap to take, and are
+	// reported as wall-clock time through an anchor pairing the two clocks.
+	// The anchor is taken again every AnchorInterval so the times follow
+	// adjustments of the system clock; a new anchor never moves the reported
+	// time backwards, so after the system clock is set back the times hold
+	// still until it catches up. Not thread-safe.
+	class ReceiveClock {
+
+	public:
+
+		using Timestamp = std::chrono::system_clock::time_point;
+
+		static constexpr std::chrono::seconds AnchorInterval{ 60 };
+
+		ReceiveClock() { Anchor(std::chrono::steady_clock::now()); }
+
+		Timestamp Now()
+		{
+			const auto steady = std::chrono::steady_clock::now();
+			if (steady - mAnchorSteady >= AnchorInterval) {
+				Anchor(steady);
+			}
+			const Timestamp time = mAnchorWall
+				+ std::chrono::duration_cast<Timestamp::duration>(steady - mAnchorSteady);
+			if (time > mLast) {
+				mLast = time;
+			}
+			return mLast;
+		}
+
+	private:
+
+		void Anchor(std::chrono::steady_clock::time_point aSteady)
+		{
+			mAnchorSteady = aSteady;
+			mAnchorWall = std::chrono::system_clock::now();
+		}
+
+		std::chrono::steady_clock::time_point mAnchorSteady;
+		Timestamp mAnchorWall;
+		Timestamp mLast = Timestamp::min();
+	};
+
+}
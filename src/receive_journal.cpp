@@ -0,0 +1,94 @@
+#include "receive_journal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <utility>
+
+namespace imterm {
+
+	ReceiveJournal::ReceiveJournal(std::filesystem::path aPath)
+		: ReceiveJournal(std::move(aPath), Options())
+	{
+	}
+
+	ReceiveJournal::ReceiveJournal(std::filesystem::path aPath, Options aOptions)
+		: mOptions(aOptions), mFile(std::move(aPath), aOptions.ChunkSize, aOptions.KeepFile)
+	{
+		if (mOptions.KeepFile) {
+			const auto timesPath = TimesPath(mFile.GetPath());
+#if defined(_WIN32)
+			mTimesFile.reset(_wfopen(timesPath.c_str(), L"w"));
+#else
+			mTimesFile.reset(std::fopen(timesPath.c_str(), "w"));
+#endif
+			if (!mTimesFile) {
+				throw std::system_error(errno, std::generic_category(), "ReceiveJournal could not create " + timesPath.string());
+			}
+		}
+	}
+
+	void ReceiveJournal::Append(std::span<const uint8_t> aBytes, Clock::time_point aTime)
+	{
+		const uint64_t size = mFile.GetSize();
+		const uint64_t room = mFile.HasFailed() ? 0 : mOptions.MaxBytes - std::min(mOptions.MaxBytes, size);
+		const size_t count = static_cast<size_t>(std::min<uint64_t>(aBytes.size(), room));
+
+		if (count > 0 && (mTimeMarks.empty() || aTime - mTimeMarks.back().mTime >= mOptions.TimeResolution)) {
+			mTimeMarks.push_back(TimeMark{ size, aTime });
+			if (mTimesFile) {
+				const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(aTime.time_since_epoch());
+				std::fprintf(mTimesFile.get(), "%llu %lld\n",
+					static_cast<unsigned long long>(size), static_cast<long long>(micros.count()));
+			}
+		}
+		mDropped += aBytes.size() - mFile.Append(aBytes.first(count));
+	}
+
+	std::optional<ReceiveJournal::Clock::time_point> ReceiveJournal::GetTime(uint64_t aOffset) const
+	{
+		if (aOffset >= mFile.GetSize()) {
+			return std::nullopt;
+		}
+		if (const TimeMark* mark = FindTimeMark(mTimeMarks, aOffset)) {
+			return mark->mTime;
+		}
+		return std::nullopt;
+	}
+
+	std::filesystem::path ReceiveJournal::TimesPath(const std::filesystem::path& aJournalPath)
+	{
+		auto path = aJournalPath;
+		path += ".times";
+		return path;
+	}
+
+	std::vector<ReceiveJournal::TimeMark> ReceiveJournal::LoadTimeMarks(const std::filesystem::path& aJournalPath)
+	{
+		std::vector<TimeMark> marks;
+		std::ifstream file(TimesPath(aJournalPath));
+		unsigned long long offset;
+		long long micros;
+		while (file >> offset >> micros) {
+			if (!marks.empty() && offset < marks.back().mOffset) {
+				break;
+			}
+			marks.push_back(TimeMark{ offset, Clock::time_point(
+				std::chrono::duration_cast<Clock::duration>(std::chrono::microseconds(micros))) });
+		}
+		return marks;
+	}
+
+	const ReceiveJournal::TimeMark* ReceiveJournal::FindTimeMark(std::span<const TimeMark> aMarks, uint64_t aOffset)
+	{
+		const auto next = std::upper_bound(aMarks.begin(), aMarks.end(), aOffset,
+			[](uint64_t aValue, const TimeMark& aMark) { return aValue < aMark.mOffset; });
+		if (next == aMarks.begin()) {
+			return nullptr;
+		}
+		return &*std::prev(next);
+	}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mapped_append_file.h"
+
+namespace imterm {
+
+	// Append-only record of every received byte, kept before the terminal
+	// interprets them, so escape sequences and NULs stay visible to the hex
+	// view.
+	//
+	// The bytes live in a MappedAppendFile, so a journal of many gigabytes
+	// costs the process a few chunks of address space and the page cache holds
+	// the rest.
+	//
+	// Receive times are kept coarsely: a time mark is added when an append
+	// comes at least TimeResolution after the previous mark, and every byte is
+	// taken to arrive at the time of the mark before it.
+	//
+	// Not thread-safe; the capture session appends and the view reads on the
+	// UI thread.
+	class ReceiveJournal {
+
+	public:
+
+		using Clock = std::chrono::system_clock;
+
+		static constexpr size_t DefaultChunkSize = 16 << 20;
+
+		struct Options {
+			// Rounded up to a multiple of MappedAppendFile::MappingGranularity.
+			size_t ChunkSize = DefaultChunkSize;
+			// Bytes beyond this are counted in GetDroppedBytes() instead.
+			uint64_t MaxBytes = uint64_t{ 16 } << 30;
+			std::chrono::milliseconds TimeResolution{ 10 };
+			// Leave the file behind when the journal is destroyed, along with
+			// its time marks in TimesPath(), so it can be replayed with its
+			// original timing; see CaptureRecording.
+			bool KeepFile = false;
+		};
+
+		struct TimeMark {
+			uint64_t mOffset;
+			Clock::time_point mTime;
+		};
+
+		// Creates or truncates the file at aPath. Throws std::system_error if it
+		// cannot be created.
+		explicit ReceiveJournal(std::filesystem::path aPath);
+		ReceiveJournal(std::filesystem::path aPath, Options aOptions);
+
+		// Records aBytes as received at aTime. If the file cannot grow, recording
+		// stops; the error is reported by TakeError() and later bytes are
+		// counted as dropped.
+		void Append(std::span<const uint8_t> aBytes, Clock::time_point aTime = Clock::now());
+
+		// Copies the bytes from aOffset into aBuffer and returns how many were
+		// copied, fewer than requested at the end of the journal.
+		size_t Read(uint64_t aOffset, std::span<uint8_t> aBuffer) const { return mFile.Read(aOffset, aBuffer); }
+
+		// When the byte at aOffset was received, to within the time resolution.
+		std::optional<Clock::time_point> GetTime(uint64_t aOffset) const;
+
+		uint64_t GetSize() const { return mFile.GetSize(); }
+		uint64_t GetDroppedBytes() const { return mDropped; }
+		size_t GetChunkSize() const { return mFile.GetChunkSize(); }
+		const std::filesystem::path& GetPath() const { return mFile.GetPath(); }
+		const std::vector<TimeMark>& GetTimeMarks() const { return mTimeMarks; }
+
+		// Returns the message of the error that stopped recording, once.
+		std::optional<std::string> TakeError() { return mFile.TakeError(); }
+
+		// The time marks of a kept journal are written next to it, one
+		// "offset microseconds-since-epoch" line each.
+		static std::filesystem::path TimesPath(const std::filesystem::path& aJournalPath);
+		// Reads the time marks kept next to aJournalPath; empty if there are
+		// none. Stops at the first malformed line.
+		static std::vector<TimeMark> LoadTimeMarks(const std::filesystem::path& aJournalPath);
+		// The last of aMarks at or before aOffset, or nullptr.
+		static const TimeMark* FindTimeMark(std::span<const TimeMark> aMarks, uint64_t aOffset);
+
+	private:
+
+		struct FileCloser {
+			void operator()(std::FILE* aFile) const noexcept { std::fclose(aFile); }
+		};
+
+		Options mOptions;
+		MappedAppendFile mFile;
+		std::unique_ptr<std::FILE, FileCloser> mTimesFile;
+		uint64_t mDropped = 0;
+		std::vector<TimeMark> mTimeMarks;
+	};
+
+}
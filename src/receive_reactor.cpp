@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "receive_reactor.h"
+#include "receive_worker.h"
+
+namespace imterm {
+
+	ReceiveReactor::ReceiveReactor()
+	{
+#if defined(__linux__)
+		mEpoll = epoll_create1(EPOLL_CLOEXEC);
+		if (mEpoll < 0) {
+			throw std::system_error(errno, std::generic_category(), "ReceiveReactor could not create an epoll set");
+		}
+		mStopEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u64 = 0;
+		if (mStopEvent < 0 || epoll_ctl(mEpoll, EPOLL_CTL_ADD, mStopEvent, &event) != 0) {
+			const int error = errno;
+			if (mStopEvent >= 0) {
+				close(mStopEvent);
+			}
+			close(mEpoll);
+			throw std::system_error(error, std::generic_category(), "ReceiveReactor could not create its stop event");
+		}
+#endif
+	}
+
+	ReceiveReactor::~ReceiveReactor()
+	{
+#if defined(__linux__)
+		if (mThread.joinable()) {
+			const uint64_t one = 1;
+			// Cannot fail short of a full counter, which one write never makes.
+			[[maybe_unused]] const ssize_t written = write(mStopEvent, &one, sizeof(one));
+			mThread.join();
+		}
+		close(mStopEvent);
+		close(mEpoll);
+#endif
+	}
+
+	bool ReceiveReactor::IsSupported()
+	{
+#if defined(__linux__)
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	uint64_t ReceiveReactor::Add(ReceiveWorker& aWorker, int aDescriptor)
+	{
+#if defined(__linux__)
+		if (aDescriptor < 0) {
+			return 0;
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		const uint64_t id = mNextId;
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u64 = id;
+		if (epoll_ctl(mEpoll, EPOLL_CTL_ADD, aDescriptor, &event) != 0) {
+			// Not pollable, or already waited on for another worker.
+			return 0;
+		}
+		++mNextId;
+		mPorts.emplace(id, Port{ &aWorker, aDescriptor });
+		if (!mThread.joinable()) {
+			mThread = std::thread([this] { Run(); });
+		}
+		return id;
+#else
+		(void)aWorker;
+		(void)aDescriptor;
+		return 0;
+#endif
+	}
+
+	void ReceiveReactor::Remove(uint64_t aId)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		const auto port = mPorts.find(aId);
+		if (port != mPorts.end()) {
+			Arm(port->second, aId, false);
+			mPorts.erase(port);
+		}
+		mServed.wait(lock, [&] { return mServing != aId; });
+	}
+
+	void ReceiveReactor::Arm(Port& aPort, uint64_t aId, bool aArmed)
+	{
+#if defined(__linux__)
+		if (aPort.mArmed == aArmed) {
+			return;
+		}
+		epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u64 = aId;
+		if (epoll_ctl(mEpoll, aArmed ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, aPort.mDescriptor, &event) != 0 && aArmed) {
+			aPort.mWorker->Fail(std::string("Could not wait for the port: ") + std::strerror(errno));
+			return;
+		}
+		aPort.mArmed = aArmed;
+#else
+		(void)aId;
+		aPort.mArmed = aArmed;
+#endif
+	}
+
+	ReceiveReactor::Statistics ReceiveReactor::GetStatistics() const
+	{
+		Statistics stats;
+		stats.mWakeups = mWakeups.load(std::memory_order_relaxed);
+		stats.mReads = mReads.load(std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(mMutex);
+		stats.mPorts = mPorts.size();
+		return stats;
+	}
+
+	void ReceiveReactor::Run()
+	{
+#if defined(__linux__)
+		std::array<epoll_event, 64> events;
+		// Ports to serve again after RetryInterval, and those due this time.
+		std::vector<uint64_t> retry;
+		std::vector<uint64_t> due;
+
+		while (true) {
+
+			const int timeout = retry.empty() ? -1 : static_cast<int>(RetryInterval.count());
+			const int count = epoll_wait(mEpoll, events.data(), static_cast<int>(events.size()), timeout);
+			if (count < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				// Only a broken epoll set fails; no port can be served.
+				const std::string message = std::string("The receive reactor stopped: ") + std::strerror(errno);
+				std::lock_guard<std::mutex> lock(mMutex);
+				for (auto& [id, port] : mPorts) {
+					port.mWorker->Fail(message);
+				}
+				return;
+			}
+			mWakeups.fetch_add(1, std::memory_order_relaxed);
+
+			due.swap(retry);
+			retry.clear();
+			for (int i = 0; i < count; ++i) {
+				const uint64_t id = events[i].data.u64;
+				if (id == 0) {
+					return;
+				}
+				if (Serve(id, true, (events[i].events & (EPOLLHUP | EPOLLERR)) != 0)) {
+					retry.push_back(id);
+				}
+			}
+			for (const uint64_t id : due) {
+				if (Serve(id, false, false)) {
+					retry.push_back(id);
+				}
+			}
+			std::sort(retry.begin(), retry.end());
+			retry.erase(std::unique(retry.begin(), retry.end()), retry.end());
+		}
+#endif
+	}
+
+	bool ReceiveReactor::Serve(uint64_t aId, bool aReadable, bool aHangUp)
+	{
+		ReceiveWorker* worker;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			const auto port = mPorts.find(aId);
+			if (port == mPorts.end()) {
+				// Removed since epoll reported it.
+				return false;
+			}
+			worker = port->second.mWorker;
+			mServing = aId;
+		}
+
+		if (aReadable) {
+			mReads.fetch_add(1, std::memory_order_relaxed);
+		}
+		const ReceiveWorker::ReactorInterest interest = worker->Serve(aReadable, aHangUp);
+
+		bool retry = false;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mServing = 0;
+			const auto port = mPorts.find(aId);
+			if (port != mPorts.end()) {
+				Arm(port->second, aId, interest.mReadable);
+				retry = interest.mRetry;
+			}
+		}
+		mServed.notify_all();
+		return retry;
+	}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace imterm {
+
+	class ReceiveWorker;
+
+	// Services the reads of many ReceiveWorkers on one thread, so that a bench
+	// of ports costs one thread rather than one each, and an idle port costs
+	// nothing at all.
+	//
+	// On Linux the thread waits in epoll on the descriptors of every port
+	// and reads only the ports that are readable, so its work grows with the
+	// bytes received rather than with the number of ports. A worker whose
+	// transport has no descriptor (see Transport::GetPollDescriptor()), and
+	// every worker on other systems, keeps its own reader thread instead.
+	//
+	// Workers join with ReceiveWorker::SetReactor(); the reactor must outlive
+	// them, which the shared_ptr they hold arranges.
+	class ReceiveReactor {
+
+	public:
+
+		// How soon a port that could not be served completely, because its
+		// ring or its marks were full, is served again.
+		static constexpr std::chrono::milliseconds RetryInterval{ 1 };
+
+		struct Statistics {
+			uint64_t mWakeups = 0;  // times the thread woke up
+			uint64_t mReads = 0;    // reads of a readable port
+			size_t mPorts = 0;      // ports being waited on
+		};
+
+		ReceiveReactor();
+		~ReceiveReactor();
+
+		ReceiveReactor(const ReceiveReactor&) = delete;
+		ReceiveReactor& operator=(const ReceiveReactor&) = delete;
+
+		// False where the reactor cannot wait on descriptors, and every
+		// worker keeps its own thread.
+		static bool IsSupported();
+
+		Statistics GetStatistics() const;
+
+	private:
+
+		friend class ReceiveWorker;
+
+		struct Port {
+			ReceiveWorker* mWorker;
+			int mDescriptor;
+			// In the epoll set. A port is taken out while it cannot read, so
+			// a hung-up descriptor does not wake the thread over and over.
+			bool mArmed = true;
+		};
+
+		// Starts waiting on aDescriptor for aWorker and returns a non-zero id
+		// for Remove(), or 0 when the descriptor cannot be waited on.
+		uint64_t Add(ReceiveWorker& aWorker, int aDescriptor);
+		// Stops serving the port. Waits for a read of it in progress, so the
+		// worker is not touched once this returns.
+		void Remove(uint64_t aId);
+
+		void Run();
+		// Serves the port aId. Returns true when it wants to be served again
+		// after RetryInterval, readable or not.
+		bool Serve(uint64_t aId, bool aReadable, bool aHangUp);
+		void Arm(Port& aPort, uint64_t aId, bool aArmed);
+
+		int mEpoll = -1;
+		// Wakes the thread to stop.
+		int mStopEvent = -1;
+		std::thread mThread;
+
+		// Guards mPorts and mServing. Held while a port is looked up and
+		// re-armed, not while it is read.
+		mutable std::mutex mMutex;
+		std::condition_variable mServed;
+		std::unordered_map<uint64_t, Port> mPorts;
+		uint64_t mNextId = 1;
+		// The port being read, or 0.
+		uint64_t mServing = 0;
+
+		std::atomic<uint64_t> mWakeups{ 0 };
+		std::atomic<uint64_t> mReads{ 0 };
+	};
+
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include "receive_worker.h"
+
+namespace imterm {
+
+	namespace {
+
+		// One mark per 256 bytes of ring holds a full ring of reads averaging
+		// that size; smaller reads share marks only while the consumer lags.
+		size_t MarkCapacity(size_t aRingCapacity)
+		{
+			return std::max<size_t>(64, aRingCapacity / 256);
+		}
+
+	}
+
+	ReceiveWorker::ReceiveWorker(std::shared_ptr<Transport> aTransport, size_t aCapacity)
+		: mTransport(std::move(aTransport)), mRing(aCapacity),
+		  mMarks(std::make_unique<ReceiveMark[]>(MarkCapacity(aCapacity))),
+		  mMarkMask(MarkCapacity(aCapacity) - 1)
+	{
+	}
+
+	ReceiveWorker::~ReceiveWorker()
+	{
+		Stop();
+	}
+
+	void ReceiveWorker::Start()
+	{
+		if (mThread.joinable() || mReactorId != 0) {
+			if (!mFinished.load(std::memory_order_acquire)) {
+				return;
+			}
+			if (mReactorId != 0) {
+				mReactor->Remove(mReactorId);
+				mReactorId = 0;
+			}
+			if (mThread.joinable()) {
+				mThread.join();
+			}
+		}
+
+		mStopRequested.store(false, std::memory_order_relaxed);
+		mFinished.store(false, std::memory_order_relaxed);
+		if (mReactor) {
+			// Asked each time: a reopened port has a new descriptor.
+			mReactorId = mReactor->Add(*this, mTransport->GetPollDescriptor());
+			if (mReactorId != 0) {
+				return;
+			}
+		}
+		mThread = std::thread([this] { Run(); });
+	}
+
+	void ReceiveWorker::Stop()
+	{
+		mStopRequested.store(true, std::memory_order_relaxed);
+		if (mReactorId != 0) {
+			mReactor->Remove(mReactorId);
+			mReactorId = 0;
+		}
+		if (mThread.joinable()) {
+			mThread.join();
+		}
+	}
+
+	void ReceiveWorker::Run()
+	{
+		try {
+			while (!mStopRequested.load(std::memory_order_relaxed)) {
+
+				PublishPendingMark();
+
+				if (WaitingForRoom()) {
+					std::this_thread::sleep_for(WaitForRoomInterval);
+					continue;
+				}
+
+				if (!mTransport->WaitReadable()) {
+					continue;
+				}
+
+				ReadOnce();
+			}
+		}
+		catch (const std::exception& ex) {
+			std::lock_guard<std::mutex> lock(mErrorMutex);
+			mError = ex.what();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mErrorMutex);
+			mError = "Unknown receive error";
+		}
+
+		mFinished.store(true, std::memory_order_release);
+		if (!mStopRequested.load(std::memory_order_relaxed)) {
+			Notify();
+		}
+	}
+
+	void ReceiveWorker::PublishPendingMark()
+	{
+		if (mUnpublishedMark && PublishMark(*mUnpublishedMark)) {
+			mUnpublishedMark.reset();
+			Notify();
+		}
+	}
+
+	size_t ReceiveWorker::ReadOnce()
+	{
+		// Only the consumer frees space, so with the Wait policy there is
+		// room when the reader gets here.
+		std::span<uint8_t> target = mRing.Reserve(ReadChunkSize);
+		const bool full = target.empty();
+		if (full) {
+			target = mDiscard;
+		}
+
+		const size_t count = mTransport->Read(target);
+		if (count == 0) {
+			return 0;
+		}
+		const Timestamp time = mClock.Now();
+		if (mObserver) {
+			// Not yet committed, so the consumer cannot free it.
+			mObserver(target.first(count));
+		}
+
+		if (full) {
+			mBytesDropped.fetch_add(count, std::memory_order_relaxed);
+			mOverflowEvents.fetch_add(1, std::memory_order_relaxed);
+		}
+		else {
+			mRing.Commit(count);
+			mBytesQueued += count;
+			if (mUnpublishedMark) {
+				mUnpublishedMark->mEnd = mBytesQueued;
+			}
+			else {
+				mUnpublishedMark = ReceiveMark{ mBytesQueued, time };
+			}
+			if (PublishMark(*mUnpublishedMark)) {
+				mUnpublishedMark.reset();
+			}
+		}
+
+		// Counted after queuing so a consumer that observes the new total can
+		// also drain the bytes behind it.
+		mBytesReceived.fetch_add(count, std::memory_order_release);
+		Notify();
+		return count;
+	}
+
+	ReceiveWorker::ReactorInterest ReceiveWorker::Serve(bool aReadable, bool aHangUp)
+	{
+		try {
+			PublishPendingMark();
+
+			if (WaitingForRoom()) {
+				// Not read until the consumer makes room, which nothing polls.
+				return { false, true };
+			}
+
+			if (aReadable && ReadOnce() == 0 && aHangUp && !mTransport->AtEnd()) {
+				throw std::runtime_error("The port hung up");
+			}
+
+			// At the end there is nothing left to wait for; a descriptor that
+			// stays readable would only wake the reactor over and over.
+			return { !mTransport->AtEnd(), mUnpublishedMark.has_value() };
+		}
+		catch (const std::exception& ex) {
+			Fail(ex.what());
+		}
+		catch (...) {
+			Fail("Unknown receive error");
+		}
+		return { false, false };
+	}
+
+	void ReceiveWorker::Fail(std::string aError)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mErrorMutex);
+			mError = std::move(aError);
+		}
+		mFinished.store(true, std::memory_order_release);
+		Notify();
+	}
+
+	void ReceiveWorker::Notify()
+	{
+		// The exchange pairs with the one in Drain(): bytes queued before a
+		// notification is skipped are visible to the drain that re-arms it.
+		if (mNotifier && !mNotifyPending.exchange(true, std::memory_order_acq_rel)) {
+			mNotifier();
+		}
+	}
+
+	bool ReceiveWorker::PublishMark(const ReceiveMark& aMark)
+	{
+		const uint64_t written = mMarksWritten.load(std::memory_order_relaxed);
+		if (written - mMarksRead.load(std::memory_order_acquire) > mMarkMask) {
+			return false;
+		}
+		mMarks[written & mMarkMask] = aMark;
+		mMarksWritten.store(written + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t ReceiveWorker::Drain(size_t aBudget, const DrainCallback& aCallback)
+	{
+		size_t total = 0;
+		mNotifyPending.exchange(false, std::memory_order_acq_rel);
+
+		while (total < aBudget) {
+			const uint64_t markIndex = mMarksRead.load(std::memory_order_relaxed);
+			if (markIndex == mMarksWritten.load(std::memory_order_acquire)) {
+				break;
+			}
+			const ReceiveMark mark = mMarks[markIndex & mMarkMask];
+			auto run = mRing.Peek(static_cast<size_t>(std::min<uint64_t>(aBudget - total, mark.mEnd - mBytesDrained)));
+			if (run.empty()) {
+				break;
+			}
+
+			const auto consume = [&] {
+				mRing.Consume(run.size());
+				mBytesDrained += run.size();
+				total += run.size();
+				if (mBytesDrained == mark.mEnd) {
+					mMarksRead.store(markIndex + 1, std::memory_order_release);
+				}
+			};
+			try {
+				aCallback(run, mark.mTime);
+			}
+			catch (...) {
+				// Do not hand the same bytes to the consumer again.
+				consume();
+				mBytesDelivered.fetch_add(total, std::memory_order_relaxed);
+				throw;
+			}
+			consume();
+		}
+
+		mBytesDelivered.fetch_add(total, std::memory_order_relaxed);
+		return total;
+	}
+
+	ReceiveWorker::Statistics ReceiveWorker::GetStatistics() const
+	{
+		Statistics stats;
+		stats.mBytesReceived = mBytesReceived.load(std::memory_order_acquire);
+		stats.mBytesDelivered = mBytesDelivered.load(std::memory_order_relaxed);
+		stats.mBytesDropped = mBytesDropped.load(std::memory_order_relaxed);
+		stats.mOverflowEvents = mOverflowEvents.load(std::memory_order_relaxed);
+		stats.mBuffered = mRing.Size();
+		stats.mHighWaterMark = mRing.HighWaterMark();
+		stats.mCapacity = mRing.Capacity();
+		return stats;
+	}
+
+	std::optional<std::string> ReceiveWorker::TakeError()
+	{
+		std::lock_guard<std::mutex> lock(mErrorMutex);
+		std::optional<std::string> error = std::move(mError);
+		mError.reset();
+		return error;
+	}
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+
+#include "receive_clock.h"
+#include "receive_reactor.h"
+#include "spsc_byte_ring.h"
+#include "transport.h"
+
+namespace imterm {
+
+	// Reads a Transport on a dedicated thread and queues the bytes in a lock-free
+	// ring for a single consumer, normally the UI thread.
+	//
+	// The transport reads straight into free space in the ring, and Drain()
+	// hands the consumer spans of the ring, so a received byte is copied once
+	// and the receive path allocates nothing after the ring is created.
+	//
+	// By default the reader never waits for the consumer. When the ring is full,
+	// the bytes read are discarded and counted, so a zero BytesDropped
+	// count is proof that everything read from the transport reached the
+	// consumer. Sources that can be paused, such as files, can instead make the
+	// reader wait for room; see OverflowPolicy.
+	//
+	// Each read is stamped with a ReceiveClock time as it is queued, and the
+	// consumer gets the bytes of each read together with its time.
+	//
+	// With a ReceiveReactor the reads are made on the reactor's thread,
+	// shared with other ports, instead of a thread of the worker's own.
+	class ReceiveWorker {
+
+	public:
+
+		// 1 MiB holds about 3.5 s of traffic at 3 Mbaud.
+		static constexpr size_t DefaultCapacity = 1 << 20;
+		static constexpr size_t ReadChunkSize = 4096;
+
+		using Timestamp = ReceiveClock::Timestamp;
+		using DrainCallback = std::function<void(std::span<const uint8_t>, Timestamp)>;
+		using ReceiveNotifier = std::function<void()>;
+		using ReceiveObserver = std::function<void(std::span<const uint8_t>)>;
+
+		// What the reader does when the ring cannot take a whole read.
+		enum class OverflowPolicy {
+			// Read anyway and drop what does not fit. For live sources such as
+			// a UART, which keeps sending whether or not it is read.
+			Drop,
+			// Read only as much as fits, and stop reading while the ring is
+			// full. For sources that wait for their reader, such as files and
+			// pipes; nothing is dropped.
+			Wait
+		};
+
+		// How long a waiting reader sleeps before it checks the ring again.
+		static constexpr std::chrono::milliseconds WaitForRoomInterval{ 1 };
+
+		struct Statistics {
+			uint64_t mBytesReceived = 0;   // read from the transport
+			uint64_t mBytesDelivered = 0;  // handed to a Drain() callback
+			uint64_t mBytesDropped = 0;    // discarded because the ring was full
+			uint64_t mOverflowEvents = 0;  // reads that found the ring full
+			size_t mBuffered = 0;          // currently queued
+			size_t mHighWaterMark = 0;     // most ever queued at once
+			size_t mCapacity = 0;
+		};
+
+		explicit ReceiveWorker(std::shared_ptr<Transport> aTransport, size_t aCapacity = DefaultCapacity);
+		~ReceiveWorker();
+
+		ReceiveWorker(const ReceiveWorker&) = delete;
+		ReceiveWorker& operator=(const ReceiveWorker&) = delete;
+
+		// Starts the reader thread, or starts reading on the reactor. Has no
+		// effect if it is already running.
+		void Start();
+
+		// Stops and joins the reader thread, or leaves the reactor once a
+		// read in progress is done. Queued bytes remain drainable.
+		void Stop();
+
+		bool IsRunning() const { return (mThread.joinable() || mReactorId != 0) && !mFinished.load(std::memory_order_acquire); }
+
+		// Set before Start(). Reads on aReactor's thread when the transport
+		// has a descriptor to wait on, and on a thread of its own otherwise.
+		void SetReactor(std::shared_ptr<ReceiveReactor> aReactor) { mReactor = std::move(aReactor); }
+		// True while the reads are made on the reactor.
+		bool OnReactor() const { return mReactorId != 0; }
+
+		// Consumer only. Passes up to aBudget queued bytes to aCallback in one or
+		// more contiguous runs, each read at the time passed with it, and
+		// returns the number of bytes passed.
+		size_t Drain(size_t aBudget, const DrainCallback& aCallback);
+
+		// True when Drain() has bytes to pass on.
+		bool HasPendingBytes() const { return mMarksRead.load(std::memory_order_relaxed) != mMarksWritten.load(std::memory_order_acquire); }
+
+		// Set before Start(). aNotifier is called on the reader thread when
+		// bytes are queued or the thread stops on an error, at most once until
+		// the consumer next calls Drain(), so a consumer that sleeps between
+		// drains can be woken (with glfwPostEmptyEvent(), say) without a call
+		// per read.
+		void SetReceiveNotifier(ReceiveNotifier aNotifier) { mNotifier = std::move(aNotifier); }
+
+		// Set before Start(). aObserver sees the bytes of each read on the
+		// reader thread as soon as they are read, before the consumer does,
+		// including reads that are dropped. For flow control and prompt
+		// detection that must not wait for the consumer; it must be quick.
+		void SetReceiveObserver(ReceiveObserver aObserver) { mObserver = std::move(aObserver); }
+
+		// Set before Start().
+		void SetOverflowPolicy(OverflowPolicy aPolicy) { mOverflowPolicy = aPolicy; }
+		OverflowPolicy GetOverflowPolicy() const { return mOverflowPolicy; }
+
+		Statistics GetStatistics() const;
+		void ResetHighWaterMark() { mRing.ResetHighWaterMark(); }
+
+		// Returns the message of the exception that stopped the reader thread, once.
+		std::optional<std::string> TakeError();
+
+	private:
+
+		friend class ReceiveReactor;
+
+		// Where a read ends in the stream of queued bytes, and when it was read.
+		struct ReceiveMark {
+			uint64_t mEnd;
+			Timestamp mTime;
+		};
+
+		// What a worker on a reactor waits for after Serve().
+		struct ReactorInterest {
+			bool mReadable;  // the transport polling readable
+			bool mRetry;     // ReceiveReactor::RetryInterval passing
+		};
+
+		void Run();
+		// Reader side. Publishes a mark held back while the marks were full.
+		void PublishPendingMark();
+		// Reader side. True while the Wait policy keeps the reader from
+		// reading.
+		bool WaitingForRoom() const { return mOverflowPolicy == OverflowPolicy::Wait && mRing.Size() == mRing.Capacity(); }
+		// Reader side. Reads the transport once and queues the bytes. Returns
+		// the number read.
+		size_t ReadOnce();
+		// Reactor side, one turn of Run(). aReadable when the transport polled
+		// readable, aHangUp when it polled hung up.
+		ReactorInterest Serve(bool aReadable, bool aHangUp);
+		// Stops the worker with aError, as an exception on the reader thread
+		// does.
+		void Fail(std::string aError);
+		void Notify();
+		bool PublishMark(const ReceiveMark& aMark);
+
+		std::shared_ptr<Transport> mTransport;
+		SpscByteRing mRing;
+
+		// Marks form a second single-producer ring next to the bytes. The
+		// reader publishes a read's mark after its bytes; Drain() passes on only
+		// bytes whose mark it can see. When the marks are full, reads are
+		// merged into the oldest unpublished one, keeping its time.
+		std::unique_ptr<ReceiveMark[]> mMarks;
+		size_t mMarkMask;
+		std::atomic<uint64_t> mMarksWritten{ 0 };
+		std::atomic<uint64_t> mMarksRead{ 0 };
+		// Reader thread only.
+		ReceiveClock mClock;
+		uint64_t mBytesQueued = 0;
+		std::optional<ReceiveMark> mUnpublishedMark;
+		// Reads that find the ring full land here and are dropped.
+		std::array<uint8_t, ReadChunkSize> mDiscard;
+		// Consumer only.
+		uint64_t mBytesDrained = 0;
+
+		std::thread mThread;
+		std::shared_ptr<ReceiveReactor> mReactor;
+		// The id the reactor knows this worker by, or 0 when not on it.
+		uint64_t mReactorId = 0;
+		std::atomic<bool> mStopRequested{ false };
+		std::atomic<bool> mFinished{ false };
+
+		ReceiveNotifier mNotifier;
+		ReceiveObserver mObserver;
+		OverflowPolicy mOverflowPolicy = OverflowPolicy::Drop;
+		// Set by the reader when it notifies, cleared by Drain().
+		std::atomic<bool> mNotifyPending{ false };
+
+		std::atomic<uint64_t> mBytesReceived{ 0 };
+		std::atomic<uint64_t> mBytesDelivered{ 0 };
+		std::atomic<uint64_t> mBytesDropped{ 0 };
+		std::atomic<uint64_t> mOverflowEvents{ 0 };
+
+		std::mutex mErrorMutex;
+		std::optional<std::string> mError;
+	};
+
+}
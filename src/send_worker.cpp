@@ -0,0 +1,144 @@
+#include <exception>
+
+#include "send_worker.h"
+
+namespace imterm {
+
+	SendWorker::SendWorker(std::shared_ptr<Transport> aTransport, size_t aCapacity)
+		: mTransport(std::move(aTransport)), mRing(aCapacity)
+	{
+	}
+
+	SendWorker::~SendWorker()
+	{
+		Stop();
+	}
+
+	void SendWorker::Start()
+	{
+		if (mThread.joinable()) {
+			if (!mFinished.load(std::memory_order_acquire)) {
+				return;
+			}
+			mThread.join();
+		}
+
+		mStopRequested.store(false, std::memory_order_relaxed);
+		mFinished.store(false, std::memory_order_relaxed);
+		mThread = std::thread([this] { Run(); });
+	}
+
+	void SendWorker::Stop()
+	{
+		{
+			// Under the lock, so the writer cannot miss it between checking
+			// and starting to wait.
+			std::lock_guard<std::mutex> lock(mWakeMutex);
+			mStopRequested.store(true, std::memory_order_relaxed);
+		}
+		mWake.notify_one();
+		if (mThread.joinable()) {
+			mThread.join();
+		}
+	}
+
+	size_t SendWorker::Send(std::span<const uint8_t> aBytes)
+	{
+		if (aBytes.empty()) {
+			return 0;
+		}
+
+		const size_t count = mRing.Write(aBytes);
+		mBytesQueued.fetch_add(count, std::memory_order_relaxed);
+		mBytesDropped.fetch_add(aBytes.size() - count, std::memory_order_relaxed);
+
+		if (count > 0) {
+			// Taking the lock orders the write before the writer's next check
+			// of the ring, so it cannot go to sleep on the bytes. The writer
+			// never holds it for long.
+			{
+				std::lock_guard<std::mutex> lock(mWakeMutex);
+			}
+			mWake.notify_one();
+		}
+		return count;
+	}
+
+	void SendWorker::Run()
+	{
+		using Clock = std::chrono::steady_clock;
+
+		// Set by a write that took nothing, cleared by one that took bytes.
+		std::optional<Clock::time_point> stalledSince;
+
+		try {
+			while (!mStopRequested.load(std::memory_order_relaxed)) {
+
+				if (mRing.Empty()) {
+					std::unique_lock<std::mutex> lock(mWakeMutex);
+					mWake.wait(lock, [this] {
+						return mStopRequested.load(std::memory_order_relaxed) || !mRing.Empty();
+					});
+					continue;
+				}
+
+				const auto runs = mRing.PeekRuns(MaxWriteSize);
+				const size_t count = mTransport->Write(runs);
+				if (count > 0) {
+					mRing.Consume(count);
+					mBytesWritten.fetch_add(count, std::memory_order_relaxed);
+					mWrites.fetch_add(1, std::memory_order_relaxed);
+					stalledSince.reset();
+					continue;
+				}
+
+				const auto now = Clock::now();
+				if (!stalledSince) {
+					stalledSince = now;
+				}
+				else if (now - *stalledSince >= mStallTimeout) {
+					const size_t queued = mRing.Size();
+					mRing.Consume(queued);
+					mBytesDropped.fetch_add(queued, std::memory_order_relaxed);
+					mStalls.fetch_add(1, std::memory_order_relaxed);
+					stalledSince.reset();
+					continue;
+				}
+				std::this_thread::sleep_for(RetryInterval);
+			}
+		}
+		catch (const std::exception& ex) {
+			std::lock_guard<std::mutex> lock(mErrorMutex);
+			mError = ex.what();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mErrorMutex);
+			mError = "Unknown send error";
+		}
+
+		mFinished.store(true, std::memory_order_release);
+	}
+
+	SendWorker::Statistics SendWorker::GetStatistics() const
+	{
+		Statistics stats;
+		stats.mBytesQueued = mBytesQueued.load(std::memory_order_relaxed);
+		stats.mBytesWritten = mBytesWritten.load(std::memory_order_relaxed);
+		stats.mBytesDropped = mBytesDropped.load(std::memory_order_relaxed);
+		stats.mWrites = mWrites.load(std::memory_order_relaxed);
+		stats.mStalls = mStalls.load(std::memory_order_relaxed);
+		stats.mBuffered = mRing.Size();
+		stats.mHighWaterMark = mRing.HighWaterMark();
+		stats.mCapacity = mRing.Capacity();
+		return stats;
+	}
+
+	std::optional<std::string> SendWorker::TakeError()
+	{
+		std::lock_guard<std::mutex> lock(mErrorMutex);
+		std::optional<std::string> error = std::move(mError);
+		mError.reset();
+		return error;
+	}
+
+}
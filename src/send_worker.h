@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+
+#include "spsc_byte_ring.h"
+#include "transport.h"
+
+namespace imterm {
+
+	// Writes bytes for a Transport on a dedicated thread, so the thread that
+	// produces them, normally the UI thread, never waits for the device.
+	//
+	// Send() appends to a lock-free ring and returns at once. The writer
+	// thread hands everything queued to one Transport::Write() call, so a
+	// burst of keystrokes and terminal reports typed or produced during a
+	// frame goes out in one write rather than one per byte.
+	//
+	// Send() never blocks: bytes that do not fit in the ring are counted as
+	// dropped. When the transport takes nothing for StallTimeout, say because
+	// the device holds off flow control or stopped reading, the queued bytes
+	// are discarded and counted too, so that a device that comes back does
+	// not receive a burst of stale input.
+	class SendWorker {
+
+	public:
+
+		// Thousands of keystrokes and reports.
+		static constexpr size_t DefaultCapacity = 64 * 1024;
+		// Most bytes passed to one Transport::Write(). A serial port's write
+		// timeout grows with the size of the write, and Stop() waits for it.
+		static constexpr size_t MaxWriteSize = 256;
+		// How long the writer waits before retrying a write that took nothing.
+		static constexpr std::chrono::milliseconds RetryInterval{ 1 };
+		static constexpr std::chrono::milliseconds DefaultStallTimeout{ 2000 };
+
+		struct Statistics {
+			uint64_t mBytesQueued = 0;   // accepted by Send()
+			uint64_t mBytesWritten = 0;  // taken by the transport
+			uint64_t mBytesDropped = 0;  // did not fit, or discarded after a stall
+			uint64_t mWrites = 0;        // Transport::Write() calls that took bytes
+			uint64_t mStalls = 0;        // times the queue was discarded
+			size_t mBuffered = 0;        // currently queued
+			size_t mHighWaterMark = 0;   // most ever queued at once
+			size_t mCapacity = 0;
+		};
+
+		explicit SendWorker(std::shared_ptr<Transport> aTransport, size_t aCapacity = DefaultCapacity);
+		~SendWorker();
+
+		SendWorker(const SendWorker&) = delete;
+		SendWorker& operator=(const SendWorker&) = delete;
+
+		// Starts the writer thread. Has no effect if it is already running.
+		void Start();
+
+		// Stops and joins the writer thread, waiting out a write in progress.
+		// Queued bytes stay queued for the next Start().
+		void Stop();
+
+		bool IsRunning() const { return mThread.joinable() && !mFinished.load(std::memory_order_acquire); }
+
+		// Producer only. Queues as much of aBytes as fits and returns the number
+		// of bytes queued. Never waits for the writer thread.
+		size_t Send(std::span<const uint8_t> aBytes);
+
+		// True while bytes wait for the transport.
+		bool HasPendingBytes() const { return !mRing.Empty(); }
+
+		// Set before Start().
+		void SetStallTimeout(std::chrono::milliseconds aTimeout) { mStallTimeout = aTimeout; }
+		std::chrono::milliseconds GetStallTimeout() const { return mStallTimeout; }
+
+		Statistics GetStatistics() const;
+
+		// Returns the message of the exception that stopped the writer thread, once.
+		std::optional<std::string> TakeError();
+
+	private:
+
+		void Run();
+
+		std::shared_ptr<Transport> mTransport;
+		SpscByteRing mRing;
+		std::chrono::milliseconds mStallTimeout = DefaultStallTimeout;
+
+		std::thread mThread;
+		std::atomic<bool> mStopRequested{ false };
+		std::atomic<bool> mFinished{ false };
+
+		// The writer sleeps here while the ring is empty. Never held across a
+		// write.
+		std::mutex mWakeMutex;
+		std::condition_variable mWake;
+
+		std::atomic<uint64_t> mBytesQueued{ 0 };
+		std::atomic<uint64_t> mBytesWritten{ 0 };
+		std::atomic<uint64_t> mBytesDropped{ 0 };
+		std::atomic<uint64_t> mWrites{ 0 };
+		std::atomic<uint64_t> mStalls{ 0 };
+
+		std::mutex mErrorMutex;
+		std::optional<std::string> mError;
+	};
+
+}
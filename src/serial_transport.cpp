@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "serial_transport.h"
+
+namespace imterm {
+
+	bool SerialTransport::WaitReadable()
+	{
+#if defined(_WIN32)
+		// deps/serial does not implement waitReadable() on Windows. Poll instead;
+		// a millisecond is well under the UART FIFO fill time at 3 Mbaud.
+		if (mSerial.available() > 0) {
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return false;
+#else
+		// Blocks for at most the port's constant read timeout.
+		return mSerial.waitReadable();
+#endif
+	}
+
+	size_t SerialTransport::Read(std::span<uint8_t> aBuffer)
+	{
+		const size_t count = std::min(mSerial.available(), aBuffer.size());
+		if (count == 0) {
+			return 0;
+		}
+		return mSerial.read(aBuffer.data(), count);
+	}
+
+	int SerialTransport::GetPollDescriptor() const
+	{
+#if defined(_WIN32)
+		return -1;
+#else
+		return mSerial.getFileDescriptor();
+#endif
+	}
+
+	size_t SerialTransport::Write(std::span<const std::span<const uint8_t>> aBuffers)
+	{
+		std::lock_guard<std::mutex> lock(mWriteMutex);
+		size_t total = 0;
+		for (const auto& buffer : aBuffers) {
+			if (buffer.empty()) {
+				continue;
+			}
+			const size_t count = mSerial.write(buffer.data(), buffer.size());
+			total += count;
+			if (count < buffer.size()) {
+				// Timed out; the rest waits for the next call.
+				break;
+			}
+		}
+		return total;
+	}
+
+}
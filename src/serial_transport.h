@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+
+#include "serial/serial.h"
+#include "transport.h"
+
+namespace imterm {
+
+	// Transport over a deps/serial port. The port must outlive this object and
+	// must not be closed or reconfigured while a capture session is reading or
+	// writing it.
+	class SerialTransport : public Transport {
+
+	public:
+
+		explicit SerialTransport(serial::Serial& aSerial) : mSerial(aSerial) { }
+
+		bool WaitReadable() override;
+		size_t Read(std::span<uint8_t> aBuffer) override;
+		int GetPollDescriptor() const override;
+		bool CanWrite() const override { return true; }
+		// Each buffer is one write, bounded by the port's write timeout. Calls
+		// from different threads take turns.
+		size_t Write(std::span<const std::span<const uint8_t>> aBuffers) override;
+
+	private:
+
+		serial::Serial& mSerial;
+		std::mutex mWriteMutex;
+	};
+
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+
+namespace imterm {
+
+	// Fixed-capacity, lock-free byte queue for exactly one producer thread and one
+	// consumer thread. The read and write positions only ever increase; the ring
+	// offset is taken by masking, so the capacity must be a power of two.
+	//
+	// Write() never blocks and never overwrites unread data: bytes that do not fit
+	// are left with the caller, which decides whether to retry or count them as
+	// dropped. A producer that reads from a device can instead Reserve() free
+	// space, read into it in place and Commit() what it read, so the bytes are
+	// copied once on their way to the consumer.
+	class SpscByteRing {
+
+	public:
+
+		explicit SpscByteRing(size_t aCapacity)
+			: mCapacity(aCapacity), mMask(aCapacity - 1), mBuffer(std::make_unique<uint8_t[]>(aCapacity))
+		{
+			if (aCapacity == 0 || (aCapacity & (aCapacity - 1)) != 0) {
+				throw std::invalid_argument("SpscByteRing capacity must be a non-zero power of two");
+			}
+		}
+
+		SpscByteRing(const SpscByteRing&) = delete;
+		SpscByteRing& operator=(const SpscByteRing&) = delete;
+
+		size_t Capacity() const { return mCapacity; }
+
+		// Number of unread bytes. Exact when called from either the producer or the
+		// consumer; a snapshot otherwise.
+		size_t Size() const {
+			const size_t write = mWrite.load(std::memory_order_acquire);
+			const size_t read = mRead.load(std::memory_order_acquire);
+			return write - read;
+		}
+
+		bool Empty() const { return Size() == 0; }
+
+		// Largest Size() observed by the producer immediately after a write.
+		size_t HighWaterMark() const { return mHighWaterMark.load(std::memory_order_relaxed); }
+
+		void ResetHighWaterMark() { mHighWaterMark.store(Size(), std::memory_order_relaxed); }
+
+		// Producer only. Copies as much of aBytes as fits and returns the number of
+		// bytes accepted.
+		size_t Write(std::span<const uint8_t> aBytes) {
+			const size_t write = mWrite.load(std::memory_order_relaxed);
+			const size_t read = mRead.load(std::memory_order_acquire);
+			const size_t free = mCapacity - (write - read);
+			const size_t count = std::min(free, aBytes.size());
+
+			if (count == 0) {
+				return 0;
+			}
+
+			const size_t offset = write & mMask;
+			const size_t first = std::min(count, mCapacity - offset);
+			std::memcpy(mBuffer.get() + offset, aBytes.data(), first);
+			std::memcpy(mBuffer.get(), aBytes.data() + first, count - first);
+
+			Publish(write + count, read);
+			return count;
+		}
+
+		// Producer only. The longest contiguous run of free space, capped at
+		// aMaxBytes; empty when the ring is full. The consumer does not see
+		// what is written there until Commit().
+		std::span<uint8_t> Reserve(size_t aMaxBytes = SIZE_MAX) {
+			const size_t write = mWrite.load(std::memory_order_relaxed);
+			const size_t read = mRead.load(std::memory_order_acquire);
+			const size_t offset = write & mMask;
+			const size_t count = std::min({ mCapacity - (write - read), mCapacity - offset, aMaxBytes });
+			return { mBuffer.get() + offset, count };
+		}
+
+		// Producer only. Queues the first aCount bytes of the last Reserve().
+		void Commit(size_t aCount) {
+			if (aCount == 0) {
+				return;
+			}
+			const size_t write = mWrite.load(std::memory_order_relaxed);
+			Publish(write + aCount, mRead.load(std::memory_order_acquire));
+		}
+
+		// Consumer only. The longest contiguous run of unread bytes, capped at
+		// aMaxBytes. The span stays valid until the matching Consume().
+		std::span<const uint8_t> Peek(size_t aMaxBytes = SIZE_MAX) const {
+			const size_t read = mRead.load(std::memory_order_relaxed);
+			const size_t write = mWrite.load(std::memory_order_acquire);
+			const size_t offset = read & mMask;
+			const size_t count = std::min({ write - read, mCapacity - offset, aMaxBytes });
+			return { mBuffer.get() + offset, count };
+		}
+
+		// Consumer only. Up to aMaxBytes unread bytes in at most two runs: the
+		// second is the part that wrapped to the start of the buffer. Lets a
+		// consumer hand everything queued to a gathering write at once.
+		std::array<std::span<const uint8_t>, 2> PeekRuns(size_t aMaxBytes = SIZE_MAX) const {
+			const size_t read = mRead.load(std::memory_order_relaxed);
+			const size_t write = mWrite.load(std::memory_order_acquire);
+			const size_t offset = read & mMask;
+			const size_t count = std::min(write - read, aMaxBytes);
+			const size_t first = std::min(count, mCapacity - offset);
+			return { std::span<const uint8_t>(mBuffer.get() + offset, first),
+				std::span<const uint8_t>(mBuffer.get(), count - first) };
+		}
+
+		// Consumer only. Releases aCount bytes previously returned by Peek() or
+		// PeekRuns().
+		void Consume(size_t aCount) {
+			const size_t read = mRead.load(std::memory_order_relaxed);
+			mRead.store(read + aCount, std::memory_order_release);
+		}
+
+		// Consumer only. Copies up to aOut.size() bytes out of the ring.
+		size_t Read(std::span<uint8_t> aOut) {
+			size_t total = 0;
+			while (total < aOut.size()) {
+				auto run = Peek(aOut.size() - total);
+				if (run.empty()) {
+					break;
+				}
+				std::memcpy(aOut.data() + total, run.data(), run.size());
+				Consume(run.size());
+				total += run.size();
+			}
+			return total;
+		}
+
+	private:
+
+		void Publish(size_t aWrite, size_t aRead) {
+			mWrite.store(aWrite, std::memory_order_release);
+
+			const size_t used = aWrite - aRead;
+			if (used > mHighWaterMark.load(std::memory_order_relaxed)) {
+				mHighWaterMark.store(used, std::memory_order_relaxed);
+			}
+		}
+
+		// Keep the producer- and consumer-owned positions on separate cache lines so
+		// the two threads do not false-share.
+		static constexpr size_t CacheLineSize = 64;
+
+		const size_t mCapacity;
+		const size_t mMask;
+		std::unique_ptr<uint8_t[]> mBuffer;
+
+		alignas(CacheLineSize) std::atomic<size_t> mWrite{ 0 };
+		std::atomic<size_t> mHighWaterMark{ 0 };
+		alignas(CacheLineSize) std::atomic<size_t> mRead{ 0 };
+	};
+
+}
@@ -6,8 +6,10 @@ namespace imterm {
 
 	namespace {
 
+		using Arguments = EscapeSequenceParser::Arguments;
+
 		int ParameterOrDefault(
-			const std::vector<int>& aParameters, size_t aIndex, int aDefault)
+			const Arguments& aParameters, size_t aIndex, int aDefault)
 		{
 			if (aIndex >= aParameters.size() || aParameters[aIndex] == 0) {
 				return aDefault;
@@ -16,7 +18,7 @@ namespace imterm {
 		}
 
 		std::optional<TerminalCommand> DecodeMove(
-			const std::vector<int>& aParameters,
+			const Arguments& aParameters,
 			MoveCursor::Direction aDirection,
 			bool aMoveToLineStart = false)
 		{
@@ -46,7 +48,7 @@ namespace imterm {
 			return std::nullopt;
 		}
 
-		const std::vector<int>& parameters = aSequence.mCommandData;
+		const Arguments& parameters = aSequence.mCommandData;
 		switch (aSequence.mIdentifier) {
 		case Identifier::A_MoveCursorUp:
 			return DecodeMove(parameters, MoveCursor::Direction::Up);
@@ -107,7 +109,7 @@ namespace imterm {
 			}
 		case Identifier::m_SetGraphics:
 			return SetGraphics{
-				parameters.empty() ? std::vector<int>{0} : parameters};
+				parameters.empty() ? Arguments{0} : parameters};
 		case Identifier::n_RequestReport:
 			if (parameters.size() != 1) {
 				return std::nullopt;
@@ -2,7 +2,6 @@
 
 #include <optional>
 #include <variant>
-#include <vector>
 
 #include "escape_sequence_parser.h"
 #include "terminal_coordinates.h"
@@ -75,7 +74,7 @@ namespace imterm {
 	};
 
 	struct SetGraphics {
-		std::vector<int> mParameters;
+		EscapeSequenceParser::Arguments mParameters;
 	};
 
 	struct RequestStatusReport {
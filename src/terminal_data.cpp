@@ -1,18 +1,20 @@
 #include "terminal_data.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <stdexcept>
+#include <utility>
 
 namespace imterm {
 
 	TerminalData::TerminalData()
-		: mReadOnly(false), mTextChanged(false), mTabSize(4)
+		: mReadOnly(false), mTabSize(4)
 	{
 	}
 
 	TerminalData::TerminalData(std::shared_ptr<TerminalLogger> aLogger)
-		: mReadOnly(false), mTextChanged(false), mTabSize(4),
+		: mReadOnly(false), mTabSize(4),
 		  mLogger(std::move(aLogger))
 	{
 		if (mLogger) {
@@ -49,10 +51,67 @@ namespace imterm {
 		mReadOnly = aValue;
 	}
 
-	void TerminalData::Touch(Line& aLine) noexcept
+	void TerminalData::Touch(Line& aLine, size_t aLineIndex) noexcept
 	{
-		aLine.Touch();
-		mTextChanged = true;
+		aLine.Touch(++mGeneration, ChangeTime());
+		MarkChanged(aLineIndex);
+		mWidestLineColumn = std::max(mWidestLineColumn, aLine.ColumnBound(mTabSize));
+	}
+
+	void TerminalData::MarkChanged(size_t aLineIndex, bool aThroughEnd) noexcept
+	{
+		const uint64_t serial = mFirstLineSerial + aLineIndex;
+		const uint64_t end = aThroughEnd ? UINT64_MAX : serial + 1;
+		for (std::optional<ChangedSerials>& changed : mChangeTrackers) {
+			if (changed) {
+				changed->mFirst = std::min(changed->mFirst, serial);
+				changed->mEnd = std::max(changed->mEnd, end);
+			}
+		}
+	}
+
+	TerminalData::ChangeTracker TerminalData::AddChangeTracker()
+	{
+		// A new tracker reports nothing until the buffer next changes; its
+		// owner reads the current contents itself.
+		const auto unused = std::find(
+			mChangeTrackers.begin(), mChangeTrackers.end(), std::nullopt);
+		if (unused != mChangeTrackers.end()) {
+			*unused = NoChange;
+			return static_cast<ChangeTracker>(unused - mChangeTrackers.begin());
+		}
+		mChangeTrackers.push_back(NoChange);
+		return mChangeTrackers.size() - 1;
+	}
+
+	void TerminalData::RemoveChangeTracker(ChangeTracker aTracker)
+	{
+		if (aTracker >= mChangeTrackers.size() || !mChangeTrackers[aTracker]) {
+			throw std::out_of_range("TerminalData::RemoveChangeTracker tracker");
+		}
+		mChangeTrackers[aTracker].reset();
+	}
+
+	std::optional<TerminalData::ChangedSerials> TerminalData::TakeChangedSerials(
+		ChangeTracker aTracker)
+	{
+		if (aTracker >= mChangeTrackers.size() || !mChangeTrackers[aTracker]) {
+			throw std::out_of_range("TerminalData::TakeChangedSerials tracker");
+		}
+		const ChangedSerials changed = std::exchange(*mChangeTrackers[aTracker], NoChange);
+		if (changed == NoChange) {
+			return std::nullopt;
+		}
+		return changed;
+	}
+
+	std::optional<uint64_t> TerminalData::TakeLowestChangedSerial(
+		ChangeTracker aTracker)
+	{
+		if (const auto changed = TakeChangedSerials(aTracker)) {
+			return changed->mFirst;
+		}
+		return std::nullopt;
 	}
 
 	void TerminalData::ResetPendingLog(size_t aLineIndex)
@@ -99,10 +158,13 @@ namespace imterm {
 		}
 
 		AdjustPendingLogForRemoval(start, end);
-		mLines.erase(
-			mLines.begin() + static_cast<std::ptrdiff_t>(start),
-			mLines.begin() + static_cast<std::ptrdiff_t>(end));
-		mTextChanged = true;
+		mLines.erase(start, end);
+		if (start == 0) {
+			mFirstLineSerial += end;
+		}
+		else {
+			MarkChanged(start, true);
+		}
 	}
 
 	void TerminalData::RemoveLine(int aIndex)
@@ -122,10 +184,14 @@ namespace imterm {
 
 		LogPendingLine();
 		const size_t index = static_cast<size_t>(aIndex);
-		mLines.insert(
-			mLines.begin() + static_cast<std::ptrdiff_t>(index), Line());
+		if (index == mLines.size() && index > 0) {
+			// The previous last line is usually complete now; drop its growth
+			// slack so long captures cost close to one byte per received byte.
+			mLines[index - 1].ShrinkToFit();
+		}
+		mLines.insert(index, Line());
+		MarkChanged(index, true);
 		ResetPendingLog(index);
-		mTextChanged = true;
 	}
 
 	void TerminalData::EnsureLineExists(size_t aIndex)
@@ -172,19 +238,17 @@ namespace imterm {
 			return;
 		}
 		Line& line = mLines.at(aLineIndex);
-		const size_t start = std::min(aStart, line.mGlyphs.size());
-		const size_t end = std::min(std::max(aEnd, start), line.mGlyphs.size());
+		const size_t start = std::min(aStart, line.size());
+		const size_t end = std::min(std::max(aEnd, start), line.size());
 		if (start == end) {
 			return;
 		}
 
-		line.mGlyphs.erase(
-			line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(start),
-			line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(end));
+		line.Erase(start, end);
 		if (!mPendingLog) {
 			ResetPendingLog(aLineIndex);
 		}
-		Touch(line);
+		Touch(line, aLineIndex);
 	}
 
 	void TerminalData::ReplaceBytesWithSpaces(
@@ -195,19 +259,19 @@ namespace imterm {
 			return;
 		}
 		Line& line = mLines.at(aLineIndex);
-		const size_t start = std::min(aStart, line.mGlyphs.size());
-		const size_t end = std::min(std::max(aEnd, start), line.mGlyphs.size());
+		const size_t start = std::min(aStart, line.size());
+		const size_t end = std::min(std::max(aEnd, start), line.size());
 		if (start == end) {
 			return;
 		}
 
 		for (size_t index = start; index < end; ++index) {
-			line.mGlyphs[index].mChar = ' ';
+			line.SetChar(index, ' ');
 		}
 		if (!mPendingLog) {
 			ResetPendingLog(aLineIndex);
 		}
-		Touch(line);
+		Touch(line, aLineIndex);
 	}
 
 	void TerminalData::ClearLine(size_t aLineIndex)
@@ -230,26 +294,24 @@ namespace imterm {
 		const size_t blankColumns = static_cast<size_t>(std::max(
 			aThroughColumn.mValue + 1, originalEndColumn));
 
-		line.mGlyphs.erase(
-			line.mGlyphs.begin(),
-			line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(byteEnd));
-		line.mGlyphs.insert(
-			line.mGlyphs.begin(), blankColumns,
-			Glyph(' ', PaletteIndex::Default));
+		line.Erase(0, byteEnd);
+		line.Insert(0, blankColumns, ' ', PaletteIndex::Default);
 		if (!mPendingLog) {
 			ResetPendingLog(aLineIndex);
 		}
-		Touch(line);
+		Touch(line, aLineIndex);
 	}
 
 	ByteOffset TerminalData::GetByteOffset(
 		const BufferPosition& aPosition) const
 	{
-		const Line& line = mLines.at(aPosition.mRow);
+		const Line& storedLine = mLines.at(aPosition.mRow);
+		const auto line = storedLine.GetBytes();
 		const int targetColumn = std::max(aPosition.mColumn.mValue, 0);
-		int renderedColumn = 0;
-		for (size_t index = 0; index < line.size();) {
-			const Char character = line[index].mChar;
+		const ColumnStop stop = storedLine.StopAtColumn(targetColumn, mTabSize);
+		int renderedColumn = stop.mColumn;
+		for (size_t index = stop.mByte; index < line.size();) {
+			const Char character = line[index];
 			const size_t characterLength = static_cast<size_t>(UTF8CharLength(
 				character, line.size() - index));
 			const int nextColumn = character == '\t'
@@ -267,11 +329,13 @@ namespace imterm {
 	ByteOffset TerminalData::GetByteOffsetAfter(
 		const BufferPosition& aPosition) const
 	{
-		const Line& line = mLines.at(aPosition.mRow);
+		const Line& storedLine = mLines.at(aPosition.mRow);
+		const auto line = storedLine.GetBytes();
 		const int targetColumn = std::max(aPosition.mColumn.mValue, 0);
-		int renderedColumn = 0;
-		for (size_t index = 0; index < line.size();) {
-			const Char character = line[index].mChar;
+		const ColumnStop stop = storedLine.StopAtColumn(targetColumn, mTabSize);
+		int renderedColumn = stop.mColumn;
+		for (size_t index = stop.mByte; index < line.size();) {
+			const Char character = line[index];
 			const size_t characterLength = static_cast<size_t>(UTF8CharLength(
 				character, line.size() - index));
 			const int nextColumn = character == '\t'
@@ -323,17 +387,12 @@ namespace imterm {
 		Line& firstLine = mLines[startLineIndex];
 		Line& lastLine = mLines[endLineIndex];
 		const size_t firstErase = std::min(
-			static_cast<size_t>(startIndex), firstLine.mGlyphs.size());
+			static_cast<size_t>(startIndex), firstLine.size());
 		const size_t lastErase = std::min(
-			static_cast<size_t>(endIndex), lastLine.mGlyphs.size());
-		firstLine.mGlyphs.erase(
-			firstLine.mGlyphs.begin() + static_cast<std::ptrdiff_t>(firstErase),
-			firstLine.mGlyphs.end());
-		firstLine.mGlyphs.insert(
-			firstLine.mGlyphs.end(),
-			lastLine.mGlyphs.begin() + static_cast<std::ptrdiff_t>(lastErase),
-			lastLine.mGlyphs.end());
-		Touch(firstLine);
+			static_cast<size_t>(endIndex), lastLine.size());
+		firstLine.Truncate(firstErase);
+		firstLine.Append(lastLine, lastErase);
+		Touch(firstLine, startLineIndex);
 		RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
 		if (!mPendingLog) {
 			ResetPendingLog(startLineIndex);
@@ -360,21 +419,16 @@ namespace imterm {
 				const size_t lineIndex = static_cast<size_t>(aWhere.mLine);
 				const size_t splitIndex = std::min(
 					static_cast<size_t>(std::max(characterIndex, 0)),
-					mLines[lineIndex].mGlyphs.size());
+					mLines[lineIndex].size());
 				InsertLine(aWhere.mLine + 1);
 
 				Line& line = mLines[lineIndex];
 				Line& newLine = mLines[lineIndex + 1];
-				newLine.mGlyphs.insert(
-					newLine.mGlyphs.end(),
-					line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(splitIndex),
-					line.mGlyphs.end());
-				line.mGlyphs.erase(
-					line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(splitIndex),
-					line.mGlyphs.end());
-				Touch(line);
-				if (!newLine.mGlyphs.empty()) {
-					Touch(newLine);
+				newLine.Append(line, splitIndex);
+				line.Truncate(splitIndex);
+				Touch(line, lineIndex);
+				if (!newLine.empty()) {
+					Touch(newLine, lineIndex + 1);
 				}
 			}
 				++aWhere.mLine;
@@ -384,14 +438,14 @@ namespace imterm {
 				++aValue;
 			}
 			else {
-				Line& line = mLines[static_cast<size_t>(aWhere.mLine)];
+				const size_t lineIndex = static_cast<size_t>(aWhere.mLine);
+				Line& line = mLines[lineIndex];
 				int bytesRemaining = UTF8CharLength(*aValue);
 				while (bytesRemaining-- > 0 && *aValue != '\0') {
-					line.mGlyphs.insert(
-						line.mGlyphs.begin() + characterIndex++,
-						Glyph(*aValue++, PaletteIndex::Default));
+					line.Insert(static_cast<size_t>(characterIndex++), 1,
+						static_cast<Char>(*aValue++), PaletteIndex::Default);
 				}
-				Touch(line);
+				Touch(line, lineIndex);
 				++aWhere.mColumn;
 			}
 		}
@@ -406,6 +460,7 @@ namespace imterm {
 			return;
 		}
 		LogPendingLine(true);
+		mFirstLineSerial += mLines.size();
 		mLines.clear();
 		mLines.emplace_back();
 		for (const char character : aText) {
@@ -416,17 +471,20 @@ namespace imterm {
 				mLines.emplace_back();
 			}
 			else {
-				mLines.back().mGlyphs.emplace_back(
-					character, PaletteIndex::Default);
+				mLines.back().PushBack(
+					static_cast<Char>(character), PaletteIndex::Default);
 			}
 		}
+		mWidestLineColumn = 0;
+		const Line::Timestamp time = ChangeTime();
 		for (Line& line : mLines) {
-			if (!line.mGlyphs.empty()) {
-				line.Touch();
+			if (!line.empty()) {
+				line.Touch(++mGeneration, time);
 			}
+			mWidestLineColumn = std::max(mWidestLineColumn, line.ColumnBound(mTabSize));
 		}
+		MarkChanged(0, true);
 		ResetPendingLog(mLines.size() - 1);
-		mTextChanged = true;
 	}
 
 	void TerminalData::SetTextLines(const std::vector<std::string>& aLines)
@@ -436,22 +494,52 @@ namespace imterm {
 			return;
 		}
 		LogPendingLine(true);
+		mFirstLineSerial += mLines.size();
 		mLines.clear();
 		mLines.resize(std::max<size_t>(1, aLines.size()));
+		mWidestLineColumn = 0;
+		const Line::Timestamp time = ChangeTime();
 
 		for (size_t lineIndex = 0; lineIndex < aLines.size(); ++lineIndex) {
 			Line& line = mLines[lineIndex];
-			line.mGlyphs.reserve(aLines[lineIndex].size());
+			line.Reserve(aLines[lineIndex].size());
 			for (const char character : aLines[lineIndex]) {
-				line.mGlyphs.emplace_back(character, PaletteIndex::Default);
+				line.PushBack(static_cast<Char>(character), PaletteIndex::Default);
 			}
-			if (!line.mGlyphs.empty()) {
-				line.Touch();
+			if (!line.empty()) {
+				line.Touch(++mGeneration, time);
 			}
+			mWidestLineColumn = std::max(mWidestLineColumn, line.ColumnBound(mTabSize));
 		}
 
+		MarkChanged(0, true);
+		ResetPendingLog(mLines.size() - 1);
+	}
+
+	void TerminalData::SetLines(std::span<const Line> aLines)
+	{
+		assert(!mReadOnly);
+		if (mReadOnly) {
+			return;
+		}
+		LogPendingLine(true);
+		mFirstLineSerial += mLines.size();
+		mLines.clear();
+		mLines.resize(std::max<size_t>(1, aLines.size()));
+		mWidestLineColumn = 0;
+
+		for (size_t lineIndex = 0; lineIndex < aLines.size(); ++lineIndex) {
+			Line& line = mLines[lineIndex];
+			line = aLines[lineIndex];
+			// Generations are only comparable within one buffer.
+			if (line.mGeneration != 0) {
+				line.mGeneration = ++mGeneration;
+			}
+			mWidestLineColumn = std::max(mWidestLineColumn, line.ColumnBound(mTabSize));
+		}
+
+		MarkChanged(0, true);
 		ResetPendingLog(mLines.size() - 1);
-		mTextChanged = true;
 	}
 
 	std::string TerminalData::GetText(
@@ -478,9 +566,9 @@ namespace imterm {
 				break;
 			}
 
-			const Line& line = mLines[static_cast<size_t>(lineIndex)];
+			const auto line = mLines[static_cast<size_t>(lineIndex)].GetBytes();
 			if (static_cast<size_t>(byteIndex) < line.size()) {
-				result += line[static_cast<size_t>(byteIndex)].mChar;
+				result += static_cast<char>(line[static_cast<size_t>(byteIndex)]);
 				++byteIndex;
 			}
 			else {
@@ -504,16 +592,58 @@ namespace imterm {
 		std::vector<std::string> result;
 		result.reserve(mLines.size());
 		for (const Line& line : mLines) {
-			std::string text;
-			text.reserve(line.size());
-			for (const Glyph& glyph : line) {
-				text += static_cast<char>(glyph.mChar);
-			}
-			result.emplace_back(std::move(text));
+			const auto bytes = line.GetBytes();
+			result.emplace_back(bytes.begin(), bytes.end());
 		}
 		return result;
 	}
 
+	std::shared_ptr<const TerminalData::Snapshot> TerminalData::TakeSnapshot()
+	{
+		auto snapshot = std::make_shared<Snapshot>();
+		snapshot->mLines = mLines.TakeSnapshot();
+		snapshot->mFirstLineSerial = mFirstLineSerial;
+		snapshot->mGeneration = mGeneration;
+		return snapshot;
+	}
+
+	void TerminalData::PublishSnapshot()
+	{
+		auto snapshot = TakeSnapshot();
+		const std::lock_guard lock(mPublishedMutex);
+		// The previous snapshot is released outside the lock by its last reader
+		// or here, after the swap.
+		mPublished.swap(snapshot);
+	}
+
+	std::shared_ptr<const TerminalData::Snapshot> TerminalData::GetPublishedSnapshot() const
+	{
+		const std::lock_guard lock(mPublishedMutex);
+		return mPublished;
+	}
+
+	std::vector<std::string> TerminalData::Snapshot::GetTextLines() const
+	{
+		std::vector<std::string> result;
+		result.reserve(mLines.size());
+		mLines.ForEach(0, mLines.size(), [&result](size_t, const Line& aLine) {
+			const auto bytes = aLine.GetBytes();
+			result.emplace_back(bytes.begin(), bytes.end());
+		});
+		return result;
+	}
+
+	std::string TerminalData::Snapshot::GetText() const
+	{
+		std::string result;
+		mLines.ForEach(0, mLines.size(), [&result](size_t, const Line& aLine) {
+			const auto bytes = aLine.GetBytes();
+			result.append(bytes.begin(), bytes.end());
+			result += '\n';
+		});
+		return result;
+	}
+
 	void TerminalData::InputGlyph(
 		size_t aLineIndex, int& aColumnIndex,
 		PaletteIndex aPaletteIndex, uint8_t aValue)
@@ -532,30 +662,76 @@ namespace imterm {
 		}
 		Line& line = mLines.at(aLineIndex);
 		aColumnIndex = std::max(aColumnIndex, 0);
-		while (GetLineMaxColumn(static_cast<int>(aLineIndex)) < aColumnIndex) {
-			line.mGlyphs.emplace_back(' ', PaletteIndex::Default);
-		}
+		PadLineToColumn(line, aColumnIndex);
 
 		const BufferPosition position{
 			aLineIndex, RenderedColumn{aColumnIndex}};
 		const size_t start = GetByteOffset(position).mValue;
 		const size_t finish = GetByteOffsetAfter(position).mValue;
-		if (start < line.mGlyphs.size()) {
-			line.mGlyphs.erase(
-				line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(start),
-				line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(finish));
+		line.Erase(start, finish);
+		line.Insert(start, aBytes, aPaletteIndex);
+		if (!mPendingLog) {
+			ResetPendingLog(aLineIndex);
 		}
-		line.mGlyphs.insert(
-			line.mGlyphs.begin() + static_cast<std::ptrdiff_t>(start),
-			aBytes.size(), Glyph(0, aPaletteIndex));
-		for (size_t index = 0; index < aBytes.size(); ++index) {
-			line.mGlyphs[start + index].mChar = aBytes[index];
+		Touch(line, aLineIndex);
+		++aColumnIndex;
+	}
+
+	void TerminalData::InputCharacters(
+		size_t aLineIndex, int& aColumnIndex,
+		PaletteIndex aPaletteIndex, std::span<const uint8_t> aBytes)
+	{
+		assert(!mReadOnly);
+		if (mReadOnly || aBytes.empty()) {
+			return;
 		}
+		Line& line = mLines.at(aLineIndex);
+		aColumnIndex = std::max(aColumnIndex, 0);
+
+		// A tab spans several columns, so overwriting one character per column
+		// no longer lines up; replay such lines one character at a time.
+		if (line.HasTabs()) {
+			for (size_t index = 0; index < aBytes.size();) {
+				const size_t length = static_cast<size_t>(UTF8CharLength(
+					aBytes[index], aBytes.size() - index));
+				InputBytes(aLineIndex, aColumnIndex, aPaletteIndex,
+					aBytes.subspan(index, length));
+				index += length;
+			}
+			return;
+		}
+
+		// Without tabs every character is one column wide, so the run replaces
+		// the characters that follow the first one it covers.
+		PadLineToColumn(line, aColumnIndex);
+		const size_t start = GetByteOffset(
+			BufferPosition{aLineIndex, RenderedColumn{aColumnIndex}}).mValue;
+		const size_t characters = UTF8CharCount(aBytes);
+		const auto text = line.GetBytes();
+		size_t finish = start;
+		for (size_t replaced = 0; finish < text.size() && replaced < characters; ++replaced) {
+			finish += static_cast<size_t>(UTF8CharLength(
+				text[finish], text.size() - finish));
+		}
+
+		line.Erase(start, finish);
+		line.Insert(start, aBytes, aPaletteIndex);
 		if (!mPendingLog) {
 			ResetPendingLog(aLineIndex);
 		}
-		Touch(line);
-		++aColumnIndex;
+		Touch(line, aLineIndex);
+		aColumnIndex += static_cast<int>(characters);
+	}
+
+	void TerminalData::PadLineToColumn(Line& aLine, int aColumn)
+	{
+		// A space appended after a truncated UTF-8 sequence joins that
+		// character instead of adding a column, so check again after padding.
+		for (int width = aLine.EndStop(mTabSize).mColumn; width < aColumn;
+			width = aLine.EndStop(mTabSize).mColumn) {
+			aLine.Insert(aLine.size(), static_cast<size_t>(aColumn - width),
+				' ', PaletteIndex::Default);
+		}
 	}
 
 	int TerminalData::GetCharacterIndex(const Coordinates& aCoordinates) const
@@ -564,18 +740,20 @@ namespace imterm {
 			|| static_cast<size_t>(aCoordinates.mLine) >= mLines.size()) {
 			return -1;
 		}
-		const Line& line = mLines[static_cast<size_t>(aCoordinates.mLine)];
-		int column = 0;
-		size_t index = 0;
+		const Line& storedLine = mLines[static_cast<size_t>(aCoordinates.mLine)];
+		const auto line = storedLine.GetBytes();
+		const ColumnStop stop = storedLine.StopAtColumn(aCoordinates.mColumn, mTabSize);
+		int column = stop.mColumn;
+		size_t index = stop.mByte;
 		while (index < line.size() && column < aCoordinates.mColumn) {
-			if (line[index].mChar == '\t') {
+			if (line[index] == '\t') {
 				column = (column / mTabSize) * mTabSize + mTabSize;
 			}
 			else {
 				++column;
 			}
 			index += static_cast<size_t>(UTF8CharLength(
-				line[index].mChar, line.size() - index));
+				line[index], line.size() - index));
 		}
 		return static_cast<int>(index);
 	}
@@ -585,12 +763,15 @@ namespace imterm {
 		if (aLine < 0 || static_cast<size_t>(aLine) >= mLines.size()) {
 			return 0;
 		}
-		const Line& line = mLines[static_cast<size_t>(aLine)];
-		int column = 0;
-		size_t index = 0;
+		const Line& storedLine = mLines[static_cast<size_t>(aLine)];
+		const auto line = storedLine.GetBytes();
+		const ColumnStop stop = storedLine.StopAtByte(
+			static_cast<size_t>(std::max(aIndex, 0)), mTabSize);
+		int column = stop.mColumn;
+		size_t index = stop.mByte;
 		while (index < static_cast<size_t>(std::max(aIndex, 0))
 			&& index < line.size()) {
-			const Char character = line[index].mChar;
+			const Char character = line[index];
 			index += static_cast<size_t>(UTF8CharLength(
 				character, line.size() - index));
 			if (character == '\t') {
@@ -608,13 +789,8 @@ namespace imterm {
 		if (aLine < 0 || static_cast<size_t>(aLine) >= mLines.size()) {
 			return 0;
 		}
-		const Line& line = mLines[static_cast<size_t>(aLine)];
-		int count = 0;
-		for (size_t index = 0; index < line.size(); ++count) {
-			index += static_cast<size_t>(UTF8CharLength(
-				line[index].mChar, line.size() - index));
-		}
-		return count;
+		return static_cast<int>(
+			mLines[static_cast<size_t>(aLine)].EndStop(mTabSize).mCharacter);
 	}
 
 	int TerminalData::GetLineMaxColumn(int aLine) const
@@ -622,20 +798,12 @@ namespace imterm {
 		if (aLine < 0 || static_cast<size_t>(aLine) >= mLines.size()) {
 			return 0;
 		}
-		const Line& line = mLines[static_cast<size_t>(aLine)];
-		int column = 0;
-		for (size_t index = 0; index < line.size();) {
-			const Char character = line[index].mChar;
-			if (character == '\t') {
-				column = (column / mTabSize) * mTabSize + mTabSize;
-			}
-			else {
-				++column;
-			}
-			index += static_cast<size_t>(UTF8CharLength(
-				character, line.size() - index));
-		}
-		return column;
+		return mLines[static_cast<size_t>(aLine)].EndStop(mTabSize).mColumn;
+	}
+
+	size_t TerminalData::GetApproximateMemoryUsage() const
+	{
+		return sizeof(*this) + mLines.GetHeapUsage() + mLines.GetLineHeapUsage();
 	}
 
 	void TerminalData::SetTabSize(int aValue)
@@ -2,14 +2,18 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <span>
+#include <utility>
 
 #include "terminal_types.h"
+#include "line_store.h"
 #include "coordinates.h"
 #include "terminal_coordinates.h"
 #include "terminal_logger.h"
@@ -30,13 +34,38 @@ namespace imterm {
 		size_t GetLineCount() const noexcept { return mLines.size(); }
 		size_t GetLineSize(size_t aIndex) const { return mLines.at(aIndex).size(); }
 
+		// Every line gets a serial number when it is created. Removing lines from
+		// the top of the buffer does not renumber the rest, so a serial keeps
+		// naming the same line while the scrollback is trimmed; line aIndex has
+		// serial GetFirstLineSerial() + aIndex.
+		uint64_t GetFirstLineSerial() const noexcept { return mFirstLineSerial; }
+
+		// A change tracker remembers the range of serials changed since its
+		// owner last asked, so a consumer such as the search index can catch up
+		// on edits without rescanning the buffer, and the view can tell whether
+		// the lines it shows changed. Inserting or removing a line changes it
+		// and every line after it, so the range then ends at UINT64_MAX;
+		// trimming lines from the top changes nothing that remains. Each line
+		// also carries the generation of its last change, see
+		// TerminalLine::GetGeneration().
+		struct ChangedSerials {
+			uint64_t mFirst;
+			// One past the last changed serial.
+			uint64_t mEnd;
+
+			bool operator==(const ChangedSerials&) const = default;
+		};
+		using ChangeTracker = size_t;
+		ChangeTracker AddChangeTracker();
+		void RemoveChangeTracker(ChangeTracker aTracker);
+		std::optional<ChangedSerials> TakeChangedSerials(ChangeTracker aTracker);
+		std::optional<uint64_t> TakeLowestChangedSerial(ChangeTracker aTracker);
+
 		void InsertLine(int aIndex);
 		void EnsureLineExists(size_t aIndex);
 
 		void SetReadOnly(bool aValue);
 		bool IsReadOnly() const { return mReadOnly; }
-		bool IsTextChanged() const { return mTextChanged; }
-		void SetTextChanged(bool aValue) { mTextChanged = aValue; }
 
 		void RemoveLine(int aStart, int aEnd);
 		void RemoveLine(int aIndex);
@@ -44,12 +73,19 @@ namespace imterm {
 		int InsertTextAt(Coordinates& aWhere, const char* aValue);
 		void SetText(const std::string& aText);
 		void SetTextLines(const std::vector<std::string>& aLines);
+		// Replaces the buffer with copies of aLines, keeping their colors and
+		// times, as when a replay restores a saved screen.
+		void SetLines(std::span<const Line> aLines);
 		std::vector<std::string> GetTextLines() const;
 		std::string GetText(const Coordinates& aStart, const Coordinates& aEnd) const;
 		std::string GetText() const;
 
 		void InputGlyph(size_t aLineIndex, int& aColumnIndex, PaletteIndex aPaletteIndex, uint8_t aValue);
 		void InputBytes(size_t aLineIndex, int& aColumnIndex, PaletteIndex aPaletteIndex, std::span<const uint8_t> aBytes);
+		// Writes a run of whole characters at successive columns, as if each had
+		// been passed to InputBytes() in turn, and advances aColumnIndex by the
+		// number of characters. aBytes must not contain tabs.
+		void InputCharacters(size_t aLineIndex, int& aColumnIndex, PaletteIndex aPaletteIndex, std::span<const uint8_t> aBytes);
 		void EraseBytes(size_t aLineIndex, size_t aStart, size_t aEnd);
 		void ReplaceBytesWithSpaces(size_t aLineIndex, size_t aStart, size_t aEnd);
 		void ReplaceLinePrefixWithSpaces(size_t aLineIndex, RenderedColumn aThroughColumn);
@@ -66,22 +102,72 @@ namespace imterm {
 		void SetTabSize(int aValue);
 		inline int GetTabSize() const { return mTabSize; }
 
+		// At least as many columns as the widest line written since the text
+		// was last replaced; kept as lines change, so it costs nothing to read
+		// each frame. Removing lines does not narrow it, and lines with tabs or
+		// multibyte characters may overstate it.
+		int GetWidestLineColumn() const noexcept { return mWidestLineColumn; }
+
+		// Lines changed while a receive time is set take it as their timestamp,
+		// so a batch of received bytes costs one clock read rather than one per
+		// change. Without one, each change reads the system clock.
+		void SetReceiveTime(std::optional<Line::Timestamp> aTime) noexcept { mReceiveTime = aTime; }
+		std::optional<Line::Timestamp> GetReceiveTime() const noexcept { return mReceiveTime; }
+
+		// Counts line changes; each changed line takes the next value as its
+		// TerminalLine::GetGeneration().
+		uint64_t GetGeneration() const noexcept { return mGeneration; }
+
+		// The buffer at one moment, for workers on other threads to search,
+		// export or index while the buffer keeps changing. Reading follows
+		// the rules of LineStore::Snapshot.
+		class Snapshot
+		{
+		public:
+			const LineStore::Snapshot& GetLines() const noexcept { return mLines; }
+			size_t GetLineCount() const noexcept { return mLines.size(); }
+			uint64_t GetFirstLineSerial() const noexcept { return mFirstLineSerial; }
+			uint64_t GetGeneration() const noexcept { return mGeneration; }
+
+			std::vector<std::string> GetTextLines() const;
+			// Each line followed by a newline, as TerminalData::GetText().
+			std::string GetText() const;
+
+		private:
+			friend class TerminalData;
+
+			LineStore::Snapshot mLines;
+			uint64_t mFirstLineSerial = 0;
+			uint64_t mGeneration = 0;
+		};
+
+		// Costs a copy of the last LineStore block; the other blocks are shared
+		// until they are next written.
+		std::shared_ptr<const Snapshot> TakeSnapshot();
+		// Takes a snapshot and makes it the one GetPublishedSnapshot() returns,
+		// so the owning thread can publish once per frame or batch while any
+		// number of readers pick up the latest. GetPublishedSnapshot() may be
+		// called from any thread; it returns nullptr before the first publish.
+		void PublishSnapshot();
+		std::shared_ptr<const Snapshot> GetPublishedSnapshot() const;
+
+		// Bytes held by the line buffer, including unused vector capacity. Walks
+		// every resident line, so it is meant for diagnostics rather than
+		// per-frame use. Lines spilled to disk are not counted.
+		size_t GetApproximateMemoryUsage() const;
+
+		// Keeps only the most recent lines in memory and pages older ones in
+		// from a file when they are read; see LineStore. Throws
+		// std::system_error if the file cannot be created.
+		void EnableSpill(LineStore::SpillOptions aOptions) { mLines.EnableSpill(std::move(aOptions)); }
+		std::optional<std::string> TakeSpillError() { return mLines.TakeSpillError(); }
+
 		//static int UTF8CharLength(Char c);
 		// https://en.wikipedia.org/wiki/UTF-8
 		// We assume that the char is a standalone character (<128) or a leading byte of an UTF-8 code sequence (non-10xxxxxx code)
 		static int UTF8CharLength(Char c)
 		{
-			if ((c & 0xFE) == 0xFC)
-				return 6;
-			if ((c & 0xFC) == 0xF8)
-				return 5;
-			if ((c & 0xF8) == 0xF0)
-				return 4;
-			else if ((c & 0xF0) == 0xE0)
-				return 3;
-			else if ((c & 0xE0) == 0xC0)
-				return 2;
-			return 1;
+			return UTF8SequenceLength(c);
 		}
 
 		static int UTF8CharLength(Char c, size_t available)
@@ -90,6 +176,18 @@ namespace imterm {
 				available, static_cast<size_t>(UTF8CharLength(c))));
 		}
 
+		// Number of characters in aBytes, splitting it the same way the column
+		// scans do.
+		static size_t UTF8CharCount(std::span<const Char> aBytes)
+		{
+			size_t count = 0;
+			for (size_t index = 0; index < aBytes.size(); ++count) {
+				index += static_cast<size_t>(UTF8CharLength(
+					aBytes[index], aBytes.size() - index));
+			}
+			return count;
+		}
+
 
 	private:
 		struct PendingLog {
@@ -97,11 +195,21 @@ namespace imterm {
 			int mLineNumber;
 		};
 
-		Lines mLines = Lines{Line()};
+		Lines mLines = Lines(1);
+		uint64_t mFirstLineSerial = 0;
+		// Changed serials per tracker; NoChange when nothing changed and
+		// nullopt for removed trackers.
+		static constexpr ChangedSerials NoChange{ UINT64_MAX, 0 };
+		std::vector<std::optional<ChangedSerials>> mChangeTrackers;
 
 		bool mReadOnly;
-		bool mTextChanged;
 		int mTabSize;
+		int mWidestLineColumn = 0;
+		uint64_t mGeneration = 0;
+		std::optional<Line::Timestamp> mReceiveTime;
+
+		mutable std::mutex mPublishedMutex;
+		std::shared_ptr<const Snapshot> mPublished;
 
 		std::shared_ptr<TerminalLogger> mLogger = nullptr;
 
@@ -111,7 +219,11 @@ namespace imterm {
 		void LogPendingLine(bool aLoggerIsClosing=false);
 		void ResetPendingLog(size_t aLineIndex = 0);
 		void AdjustPendingLogForRemoval(size_t aStart, size_t aEnd);
-		void Touch(Line& aLine) noexcept;
+		void Touch(Line& aLine, size_t aLineIndex) noexcept;
+		Line::Timestamp ChangeTime() const noexcept { return mReceiveTime ? *mReceiveTime : std::chrono::system_clock::now(); }
+		// With aThroughEnd, every line from aLineIndex on has changed.
+		void MarkChanged(size_t aLineIndex, bool aThroughEnd = false) noexcept;
+		void PadLineToColumn(Line& aLine, int aColumn);
 
 	};
 
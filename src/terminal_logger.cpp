@@ -1,8 +1,41 @@
 #include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "terminal_logger.h"
 
 namespace imterm {
 
+	namespace {
+
+		std::FILE* OpenForAppend(const std::filesystem::path& aPath)
+		{
+#if defined(_WIN32)
+			return _wfopen(aPath.c_str(), L"ab");
+#else
+			return std::fopen(aPath.c_str(), "ab");
+#endif
+		}
+
+		// Forces data the OS has accepted for aFile to the disk.
+		bool SyncToDisk(std::FILE* aFile)
+		{
+#if defined(_WIN32)
+			return _commit(_fileno(aFile)) == 0;
+#else
+			return fsync(fileno(aFile)) == 0;
+#endif
+		}
+
+	}
+
 	TerminalLogger::TerminalLogger() : TerminalLogger(true, "", ".log", GetDefaultLogPath(), Options()) { }
 
 	TerminalLogger::TerminalLogger(std::string aFileNamePostfix) : TerminalLogger(true, aFileNamePostfix, ".log", GetDefaultLogPath(), Options()) { }
@@ -87,6 +120,13 @@ namespace imterm {
 		}
 	}
 
+	void TerminalLogger::SetOptions(const Options& aOptions) {
+		if (aOptions.Asynchronous != mOptions.Asynchronous) {
+			Close();
+		}
+		mOptions = aOptions;
+	}
+
 	void TerminalLogger::SetUsePrefixTimestamp(bool aUsePrefixTimestamp) {
 		if (aUsePrefixTimestamp != mUsePrefixTimestamp) {
 			mUsePrefixTimestamp = aUsePrefixTimestamp;
@@ -147,17 +187,16 @@ namespace imterm {
 			}
 		}
 
-		try {
-			if (mOutput && mOutput->is_open()) {
-				mOutput->flush();
-				mOutput->close();
+		StopWriter();
+
+		if (mOutput) {
+			if (std::fflush(mOutput.get()) != 0) {
+				std::cerr << "TerminalLogger close failed\n";
 			}
-		}
-		catch (const std::exception& error) {
-			std::cerr << "TerminalLogger close failed: " << error.what() << '\n';
-		}
-		catch (...) {
-			std::cerr << "TerminalLogger close failed\n";
+			if (mOptions.DurabilityPolicy == Durability::SyncInterval) {
+				Sync(mOptions, true);
+			}
+			mOutput.reset();
 		}
 	}
 
@@ -174,54 +213,163 @@ namespace imterm {
 		} guard{mLogging};
 
 
-		if (!mOutput.get() || (mOutput.get() && !mOutput->is_open())) {
+		if (!mOutput) {
+			Open();
+		}
+		if (!mOutput) {
+			return;
+		}
 
-			mLogFilePath = mBasePath;
-			mLogFilePath /= ""; // Concatenate with an empty path to add a trailing slash
-			std::filesystem::create_directories(mLogFilePath);
-			if (mUsePrefixTimestamp) {
-				mLogFilePath += GetDateTimeNowString();
-				if (mFileNamePostfix != "") {
-					mLogFilePath += std::string("_");
-				}
+		Format(aLine, aLineNumber, mLineBuffer);
+		if (mWriter.joinable()) {
+			Enqueue(mLineBuffer);
+		}
+		else {
+			Write(mLineBuffer);
+			if (std::fflush(mOutput.get()) != 0) {
+				std::cerr << "TerminalLogger flush failed\n";
 			}
+			Sync(mOptions, false);
+		}
+	}
+
+	void TerminalLogger::Open() {
+		mLogFilePath = mBasePath;
+		mLogFilePath /= ""; // Concatenate with an empty path to add a trailing slash
+		std::filesystem::create_directories(mLogFilePath);
+		if (mUsePrefixTimestamp) {
+			mLogFilePath += GetDateTimeNowString();
 			if (mFileNamePostfix != "") {
-				mLogFilePath += mFileNamePostfix;
+				mLogFilePath += std::string("_");
 			}
-			mLogFilePath += mFileNameExtension;
+		}
+		if (mFileNamePostfix != "") {
+			mLogFilePath += mFileNamePostfix;
+		}
+		mLogFilePath += mFileNameExtension;
 
-			mOutput = std::make_unique<std::ofstream>(mLogFilePath, std::ios::app | std::ios::ate);
+		mOutput.reset(OpenForAppend(mLogFilePath));
+		if (!mOutput) {
+			return;
+		}
+		mUnsynced = false;
+		mLastSync = std::chrono::steady_clock::now();
 
+		if (mOptions.Asynchronous) {
+			mStopWriter = false;
+			mWriter = std::thread(&TerminalLogger::RunWriter, this, mOptions);
 		}
+	}
 
-		if (mOutput.get() && mOutput->is_open()) {
-			std::ostringstream oss;
+	void TerminalLogger::Format(const Line& aLine, int aLineNumber, std::string& aOutput) {
+		aOutput.clear();
 
-			if (mOptions.LineNumbers) {
-				oss << aLineNumber << " ";
+		if (mOptions.LineNumbers) {
+			aOutput += std::to_string(aLineNumber);
+			aOutput += ' ';
+		}
+
+		if (mOptions.TimeStamps) {
+			if (mOptions.TimeStampKind != LineTimestampKind::LastByte) {
+				mTimestampFormatter.Append(aLine.GetFirstTimestamp(), mOptions.TimeStampResolution, aOutput);
+				aOutput += ' ';
 			}
+			if (mOptions.TimeStampKind != LineTimestampKind::FirstByte) {
+				mTimestampFormatter.Append(aLine.GetTimestamp(), mOptions.TimeStampResolution, aOutput);
+				aOutput += ' ';
+			}
+		}
 
-			if (mOptions.TimeStamps) {
-				std::time_t time_t_timestamp = std::chrono::system_clock::to_time_t(aLine.GetTimestamp());
-				std::tm* time_tm_timestamp = std::localtime(&time_t_timestamp);
-				if (time_tm_timestamp) {
-					oss << std::put_time(time_tm_timestamp, "%H:%M:%S ");
-				}
-				else {
-					oss << "00:00:00";
-				}
+		const auto bytes = aLine.GetBytes();
+		aOutput.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		aOutput += '\n';
+	}
+
+	void TerminalLogger::Enqueue(std::string_view aText) {
+		std::unique_lock lock(mQueueMutex);
+		// A line longer than the whole queue is still accepted once the queue
+		// is empty.
+		mQueueDrained.wait(lock, [this, &aText] {
+			return mQueue.empty() || mQueue.size() + aText.size() <= mOptions.QueueCapacity;
+		});
+		if (mQueue.empty()) {
+			mQueuedSince = std::chrono::steady_clock::now();
+		}
+		mQueue.append(aText);
+		lock.unlock();
+		mQueueFilled.notify_one();
+	}
+
+	void TerminalLogger::RunWriter(Options aSettings) {
+		std::string group;
+		std::unique_lock lock(mQueueMutex);
+
+		while (!mStopWriter || !mQueue.empty()) {
+			const auto hasWork = [this] { return mStopWriter || !mQueue.empty(); };
+			if (mUnsynced && aSettings.DurabilityPolicy == Durability::SyncInterval) {
+				mQueueFilled.wait_until(lock, mLastSync + aSettings.SyncInterval, hasWork);
+			}
+			else {
+				mQueueFilled.wait(lock, hasWork);
 			}
 
-			if (aLine.size() > 0) {
-				for (Glyph g : aLine) {
-					oss << g.mChar;
+			if (!mStopWriter && !mQueue.empty() && mQueue.size() < aSettings.GroupCommitBytes) {
+				mQueueFilled.wait_until(lock, mQueuedSince + aSettings.GroupCommitInterval, [this, &aSettings] {
+					return mStopWriter || mQueue.size() >= aSettings.GroupCommitBytes;
+				});
+			}
+
+			group.swap(mQueue);
+			lock.unlock();
+			mQueueDrained.notify_all();
+
+			if (!group.empty()) {
+				Write(group);
+				group.clear();
+				if (std::fflush(mOutput.get()) != 0) {
+					std::cerr << "TerminalLogger flush failed\n";
 				}
 			}
+			Sync(aSettings, false);
 
-			*mOutput.get() << oss.str() << "\n";
-			mOutput->flush();
+			lock.lock();
 		}
+	}
+
+	void TerminalLogger::StopWriter() noexcept {
+		if (!mWriter.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard lock(mQueueMutex);
+			mStopWriter = true;
+		}
+		mQueueFilled.notify_one();
+		mWriter.join();
+	}
 
+	void TerminalLogger::Write(std::string_view aText) {
+		if (std::fwrite(aText.data(), 1, aText.size(), mOutput.get()) != aText.size()) {
+			std::cerr << "TerminalLogger write failed: " << mLogFilePath.string() << '\n';
+		}
+		mUnsynced = true;
+	}
+
+	// Syncs the file when aSettings' durability policy asks for it, or always
+	// with aForce.
+	void TerminalLogger::Sync(const Options& aSettings, bool aForce) {
+		if (!mUnsynced) {
+			return;
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if (!aForce && (aSettings.DurabilityPolicy != Durability::SyncInterval || now < mLastSync + aSettings.SyncInterval)) {
+			return;
+		}
+		if (!SyncToDisk(mOutput.get())) {
+			std::cerr << "TerminalLogger sync failed: " << mLogFilePath.string() << '\n';
+		}
+		mUnsynced = false;
+		mLastSync = now;
 	}
 
 }
@@ -2,14 +2,22 @@
 
 #include <filesystem>
 #include <iostream>
-#include <fstream>
+#include <cstdio>
 #include <chrono>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
 #include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include "terminal_types.h"
+#include "timestamp_formatter.h"
 
 namespace imterm {
 
@@ -22,10 +30,34 @@ namespace imterm {
 
 
 
+		// When logged lines are forced from the OS to the disk.
+		enum class Durability {
+			// Only when the log is closed.
+			FlushOnClose,
+			// Also no later than SyncInterval after a line is written.
+			SyncInterval
+		};
+
 		struct Options {
 			bool Enabled = true;
 			bool LineNumbers = true;
 			bool TimeStamps = true;
+			TimestampResolution TimeStampResolution = TimestampResolution::Seconds;
+			LineTimestampKind TimeStampKind = LineTimestampKind::LastByte;
+
+			// Write from a background thread. Log() only formats the line and
+			// queues it, and the writer commits queued lines in groups. Without
+			// it every line is written and flushed before Log() returns.
+			bool Asynchronous = false;
+			// Log() blocks while this many bytes are waiting to be written.
+			size_t QueueCapacity = 4 << 20;
+			// A group is committed once this many bytes are queued, or when the
+			// oldest queued line has waited GroupCommitInterval.
+			size_t GroupCommitBytes = 64 << 10;
+			std::chrono::milliseconds GroupCommitInterval{ 100 };
+
+			Durability DurabilityPolicy = Durability::FlushOnClose;
+			std::chrono::milliseconds SyncInterval{ 1000 };
 		};
 
 		TerminalLogger();
@@ -44,7 +76,9 @@ namespace imterm {
 		void Log(const Line& aLine, int aLineNumber);
 
 		inline Options GetOptions() { return mOptions; }
-		void SetOptions(const Options& aOptions) { mOptions = aOptions; }
+		// The writer settings of an open log file keep their values until the
+		// file is closed; changing Asynchronous closes it.
+		void SetOptions(const Options& aOptions);
 
 		inline bool GetUsePrefixTimestamp() { return mUsePrefixTimestamp; }
 		void SetUsePrefixTimestamp(bool aUsePrefixTimestamp);
@@ -66,10 +100,24 @@ namespace imterm {
 
 		bool DeregisterLogClosingWatcher(WatcherToken aToken);
 
+		// Notifies the log-closing watchers, waits for queued lines to be
+		// written, then flushes and closes the file.
 		void Close() noexcept;
 
 	private:
 
+		struct FileCloser {
+			void operator()(std::FILE* aFile) const noexcept { std::fclose(aFile); }
+		};
+
+		void Open();
+		void Format(const Line& aLine, int aLineNumber, std::string& aOutput);
+		void Enqueue(std::string_view aText);
+		void RunWriter(Options aSettings);
+		void StopWriter() noexcept;
+		void Write(std::string_view aText);
+		void Sync(const Options& aSettings, bool aForce);
+
 		bool mUsePrefixTimestamp = true;
 		std::string mFileNamePostfix;
 		std::string mFileNameExtension;
@@ -77,11 +125,25 @@ namespace imterm {
 
 		std::filesystem::path mLogFilePathPending;
 		std::filesystem::path mLogFilePath;
-		//std::ofstream * mLogger;
-		std::unique_ptr<std::ofstream> mOutput = nullptr;
+		std::unique_ptr<std::FILE, FileCloser> mOutput = nullptr;
+		std::string mLineBuffer;
+		TimestampFormatter mTimestampFormatter;
+		// Bytes written since the last sync, and when that sync happened.
+		bool mUnsynced = false;
+		std::chrono::steady_clock::time_point mLastSync;
 
 		Options mOptions;
 
+		// Asynchronous mode. mQueue holds preformatted lines; the writer swaps
+		// it with its own buffer, so both keep their capacity between groups.
+		std::thread mWriter;
+		std::mutex mQueueMutex;
+		std::condition_variable mQueueFilled;
+		std::condition_variable mQueueDrained;
+		std::string mQueue;
+		std::chrono::steady_clock::time_point mQueuedSince;
+		bool mStopWriter = false;
+
 		//bool mNewLogFile = true;
 
 		struct LogClosingWatcher {
@@ -0,0 +1,486 @@
+#include "terminal_search.h"
+
+#include <algorithm>
+#include <cctype>
+#include <regex>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace imterm {
+
+	namespace {
+
+		char FoldAscii(char aValue)
+		{
+			return aValue >= 'A' && aValue <= 'Z'
+				? static_cast<char>(aValue - 'A' + 'a')
+				: aValue;
+		}
+
+		// Bit for the trigram starting at aText. Summaries are built from
+		// folded text, so one summary serves both case modes.
+		size_t TrigramBit(const char* aText, size_t aBits)
+		{
+			const uint32_t trigram =
+				static_cast<uint32_t>(static_cast<uint8_t>(FoldAscii(aText[0]))) << 16
+				| static_cast<uint32_t>(static_cast<uint8_t>(FoldAscii(aText[1]))) << 8
+				| static_cast<uint32_t>(static_cast<uint8_t>(FoldAscii(aText[2])));
+			return static_cast<size_t>((trigram * 2654435761U) >> 8) % aBits;
+		}
+
+		// Horspool search for a literal, optionally folding ASCII case.
+		class LiteralFinder {
+
+		public:
+
+			LiteralFinder() = default;
+
+			LiteralFinder(std::string_view aNeedle, bool aFold)
+				: mNeedle(aNeedle), mFold(aFold)
+			{
+				if (mFold) {
+					std::transform(mNeedle.begin(), mNeedle.end(), mNeedle.begin(), FoldAscii);
+				}
+				mSkip.fill(std::max<size_t>(mNeedle.size(), 1));
+				for (size_t i = 0; i + 1 < mNeedle.size(); ++i) {
+					mSkip[static_cast<uint8_t>(mNeedle[i])] = mNeedle.size() - 1 - i;
+				}
+			}
+
+			bool Empty() const { return mNeedle.empty(); }
+			size_t Size() const { return mNeedle.size(); }
+			const std::string& GetNeedle() const { return mNeedle; }
+
+			// Offset of the first occurrence in aText at or after aFrom.
+			size_t Find(std::string_view aText, size_t aFrom) const
+			{
+				const size_t length = mNeedle.size();
+				if (length == 0 || aText.size() < length) {
+					return std::string_view::npos;
+				}
+				for (size_t position = aFrom; position <= aText.size() - length;) {
+					const char last = Fold(aText[position + length - 1]);
+					if (last == mNeedle[length - 1]) {
+						size_t i = 0;
+						while (i + 1 < length && Fold(aText[position + i]) == mNeedle[i]) {
+							++i;
+						}
+						if (i + 1 >= length) {
+							return position;
+						}
+					}
+					position += mSkip[static_cast<uint8_t>(last)];
+				}
+				return std::string_view::npos;
+			}
+
+		private:
+
+			char Fold(char aValue) const { return mFold ? FoldAscii(aValue) : aValue; }
+
+			std::string mNeedle;
+			bool mFold = false;
+			std::array<size_t, 256> mSkip{};
+		};
+
+		// The longest run of literal text that every match of aPattern must
+		// contain, or an empty string when that cannot be worked out cheaply.
+		// Only text outside groups and classes is considered, and a pattern
+		// with alternation has none.
+		std::string RequiredLiteral(std::string_view aPattern)
+		{
+			if (aPattern.find('|') != std::string_view::npos) {
+				return {};
+			}
+
+			std::string best;
+			std::string current;
+			const auto endRun = [&] {
+				if (current.size() > best.size()) {
+					best = current;
+				}
+				current.clear();
+			};
+
+			int depth = 0;
+			for (size_t i = 0; i < aPattern.size(); ++i) {
+				const char value = aPattern[i];
+				char literal = value;
+				switch (value) {
+				case '\\':
+					if (i + 1 >= aPattern.size()) {
+						return {};
+					}
+					literal = aPattern[++i];
+					if (std::isalnum(static_cast<unsigned char>(literal))) {
+						// Class escapes stand for many characters; others such
+						// as \x41 or \1 are not worth decoding.
+						if (std::string_view("dDwWsSbB").find(literal) == std::string_view::npos) {
+							return {};
+						}
+						endRun();
+						continue;
+					}
+					break;
+				case '[':
+					endRun();
+					if (i + 1 < aPattern.size() && aPattern[i + 1] == '^') {
+						++i;
+					}
+					if (i + 1 < aPattern.size() && aPattern[i + 1] == ']') {
+						++i;
+					}
+					while (++i < aPattern.size() && aPattern[i] != ']') {
+						if (aPattern[i] == '\\') {
+							++i;
+						}
+					}
+					continue;
+				case '(':
+					++depth;
+					endRun();
+					continue;
+				case ')':
+					--depth;
+					endRun();
+					continue;
+				case '.':
+				case '^':
+				case '$':
+				case '+':
+					// After '+' the previous character is still required once.
+					endRun();
+					continue;
+				case '*':
+				case '?':
+				case '{':
+					// The previous character may be absent.
+					if (!current.empty()) {
+						current.pop_back();
+					}
+					endRun();
+					if (value == '{') {
+						while (i + 1 < aPattern.size() && aPattern[i] != '}') {
+							++i;
+						}
+					}
+					continue;
+				default:
+					break;
+				}
+				if (depth == 0) {
+					current.push_back(literal);
+				}
+			}
+			endRun();
+			return best;
+		}
+
+	}
+
+	struct TerminalSearch::Run {
+		std::shared_ptr<const TerminalData::Snapshot> mSnapshot;
+		std::vector<std::shared_ptr<const Chunk>> mChunks;
+		uint64_t mLinesTotal = 0;
+
+		LiteralFinder mLiteral;             // the query, or a literal every regex match contains
+		std::optional<std::regex> mRegex;
+		std::vector<size_t> mTrigramBits;   // bits every chunk holding a match has set
+
+		std::atomic<bool> mCancel{ false };
+		std::atomic<bool> mFinished{ false };
+		std::atomic<uint64_t> mLinesSearched{ 0 };
+
+		mutable std::mutex mMutex;
+		std::vector<Match> mMatches;
+	};
+
+	TerminalSearch::TerminalSearch(std::shared_ptr<TerminalData> aData)
+		: mData(std::move(aData))
+	{
+		if (!mData) {
+			throw std::invalid_argument("TerminalSearch requires terminal data");
+		}
+		mTracker = mData->AddChangeTracker();
+		Reopen(mData->GetFirstLineSerial());
+	}
+
+	TerminalSearch::~TerminalSearch()
+	{
+		Cancel();
+		mData->RemoveChangeTracker(mTracker);
+	}
+
+	void TerminalSearch::Reopen(uint64_t aFirstSerial)
+	{
+		mOpenFirstSerial = aFirstSerial;
+		mOpenLineEnds.clear();
+		mIndexedEnd = aFirstSerial;
+	}
+
+	void TerminalSearch::Truncate(uint64_t aSerial)
+	{
+		if (aSerial >= mIndexedEnd) {
+			return;
+		}
+
+		if (aSerial < mOpenFirstSerial) {
+			// Drop the sealed chunk that holds aSerial and the ones after it;
+			// the lines of that chunk before aSerial are indexed again.
+			const auto holder = std::upper_bound(mSealed.begin(), mSealed.end(), aSerial,
+				[](uint64_t aValue, const std::shared_ptr<const Chunk>& aChunk) {
+					return aValue < aChunk->mFirstSerial;
+				});
+			const uint64_t first = holder == mSealed.begin() ? aSerial : (*std::prev(holder))->mFirstSerial;
+			mSealed.erase(holder == mSealed.begin() ? holder : std::prev(holder), mSealed.end());
+			Reopen(first);
+			return;
+		}
+
+		mOpenLineEnds.resize(static_cast<size_t>(aSerial - mOpenFirstSerial));
+		mIndexedEnd = aSerial;
+	}
+
+	void TerminalSearch::Seal()
+	{
+		auto chunk = std::make_shared<Chunk>();
+		chunk->mFirstSerial = mOpenFirstSerial;
+		chunk->mEndSerial = mIndexedEnd;
+
+		const TerminalData& data = *mData;
+		const uint64_t first = data.GetFirstLineSerial();
+		// The top of the chunk may have been trimmed already.
+		for (uint64_t serial = std::max(mOpenFirstSerial, first); serial < mIndexedEnd; ++serial) {
+			const auto bytes = data.GetLine(static_cast<size_t>(serial - first)).GetBytes();
+			const char* text = reinterpret_cast<const char*>(bytes.data());
+			for (size_t i = 0; i + 2 < bytes.size(); ++i) {
+				const size_t bit = TrigramBit(text + i, SummaryBits);
+				chunk->mSummary[bit / 64] |= uint64_t{ 1 } << (bit % 64);
+			}
+		}
+		mSealed.push_back(std::move(chunk));
+		Reopen(mIndexedEnd);
+	}
+
+	void TerminalSearch::ApplyChanges()
+	{
+		const uint64_t first = mData->GetFirstLineSerial();
+		const uint64_t end = first + mData->GetLineCount();
+
+		if (const auto changed = mData->TakeLowestChangedSerial(mTracker)) {
+			Truncate(*changed);
+		}
+		if (mIndexedEnd > end) {
+			Truncate(end);
+		}
+
+		// Forget lines trimmed from the top of the scrollback.
+		while (!mSealed.empty() && mSealed.front()->mEndSerial <= first) {
+			mSealed.pop_front();
+		}
+		if (mIndexedEnd < first) {
+			mSealed.clear();
+			Reopen(first);
+		}
+	}
+
+	bool TerminalSearch::Update(size_t aLineBudget)
+	{
+		ApplyChanges();
+
+		const TerminalData& data = *mData;
+		const uint64_t first = data.GetFirstLineSerial();
+		const uint64_t end = first + data.GetLineCount();
+		for (; mIndexedEnd < end && aLineBudget > 0; --aLineBudget) {
+			const size_t bytes = data.GetLine(static_cast<size_t>(mIndexedEnd - first)).GetBytes().size();
+			mOpenLineEnds.push_back((mOpenLineEnds.empty() ? 0 : mOpenLineEnds.back()) + bytes);
+			++mIndexedEnd;
+			if (mOpenLineEnds.size() == ChunkLines || mOpenLineEnds.back() >= ChunkBytes) {
+				Seal();
+			}
+		}
+		return mIndexedEnd == end;
+	}
+
+	void TerminalSearch::Start(const Query& aQuery)
+	{
+		Cancel();
+
+		auto run = std::make_shared<Run>();
+		const bool fold = !aQuery.mCaseSensitive;
+		if (aQuery.mRegex && !aQuery.mText.empty()) {
+			auto flags = std::regex::ECMAScript | std::regex::optimize;
+			if (fold) {
+				flags |= std::regex::icase;
+			}
+			run->mRegex.emplace(aQuery.mText, flags);
+			run->mLiteral = LiteralFinder(RequiredLiteral(aQuery.mText), fold);
+		}
+		else {
+			run->mLiteral = LiteralFinder(aQuery.mText, fold);
+		}
+
+		const std::string& literal = run->mLiteral.GetNeedle();
+		for (size_t i = 0; i + 2 < literal.size(); ++i) {
+			run->mTrigramBits.push_back(TrigramBit(literal.data() + i, SummaryBits));
+		}
+
+		if (!aQuery.mText.empty()) {
+			// The summaries must describe the lines the snapshot holds.
+			ApplyChanges();
+			mData->PublishSnapshot();
+			run->mSnapshot = mData->GetPublishedSnapshot();
+			run->mChunks.assign(mSealed.begin(), mSealed.end());
+			run->mLinesTotal = run->mSnapshot->GetLineCount();
+		}
+
+		mRun = run;
+		mThread = std::thread([run] { Search(*run); });
+	}
+
+	void TerminalSearch::Cancel()
+	{
+		if (mRun) {
+			mRun->mCancel.store(true, std::memory_order_relaxed);
+		}
+		if (mThread.joinable()) {
+			mThread.join();
+		}
+		mRun.reset();
+	}
+
+	void TerminalSearch::Search(Run& aRun)
+	{
+		if (!aRun.mSnapshot) {
+			aRun.mFinished.store(true, std::memory_order_release);
+			return;
+		}
+
+		const TerminalData::Snapshot& snapshot = *aRun.mSnapshot;
+		const uint64_t first = snapshot.GetFirstLineSerial();
+		const uint64_t end = first + snapshot.GetLineCount();
+		auto chunk = aRun.mChunks.begin();
+		std::vector<Match> found;
+
+		const auto searchLine = [&](uint64_t aSerial, std::string_view aLine) {
+			size_t position = aRun.mLiteral.Find(aLine, 0);
+			if (!aRun.mRegex) {
+				for (; position != std::string_view::npos;
+					position = aRun.mLiteral.Find(aLine, position + aRun.mLiteral.Size())) {
+					found.push_back(Match{ aSerial, static_cast<uint32_t>(position),
+						static_cast<uint32_t>(aRun.mLiteral.Size()) });
+				}
+				return;
+			}
+
+			if (!aRun.mLiteral.Empty() && position == std::string_view::npos) {
+				return;
+			}
+			for (std::cregex_iterator match(aLine.data(), aLine.data() + aLine.size(), *aRun.mRegex), last;
+				match != last; ++match) {
+				if (match->length() > 0) {
+					found.push_back(Match{ aSerial, static_cast<uint32_t>(match->position()),
+						static_cast<uint32_t>(match->length()) });
+				}
+			}
+		};
+
+		for (uint64_t serial = first; serial < end;) {
+			if (aRun.mCancel.load(std::memory_order_relaxed)) {
+				break;
+			}
+
+			while (chunk != aRun.mChunks.end() && (*chunk)->mEndSerial <= serial) {
+				++chunk;
+			}
+			uint64_t stop;
+			bool mayMatch = true;
+			if (chunk != aRun.mChunks.end() && (*chunk)->mFirstSerial <= serial) {
+				stop = std::min((*chunk)->mEndSerial, end);
+				mayMatch = std::all_of(aRun.mTrigramBits.begin(), aRun.mTrigramBits.end(), [&](size_t aBit) {
+					return ((*chunk)->mSummary[aBit / 64] >> (aBit % 64)) & 1;
+				});
+			}
+			else {
+				// Lines without a summary yet, searched a chunk at a time.
+				stop = std::min<uint64_t>(end, serial + ChunkLines);
+				if (chunk != aRun.mChunks.end()) {
+					stop = std::min(stop, (*chunk)->mFirstSerial);
+				}
+			}
+
+			if (mayMatch) {
+				snapshot.GetLines().ForEach(static_cast<size_t>(serial - first), static_cast<size_t>(stop - first),
+					[&](size_t aIndex, const Line& aLine) {
+						const auto bytes = aLine.GetBytes();
+						searchLine(first + aIndex, std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+					});
+			}
+
+			if (!found.empty()) {
+				std::lock_guard lock(aRun.mMutex);
+				aRun.mMatches.insert(aRun.mMatches.end(), found.begin(), found.end());
+				found.clear();
+			}
+			aRun.mLinesSearched.fetch_add(stop - serial, std::memory_order_relaxed);
+			serial = stop;
+		}
+		aRun.mFinished.store(true, std::memory_order_release);
+	}
+
+	TerminalSearch::Progress TerminalSearch::GetProgress() const
+	{
+		Progress progress;
+		if (!mRun) {
+			return progress;
+		}
+		progress.mFinished = mRun->mFinished.load(std::memory_order_acquire);
+		progress.mLinesSearched = mRun->mLinesSearched.load(std::memory_order_relaxed);
+		progress.mLinesTotal = mRun->mLinesTotal;
+		std::lock_guard lock(mRun->mMutex);
+		progress.mMatches = mRun->mMatches.size();
+		return progress;
+	}
+
+	void TerminalSearch::GetMatches(uint64_t aFirstSerial, uint64_t aEndSerial, std::vector<Match>& aMatches) const
+	{
+		if (!mRun) {
+			return;
+		}
+		std::lock_guard lock(mRun->mMutex);
+		const auto& matches = mRun->mMatches;
+		auto match = std::lower_bound(matches.begin(), matches.end(), aFirstSerial,
+			[](const Match& aMatch, uint64_t aSerial) { return aMatch.mLineSerial < aSerial; });
+		for (; match != matches.end() && match->mLineSerial < aEndSerial; ++match) {
+			aMatches.push_back(*match);
+		}
+	}
+
+	std::optional<TerminalSearch::Match> TerminalSearch::FindNext(uint64_t aLineSerial, uint32_t aByte, bool aForward) const
+	{
+		if (!mRun) {
+			return std::nullopt;
+		}
+		std::lock_guard lock(mRun->mMutex);
+		const auto& matches = mRun->mMatches;
+		if (matches.empty()) {
+			return std::nullopt;
+		}
+
+		const auto before = [](const Match& aMatch, const std::pair<uint64_t, uint32_t>& aPosition) {
+			return std::pair(aMatch.mLineSerial, aMatch.mStart) < aPosition;
+		};
+		const std::pair position(aLineSerial, aByte);
+		if (aForward) {
+			auto next = std::lower_bound(matches.begin(), matches.end(), position, before);
+			if (next != matches.end() && std::pair(next->mLineSerial, next->mStart) == position) {
+				++next;
+			}
+			return next == matches.end() ? matches.front() : *next;
+		}
+		const auto next = std::lower_bound(matches.begin(), matches.end(), position, before);
+		return next == matches.begin() ? matches.back() : *std::prev(next);
+	}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "terminal_data.h"
+
+namespace imterm {
+
+	// Text search over the whole scrollback.
+	//
+	// The search reads the buffer itself and keeps only an index of it: the
+	// scrollback is split into chunks of up to ChunkLines lines, and Update()
+	// on the UI thread gives each full chunk a trigram summary, a bit set of
+	// hashed three-byte sequences, so a query can skip chunks that cannot
+	// contain it. A summarized chunk never changes; an edit drops the
+	// summaries from the changed line on, and Update() builds them again.
+	//
+	// Start() publishes a TerminalData::Snapshot and runs the query on a
+	// worker thread against it and the summaries. The terminal keeps
+	// receiving while it runs, the results describe one consistent state of
+	// the buffer, and matches are published oldest first as each chunk is
+	// searched. Lines not summarized yet are searched without skipping.
+	//
+	// Lines are named by serial (see TerminalData::GetFirstLineSerial()).
+	// Matches never span lines, and case-insensitive matching folds ASCII
+	// letters only.
+	class TerminalSearch {
+
+	public:
+
+		static constexpr size_t ChunkLines = 1024;
+		// A chunk is also summarized early once it holds this much text.
+		static constexpr size_t ChunkBytes = 1 << 20;
+		// Lines indexed per Update() by default, a few milliseconds of work
+		// when catching up on a large buffer.
+		static constexpr size_t DefaultUpdateBudget = 64 * 1024;
+
+		struct Query {
+			std::string mText;
+			bool mRegex = false;
+			bool mCaseSensitive = false;
+		};
+
+		struct Match {
+			uint64_t mLineSerial;
+			uint32_t mStart;   // byte offset in the line
+			uint32_t mLength;  // in bytes, never zero
+
+			friend bool operator==(const Match&, const Match&) = default;
+		};
+
+		struct Progress {
+			uint64_t mLinesSearched = 0;
+			uint64_t mLinesTotal = 0;
+			size_t mMatches = 0;
+			bool mFinished = true;
+		};
+
+		explicit TerminalSearch(std::shared_ptr<TerminalData> aData);
+		~TerminalSearch();
+
+		TerminalSearch(const TerminalSearch&) = delete;
+		TerminalSearch& operator=(const TerminalSearch&) = delete;
+
+		// UI thread. Applies edits made since the last call and indexes at
+		// most aLineBudget new lines. Returns true once the index covers every
+		// line of the buffer.
+		bool Update(size_t aLineBudget = DefaultUpdateBudget);
+
+		// UI thread. Cancels any running search and starts aQuery against the
+		// whole buffer as it is now. It skips only chunks the index already
+		// summarizes, so call Update() until it returns true first for the
+		// fastest search. An empty query finds nothing. Throws
+		// std::regex_error if a regex query is not a valid ECMAScript pattern.
+		void Start(const Query& aQuery);
+
+		// Stops the running search and discards its results.
+		void Cancel();
+
+		Progress GetProgress() const;
+
+		// Appends the matches found so far on lines with serials in
+		// [aFirstSerial, aEndSerial), in order.
+		void GetMatches(uint64_t aFirstSerial, uint64_t aEndSerial, std::vector<Match>& aMatches) const;
+
+		// The first match after (or, with aForward false, the last match
+		// before) byte aByte of line aLineSerial, wrapping around at either
+		// end of the results found so far.
+		std::optional<Match> FindNext(uint64_t aLineSerial, uint32_t aByte, bool aForward) const;
+
+	private:
+
+		static constexpr size_t SummaryBits = 1 << 15;
+
+		// The summary of the lines with serials [mFirstSerial, mEndSerial).
+		struct Chunk {
+			uint64_t mFirstSerial = 0;
+			uint64_t mEndSerial = 0;
+			std::array<uint64_t, SummaryBits / 64> mSummary{};
+		};
+
+		struct Run;
+
+		// Drops the index from the lowest changed line on, and the chunks
+		// trimmed from the top of the buffer.
+		void ApplyChanges();
+		void Truncate(uint64_t aSerial);
+		void Seal();
+		void Reopen(uint64_t aFirstSerial);
+		static void Search(Run& aRun);
+
+		std::shared_ptr<TerminalData> mData;
+		TerminalData::ChangeTracker mTracker;
+
+		std::deque<std::shared_ptr<const Chunk>> mSealed;
+		// Lines indexed after the last sealed chunk, summarized once there are
+		// enough of them. mOpenLineEnds keeps the running total of their bytes
+		// for ChunkBytes.
+		uint64_t mOpenFirstSerial = 0;
+		std::vector<size_t> mOpenLineEnds;
+		uint64_t mIndexedEnd = 0;  // serial after the last indexed line
+
+		std::shared_ptr<Run> mRun;
+		std::thread mThread;
+	};
+
+}
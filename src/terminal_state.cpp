@@ -1,9 +1,14 @@
 #include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
 #include <cstddef>
 #include <future>
 #include <limits>
+#include <optional>
 #include <span>
 #include <stdexcept>
+#include <string_view>
 
 //#include "imgui.h"
 #include "terminal_state.h"
@@ -11,6 +16,43 @@
 
 namespace imterm {
 
+    namespace {
+
+        // Number of tokens TerminalState::Input() takes from the parser per
+        // call. A batch also ends at each completed sequence.
+        constexpr size_t TokenBatchSize = 64;
+
+        // Counts the characters of aText the way TerminalData splits them.
+        // With aHoldPartial set, a final UTF-8 sequence cut off by the end of
+        // aText is left out. Returns the number of bytes counted.
+        size_t CountCharacters(std::span<const uint8_t> aText, bool aHoldPartial, size_t& aCharacters)
+        {
+            size_t characters = 0;
+            size_t index = 0;
+            while (index < aText.size()) {
+                if (aText[index] < 0x80) {
+                    ++index;
+                    ++characters;
+                    continue;
+                }
+                const size_t remaining = aText.size() - index;
+                size_t length = static_cast<size_t>(
+                    TerminalData::UTF8CharLength(aText[index]));
+                if (length > remaining) {
+                    if (aHoldPartial) {
+                        break;
+                    }
+                    length = remaining;
+                }
+                index += length;
+                ++characters;
+            }
+            aCharacters = characters;
+            return index;
+        }
+
+    }
+
     TerminalGraphicsState::TerminalGraphicsState() : mState(0)
     {
     }
@@ -98,7 +140,7 @@ namespace imterm {
         return mState;
     }
 
-    uint32_t TerminalGraphicsState::Update(const std::vector<int>& aCommandData)
+    uint32_t TerminalGraphicsState::Update(std::span<const int> aCommandData)
     {
         for (int item : aCommandData) {
             {
@@ -157,6 +199,25 @@ namespace imterm {
             mCursorPosition.mRow, 0, mViewportSize.mRows - 1);
     }
 
+    TerminalState::Snapshot TerminalState::TakeSnapshot() const
+    {
+        return Snapshot{
+            mViewportSize, mCursorPosition, mSavedCursorPosition, mGraphics,
+            mNewLineMode, mAnsiEscSeqParser, mPendingUtf8};
+    }
+
+    void TerminalState::RestoreSnapshot(const Snapshot& aSnapshot)
+    {
+        mViewportSize = aSnapshot.mViewportSize;
+        mCursorPosition = aSnapshot.mCursorPosition;
+        mSavedCursorPosition = aSnapshot.mSavedCursorPosition;
+        mGraphics = aSnapshot.mGraphics;
+        mNewLineMode = aSnapshot.mNewLineMode;
+        mAnsiEscSeqParser = aSnapshot.mParser;
+        mPendingUtf8 = aSnapshot.mPendingUtf8;
+        mQueuedTerminalOutput.clear();
+    }
+
     size_t TerminalState::GetViewportTopBufferRow(size_t aTotalLines) const
     {
         const size_t viewportRows = static_cast<size_t>(mViewportSize.mRows);
@@ -332,16 +393,27 @@ namespace imterm {
     TerminalState::CommandResult TerminalState::ApplyCommand(
         const RequestStatusReport& aCommand)
     {
-        std::string output;
+        // Appended in place; the queue keeps its storage between replies.
+        auto& output = mQueuedTerminalOutput;
+        const auto append = [&output](std::string_view aText) {
+            output.insert(output.end(), aText.begin(), aText.end());
+        };
+        const auto appendNumber = [&output](int aValue) {
+            std::array<char, 20> digits;
+            char* end = std::to_chars(digits.data(), digits.data() + digits.size(), aValue).ptr;
+            output.insert(output.end(), digits.data(), end);
+        };
+
         if (aCommand.mKind == RequestStatusReport::Kind::DeviceStatus) {
-            output = "\x1b[0n";
+            append("\x1b[0n");
         }
         else {
-            output = "\x1b[" + std::to_string(mCursorPosition.mRow + 1)
-                + ";" + std::to_string(mCursorPosition.mColumn + 1) + "R";
+            append("\x1b[");
+            appendNumber(mCursorPosition.mRow + 1);
+            append(";");
+            appendNumber(mCursorPosition.mColumn + 1);
+            append("R");
         }
-        mQueuedTerminalOutput.push(
-            std::vector<uint8_t>(output.begin(), output.end()));
         return CommandResult::Applied;
     }
 
@@ -350,11 +422,9 @@ namespace imterm {
         if (mQueuedTerminalOutput.empty()) {
             throw std::underflow_error("No terminal output to get. Check TerminalOutputAvailable() before calling.");
         }
-        else {
-            auto item = mQueuedTerminalOutput.front();
-            mQueuedTerminalOutput.pop();
-            return item;
-        }
+        std::vector<uint8_t> output;
+        output.swap(mQueuedTerminalOutput);
+        return output;
     }
 
     bool TerminalState::TerminalOutputAvailable()
@@ -363,15 +433,18 @@ namespace imterm {
     }
 
 
-    void TerminalState::InputPrintableByte(uint8_t value)
+    size_t TerminalState::CursorLineIndex()
     {
         SanitizeCursorPosition();
         mTerminalData->EnsureLineExists(
             static_cast<size_t>(mCursorPosition.mRow));
         const size_t lineCount = mTerminalData->GetLineCount();
+        return ToBufferPosition(mCursorPosition, lineCount).mRow;
+    }
 
-        const size_t lineIndex = ToBufferPosition(
-            mCursorPosition, lineCount).mRow;
+    void TerminalState::InputPrintableByte(uint8_t value)
+    {
+        const size_t lineIndex = CursorLineIndex();
         mTerminalData->EnsureLineExists(lineIndex);
 
         mTerminalData->InputGlyph(
@@ -379,7 +452,111 @@ namespace imterm {
         SanitizeCursorPosition();
     }
 
+    void TerminalState::InputPlainText(
+        std::span<const uint8_t> aBytes, size_t aCharacters)
+    {
+        const size_t lineIndex = CursorLineIndex();
+        const PaletteIndex color = GetPaletteIndex();
+
+        // The cursor does not wrap: once it reaches the last column, every
+        // further character overwrites that column. Only the characters that
+        // land in a distinct column and the final one survive.
+        const size_t available = static_cast<size_t>(
+            mViewportSize.mColumns - mCursorPosition.mColumn);
+        if (aCharacters > available) {
+            size_t keep = 0;
+            for (size_t kept = 0; kept + 1 < available; ++kept) {
+                keep += static_cast<size_t>(TerminalData::UTF8CharLength(
+                    aBytes[keep], aBytes.size() - keep));
+            }
+            size_t last = keep;
+            for (size_t index = keep; index < aBytes.size();) {
+                last = index;
+                index += static_cast<size_t>(TerminalData::UTF8CharLength(
+                    aBytes[index], aBytes.size() - index));
+            }
+            mTerminalData->InputCharacters(lineIndex, mCursorPosition.mColumn,
+                color, aBytes.first(keep));
+            aBytes = aBytes.subspan(last);
+        }
+
+        mTerminalData->InputCharacters(
+            lineIndex, mCursorPosition.mColumn, color, aBytes);
+        SanitizeCursorPosition();
+    }
+
+    int TerminalState::InputControl(uint8_t value)
+    {
+        if (value == 0) {
+            return 0;
+        }
+        if (value == '\a')
+        {
+            if (!mBellEnabled) {
+                return 0;
+            }
+            // beep is blocking, so run it in the background, only if it is not already running.
+            static std::future<void> beep_result;
+            if (!beep_result.valid() || beep_result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                beep_result = std::async(std::launch::async, []() {
+                    beep(1200, 150);
+                    });
+            }
+            return 0;
+        }
+        if (value == '\r')
+        {
+            if (mNewLineMode == NewLineMode::AddLfToCr) {
+                if (mCursorPosition.mRow == mViewportSize.mRows - 1) {
+                    // At the bottom (end) of the lines, so we need to add
+                    mTerminalData->InsertLine(
+                        static_cast<int>(CursorLineIndex() + 1));
+                }
+                else {
+                    // Only advance the terminal row if we are not at the bottom
+                    ++mCursorPosition.mRow;
+                }
+            }
+            mCursorPosition.mColumn = 0;
+            return 0;
+        }
+        if (value == '\n')
+        {
+            if (mCursorPosition.mRow == mViewportSize.mRows - 1) {
+                // At the bottom (end) of the lines, so we need to add
+                mTerminalData->InsertLine(
+                    static_cast<int>(CursorLineIndex() + 1));
+            }
+            else {
+                ++mCursorPosition.mRow;
+            }
+            if (mNewLineMode == NewLineMode::AddCrToLf) {
+                mCursorPosition.mColumn = 0;
+            }
+            return 1;
+        }
+        if (value == '\b')
+        {
+            if (mCursorPosition.mColumn > 0) {
+                --mCursorPosition.mColumn;
+            }
+            return 0;
+        }
+
+        // Tabs, DEL and the remaining controls are drawn like any other character.
+        InputPrintableByte(value);
+        return 0;
+    }
+
     int TerminalState::Input(std::span<const uint8_t> bytes)
+    {
+        if (bytes.empty()) {
+            return 0;
+        }
+        return Input(bytes, std::chrono::system_clock::now());
+    }
+
+    int TerminalState::Input(std::span<const uint8_t> bytes, TerminalLine::Timestamp time)
     {
         if (bytes.empty()) {
             return 0;
@@ -388,125 +565,79 @@ namespace imterm {
             return 0;
         }
 
-        std::vector<uint8_t> joinedInput;
-        if (!mPendingUtf8.empty()) {
-            joinedInput.reserve(mPendingUtf8.size() + bytes.size());
-            joinedInput.insert(
-                joinedInput.end(), mPendingUtf8.begin(), mPendingUtf8.end());
-            joinedInput.insert(joinedInput.end(), bytes.begin(), bytes.end());
+        // Changes made outside Input() go back to reading the clock.
+        struct ReceiveTimeScope {
+            TerminalData& mData;
+            std::optional<TerminalLine::Timestamp> mPrevious;
+            ~ReceiveTimeScope() { mData.SetReceiveTime(mPrevious); }
+        } receiveTimeScope{ *mTerminalData, mTerminalData->GetReceiveTime() };
+        mTerminalData->SetReceiveTime(time);
+
+        int totalLines = 0;
+        // A character cut off at the end of the last input is completed from
+        // the first bytes of this one on the stack, instead of copying the
+        // whole input behind it. The parser state carries over between the
+        // two parts as it does between reads.
+        while (!mPendingUtf8.empty() && !bytes.empty()) {
+            std::array<uint8_t, 6> joined;
+            const size_t pending = mPendingUtf8.size();
+            const size_t length = static_cast<size_t>(TerminalData::UTF8CharLength(mPendingUtf8[0]));
+            const size_t taken = std::min(bytes.size(), length > pending ? length - pending : 1);
+            std::copy(mPendingUtf8.begin(), mPendingUtf8.end(), joined.begin());
+            std::copy_n(bytes.begin(), taken, joined.begin() + static_cast<std::ptrdiff_t>(pending));
             mPendingUtf8.clear();
-            bytes = joinedInput;
+            totalLines += ApplyInput(std::span<const uint8_t>(joined.data(), pending + taken));
+            bytes = bytes.subspan(taken);
         }
+        totalLines += ApplyInput(bytes);
 
-        const auto currentLineIndex = [this]() {
-            SanitizeCursorPosition();
-            mTerminalData->EnsureLineExists(
-                static_cast<size_t>(mCursorPosition.mRow));
-            const size_t lineCount = mTerminalData->GetLineCount();
-            return ToBufferPosition(mCursorPosition, lineCount).mRow;
-        };
+        return totalLines;
+    }
 
+    int TerminalState::ApplyInput(std::span<const uint8_t> bytes)
+    {
         int totalLines = 0;
+        std::array<EscapeSequenceParser::Token, TokenBatchSize> tokens;
         size_t offset = 0;
         while (offset < bytes.size()) {
-            SanitizeCursorPosition();
-            const uint8_t value = bytes[offset];
-
-            if (value == 0) {
-                ++offset;
-            }
-            else if (value == '\a')
-            {
-                // beep is blocking, so run it in the background, only if it is not already running.
-                static std::future<void> beep_result;
-                if (!beep_result.valid() || beep_result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-                    beep_result = std::async(std::launch::async, []() {
-                        beep(1200, 150);
-                        });
-                }
-                ++offset;
-
-            }
-            else if (value == '\r')
-            {
-                if (mNewLineMode == NewLineMode::AddLfToCr) {
-                    if (mCursorPosition.mRow == mViewportSize.mRows - 1) {
-                        // At the bottom (end) of the lines, so we need to add
-                        mTerminalData->InsertLine(
-                            static_cast<int>(currentLineIndex() + 1));
+            const std::span<const uint8_t> batch = bytes.subspan(offset);
+            size_t tokenCount = 0;
+            offset += mAnsiEscSeqParser.Parse(batch, tokens, tokenCount);
+
+            for (size_t i = 0; i < tokenCount; ++i) {
+                SanitizeCursorPosition();
+                const EscapeSequenceParser::Token& token = tokens[i];
+                switch (token.mKind) {
+                case EscapeSequenceParser::TokenKind::Text:
+                {
+                    const auto text = batch.subspan(token.mOffset, token.mLength);
+                    // A character cut off by the end of the input is held
+                    // back until the rest of it arrives.
+                    const bool atEnd = token.mOffset + token.mLength == batch.size();
+                    size_t characters = 0;
+                    const size_t complete = CountCharacters(text, atEnd, characters);
+                    if (complete < text.size()) {
+                        mPendingUtf8.assign(text.begin() + static_cast<std::ptrdiff_t>(complete), text.end());
                     }
-                    else {
-                        // Only advance the terminal row if we are not at the bottom
-                        ++mCursorPosition.mRow;
+                    if (complete > 0) {
+                        InputPlainText(text.first(complete), characters);
                     }
-                }
-                mCursorPosition.mColumn = 0;
-                ++offset;
-            }
-            else if (value == '\n')
-            {
-                if (mCursorPosition.mRow == mViewportSize.mRows - 1) {
-                    // At the bottom (end) of the lines, so we need to add
-                    mTerminalData->InsertLine(
-                        static_cast<int>(currentLineIndex() + 1));
-                }
-                else {
-                    ++mCursorPosition.mRow;
-                }
-                if (mNewLineMode == NewLineMode::AddCrToLf) {
-                    mCursorPosition.mColumn = 0;
-                }
-                
-                ++totalLines;
-                ++offset;
-            }
-            else if (value == '\b')
-            {
-                if (mCursorPosition.mColumn > 0) {
-                    --mCursorPosition.mColumn;
-                }
-                ++offset;
-            }
-            else
-            {
-                const size_t characterLength = static_cast<size_t>(
-                    TerminalData::UTF8CharLength(value));
-                const size_t remaining = bytes.size() - offset;
-                if (characterLength > remaining) {
-                    mPendingUtf8.assign(
-                        bytes.begin() + static_cast<std::ptrdiff_t>(offset),
-                        bytes.end());
                     break;
                 }
-
-                if (characterLength > 1) {
-                    SanitizeCursorPosition();
-                    const size_t lineIndex = currentLineIndex();
-                    mTerminalData->InputBytes(
-                        lineIndex, mCursorPosition.mColumn, GetPaletteIndex(),
-                        bytes.subspan(offset, characterLength));
-                    SanitizeCursorPosition();
-                    offset += characterLength;
-                }
-                else {
-                    const auto& escSeq = mAnsiEscSeqParser.Parse(value);
-
-                    if (escSeq.mOutputChar) {
-                        InputPrintableByte(escSeq.mOutputChar);
-                    }
-
+                case EscapeSequenceParser::TokenKind::Control:
+                    totalLines += InputControl(batch[token.mOffset]);
+                    break;
+                case EscapeSequenceParser::TokenKind::Sequence:
                     // Update the terminal state, which includes coloring,
-                    // clearing, and positioning the cursor. It may also cause 
+                    // clearing, and positioning the cursor. It may also cause
                     // serial output to be produced which mTermState will queue up
-                    Update(escSeq);
-
-                    ++offset;
+                    Update(mAnsiEscSeqParser.GetSequence());
+                    break;
+                case EscapeSequenceParser::TokenKind::Malformed:
+                    break;
                 }
             }
-
-            mTerminalData->SetTextChanged(true);
         }
-
         return totalLines;
     }
 
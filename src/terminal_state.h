@@ -3,7 +3,6 @@
 #include <cstdint>
 #include <memory>
 #include <limits>
-#include <queue>
 #include <span>
 #include <vector>
 
@@ -66,7 +65,7 @@ namespace imterm {
 		Flags getTextFormatting();
 
 		uint32_t Update(GraphicsCommand aCommand);
-		uint32_t Update(const std::vector<int>& aCommandData);
+		uint32_t Update(std::span<const int> aCommandData);
 
 		bool IsBold() const { return mState & static_cast<uint32_t>(Flags::Bold); }
 		bool IsDim() const { return mState & static_cast<uint32_t>(Flags::Dim); }
@@ -104,7 +103,11 @@ namespace imterm {
 		CommandResult Apply(const TerminalCommand& aCommand);
 		void SetViewportSize(int aRows, int aColumns);
 
+		// Applies received bytes. Lines they change are stamped with aTime, the
+		// time the bytes were read; the overload without it reads the clock
+		// once for the whole call.
 		int Input(std::span<const uint8_t> aBytes);
+		int Input(std::span<const uint8_t> aBytes, TerminalLine::Timestamp aTime);
 
 		ViewportSize GetViewportSize() const { return mViewportSize; }
 		int getColumnIndex() const { return mCursorPosition.mColumn; }
@@ -146,12 +149,41 @@ namespace imterm {
 		bool IsHidden() const { return mGraphics.IsHidden(); }
 		bool IsStrikethrough() const { return mGraphics.IsStrikethrough(); }
 
+		// Replies to device status and cursor position requests, queued back to
+		// back in the order they were requested. Clearing keeps the storage, so
+		// a consumer that peeks and clears allocates nothing per reply.
+		std::span<const uint8_t> PeekTerminalOutput() const { return mQueuedTerminalOutput; }
+		void ClearTerminalOutput() { mQueuedTerminalOutput.clear(); }
+		// Takes every queued reply at once.
 		std::vector<uint8_t> GetTerminalOutput();
 		bool TerminalOutputAvailable();
 
 		inline NewLineMode GetNewLineMode() const { return mNewLineMode; }
 		inline void SetNewLineMode(NewLineMode aValue) { mNewLineMode = aValue; }
 
+		// Whether BEL sounds the system beep. Off for replays and headless
+		// captures.
+		inline bool IsBellEnabled() const { return mBellEnabled; }
+		inline void SetBellEnabled(bool aValue) { mBellEnabled = aValue; }
+
+		// Everything the terminal keeps between Input() calls apart from the
+		// lines themselves: the cursor, colors, escape parser and any partial
+		// UTF-8 character. Restoring a snapshot, with the screen lines it was
+		// taken with, continues the byte stream as if from where it was taken.
+		// Queued terminal output is not part of it.
+		struct Snapshot {
+			ViewportSize mViewportSize;
+			ScreenPosition mCursorPosition;
+			ScreenPosition mSavedCursorPosition;
+			TerminalGraphicsState mGraphics;
+			NewLineMode mNewLineMode;
+			EscapeSequenceParser mParser;
+			std::vector<uint8_t> mPendingUtf8;
+		};
+		Snapshot TakeSnapshot() const;
+		// Discards queued terminal output.
+		void RestoreSnapshot(const Snapshot& aSnapshot);
+
 		PaletteIndex GetPaletteIndex();
 
 	private:
@@ -170,6 +202,12 @@ namespace imterm {
 		void EraseDisplayAtCursor(EraseDisplay::Area aArea);
 		size_t GetViewportTopBufferRow(size_t aTotalLines) const;
 		void InputPrintableByte(uint8_t value);
+		// Parses and applies aBytes; Input() without the receive time and the
+		// held-back character.
+		int ApplyInput(std::span<const uint8_t> aBytes);
+		void InputPlainText(std::span<const uint8_t> aBytes, size_t aCharacters);
+		int InputControl(uint8_t value);
+		size_t CursorLineIndex();
 
 		ViewportSize mViewportSize;
 		ScreenPosition mCursorPosition;
@@ -177,9 +215,10 @@ namespace imterm {
 		TerminalGraphicsState mGraphics;
 		std::shared_ptr<TerminalData> mTerminalData = nullptr;
 
-		std::queue<std::vector<uint8_t>> mQueuedTerminalOutput;
+		std::vector<uint8_t> mQueuedTerminalOutput;
 
 		NewLineMode mNewLineMode;
+		bool mBellEnabled = true;
 
 		EscapeSequenceParser mAnsiEscSeqParser;
 		std::vector<uint8_t> mPendingUtf8;
@@ -0,0 +1,395 @@
+#include "terminal_types.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace imterm {
+
+	PaletteIndex TerminalLine::ColorAt(size_type aIndex) const
+	{
+		if (mRuns.empty()) {
+			return PaletteIndex::Default;
+		}
+		return mRuns[RunIndexAt(aIndex)].mColorIndex;
+	}
+
+	PaletteIndex TerminalLine::ColorAtCached(size_type aIndex, size_type& aRun) const
+	{
+		if (mRuns.empty()) {
+			return PaletteIndex::Default;
+		}
+
+		const auto contains = [this, aIndex](size_type aCandidate) {
+			return aCandidate < mRuns.size()
+				&& mRuns[aCandidate].mStart <= aIndex
+				&& (aCandidate + 1 == mRuns.size() || aIndex < mRuns[aCandidate + 1].mStart);
+		};
+
+		if (!contains(aRun)) {
+			aRun = contains(aRun + 1) ? aRun + 1 : RunIndexAt(aIndex);
+		}
+		return mRuns[aRun].mColorIndex;
+	}
+
+	TerminalLine::size_type TerminalLine::RunIndexAt(size_type aPosition) const
+	{
+		const auto it = std::upper_bound(mRuns.begin(), mRuns.end(), aPosition,
+			[](size_type aValue, const AttributeRun& aRun) {
+				return aValue < aRun.mStart;
+			});
+		return static_cast<size_type>(std::max<std::ptrdiff_t>(it - mRuns.begin() - 1, 0));
+	}
+
+	TerminalLine::size_type TerminalLine::SplitRunAt(size_type aPosition)
+	{
+		const size_type run = RunIndexAt(aPosition);
+		if (mRuns[run].mStart == aPosition) {
+			return run;
+		}
+		mRuns.insert(mRuns.begin() + static_cast<std::ptrdiff_t>(run + 1),
+			AttributeRun{ static_cast<uint32_t>(aPosition), mRuns[run].mColorIndex });
+		return run + 1;
+	}
+
+	void TerminalLine::MergeRunsAround(size_type aRun)
+	{
+		if (aRun + 1 < mRuns.size() && mRuns[aRun + 1].mColorIndex == mRuns[aRun].mColorIndex) {
+			mRuns.erase(mRuns.begin() + static_cast<std::ptrdiff_t>(aRun + 1));
+		}
+		if (aRun > 0 && aRun < mRuns.size() && mRuns[aRun - 1].mColorIndex == mRuns[aRun].mColorIndex) {
+			mRuns.erase(mRuns.begin() + static_cast<std::ptrdiff_t>(aRun));
+		}
+	}
+
+	void TerminalLine::PushBack(Char aChar, PaletteIndex aColorIndex)
+	{
+		if (mRuns.empty() || mRuns.back().mColorIndex != aColorIndex) {
+			mRuns.push_back(AttributeRun{ static_cast<uint32_t>(mText.size()), aColorIndex });
+		}
+		CountBytes(std::span<const Char>(&aChar, 1), true);
+		InvalidateColumnsFrom(mText.size());
+		mText.push_back(aChar);
+	}
+
+	void TerminalLine::Insert(size_type aPosition, std::span<const Char> aBytes, PaletteIndex aColorIndex)
+	{
+		if (aBytes.empty()) {
+			return;
+		}
+		aPosition = std::min(aPosition, size());
+		CountBytes(aBytes, true);
+		InvalidateColumnsFrom(aPosition);
+
+		if (aPosition == size()) {
+			if (mRuns.empty() || mRuns.back().mColorIndex != aColorIndex) {
+				mRuns.push_back(AttributeRun{ static_cast<uint32_t>(aPosition), aColorIndex });
+			}
+			mText.insert(mText.end(), aBytes.begin(), aBytes.end());
+			return;
+		}
+
+		const size_type run = SplitRunAt(aPosition);
+		for (size_type index = run; index < mRuns.size(); ++index) {
+			mRuns[index].mStart += static_cast<uint32_t>(aBytes.size());
+		}
+		mRuns.insert(mRuns.begin() + static_cast<std::ptrdiff_t>(run),
+			AttributeRun{ static_cast<uint32_t>(aPosition), aColorIndex });
+		MergeRunsAround(run);
+
+		mText.insert(mText.begin() + static_cast<std::ptrdiff_t>(aPosition), aBytes.begin(), aBytes.end());
+	}
+
+	void TerminalLine::Insert(size_type aPosition, size_type aCount, Char aChar, PaletteIndex aColorIndex)
+	{
+		if (aCount == 0) {
+			return;
+		}
+		aPosition = std::min(aPosition, size());
+		if (aChar == '\t') {
+			mTabBytes += static_cast<uint32_t>(aCount);
+		}
+		else if (aChar > 0x7F) {
+			mNonAsciiBytes += static_cast<uint32_t>(aCount);
+		}
+		InvalidateColumnsFrom(aPosition);
+
+		if (aPosition == size()) {
+			if (mRuns.empty() || mRuns.back().mColorIndex != aColorIndex) {
+				mRuns.push_back(AttributeRun{ static_cast<uint32_t>(aPosition), aColorIndex });
+			}
+			mText.insert(mText.end(), aCount, aChar);
+			return;
+		}
+
+		const size_type run = SplitRunAt(aPosition);
+		for (size_type index = run; index < mRuns.size(); ++index) {
+			mRuns[index].mStart += static_cast<uint32_t>(aCount);
+		}
+		mRuns.insert(mRuns.begin() + static_cast<std::ptrdiff_t>(run),
+			AttributeRun{ static_cast<uint32_t>(aPosition), aColorIndex });
+		MergeRunsAround(run);
+
+		mText.insert(mText.begin() + static_cast<std::ptrdiff_t>(aPosition), aCount, aChar);
+	}
+
+	void TerminalLine::Erase(size_type aStart, size_type aEnd)
+	{
+		aEnd = std::min(aEnd, size());
+		if (aStart >= aEnd) {
+			return;
+		}
+		CountBytes(std::span<const Char>(mText).subspan(aStart, aEnd - aStart), false);
+		InvalidateColumnsFrom(aStart);
+		if (aStart == 0 && aEnd == size()) {
+			mText.clear();
+			mRuns.clear();
+			return;
+		}
+
+		const size_type first = SplitRunAt(aStart);
+		const size_type last = aEnd < size() ? SplitRunAt(aEnd) : mRuns.size();
+		const size_type removed = aEnd - aStart;
+
+		mRuns.erase(mRuns.begin() + static_cast<std::ptrdiff_t>(first),
+			mRuns.begin() + static_cast<std::ptrdiff_t>(last));
+		for (size_type index = first; index < mRuns.size(); ++index) {
+			mRuns[index].mStart -= static_cast<uint32_t>(removed);
+		}
+		if (first < mRuns.size()) {
+			MergeRunsAround(first);
+		}
+
+		mText.erase(mText.begin() + static_cast<std::ptrdiff_t>(aStart),
+			mText.begin() + static_cast<std::ptrdiff_t>(aEnd));
+	}
+
+	void TerminalLine::Append(const TerminalLine& aOther, size_type aFrom)
+	{
+		if (aFrom >= aOther.size()) {
+			return;
+		}
+
+		const size_type base = size();
+		CountBytes(std::span<const Char>(aOther.mText).subspan(aFrom), true);
+		InvalidateColumnsFrom(base);
+		mText.insert(mText.end(),
+			aOther.mText.begin() + static_cast<std::ptrdiff_t>(aFrom), aOther.mText.end());
+
+		for (size_type run = aOther.RunIndexAt(aFrom); run < aOther.mRuns.size(); ++run) {
+			const AttributeRun& source = aOther.mRuns[run];
+			if (!mRuns.empty() && mRuns.back().mColorIndex == source.mColorIndex) {
+				continue;
+			}
+			const size_type start = std::max<size_type>(source.mStart, aFrom) - aFrom + base;
+			mRuns.push_back(AttributeRun{ static_cast<uint32_t>(start), source.mColorIndex });
+		}
+	}
+
+	void TerminalLine::SetChar(size_type aIndex, Char aChar)
+	{
+		CountBytes(std::span<const Char>(mText).subspan(aIndex, 1), false);
+		CountBytes(std::span<const Char>(&aChar, 1), true);
+		InvalidateColumnsFrom(aIndex);
+		mText[aIndex] = aChar;
+	}
+
+	void TerminalLine::ShrinkToFit()
+	{
+		mText.shrink_to_fit();
+		mRuns.shrink_to_fit();
+		if (mColumnIndex.mIndex) {
+			mColumnIndex.mIndex->mStops.shrink_to_fit();
+		}
+	}
+
+	namespace {
+
+		void EncodeVarint(std::vector<uint8_t>& aOut, uint64_t aValue)
+		{
+			while (aValue >= 0x80) {
+				aOut.push_back(static_cast<uint8_t>(aValue | 0x80));
+				aValue >>= 7;
+			}
+			aOut.push_back(static_cast<uint8_t>(aValue));
+		}
+
+		uint64_t DecodeVarint(std::span<const uint8_t>& aIn)
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (aIn.empty()) {
+					break;
+				}
+				const uint8_t byte = aIn.front();
+				aIn = aIn.subspan(1);
+				value |= uint64_t{ byte & 0x7Fu } << shift;
+				if ((byte & 0x80) == 0) {
+					return value;
+				}
+			}
+			throw std::out_of_range("TerminalLine::Decode truncated integer");
+		}
+
+	}
+
+	void TerminalLine::Encode(std::vector<uint8_t>& aOut) const
+	{
+		EncodeVarint(aOut, mText.size());
+		EncodeVarint(aOut, mRuns.size());
+		EncodeVarint(aOut, static_cast<uint64_t>(mTimestamp.time_since_epoch().count()));
+		// The first time as its distance from the last, plus one; 0 for none.
+		EncodeVarint(aOut, mFirstTimestamp == NoTimestamp ? 0 : static_cast<uint64_t>((mTimestamp - mFirstTimestamp).count()) + 1);
+		EncodeVarint(aOut, mGeneration);
+		aOut.insert(aOut.end(), mText.begin(), mText.end());
+		uint32_t previous = 0;
+		for (const AttributeRun& run : mRuns) {
+			EncodeVarint(aOut, run.mStart - previous);
+			aOut.push_back(static_cast<uint8_t>(run.mColorIndex));
+			previous = run.mStart;
+		}
+	}
+
+	TerminalLine TerminalLine::Decode(std::span<const uint8_t>& aIn)
+	{
+		TerminalLine line;
+		const uint64_t textSize = DecodeVarint(aIn);
+		const uint64_t runCount = DecodeVarint(aIn);
+		line.mTimestamp = Timestamp(Timestamp::duration(static_cast<Timestamp::rep>(DecodeVarint(aIn))));
+		if (const uint64_t firstDistance = DecodeVarint(aIn)) {
+			line.mFirstTimestamp = line.mTimestamp - Timestamp::duration(static_cast<Timestamp::rep>(firstDistance - 1));
+		}
+		line.mGeneration = DecodeVarint(aIn);
+		if (textSize > aIn.size()) {
+			throw std::out_of_range("TerminalLine::Decode truncated text");
+		}
+		line.mText.assign(aIn.begin(), aIn.begin() + static_cast<std::ptrdiff_t>(textSize));
+		aIn = aIn.subspan(static_cast<size_t>(textSize));
+		line.CountBytes(line.mText, true);
+
+		line.mRuns.reserve(static_cast<size_t>(std::min<uint64_t>(runCount, line.mText.size())));
+		uint32_t start = 0;
+		for (uint64_t run = 0; run < runCount; ++run) {
+			start += static_cast<uint32_t>(DecodeVarint(aIn));
+			if (aIn.empty()) {
+				throw std::out_of_range("TerminalLine::Decode truncated runs");
+			}
+			line.mRuns.push_back(AttributeRun{ start, static_cast<PaletteIndex>(aIn.front()) });
+			aIn = aIn.subspan(1);
+		}
+		return line;
+	}
+
+	void TerminalLine::CountBytes(std::span<const Char> aBytes, bool aAdded) noexcept
+	{
+		uint32_t tabs = 0;
+		uint32_t nonAscii = 0;
+		for (const Char byte : aBytes) {
+			tabs += byte == '\t';
+			nonAscii += byte > 0x7F;
+		}
+		if (aAdded) {
+			mTabBytes += tabs;
+			mNonAsciiBytes += nonAscii;
+		}
+		else {
+			mTabBytes -= tabs;
+			mNonAsciiBytes -= nonAscii;
+		}
+	}
+
+	void TerminalLine::InvalidateColumnsFrom(size_type aPosition) noexcept
+	{
+		auto& index = mColumnIndex.mIndex;
+		if (!index) {
+			return;
+		}
+		if (IsPlain()) {
+			index.reset();
+			return;
+		}
+		index->mEnd.reset();
+		// Boundaries up to aPosition only depend on bytes before it.
+		if (index->mTail.mByte > aPosition) {
+			while (index->mStops.size() > 1 && index->mStops.back().mByte > aPosition) {
+				index->mStops.pop_back();
+			}
+			index->mTail = index->mStops.back();
+		}
+	}
+
+	const TerminalLine::ColumnIndex& TerminalLine::IndexColumns(int aTabSize) const
+	{
+		auto& cache = mColumnIndex.mIndex;
+		if (!cache || cache->mTabSize != aTabSize) {
+			cache = std::make_unique<ColumnIndex>();
+			cache->mTabSize = aTabSize;
+			cache->mStops.push_back(ColumnStop{ 0, 0, 0 });
+		}
+
+		ColumnIndex& index = *cache;
+		if (index.mEnd) {
+			return index;
+		}
+
+		ColumnStop stop = index.mTail;
+		ColumnStop last = stop;
+		while (stop.mByte < mText.size()) {
+			last = stop;
+			if (stop.mCharacter >= index.mStops.back().mCharacter + ColumnStopInterval) {
+				index.mStops.push_back(stop);
+			}
+			const Char lead = mText[stop.mByte];
+			stop.mByte += std::min(static_cast<size_type>(UTF8SequenceLength(lead)), mText.size() - stop.mByte);
+			stop.mColumn = NextColumn(lead, stop.mColumn, aTabSize);
+			++stop.mCharacter;
+		}
+		index.mTail = last;
+		index.mEnd = stop;
+		return index;
+	}
+
+	ColumnStop TerminalLine::StopAtColumn(int aColumn, int aTabSize) const
+	{
+		if (IsPlain()) {
+			const size_type byte = std::min(static_cast<size_type>(std::max(aColumn, 0)), size());
+			return ColumnStop{ byte, static_cast<int>(byte), byte };
+		}
+
+		const ColumnIndex& index = IndexColumns(aTabSize);
+		if (index.mTail.mColumn <= aColumn) {
+			return index.mTail;
+		}
+		const auto it = std::upper_bound(index.mStops.begin(), index.mStops.end(), aColumn,
+			[](int aValue, const ColumnStop& aStop) {
+				return aValue < aStop.mColumn;
+			});
+		return it == index.mStops.begin() ? index.mStops.front() : *(it - 1);
+	}
+
+	ColumnStop TerminalLine::StopAtByte(size_type aByte, int aTabSize) const
+	{
+		if (IsPlain()) {
+			const size_type byte = std::min(aByte, size());
+			return ColumnStop{ byte, static_cast<int>(byte), byte };
+		}
+
+		const ColumnIndex& index = IndexColumns(aTabSize);
+		if (index.mTail.mByte <= aByte) {
+			return index.mTail;
+		}
+		const auto it = std::upper_bound(index.mStops.begin(), index.mStops.end(), aByte,
+			[](size_type aValue, const ColumnStop& aStop) {
+				return aValue < aStop.mByte;
+			});
+		return *(it - 1);
+	}
+
+	ColumnStop TerminalLine::EndStop(int aTabSize) const
+	{
+		if (IsPlain()) {
+			return ColumnStop{ size(), static_cast<int>(size()), size() };
+		}
+		return *IndexColumns(aTabSize).mEnd;
+	}
+
+}
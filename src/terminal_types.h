@@ -4,13 +4,17 @@
 #include <cstddef>
 #include <cstdint>
 #include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace imterm {
 
 	typedef uint8_t Char;
 
-	enum class PaletteIndex
+	enum class PaletteIndex : uint8_t
 	{
 		Default,
 		Keyword,
@@ -33,6 +37,8 @@ namespace imterm {
 		CurrentLineFill,
 		CurrentLineFillInactive,
 		CurrentLineEdge,
+		SearchMatch,
+		SearchMatchCurrent,
 		Black,
 		Red,
 		Green,
@@ -57,48 +63,253 @@ namespace imterm {
 		Char mChar;
 		PaletteIndex mColorIndex = PaletteIndex::Default;
 
-		bool mPreprocessor : 1;
+		Glyph(Char aChar, PaletteIndex aColorIndex) : mChar(aChar), mColorIndex(aColorIndex) {}
+	};
+
+	// A maximal run of bytes that share a palette index. Runs cover a line from
+	// byte 0 without gaps, and neighbouring runs never share a color.
+	struct AttributeRun
+	{
+		uint32_t mStart;
+		PaletteIndex mColorIndex;
+	};
+
+	// Byte length of the UTF-8 sequence introduced by aLead. Anything that is
+	// not a lead byte, including a stray continuation byte, counts as one.
+	inline int UTF8SequenceLength(Char aLead)
+	{
+		if ((aLead & 0xFE) == 0xFC)
+			return 6;
+		if ((aLead & 0xFC) == 0xF8)
+			return 5;
+		if ((aLead & 0xF8) == 0xF0)
+			return 4;
+		else if ((aLead & 0xF0) == 0xE0)
+			return 3;
+		else if ((aLead & 0xE0) == 0xC0)
+			return 2;
+		return 1;
+	}
+
+	// Rendered column that follows a character starting with aLead at aColumn.
+	inline int NextColumn(Char aLead, int aColumn, int aTabSize)
+	{
+		return aLead == '\t' ? (aColumn / aTabSize) * aTabSize + aTabSize : aColumn + 1;
+	}
+
+	// A character boundary within a line: the byte offset, the rendered column
+	// the character there starts at, and the number of characters before it.
+	struct ColumnStop
+	{
+		size_t mByte;
+		int mColumn;
+		size_t mCharacter;
+	};
 
-		Glyph(Char aChar, PaletteIndex aColorIndex) : mChar(aChar), mColorIndex(aColorIndex), mPreprocessor(false) {}
+	// Which of a line's times the margin and the log show.
+	enum class LineTimestampKind : uint8_t
+	{
+		LastByte,
+		FirstByte,
+		FirstAndLastByte
 	};
 
 	// A line's timestamp is the time of its most recent content mutation. This
 	// matches what users see in the terminal and what is written to the log when
-	// the line is completed. Glyph storage is intentionally read-only outside
+	// the line is completed. The line also keeps the time its current text
+	// started arriving, for measuring latency. Received bytes are stamped with
+	// the time they were read, see TerminalData::SetReceiveTime(). Glyph storage is intentionally read-only outside
 	// TerminalData so all mutations preserve the terminal-buffer invariants.
+	//
+	// Bytes and colors are stored separately: one byte per received byte plus
+	// one AttributeRun per color change. Glyphs are assembled on read, so
+	// operator[] and iteration yield Glyph values rather than references.
 	class TerminalLine
 	{
 	public:
-		using const_iterator = std::vector<Glyph>::const_iterator;
-		using size_type = std::vector<Glyph>::size_type;
+		using size_type = size_t;
 		using Timestamp = std::chrono::system_clock::time_point;
 
+		class const_iterator
+		{
+		public:
+			using iterator_category = std::random_access_iterator_tag;
+			using value_type = Glyph;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = Glyph;
+
+			const_iterator() = default;
+			const_iterator(const TerminalLine* aLine, size_type aIndex) : mLine(aLine), mIndex(aIndex) {}
+
+			Glyph operator*() const { return Glyph(mLine->mText[mIndex], mLine->ColorAtCached(mIndex, mRun)); }
+			Glyph operator[](difference_type aOffset) const { return *(*this + aOffset); }
+
+			const_iterator& operator++() { ++mIndex; return *this; }
+			const_iterator operator++(int) { auto copy = *this; ++mIndex; return copy; }
+			const_iterator& operator--() { --mIndex; return *this; }
+			const_iterator operator--(int) { auto copy = *this; --mIndex; return copy; }
+			const_iterator& operator+=(difference_type aOffset) { mIndex += aOffset; return *this; }
+			const_iterator& operator-=(difference_type aOffset) { mIndex -= aOffset; return *this; }
+			friend const_iterator operator+(const_iterator aIt, difference_type aOffset) { return aIt += aOffset; }
+			friend const_iterator operator+(difference_type aOffset, const_iterator aIt) { return aIt += aOffset; }
+			friend const_iterator operator-(const_iterator aIt, difference_type aOffset) { return aIt -= aOffset; }
+			friend difference_type operator-(const const_iterator& aLeft, const const_iterator& aRight) {
+				return static_cast<difference_type>(aLeft.mIndex) - static_cast<difference_type>(aRight.mIndex);
+			}
+			friend bool operator==(const const_iterator& aLeft, const const_iterator& aRight) { return aLeft.mIndex == aRight.mIndex; }
+			friend auto operator<=>(const const_iterator& aLeft, const const_iterator& aRight) { return aLeft.mIndex <=> aRight.mIndex; }
+
+		private:
+			const TerminalLine* mLine = nullptr;
+			size_type mIndex = 0;
+			// Run that contained the last dereferenced byte; makes sequential
+			// iteration O(1) per glyph.
+			mutable size_type mRun = 0;
+		};
+
 		TerminalLine() = default;
 		TerminalLine(std::initializer_list<Glyph> aGlyphs)
-			: mGlyphs(aGlyphs)
 		{
+			for (const Glyph& glyph : aGlyphs) {
+				PushBack(glyph.mChar, glyph.mColorIndex);
+			}
 		}
 
-		bool empty() const noexcept { return mGlyphs.empty(); }
-		size_type size() const noexcept { return mGlyphs.size(); }
-		const Glyph& operator[](size_type aIndex) const { return mGlyphs[aIndex]; }
-		const Glyph& at(size_type aIndex) const { return mGlyphs.at(aIndex); }
-		const Glyph& front() const { return mGlyphs.front(); }
-		const Glyph& back() const { return mGlyphs.back(); }
-		const_iterator begin() const noexcept { return mGlyphs.begin(); }
-		const_iterator end() const noexcept { return mGlyphs.end(); }
+		bool empty() const noexcept { return mText.empty(); }
+		size_type size() const noexcept { return mText.size(); }
+		Glyph operator[](size_type aIndex) const { return Glyph(mText[aIndex], ColorAt(aIndex)); }
+		Glyph at(size_type aIndex) const { return Glyph(mText.at(aIndex), ColorAt(aIndex)); }
+		Glyph front() const { return (*this)[0]; }
+		Glyph back() const { return (*this)[size() - 1]; }
+		const_iterator begin() const noexcept { return const_iterator(this, 0); }
+		const_iterator end() const noexcept { return const_iterator(this, size()); }
 		Timestamp GetTimestamp() const noexcept { return mTimestamp; }
+		// When the line last went from empty to holding text; GetTimestamp() for
+		// a line that was never written.
+		Timestamp GetFirstTimestamp() const noexcept { return mFirstTimestamp == NoTimestamp ? mTimestamp : mFirstTimestamp; }
+		// Taken from TerminalData's change counter whenever the line changes:
+		// two lines of one buffer with the same nonzero generation hold the same
+		// text and colors, so derived data can be cached on it. Lines that were
+		// never written have generation 0.
+		uint64_t GetGeneration() const noexcept { return mGeneration; }
+
+		// Raw access for code that only needs bytes or colors.
+		std::span<const Char> GetBytes() const noexcept { return mText; }
+		std::span<const AttributeRun> GetAttributeRuns() const noexcept { return mRuns; }
+		PaletteIndex ColorAt(size_type aIndex) const;
+
+		// True when the line holds no tabs and no bytes above 0x7F, so byte
+		// offsets, character indices, and rendered columns all coincide.
+		bool IsPlain() const noexcept { return mTabBytes == 0 && mNonAsciiBytes == 0; }
+		bool HasTabs() const noexcept { return mTabBytes != 0; }
+		// At least EndStop(aTabSize).mColumn, and equal to it for plain lines,
+		// without building the column index.
+		int ColumnBound(int aTabSize) const noexcept {
+			return static_cast<int>(size() + static_cast<size_type>(mTabBytes) * static_cast<size_type>(aTabSize - 1));
+		}
+
+		// Column lookups for lines that are not plain go through a sparse index
+		// of character boundaries, one every ColumnStopInterval characters,
+		// built on first use and kept up to date as the line grows. Each lookup
+		// returns the latest boundary at or before the requested column or byte;
+		// the caller decodes the remaining characters itself.
+		static constexpr size_type ColumnStopInterval = 256;
+		ColumnStop StopAtColumn(int aColumn, int aTabSize) const;
+		ColumnStop StopAtByte(size_type aByte, int aTabSize) const;
+		// The boundary at the end of the line: its size, rendered width, and
+		// character count.
+		ColumnStop EndStop(int aTabSize) const;
+
+		// Compact form used to page lines out of memory: the bytes, color runs,
+		// timestamps and generation, with lengths as variable-length integers. Encode()
+		// appends to aOut; Decode() reads one line from the front of aIn and
+		// advances aIn past it, throwing std::out_of_range if aIn ends early.
+		void Encode(std::vector<uint8_t>& aOut) const;
+		static TerminalLine Decode(std::span<const uint8_t>& aIn);
+
+		// Heap bytes owned by this line, excluding sizeof(TerminalLine).
+		size_t GetHeapUsage() const noexcept {
+			size_t total = mText.capacity() * sizeof(Char) + mRuns.capacity() * sizeof(AttributeRun);
+			if (mColumnIndex.mIndex) {
+				total += sizeof(ColumnIndex) + mColumnIndex.mIndex->mStops.capacity() * sizeof(ColumnStop);
+			}
+			return total;
+		}
 
 	private:
 		friend class TerminalData;
 
-		void Touch() noexcept { mTimestamp = std::chrono::system_clock::now(); }
+		void Touch(uint64_t aGeneration, Timestamp aTime) noexcept {
+			mTimestamp = aTime;
+			if (mText.empty()) {
+				mFirstTimestamp = NoTimestamp;
+			}
+			else if (mFirstTimestamp == NoTimestamp) {
+				mFirstTimestamp = aTime;
+			}
+			mGeneration = aGeneration;
+		}
+
+		static constexpr Timestamp NoTimestamp = Timestamp::min();
+
+		PaletteIndex ColorAtCached(size_type aIndex, size_type& aRun) const;
+
+		void PushBack(Char aChar, PaletteIndex aColorIndex);
+		void Insert(size_type aPosition, std::span<const Char> aBytes, PaletteIndex aColorIndex);
+		void Insert(size_type aPosition, size_type aCount, Char aChar, PaletteIndex aColorIndex);
+		void Erase(size_type aStart, size_type aEnd);
+		void Truncate(size_type aSize) { Erase(aSize, size()); }
+		void Append(const TerminalLine& aOther, size_type aFrom);
+		void SetChar(size_type aIndex, Char aChar);
+		void Reserve(size_type aSize) { mText.reserve(aSize); }
+		void ShrinkToFit();
+
+		// Makes the byte at aPosition the first byte of a run. Returns that run.
+		size_type SplitRunAt(size_type aPosition);
+		size_type RunIndexAt(size_type aPosition) const;
+		void MergeRunsAround(size_type aRun);
+
+		struct ColumnIndex
+		{
+			int mTabSize = 0;
+			// Boundaries at least ColumnStopInterval characters apart, starting
+			// at byte 0.
+			std::vector<ColumnStop> mStops;
+			// Start of the last character decoded; indexing resumes here.
+			ColumnStop mTail{};
+			// End of the line, until the next mutation.
+			std::optional<ColumnStop> mEnd;
+		};
+
+		// The index is derived data: a copied line starts without one.
+		struct ColumnIndexCache
+		{
+			ColumnIndexCache() = default;
+			ColumnIndexCache(const ColumnIndexCache&) noexcept {}
+			ColumnIndexCache(ColumnIndexCache&&) noexcept = default;
+			ColumnIndexCache& operator=(const ColumnIndexCache&) noexcept { mIndex.reset(); return *this; }
+			ColumnIndexCache& operator=(ColumnIndexCache&&) noexcept = default;
+
+			std::unique_ptr<ColumnIndex> mIndex;
+		};
+
+		const ColumnIndex& IndexColumns(int aTabSize) const;
+		// Every mutation reports the bytes it adds and removes and the first
+		// byte whose column may have changed.
+		void CountBytes(std::span<const Char> aBytes, bool aAdded) noexcept;
+		void InvalidateColumnsFrom(size_type aPosition) noexcept;
 
-		std::vector<Glyph> mGlyphs;
+		std::vector<Char> mText;
+		std::vector<AttributeRun> mRuns;
 		Timestamp mTimestamp = std::chrono::system_clock::now();
+		Timestamp mFirstTimestamp = NoTimestamp;
+		uint64_t mGeneration = 0;
+		uint32_t mTabBytes = 0;
+		uint32_t mNonAsciiBytes = 0;
+		mutable ColumnIndexCache mColumnIndex;
 	};
 
 	using Line = TerminalLine;
-	using Lines = std::vector<Line>;
 
 }
@@ -8,6 +8,7 @@
 #include <queue>
 #include <algorithm>
 #include <iterator>
+#include <cstdlib>
 
 #include "terminal_view.h"
 #include "escape_sequence_parser.h"
@@ -56,16 +57,19 @@ TerminalView::TerminalView(std::shared_ptr<TerminalData> aTerminalData, std::sha
 	, mOptions(aOptions)
 {
 	SetPalette(GetDarkPalette());
+	mChangeTracker = mData->AddChangeTracker();
 }
 
 TerminalView::~TerminalView()
 {
+	mData->RemoveChangeTracker(mChangeTracker);
 }
 
 
 void TerminalView::SetPalette(const Palette & aValue)
 {
 	mPaletteBase = aValue;
+	mPaletteAlpha = -1.0f;
 }
 
 
@@ -164,7 +168,9 @@ Coordinates TerminalView::ScreenPosToCoordinates(const ImVec2& aPosition) const
 	ImVec2 origin = ImGui::GetCursorScreenPos();
 	ImVec2 local(aPosition.x - origin.x, aPosition.y - origin.y);
 
-	int lineNo = std::max(0, (int)floor(local.y / mCharAdvance.y));
+	// The origin is far above the window in a long buffer; subtract in double
+	// as Render() does.
+	int lineNo = std::max(0, (int)floor(((double)aPosition.y - (double)origin.y) / mCharAdvance.y));
 
 	int columnCoord = 0;
 
@@ -181,7 +187,7 @@ Coordinates TerminalView::ScreenPosToCoordinates(const ImVec2& aPosition) const
 
 			if (line[columnIndex].mChar == '\t')
 			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
+				float spaceSize = mSpaceSize;
 				float oldX = columnX;
 				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mData->GetTabSize()) * spaceSize))) * (float(mData->GetTabSize()) * spaceSize);
 				columnWidth = newColumnX - oldX;
@@ -373,17 +379,7 @@ ImU32 TerminalView::GetGlyphColor(const Glyph & aGlyph) const
 	if (!mColorizerEnabled)
 		return mPalette[(int)PaletteIndex::Default];
 
-	auto const color = mPalette[(int)aGlyph.mColorIndex];
-	if (aGlyph.mPreprocessor)
-	{
-		const auto ppcolor = mPalette[(int)PaletteIndex::Preprocessor];
-		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
-		const int c1 = (((ppcolor >> 8) & 0xff) + ((color >> 8) & 0xff)) / 2;
-		const int c2 = (((ppcolor >> 16) & 0xff) + ((color >> 16) & 0xff)) / 2;
-		const int c3 = (((ppcolor >> 24) & 0xff) + ((color >> 24) & 0xff)) / 2;
-		return ImU32(c0 | (c1 << 8) | (c2 << 16) | (c3 << 24));
-	}
-	return color;
+	return mPalette[(int)aGlyph.mColorIndex];
 }
 
 void TerminalView::HandleKeyboardInputs()
@@ -471,6 +467,10 @@ void TerminalView::HandleKeyboardInputs()
 		static const auto* input_f20 = "\x1B[34~";
 
 
+		const bool searchShortcut = ctrl && shift && !alt && ImGui::IsKeyPressed(ImGuiKey_F);
+		if (searchShortcut)
+			OpenSearch();
+
 		/* handle Delete, Backspace, Enter / Return, Tab */
 		if (!ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGuiKey_Delete)) {
 			AddKeyboardInput(std::string(GetTerminalKeySequence(TerminalKey::Delete)));
@@ -537,7 +537,7 @@ void TerminalView::HandleKeyboardInputs()
 		if (ctrl) {
 
 			for (int key = (int)ImGuiKey_A; key < (int)ImGuiKey_Z; key++) {
-				if (ImGui::IsKeyPressed((ImGuiKey)key)) {
+				if (ImGui::IsKeyPressed((ImGuiKey)key) && !(searchShortcut && key == (int)ImGuiKey_F)) {
 					auto it = imguiKeyToAscii.find(static_cast<ImGuiKey>(key));
 					if (it != imguiKeyToAscii.end()) {
 							const auto control_character = GetControlCharacter(it->second);
@@ -658,20 +658,22 @@ void TerminalView::Render()
 	/* Compute mCharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
 	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
 	mCharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * mLineSpacing);
+	mSpaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
 
-	/* Update palette with the current alpha from style */
-	for (int i = 0; i < (int)PaletteIndex::Max; ++i)
+	/* Update palette with the current alpha from style, when either changed */
+	if (ImGui::GetStyle().Alpha != mPaletteAlpha)
 	{
-		auto color = ImGui::ColorConvertU32ToFloat4(mPaletteBase[i]);
-		color.w *= ImGui::GetStyle().Alpha;
-		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
+		mPaletteAlpha = ImGui::GetStyle().Alpha;
+		for (int i = 0; i < (int)PaletteIndex::Max; ++i)
+		{
+			auto color = ImGui::ColorConvertU32ToFloat4(mPaletteBase[i]);
+			color.w *= mPaletteAlpha;
+			mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
+		}
 	}
 
-	assert(mLineBuffer.empty());
-
 	auto contentSize = ImGui::GetWindowContentRegionMax();
 	auto drawList = ImGui::GetWindowDrawList();
-	float longest(mTextStart);
 
 	if (mScrollToTop)
 	{
@@ -679,6 +681,17 @@ void TerminalView::Render()
 		ImGui::SetScrollY(0.f);
 	}
 
+	const uint64_t firstLineSerial = mData->GetFirstLineSerial();
+	if (mScrollToSearchMatch)
+	{
+		mScrollToSearchMatch = false;
+		if (mSearchCurrent && mSearchCurrent->mLineSerial >= firstLineSerial && mSearchCurrent->mLineSerial - firstLineSerial < mLines.size())
+		{
+			const float matchY = (mSearchCurrent->mLineSerial - firstLineSerial) * mCharAdvance.y;
+			ImGui::SetScrollY(std::max(0.0f, matchY - contentSize.y * 0.5f));
+		}
+	}
+
 	ImVec2 cursorScreenPos = ImGui::GetCursorScreenPos();
 	auto scrollX = ImGui::GetScrollX();
 	auto scrollY = ImGui::GetScrollY();
@@ -707,14 +720,13 @@ void TerminalView::Render()
 	mTermState->SetViewportSize(terminalRows, terminalColumns);
 
 	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
-	static const int margin_work_buf_length = 48;
+	static const int margin_work_buf_length = 64;
 	char margin_work_buf[margin_work_buf_length];
 	mTextStart = mLeftMargin;
 
 	uint8_t globalLineMaxDigits = 0;
 
 	const char* marginLineNumStringFormat = "%0*d ";
-	const char* marginTimeStampStringFormat = "%02d:%02d:%02d ";
 
 	if (mOptions.LineNumbers) {
 		
@@ -729,9 +741,11 @@ void TerminalView::Render()
 	}
 
 	if (mOptions.TimeStamps) {
-		
-		int snpf_len = snprintf(margin_work_buf, margin_work_buf_length, marginTimeStampStringFormat, 12, 12, 59);
-		mTextStart += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, margin_work_buf, nullptr, nullptr).x;
+		// Digits are all the same width in the terminal font.
+		static const char marginTimeStampSample[] = "00:00:00.000000";
+		const char* sampleEnd = marginTimeStampSample + TimestampFormatter::Length(mOptions.TimeStampResolution);
+		const int timeStampCount = mOptions.TimeStampKind == LineTimestampKind::FirstAndLastByte ? 2 : 1;
+		mTextStart += timeStampCount * (ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, marginTimeStampSample, sampleEnd).x + mSpaceSize);
 	}
 
 
@@ -740,40 +754,89 @@ void TerminalView::Render()
 	//int snpf_len = snprintf(buf, buf_length, marginStringFormat, globalLineMaxDigits, globalLineMax, 12, 12, 59);
 	//mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
 
+	mVisibleMatches.clear();
+	if (mSearch && mSearchOpen)
+		mSearch->GetMatches(firstLineSerial + lineNo, firstLineSerial + lineMax + 1, mVisibleMatches);
+	auto visibleMatch = mVisibleMatches.cbegin();
+
+	// The cursor, its blink phase and the selection are the same for every
+	// line, so only the visible lines cost anything per frame.
+	mUiState.mCursorPosition = mTermState->getPositionRelative(mLines.size());
+	const bool focused = ImGui::IsWindowFocused();
+	const bool hasSelection = HasSelection();
+	bool cursorBlinkOn = false;
+	if (focused)
+	{
+		auto timeEnd = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		auto elapsed = timeEnd - mStartTime;
+		cursorBlinkOn = elapsed > CursorBlinkOnMs;
+		if (elapsed > CursorBlinkPeriodMs)
+			mStartTime = timeEnd;
+	}
+	mFocused = focused;
+	mDrawnFirstSerial = firstLineSerial + lineNo;
+	mDrawnEndSerial = firstLineSerial + lineMax + 1;
+
 	if (!mLines.empty())
 	{
-		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+		const float spaceSize = mSpaceSize;
+		mLayoutCache.BeginFrame(LineLayoutMetrics{ ImGui::GetFontSize(), spaceSize, mData->GetTabSize() });
+		const LineLayoutCache::MeasureText measureText = [](std::string_view aText) {
+			return ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, aText.data(), aText.data() + aText.size()).x;
+		};
 
 		while (lineNo <= lineMax)
 		{
-			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + lineNo * mCharAdvance.y);
+			// In double: past a few million lines a float sum would lose the
+			// line spacing.
+			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, (float)((double)cursorScreenPos.y + (double)lineNo * mCharAdvance.y));
 			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
 			thisRenderGeometry.mTextScreenPos = textScreenPos;
 
 			auto& line = mLines[lineNo];
-			longest = std::max(mTextStart + TextDistanceToLineStart(Coordinates(lineNo, mData->GetLineMaxColumn(lineNo))), longest);
-			auto columnNo = 0;
-			Coordinates lineStartCoord(lineNo, 0);
-			Coordinates lineEndCoord(lineNo, mData->GetLineMaxColumn(lineNo));
 
 			// Draw selection for the current line
-			float sstart = -1.0f;
-			float ssend = -1.0f;
+			if (hasSelection && mUiState.mSelectionStart.mLine <= lineNo && lineNo <= mUiState.mSelectionEnd.mLine)
+			{
+				Coordinates lineStartCoord(lineNo, 0);
+				Coordinates lineEndCoord(lineNo, mData->GetLineMaxColumn(lineNo));
+				float sstart = -1.0f;
+				float ssend = -1.0f;
+
+				assert(mUiState.mSelectionStart <= mUiState.mSelectionEnd);
+				if (mUiState.mSelectionStart <= lineEndCoord)
+					sstart = mUiState.mSelectionStart > lineStartCoord ? TextDistanceToLineStart(mUiState.mSelectionStart) : 0.0f;
+				if (mUiState.mSelectionEnd > lineStartCoord)
+					ssend = TextDistanceToLineStart(mUiState.mSelectionEnd < lineEndCoord ? mUiState.mSelectionEnd : lineEndCoord);
 
-			assert(mUiState.mSelectionStart <= mUiState.mSelectionEnd);
-			if (mUiState.mSelectionStart <= lineEndCoord)
-				sstart = mUiState.mSelectionStart > lineStartCoord ? TextDistanceToLineStart(mUiState.mSelectionStart) : 0.0f;
-			if (mUiState.mSelectionEnd > lineStartCoord)
-				ssend = TextDistanceToLineStart(mUiState.mSelectionEnd < lineEndCoord ? mUiState.mSelectionEnd : lineEndCoord);
+				if (mUiState.mSelectionEnd.mLine > lineNo)
+					ssend += mCharAdvance.x;
 
-			if (mUiState.mSelectionEnd.mLine > lineNo)
-				ssend += mCharAdvance.x;
+				if (sstart != -1 && ssend != -1 && sstart < ssend)
+				{
+					ImVec2 vstart(lineStartScreenPos.x + mTextStart + sstart, lineStartScreenPos.y);
+					ImVec2 vend(lineStartScreenPos.x + mTextStart + ssend, lineStartScreenPos.y + mCharAdvance.y);
+					drawList->AddRectFilled(vstart, vend, mPalette[(int)PaletteIndex::Selection]);
+				}
+			}
 
-			if (sstart != -1 && ssend != -1 && sstart < ssend)
+			// Draw search matches, which may be stale if the line changed since the search ran
+			const uint64_t lineSerial = firstLineSerial + lineNo;
+			for (; visibleMatch != mVisibleMatches.cend() && visibleMatch->mLineSerial <= lineSerial; ++visibleMatch)
 			{
-				ImVec2 vstart(lineStartScreenPos.x + mTextStart + sstart, lineStartScreenPos.y);
-				ImVec2 vend(lineStartScreenPos.x + mTextStart + ssend, lineStartScreenPos.y + mCharAdvance.y);
-				drawList->AddRectFilled(vstart, vend, mPalette[(int)PaletteIndex::Selection]);
+				if (visibleMatch->mLineSerial < lineSerial)
+					continue;
+				const int startColumn = mData->GetCharacterColumn(lineNo, (int)visibleMatch->mStart);
+				const int endColumn = mData->GetCharacterColumn(lineNo, (int)(visibleMatch->mStart + visibleMatch->mLength));
+				const float mstart = TextDistanceToLineStart(Coordinates(lineNo, startColumn));
+				const float mend = TextDistanceToLineStart(Coordinates(lineNo, endColumn));
+				if (mstart < mend)
+				{
+					const bool current = mSearchCurrent && *mSearchCurrent == *visibleMatch;
+					ImVec2 vstart(lineStartScreenPos.x + mTextStart + mstart, lineStartScreenPos.y);
+					ImVec2 vend(lineStartScreenPos.x + mTextStart + mend, lineStartScreenPos.y + mCharAdvance.y);
+					drawList->AddRectFilled(vstart, vend, mPalette[(int)(current ? PaletteIndex::SearchMatchCurrent : PaletteIndex::SearchMatch)]);
+				}
 			}
 
 			// Draw breakpoints
@@ -818,26 +881,28 @@ void TerminalView::Render()
 			}
 
 			if (mOptions.TimeStamps) {
-				std::time_t time_t_timestamp = std::chrono::system_clock::to_time_t(line.GetTimestamp());
-				std::tm* time_tm_timestamp = std::localtime(&time_t_timestamp);
-				int len = snprintf(margin_work_buf_ptr, margin_work_buf_remainder, marginTimeStampStringFormat, time_tm_timestamp->tm_hour, time_tm_timestamp->tm_min, time_tm_timestamp->tm_sec);
-				if (len > 0) {
-					margin_work_buf_ptr += len;
-					margin_work_buf_remainder -= len;
-				}
+				const auto appendTimeStamp = [&](TerminalLine::Timestamp aTime) {
+					if (margin_work_buf_remainder > (int)TimestampFormatter::MaxLength + 1) {
+						const size_t len = mTimestampFormatter.Format(aTime, mOptions.TimeStampResolution, margin_work_buf_ptr);
+						margin_work_buf_ptr += len;
+						*margin_work_buf_ptr++ = ' ';
+						*margin_work_buf_ptr = '\0';
+						margin_work_buf_remainder -= (int)len + 1;
+					}
+				};
+				if (mOptions.TimeStampKind != LineTimestampKind::LastByte)
+					appendTimeStamp(line.GetFirstTimestamp());
+				if (mOptions.TimeStampKind != LineTimestampKind::FirstByte)
+					appendTimeStamp(line.GetTimestamp());
 			}
 			
 			auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, margin_work_buf, nullptr, nullptr).x;
 			drawList->AddText(ImVec2(lineStartScreenPos.x + mTextStart - lineNoWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], margin_work_buf);
 
-			mUiState.mCursorPosition = mTermState->getPositionRelative(mLines.size());
-
 			if (mUiState.mCursorPosition.mLine == lineNo)
 			{
-				auto focused = ImGui::IsWindowFocused();
-
 				// Highlight the current line (where the cursor is)
-				if (!HasSelection())
+				if (!hasSelection)
 				{
 					auto end = ImVec2(start.x + contentSize.x + scrollX, start.y + mCharAdvance.y);
 					drawList->AddRectFilled(start, end, mPalette[(int)(focused ? PaletteIndex::CurrentLineFill : PaletteIndex::CurrentLineFillInactive)]);
@@ -845,56 +910,37 @@ void TerminalView::Render()
 				}
 
 				// Render the cursor
-				if (focused)
+				if (cursorBlinkOn)
 				{
-					auto timeEnd = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-					auto elapsed = timeEnd - mStartTime;
-					if (elapsed > 400)
-					{
-						float width = 1.0f;
-						auto cindex = mData->GetCharacterIndex(mUiState.mCursorPosition);
-						float cx = TextDistanceToLineStart(mUiState.mCursorPosition);
-
-						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
-						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + mCharAdvance.y);
-						drawList->AddRectFilled(cstart, cend, mPalette[(int)PaletteIndex::Cursor]);
-						if (elapsed > 800)
-							mStartTime = timeEnd;
-					}
+					float width = 1.0f;
+					float cx = TextDistanceToLineStart(mUiState.mCursorPosition);
+
+					ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
+					ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + mCharAdvance.y);
+					drawList->AddRectFilled(cstart, cend, mPalette[(int)PaletteIndex::Cursor]);
 				}
 			}
 
-			// Render colorized text
-			auto prevColor = line.empty() ? mPalette[(int)PaletteIndex::Default] : GetGlyphColor(line[0]);
-			ImVec2 bufferOffset;
-
-			for (int i = 0; i < line.size();)
+			// Render colorized text. Unchanged lines reuse the runs laid out
+			// when they were first drawn.
+			const LineLayout& layout = mLayoutCache.Get(line, measureText);
+			for (const LineLayout::Run& run : layout.mRuns)
 			{
-				auto& glyph = line[i];
-				auto color = GetGlyphColor(glyph);
-
-				if ((color != prevColor || glyph.mChar == '\t' || glyph.mChar == ' ') && !mLineBuffer.empty())
-				{
-					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-					drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-					auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr);
-					bufferOffset.x += textSize.x;
-					mLineBuffer.clear();
-				}
-				prevColor = color;
+				const ImU32 color = mColorizerEnabled ? mPalette[(int)run.mColorIndex] : mPalette[(int)PaletteIndex::Default];
+				drawList->AddText(ImVec2(textScreenPos.x + run.mX, textScreenPos.y), color,
+					layout.mText.data() + run.mBegin, layout.mText.data() + run.mEnd);
+			}
 
-				if (glyph.mChar == '\t')
+			if (mShowWhitespaces)
+			{
+				const auto s = ImGui::GetFontSize();
+				const auto y = textScreenPos.y + s * 0.5f;
+				for (const LineLayout::Blank& blank : layout.mBlanks)
 				{
-					auto oldX = bufferOffset.x;
-					bufferOffset.x = (1.0f + std::floor((1.0f + bufferOffset.x) / (float(mData->GetTabSize()) * spaceSize))) * (float(mData->GetTabSize()) * spaceSize);
-					++i;
-
-					if (mShowWhitespaces)
+					if (blank.mTab)
 					{
-						const auto s = ImGui::GetFontSize();
-						const auto x1 = textScreenPos.x + oldX + 1.0f;
-						const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+						const auto x1 = textScreenPos.x + blank.mX + 1.0f;
+						const auto x2 = textScreenPos.x + blank.mX + blank.mWidth - 1.0f;
 						const ImVec2 p1(x1, y);
 						const ImVec2 p2(x2, y);
 						const ImVec2 p3(x2 - s * 0.2f, y - s * 0.2f);
@@ -903,34 +949,12 @@ void TerminalView::Render()
 						drawList->AddLine(p2, p3, 0x90909090);
 						drawList->AddLine(p2, p4, 0x90909090);
 					}
-				}
-				else if (glyph.mChar == ' ')
-				{
-					if (mShowWhitespaces)
+					else
 					{
-						const auto s = ImGui::GetFontSize();
-						const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
-						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
+						const auto x = textScreenPos.x + blank.mX + spaceSize * 0.5f;
 						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
 					}
-					bufferOffset.x += spaceSize;
-					i++;
-				}
-				else
-				{
-					size_t l = TerminalData::UTF8CharLength(glyph.mChar);
-					l = std::min(l, (line.size() - i));
-					while (l-- > 0)
-						mLineBuffer.push_back(line[i++].mChar);
 				}
-				++columnNo;
-			}
-
-			if (!mLineBuffer.empty())
-			{
-				const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-				drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-				mLineBuffer.clear();
 			}
 
 			++lineNo;
@@ -939,7 +963,9 @@ void TerminalView::Render()
 	}
 
 
-	ImGui::Dummy(ImVec2((longest + 2), mLines.size() * mCharAdvance.y));
+	// The width comes from the widest line TerminalData has seen rather than
+	// from measuring lines, so it does not depend on which lines are visible.
+	ImGui::Dummy(ImVec2(mTextStart + mData->GetWidestLineColumn() * mCharAdvance.x + 2, mLines.size() * mCharAdvance.y));
 
 	if (mScrollToCursor)
 	{
@@ -954,9 +980,27 @@ void TerminalView::Render()
 void TerminalView::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 {
 	mWithinRender = true;
-	mData->SetTextChanged(false);
 	mCursorPositionChanged = false;
 
+	// Whatever changed so far is drawn by this frame.
+	mData->TakeChangedSerials(mChangeTracker);
+	mDrawnFirstLineSerial = mData->GetFirstLineSerial();
+	mDrawnLineCount = mLines.size();
+	mDrawnJournalSize = mJournal ? mJournal->GetSize() : 0;
+	mScrollRangeStale = false;
+	mLastRenderTime = std::chrono::steady_clock::now();
+
+	if (mOptions.HexView && mJournal)
+	{
+		mFocused = false;
+		RenderHexView(aTitle, aSize, aBorder);
+		mWithinRender = false;
+		return;
+	}
+
+	if (mSearchOpen)
+		RenderSearchBar();
+
 	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(mPalette[(int)PaletteIndex::Background]));
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
 	if (!mIgnoreImGuiChild)
@@ -971,7 +1015,12 @@ void TerminalView::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	if (mHandleMouseInputs)
 		HandleMouseInputs();
 
+	const auto renderStart = std::chrono::steady_clock::now();
 	Render();
+	RecordRenderTime(std::chrono::steady_clock::now() - renderStart);
+
+	if (mOptions.RenderTime)
+		RenderTimingOverlay();
 
 	if (mHandleKeyboardInputs)
 		ImGui::PopItemFlag();
@@ -985,6 +1034,328 @@ void TerminalView::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	mWithinRender = false;
 }
 
+bool TerminalView::TakeRedrawRequest()
+{
+	bool redraw = mCursorPositionChanged || (mSearchOpen && mSearchBusy);
+	if (const auto changed = mData->TakeChangedSerials(mChangeTracker))
+		redraw |= changed->mFirst < mDrawnEndSerial && changed->mEnd > mDrawnFirstSerial;
+	redraw |= mData->GetFirstLineSerial() != mDrawnFirstLineSerial;
+
+	if (mOptions.HexView && mJournal)
+		redraw |= mJournal->GetSize() != mDrawnJournalSize;
+	else if (mLines.size() != mDrawnLineCount)
+		mScrollRangeStale = true;
+
+	return redraw || (mScrollRangeStale && std::chrono::steady_clock::now() - mLastRenderTime >= ScrollRangeRefresh);
+}
+
+std::optional<std::chrono::milliseconds> TerminalView::GetRedrawDeadline() const
+{
+	using std::chrono::milliseconds;
+	std::optional<milliseconds> deadline;
+	if (mScrollRangeStale)
+	{
+		const auto since = std::chrono::duration_cast<milliseconds>(std::chrono::steady_clock::now() - mLastRenderTime);
+		deadline = std::max(milliseconds(0), ScrollRangeRefresh - since);
+	}
+	if (mFocused)
+	{
+		const auto now = std::chrono::duration_cast<milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		const auto elapsed = now - (int64_t)mStartTime;
+		const milliseconds blink(std::max<int64_t>(0, (elapsed < CursorBlinkOnMs ? CursorBlinkOnMs : CursorBlinkPeriodMs) - elapsed + 1));
+		deadline = deadline ? std::min(*deadline, blink) : blink;
+	}
+	return deadline;
+}
+
+void TerminalView::RecordRenderTime(std::chrono::steady_clock::duration aElapsed)
+{
+	// A slow frame shows at once and ages out after a window of frames.
+	constexpr int worstWindowFrames = 120;
+
+	const float ms = std::chrono::duration<float, std::milli>(aElapsed).count();
+	mRenderTiming.mLastMs = ms;
+	mRenderTiming.mAverageMs = mRenderTiming.mFrames == 0 ? ms : mRenderTiming.mAverageMs + (ms - mRenderTiming.mAverageMs) * 0.05f;
+	mRenderTiming.mWorstMs = std::max(mRenderTiming.mWorstMs, ms);
+	mRenderTimingWindowWorst = std::max(mRenderTimingWindowWorst, ms);
+	if (++mRenderTimingWindowFrames >= worstWindowFrames)
+	{
+		mRenderTiming.mWorstMs = mRenderTimingWindowWorst;
+		mRenderTimingWindowWorst = 0.0f;
+		mRenderTimingWindowFrames = 0;
+	}
+	++mRenderTiming.mFrames;
+}
+
+void TerminalView::RenderTimingOverlay()
+{
+	char text[96];
+	snprintf(text, sizeof(text), "render %.3f ms avg, %.3f ms worst, %zu lines",
+		mRenderTiming.mAverageMs, mRenderTiming.mWorstMs, mLines.size());
+
+	const ImVec2 size = ImGui::CalcTextSize(text);
+	const ImVec2 windowPos = ImGui::GetWindowPos();
+	const ImVec2 start(windowPos.x + ImGui::GetWindowContentRegionMax().x - size.x - mCharAdvance.x, windowPos.y + mCharAdvance.y * 0.25f);
+	auto drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(start, ImVec2(start.x + size.x, start.y + size.y), mPalette[(int)PaletteIndex::Background]);
+	drawList->AddText(start, mPalette[(int)PaletteIndex::LineNumber], text);
+}
+
+void TerminalView::RenderHexView(const char* aTitle, const ImVec2& aSize, bool aBorder)
+{
+	constexpr uint64_t bytesPerRow = 16;
+	const uint64_t size = mJournal->GetSize();
+	const uint64_t rowCount = (size + bytesPerRow - 1) / bytesPerRow;
+
+	ImGui::SetNextItemWidth(ImGui::GetFontSize() * 10.0f);
+	if (ImGui::InputTextWithHint("##HexGoTo", "Go to offset", mHexGoTo.data(), mHexGoTo.size(),
+		ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue))
+	{
+		mHexTopRow = std::strtoull(mHexGoTo.data(), nullptr, 16) / bytesPerRow;
+		mHexFollow = false;
+	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Follow", &mHexFollow);
+	ImGui::SameLine();
+	if (mJournal->GetDroppedBytes() > 0)
+		ImGui::Text("%llu bytes, %llu not recorded", (unsigned long long)size, (unsigned long long)mJournal->GetDroppedBytes());
+	else
+		ImGui::Text("%llu bytes", (unsigned long long)size);
+
+	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(mPalette[(int)PaletteIndex::Background]));
+	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
+	ImGui::BeginChild(aTitle, aSize, aBorder, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoNavInputs);
+
+	// Typing still goes to the device
+	if (mHandleKeyboardInputs)
+		HandleKeyboardInputs();
+
+	const float lineHeight = ImGui::GetTextLineHeightWithSpacing();
+	const ImVec2 origin = ImGui::GetCursorScreenPos();
+	const ImVec2 region = ImGui::GetContentRegionAvail();
+	const float scrollbarWidth = ImGui::GetStyle().ScrollbarSize;
+	const uint64_t visibleRows = (uint64_t)std::max(1.0f, std::floor(region.y / lineHeight));
+	const uint64_t lastTopRow = rowCount > visibleRows ? rowCount - visibleRows : 0;
+
+	if (ImGui::IsWindowHovered() && ImGui::GetIO().MouseWheel != 0.0f)
+	{
+		const int64_t rows = (int64_t)(ImGui::GetIO().MouseWheel * -3.0f);
+		if (rows < 0)
+			mHexTopRow -= std::min(mHexTopRow, (uint64_t)-rows);
+		else
+			mHexTopRow += (uint64_t)rows;
+		mHexFollow = mHexTopRow >= lastTopRow;
+	}
+
+	// A slider stands in for the scrollbar; its value counts rows up from the
+	// end so that dragging it down moves down the journal.
+	uint64_t rowsFromEnd = lastTopRow - std::min(mHexTopRow, lastTopRow);
+	const uint64_t noRows = 0;
+	ImGui::SetCursorScreenPos(ImVec2(origin.x + region.x - scrollbarWidth, origin.y));
+	if (ImGui::VSliderScalar("##HexScroll", ImVec2(scrollbarWidth, region.y), ImGuiDataType_U64, &rowsFromEnd, &noRows, &lastTopRow, ""))
+	{
+		mHexTopRow = lastTopRow - rowsFromEnd;
+		mHexFollow = rowsFromEnd == 0;
+	}
+
+	if (mHexFollow)
+		mHexTopRow = lastTopRow;
+	mHexTopRow = std::min(mHexTopRow, lastTopRow);
+
+	// One read covers every visible row; the journal maps only the chunks it
+	// touches.
+	mHexBytes.resize(visibleRows * bytesPerRow);
+	const size_t count = mJournal->Read(mHexTopRow * bytesPerRow, mHexBytes);
+
+	auto drawList = ImGui::GetWindowDrawList();
+	const float fontSize = ImGui::GetFontSize();
+	const ImU32 marginColor = mPalette[(int)PaletteIndex::LineNumber];
+	const ImU32 textColor = mPalette[(int)PaletteIndex::Default];
+	static const char hexDigits[] = "0123456789ABCDEF";
+
+	for (size_t row = 0; row * bytesPerRow < count; ++row)
+	{
+		const uint64_t offset = (mHexTopRow + row) * bytesPerRow;
+		const size_t rowBytes = std::min<size_t>(bytesPerRow, count - row * bytesPerRow);
+		const uint8_t* bytes = mHexBytes.data() + row * bytesPerRow;
+		const ImVec2 rowPos(origin.x, origin.y + row * lineHeight);
+
+		char margin[40];
+		int marginLength = snprintf(margin, sizeof(margin), "%010llX", (unsigned long long)offset);
+		if (mOptions.TimeStamps)
+		{
+			if (const auto time = mJournal->GetTime(offset))
+			{
+				margin[marginLength++] = ' ';
+				marginLength += (int)mTimestampFormatter.Format(*time, TimestampResolution::Milliseconds, margin + marginLength);
+			}
+		}
+		drawList->AddText(rowPos, marginColor, margin, margin + marginLength);
+		const float hexStart = rowPos.x + ImGui::GetFont()->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, margin, margin + marginLength).x + mCharAdvance.x * 2;
+
+		// "XX XX ... XX  XX ... XX  ascii"
+		char text[bytesPerRow * 4 + 4];
+		char* hex = text;
+		for (size_t i = 0; i < bytesPerRow; ++i)
+		{
+			if (i == bytesPerRow / 2)
+				*hex++ = ' ';
+			if (i < rowBytes)
+			{
+				*hex++ = hexDigits[bytes[i] >> 4];
+				*hex++ = hexDigits[bytes[i] & 0xF];
+			}
+			else
+			{
+				*hex++ = ' ';
+				*hex++ = ' ';
+			}
+			*hex++ = ' ';
+		}
+		*hex++ = ' ';
+		for (size_t i = 0; i < rowBytes; ++i)
+			*hex++ = bytes[i] >= 0x20 && bytes[i] < 0x7F ? (char)bytes[i] : '.';
+		drawList->AddText(ImVec2(hexStart, rowPos.y), textColor, text, hex);
+	}
+
+	ImGui::EndChild();
+	ImGui::PopStyleVar();
+	ImGui::PopStyleColor();
+}
+
+void TerminalView::OpenSearch()
+{
+	if (!mSearch)
+		mSearch = std::make_unique<TerminalSearch>(mData);
+	mSearchOpen = true;
+	mSearchFocusInput = true;
+}
+
+void TerminalView::CloseSearch()
+{
+	if (mSearch)
+		mSearch->Cancel();
+	mSearchOpen = false;
+	mSearchPending = false;
+	mSearchCurrent.reset();
+	mSearchError.clear();
+}
+
+void TerminalView::RenderSearchBar()
+{
+	// The index is brought up to date a slice per frame while the bar is open.
+	const bool indexed = mSearch->Update();
+
+	bool changed = false;
+	bool forward = false;
+	bool backward = false;
+
+	if (mSearchFocusInput)
+	{
+		ImGui::SetKeyboardFocusHere();
+		mSearchFocusInput = false;
+	}
+	ImGui::SetNextItemWidth(ImGui::GetFontSize() * 20.0f);
+	if (ImGui::InputTextWithHint("##SearchText", "Search", mSearchText.data(), mSearchText.size(), ImGuiInputTextFlags_EnterReturnsTrue))
+	{
+		// Enter goes to the next match and Shift+Enter to the previous one
+		(ImGui::GetIO().KeyShift ? backward : forward) = true;
+		mSearchFocusInput = true;
+	}
+	changed |= ImGui::IsItemEdited();
+	// Escape deactivates the text box before we get to see it
+	const bool escape = (ImGui::IsItemActive() || ImGui::IsItemDeactivated()) && ImGui::IsKeyPressed(ImGuiKey_Escape);
+
+	ImGui::SameLine();
+	changed |= ImGui::Checkbox("Aa", &mSearchQuery.mCaseSensitive);
+	ImGui::SameLine();
+	changed |= ImGui::Checkbox(".*", &mSearchQuery.mRegex);
+	ImGui::SameLine();
+	backward |= ImGui::ArrowButton("##SearchPrevious", ImGuiDir_Up);
+	ImGui::SameLine();
+	forward |= ImGui::ArrowButton("##SearchNext", ImGuiDir_Down);
+	ImGui::SameLine();
+
+	if (changed)
+	{
+		mSearch->Cancel();
+		mSearchQuery.mText = mSearchText.data();
+		mSearchPending = true;
+		mSearchCurrent.reset();
+		mSearchError.clear();
+	}
+	if (mSearchPending && indexed)
+		StartSearch();
+	mSearchBusy = !indexed || mSearchPending || (!mSearchQuery.mText.empty() && !mSearch->GetProgress().mFinished);
+
+	if (!mSearchError.empty())
+	{
+		ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", mSearchError.c_str());
+	}
+	else if (mSearchPending)
+	{
+		ImGui::TextUnformatted("Indexing...");
+	}
+	else if (!mSearchQuery.mText.empty())
+	{
+		const TerminalSearch::Progress progress = mSearch->GetProgress();
+		if (progress.mFinished)
+			ImGui::Text("%zu matches", progress.mMatches);
+		else
+			ImGui::Text("%zu matches (%d%%)", progress.mMatches,
+				(int)(progress.mLinesTotal ? progress.mLinesSearched * 100 / progress.mLinesTotal : 0));
+	}
+	ImGui::SameLine();
+	const bool close = ImGui::SmallButton("x##SearchClose");
+
+	if (forward || backward)
+		GoToSearchMatch(forward);
+	if (close || escape)
+		CloseSearch();
+}
+
+void TerminalView::StartSearch()
+{
+	mSearchPending = false;
+	try
+	{
+		mSearch->Start(mSearchQuery);
+	}
+	catch (const std::regex_error& error)
+	{
+		mSearchError = error.what();
+	}
+}
+
+void TerminalView::GoToSearchMatch(bool aForward)
+{
+	const uint64_t firstLineSerial = mData->GetFirstLineSerial();
+	uint64_t serial = firstLineSerial;
+	uint32_t byte = 0;
+	if (mSearchCurrent && mSearchCurrent->mLineSerial >= firstLineSerial)
+	{
+		serial = mSearchCurrent->mLineSerial;
+		byte = mSearchCurrent->mStart;
+	}
+	else
+	{
+		// Continue from the top of the view, including a match at its very start
+		if (mLastRenderGeometry.mValid)
+			serial += (uint64_t)std::max(mLastRenderGeometry.mFirstVisibleLineNo, 0);
+		if (aForward && serial > 0)
+		{
+			--serial;
+			byte = UINT32_MAX;
+		}
+	}
+
+	const auto match = mSearch->FindNext(serial, byte, aForward);
+	if (!match || match->mLineSerial < firstLineSerial)
+		return;
+	mSearchCurrent = match;
+	mScrollToSearchMatch = true;
+}
+
 void TerminalView::SetColorizerEnable(bool aValue)
 {
 	mColorizerEnabled = aValue;
@@ -1393,7 +1764,7 @@ void TerminalView::Copy()
 		{
 			std::string str;
 			auto& line = mLines[GetActualCursorCoordinates().mLine];
-			for (auto& g : line)
+			for (const auto& g : line)
 				str.push_back(g.mChar);
 			ImGui::SetClipboardText(str.c_str());
 		}
@@ -1410,6 +1781,9 @@ void TerminalView::Paste()
 	auto clipText = ImGui::GetClipboardText();
 	if (clipText != nullptr && strlen(clipText) > 0)
 	{
+		if (mPasteHandler && mPasteHandler(clipText)) {
+			return;
+		}
 		AddKeyboardInput(clipText);
 	}
 }
@@ -1442,6 +1816,8 @@ const TerminalView::Palette & TerminalView::GetDarkPalette()
 			0x40000000, // Current line fill
 			0x40808080, // Current line fill (inactive)
 			0x40a0a0a0, // Current line edge
+			0x6000a0e0, // Search match
+			0xa000c0ff, // Search match (current)
 			0xff000000, //        Black   ANSI FG=30 BG= 40
 			0xff0000bb, //        Red     ANSI FG=31 BG= 41
 			0xff00bb00, //        Green   ANSI FG=32 BG= 42
@@ -1486,6 +1862,8 @@ const TerminalView::Palette & TerminalView::GetLightPalette()
 			0x40000000, // Current line fill
 			0x40808080, // Current line fill (inactive)
 			0x40000000, // Current line edge
+			0x6000c0ff, // Search match
+			0xa00080ff, // Search match (current)
 			0xff000000, //        Black   ANSI FG=30 BG= 40
 			0xff0000bb, //        Red     ANSI FG=31 BG= 41
 			0xff00bb00, //        Green   ANSI FG=32 BG= 42
@@ -1530,6 +1908,8 @@ const TerminalView::Palette & TerminalView::GetRetroBluePalette()
 			0x40000000, // Current line fill
 			0x40808080, // Current line fill (inactive)
 			0x40000000, // Current line edge
+			0x6000a0e0, // Search match
+			0xa000c0ff, // Search match (current)
 			0xff000000, //        Black   ANSI FG=30 BG= 40
 			0xff0000bb, //        Red     ANSI FG=31 BG= 41
 			0xff00bb00, //        Green   ANSI FG=32 BG= 42
@@ -1609,7 +1989,7 @@ float TerminalView::TextDistanceToLineStart(const Coordinates& aFrom) const
 {
 	auto& line = mLines[aFrom.mLine];
 	float distance = 0.0f;
-	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+	float spaceSize = mSpaceSize;
 	int colIndex = mData->GetCharacterIndex(aFrom);
 	for (size_t it = 0u; it < line.size() && it < colIndex; )
 	{
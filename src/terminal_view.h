@@ -10,12 +10,19 @@
 #include <regex>
 #include <queue>
 #include <chrono>
+#include <optional>
+#include <functional>
+#include <string_view>
 
 #include "imgui.h"
 #include "coordinates.h"
 #include "escape_sequence_parser.h"
+#include "line_layout_cache.h"
+#include "receive_journal.h"
 #include "terminal_state.h"
 #include "terminal_data.h"
+#include "terminal_search.h"
+#include "timestamp_formatter.h"
 
 namespace imterm {
 
@@ -26,6 +33,25 @@ namespace imterm {
 		struct Options {
 			bool LineNumbers = true;
 			bool TimeStamps = true;
+			TimestampResolution TimeStampResolution = TimestampResolution::Seconds;
+			LineTimestampKind TimeStampKind = LineTimestampKind::LastByte;
+			// Show the received bytes in hex instead of the terminal, when a
+			// journal is set.
+			bool HexView = false;
+			// Overlay the time spent laying out the terminal each frame.
+			bool RenderTime = false;
+		};
+
+		// CPU time spent laying out the terminal, excluding the rest of the UI
+		// and the GPU.
+		struct RenderTiming
+		{
+			float mLastMs = 0.0f;
+			// Exponential moving average over roughly the last 20 frames.
+			float mAverageMs = 0.0f;
+			// Worst over roughly the last two seconds at 60 frames a second.
+			float mWorstMs = 0.0f;
+			uint64_t mFrames = 0;
 		};
 
 		enum class SelectionMode
@@ -107,9 +133,20 @@ namespace imterm {
 
 		int GetTotalLines() const { return (int)mLines.size(); }
 
-		bool IsTextChanged() const { return mData->IsTextChanged(); }
+		const RenderTiming& GetRenderTiming() const { return mRenderTiming; }
+
 		bool IsCursorPositionChanged() const { return mCursorPositionChanged; }
 
+		// For callers that skip frames while nothing changes. TakeRedrawRequest()
+		// is true when lines drawn by the last Render() have changed since, the
+		// cursor moved, lines were trimmed from the top, or a search is still
+		// running; lines added out of sight only refresh the scroll range a few
+		// times a second. GetRedrawDeadline() is how long the view can go
+		// without a frame: until the next cursor blink while focused or the
+		// next scroll range refresh, and nullopt when nothing is due.
+		bool TakeRedrawRequest();
+		std::optional<std::chrono::milliseconds> GetRedrawDeadline() const;
+
 		bool IsColorizerEnabled() const { return mColorizerEnabled; }
 		void SetColorizerEnable(bool aValue);
 
@@ -170,9 +207,23 @@ namespace imterm {
 		ImWchar GetKeyboardInput();
 		bool KeyboardInputAvailable();
 
+		// Called with the clipboard text on paste, instead of queuing it as
+		// keyboard input; returns false to have it queued after all. Lets the
+		// capture stream a long paste in chunks.
+		void SetPasteHandler(std::function<bool(std::string_view)> aHandler) { mPasteHandler = std::move(aHandler); }
+
 		inline Options GetOptions() { return mOptions; }
 		void SetOptions(const Options& aOptions) { mOptions = aOptions; }
 
+		// Shows the search bar above the terminal; Ctrl+Shift+F does the same.
+		// The search index is built the first time it is opened.
+		void OpenSearch();
+		void CloseSearch();
+		bool IsSearchOpen() const { return mSearchOpen; }
+
+		// The raw received bytes shown by the hex view.
+		void SetJournal(std::shared_ptr<const ReceiveJournal> aJournal) { mJournal = std::move(aJournal); }
+
 	private:
 		typedef std::vector<std::pair<std::regex, PaletteIndex>> RegexList;
 
@@ -207,6 +258,12 @@ namespace imterm {
 		void HandleKeyboardInputs();
 		void HandleMouseInputs();
 		void Render();
+		void RenderSearchBar();
+		void StartSearch();
+		void GoToSearchMatch(bool aForward);
+		void RenderHexView(const char* aTitle, const ImVec2& aSize, bool aBorder);
+		void RecordRenderTime(std::chrono::steady_clock::duration aElapsed);
+		void RenderTimingOverlay();
 
 		void InputGlyph(Line& line, int& termColI, PaletteIndex pi, uint8_t aValue);
 
@@ -233,25 +290,66 @@ namespace imterm {
 
 		Palette mPaletteBase;
 		Palette mPalette;
+		// Style alpha mPalette was computed for; negative after SetPalette().
+		float mPaletteAlpha = -1.0f;
 
 		Breakpoints mBreakpoints;
 		ErrorMarkers mErrorMarkers;
 		ImVec2 mCharAdvance;
+		float mSpaceSize = 0.0f;
 		Coordinates mInteractiveStart, mInteractiveEnd;
-		std::string mLineBuffer;
+		LineLayoutCache mLayoutCache;
+		TimestampFormatter mTimestampFormatter;
 		uint64_t mStartTime;
 
 		float mLastClick;
 
 		RenderGeometry mLastRenderGeometry;
+		RenderTiming mRenderTiming;
+		float mRenderTimingWindowWorst = 0.0f;
+		int mRenderTimingWindowFrames = 0;
 		std::queue<ImVector<ImWchar>> mQueuedInputQueueCharacters;
 		std::queue<ImWchar> mKeyboardInputQueue;
+		std::function<bool(std::string_view)> mPasteHandler;
 
 		//TerminalState& mTermState;
 		std::shared_ptr<TerminalState> mTermState = nullptr;
 
 		Options mOptions;
 
+		std::unique_ptr<TerminalSearch> mSearch;
+		bool mSearchOpen = false;
+		bool mSearchFocusInput = false;
+		bool mSearchPending = false;	// start once the index has caught up
+		bool mScrollToSearchMatch = false;
+		std::array<char, 256> mSearchText{};
+		TerminalSearch::Query mSearchQuery;
+		std::string mSearchError;
+		std::optional<TerminalSearch::Match> mSearchCurrent;
+		std::vector<TerminalSearch::Match> mVisibleMatches;
+		bool mSearchBusy = false;	// indexing or searching, so progress changes each frame
+
+		// What the last Render() showed, for TakeRedrawRequest().
+		static constexpr std::chrono::milliseconds ScrollRangeRefresh{ 250 };
+		static constexpr int CursorBlinkOnMs = 400;
+		static constexpr int CursorBlinkPeriodMs = 800;
+		TerminalData::ChangeTracker mChangeTracker;
+		uint64_t mDrawnFirstSerial = 0;
+		uint64_t mDrawnEndSerial = 0;
+		uint64_t mDrawnFirstLineSerial = 0;
+		size_t mDrawnLineCount = 0;
+		uint64_t mDrawnJournalSize = 0;
+		bool mFocused = false;
+		bool mScrollRangeStale = false;
+		std::chrono::steady_clock::time_point mLastRenderTime;
+
+		// The hex view scrolls itself in whole rows: a float scroll position
+		// cannot address every row of a multi-gigabyte journal.
+		std::shared_ptr<const ReceiveJournal> mJournal;
+		uint64_t mHexTopRow = 0;
+		bool mHexFollow = true;
+		std::array<char, 20> mHexGoTo{};
+		std::vector<uint8_t> mHexBytes;
 
 	};
 }
@@ -0,0 +1,135 @@
+#include "timestamp_formatter.h"
+
+#include <cstring>
+#include <ctime>
+
+namespace imterm {
+
+	namespace {
+
+		constexpr int64_t SecondsPerDay = 24 * 60 * 60;
+		constexpr int64_t SecondsPerHour = 60 * 60;
+
+		int64_t FloorDiv(int64_t aValue, int64_t aDivisor) noexcept
+		{
+			const int64_t quotient = aValue / aDivisor;
+			return (aValue % aDivisor < 0) ? quotient - 1 : quotient;
+		}
+
+		// Local time minus UTC at aSecond, from the C library.
+		bool LocalOffset(int64_t aSecond, int64_t& aOffset)
+		{
+			const std::time_t time = static_cast<std::time_t>(aSecond);
+			std::tm local{};
+#if defined(_WIN32)
+			if (localtime_s(&local, &time) != 0) {
+				return false;
+			}
+#else
+			if (!localtime_r(&time, &local)) {
+				return false;
+			}
+#endif
+			const std::chrono::sys_days day = std::chrono::year(local.tm_year + 1900)
+				/ std::chrono::month(static_cast<unsigned>(local.tm_mon + 1))
+				/ std::chrono::day(static_cast<unsigned>(local.tm_mday));
+			const int64_t localSecond = static_cast<int64_t>(day.time_since_epoch().count()) * SecondsPerDay
+				+ local.tm_hour * SecondsPerHour + local.tm_min * 60 + local.tm_sec;
+			aOffset = localSecond - aSecond;
+			return true;
+		}
+
+		char* WriteDigits(char* aOut, int64_t aValue, int aDigits) noexcept
+		{
+			for (int i = aDigits - 1; i >= 0; --i) {
+				aOut[i] = static_cast<char>('0' + aValue % 10);
+				aValue /= 10;
+			}
+			return aOut + aDigits;
+		}
+
+	}
+
+	size_t TimestampFormatter::Format(Timestamp aTime, TimestampResolution aResolution, char* aOut)
+	{
+		const int64_t micros = std::chrono::floor<std::chrono::microseconds>(aTime.time_since_epoch()).count();
+		const int64_t second = FloorDiv(micros, 1000000);
+		const int64_t fraction = micros - second * 1000000;
+
+		if (!mHaveLastSecond || second != mLastSecond) {
+			if (second < mWindowBegin || second >= mWindowEnd) {
+				LookUpOffset(second);
+			}
+			const int64_t secondOfDay = (second + mOffset) - FloorDiv(second + mOffset, SecondsPerDay) * SecondsPerDay;
+			char* text = mLastText;
+			text = WriteDigits(text, secondOfDay / SecondsPerHour, 2);
+			*text++ = ':';
+			text = WriteDigits(text, secondOfDay / 60 % 60, 2);
+			*text++ = ':';
+			WriteDigits(text, secondOfDay % 60, 2);
+			mLastSecond = second;
+			mHaveLastSecond = true;
+		}
+
+		std::memcpy(aOut, mLastText, sizeof(mLastText));
+		char* out = aOut + sizeof(mLastText);
+		switch (aResolution) {
+		case TimestampResolution::Milliseconds:
+			*out++ = '.';
+			out = WriteDigits(out, fraction / 1000, 3);
+			break;
+		case TimestampResolution::Microseconds:
+			*out++ = '.';
+			out = WriteDigits(out, fraction, 6);
+			break;
+		default:
+			break;
+		}
+		return static_cast<size_t>(out - aOut);
+	}
+
+	void TimestampFormatter::Append(Timestamp aTime, TimestampResolution aResolution, std::string& aOut)
+	{
+		char text[MaxLength];
+		aOut.append(text, Format(aTime, aResolution, text));
+	}
+
+	void TimestampFormatter::Reset() noexcept
+	{
+		mWindowBegin = 0;
+		mWindowEnd = 0;
+		mHaveLastSecond = false;
+	}
+
+	void TimestampFormatter::LookUpOffset(int64_t aSecond)
+	{
+		int64_t offset = 0;
+		if (!LocalOffset(aSecond, offset)) {
+			// Without a local time, show UTC.
+			mOffset = 0;
+			mWindowBegin = aSecond;
+			mWindowEnd = aSecond + 1;
+			return;
+		}
+
+		// The offset changes a few times a year at most, and then on a local
+		// hour boundary in practice. Keep it for the local day, or on the day
+		// it changes, for the local hour, as long as it holds at both ends.
+		mOffset = offset;
+		for (const int64_t span : { SecondsPerDay, SecondsPerHour }) {
+			const int64_t begin = FloorDiv(aSecond + offset, span) * span - offset;
+			const int64_t end = begin + span;
+			int64_t beginOffset = 0;
+			int64_t lastOffset = 0;
+			if (LocalOffset(begin, beginOffset) && beginOffset == offset
+				&& LocalOffset(end - 1, lastOffset) && lastOffset == offset) {
+				mWindowBegin = begin;
+				mWindowEnd = end;
+				return;
+			}
+		}
+		mWindowBegin = aSecond;
+		mWindowEnd = aSecond + 1;
+	}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace imterm {
+
+	enum class TimestampResolution : uint8_t
+	{
+		Seconds,
+		Milliseconds,
+		Microseconds
+	};
+
+	// Formats times as local time of day, "HH:MM:SS" with an optional
+	// ".mmm" or ".uuuuuu" fraction, for the line margin and the log.
+	//
+	// std::localtime takes a global lock and reads the time zone on every
+	// call. The formatter asks the C library only for the UTC offset, and
+	// keeps it for the local day (or hour, on a day the offset changes) that
+	// contained the time. Every other time is formatted with integer
+	// arithmetic, and a time in the same second as the previous one copies its
+	// text. Instances are not thread-safe; each caller keeps its own.
+	class TimestampFormatter
+	{
+	public:
+		using Timestamp = std::chrono::system_clock::time_point;
+
+		// Longest text Format() writes: "HH:MM:SS.uuuuuu".
+		static constexpr size_t MaxLength = 15;
+
+		static constexpr size_t Length(TimestampResolution aResolution) noexcept {
+			switch (aResolution) {
+			case TimestampResolution::Milliseconds: return 12;
+			case TimestampResolution::Microseconds: return 15;
+			default: return 8;
+			}
+		}
+
+		// Writes aTime to aOut, which must have room for MaxLength characters,
+		// and returns the number written. The text is not null-terminated.
+		size_t Format(Timestamp aTime, TimestampResolution aResolution, char* aOut);
+		void Append(Timestamp aTime, TimestampResolution aResolution, std::string& aOut);
+
+		// Forgets the cached UTC offset, for after the time zone changed.
+		void Reset() noexcept;
+
+	private:
+		// Makes [mWindowBegin, mWindowEnd) hold aSecond, in seconds since the
+		// epoch.
+		void LookUpOffset(int64_t aSecond);
+
+		int64_t mWindowBegin = 0;
+		int64_t mWindowEnd = 0;
+		// Local time minus UTC, in seconds, throughout the window.
+		int64_t mOffset = 0;
+
+		bool mHaveLastSecond = false;
+		int64_t mLastSecond = 0;
+		char mLastText[8] = {};
+	};
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+namespace imterm {
+
+	// Byte-stream endpoint a capture session reads from, and writes to when the
+	// endpoint can be written. Implementations wrap a serial port, pipe, file,
+	// or an in-memory fake for tests.
+	//
+	// WaitReadable() and Read() are called from the session's reader thread,
+	// Write() from its sender threads, so a writable transport must allow a
+	// read alongside writes, and must not interleave two writes' bytes. I/O failures are reported by
+	// throwing an exception derived from std::exception.
+	class Transport {
+
+	public:
+
+		virtual ~Transport() = default;
+
+		// Blocks until data is readable or an implementation-defined timeout
+		// elapses. Returns true when a following Read() will not block. The timeout
+		// bounds how long the reader thread takes to notice a stop request.
+		virtual bool WaitReadable() = 0;
+
+		// Copies up to aBuffer.size() bytes that are available now into aBuffer and
+		// returns the number copied.
+		virtual size_t Read(std::span<uint8_t> aBuffer) = 0;
+
+		// A POSIX descriptor that polls readable when Read() has bytes, so a
+		// ReceiveReactor can wait on it together with other ports instead of
+		// a reader thread calling WaitReadable(). -1 when there is none.
+		virtual int GetPollDescriptor() const { return -1; }
+
+		// True once the input has ended and nothing more will be read.
+		virtual bool AtEnd() const noexcept { return false; }
+
+		// True when Write() sends bytes to the other side.
+		virtual bool CanWrite() const { return false; }
+
+		// Writes the buffers in order, like writev(), and returns the number of
+		// bytes written. Writes fewer, possibly none, when the other side does not
+		// take them within an implementation-defined timeout.
+		virtual size_t Write(std::span<const std::span<const uint8_t>> aBuffers) {
+			(void)aBuffers;
+			throw std::logic_error("This transport cannot write");
+		}
+	};
+
+}
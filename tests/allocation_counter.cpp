@@ -0,0 +1,113 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global allocation functions so tests and benchmarks can count
+// heap traffic. Each block carries a small header recording its size so live
+// bytes can be tracked without relying on allocator extensions. Over-aligned
+// allocations use the default implementation and are not counted.
+
+namespace {
+
+constexpr std::size_t HeaderSize = alignof(std::max_align_t);
+
+std::atomic<uint64_t> gAllocations{0};
+std::atomic<uint64_t> gDeallocations{0};
+std::atomic<uint64_t> gAllocatedBytes{0};
+std::atomic<int64_t> gLiveBytes{0};
+
+void* CountedAllocate(std::size_t size)
+{
+    auto* block = static_cast<unsigned char*>(std::malloc(size + HeaderSize));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *reinterpret_cast<std::size_t*>(block) = size;
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    gLiveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    return block + HeaderSize;
+}
+
+void CountedFree(void* pointer) noexcept
+{
+    if (pointer == nullptr) {
+        return;
+    }
+    auto* block = static_cast<unsigned char*>(pointer) - HeaderSize;
+    const std::size_t size = *reinterpret_cast<std::size_t*>(block);
+    gDeallocations.fetch_add(1, std::memory_order_relaxed);
+    gLiveBytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+    std::free(block);
+}
+
+} // namespace
+
+namespace imterm::test {
+
+AllocationCounts CurrentAllocationCounts()
+{
+    AllocationCounts counts;
+    counts.mAllocations = gAllocations.load(std::memory_order_relaxed);
+    counts.mDeallocations = gDeallocations.load(std::memory_order_relaxed);
+    counts.mAllocatedBytes = gAllocatedBytes.load(std::memory_order_relaxed);
+    counts.mLiveBytes = gLiveBytes.load(std::memory_order_relaxed);
+    return counts;
+}
+
+} // namespace imterm::test
+
+void* operator new(std::size_t size)
+{
+    if (void* pointer = CountedAllocate(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return CountedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    CountedFree(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    CountedFree(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    CountedFree(pointer);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace imterm::test {
+
+// Counts heap traffic through the replaced global operator new/delete in
+// allocation_counter.cpp. Link that file into a binary to enable counting.
+struct AllocationCounts {
+    uint64_t mAllocations = 0;
+    uint64_t mDeallocations = 0;
+    uint64_t mAllocatedBytes = 0;
+    int64_t mLiveBytes = 0;
+};
+
+AllocationCounts CurrentAllocationCounts();
+
+// Snapshot difference over a scope.
+class AllocationScope {
+public:
+    AllocationScope() : mStart(CurrentAllocationCounts()) { }
+
+    AllocationCounts Elapsed() const
+    {
+        const AllocationCounts now = CurrentAllocationCounts();
+        AllocationCounts delta;
+        delta.mAllocations = now.mAllocations - mStart.mAllocations;
+        delta.mDeallocations = now.mDeallocations - mStart.mDeallocations;
+        delta.mAllocatedBytes = now.mAllocatedBytes - mStart.mAllocatedBytes;
+        delta.mLiveBytes = now.mLiveBytes - mStart.mLiveBytes;
+        return delta;
+    }
+
+private:
+    AllocationCounts mStart;
+};
+
+} // namespace imterm::test
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "block_codec.h"
+
+namespace {
+
+std::vector<uint8_t> RoundTrip(const std::vector<uint8_t>& input, size_t* compressedSize = nullptr)
+{
+    std::vector<uint8_t> compressed;
+    imterm::CompressBlock(input, compressed);
+    if (compressedSize) {
+        *compressedSize = compressed.size();
+    }
+    std::vector<uint8_t> output(input.size());
+    imterm::DecompressBlock(compressed, output);
+    return output;
+}
+
+std::vector<uint8_t> Bytes(const std::string& text)
+{
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+TEST(BlockCodecTest, RoundTripsShortAndEmptyInput)
+{
+    for (const std::string text : { "", "a", "abc", "abcd", "abcdabcd", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" }) {
+        EXPECT_EQ(RoundTrip(Bytes(text)), Bytes(text)) << text;
+    }
+}
+
+TEST(BlockCodecTest, CompressesRepetitiveLogLines)
+{
+    std::string log;
+    for (int line = 0; line < 2000; ++line) {
+        log += "\x1b[0;32mI (";
+        log += std::to_string(line * 13);
+        log += ") wifi: sta connected, rssi -52, channel 6\x1b[0m\r\n";
+    }
+    const std::vector<uint8_t> input = Bytes(log);
+
+    size_t compressedSize = 0;
+    EXPECT_EQ(RoundTrip(input, &compressedSize), input);
+    EXPECT_LT(compressedSize * 4, input.size());
+}
+
+TEST(BlockCodecTest, RoundTripsRandomAndMixedInput)
+{
+    std::mt19937 random(11);
+    for (size_t size : { size_t{ 100 }, size_t{ 70'000 }, size_t{ 300'000 } }) {
+        std::vector<uint8_t> input(size);
+        for (size_t index = 0; index < size; ++index) {
+            // Stretches of noise, long runs, and repeats from beyond the
+            // 64 KB window.
+            const size_t region = (index / 5000) % 3;
+            input[index] = region == 0 ? static_cast<uint8_t>(random())
+                : region == 1 ? uint8_t{ ' ' }
+                : input[index % 5000];
+        }
+        EXPECT_EQ(RoundTrip(input), input) << size;
+    }
+}
+
+TEST(BlockCodecTest, RejectsMalformedInput)
+{
+    const std::vector<uint8_t> input = Bytes("hello hello hello hello hello hello");
+    std::vector<uint8_t> compressed;
+    imterm::CompressBlock(input, compressed);
+
+    std::vector<uint8_t> output(input.size());
+    const std::span<const uint8_t> truncated(compressed.data(), compressed.size() - 1);
+    EXPECT_THROW(imterm::DecompressBlock(truncated, output), std::out_of_range);
+
+    std::vector<uint8_t> tooShort(input.size() - 1);
+    EXPECT_THROW(imterm::DecompressBlock(compressed, tooShort), std::out_of_range);
+
+    // A match reaching back before the start of the output.
+    const std::vector<uint8_t> badDistance = { 0x10, 'a', 0x05, 0x00, 0x00 };
+    std::vector<uint8_t> small(5);
+    EXPECT_THROW(imterm::DecompressBlock(badDistance, small), std::out_of_range);
+
+    EXPECT_THROW(imterm::DecompressBlock({}, output), std::out_of_range);
+}
+
+} // namespace
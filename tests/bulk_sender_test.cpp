@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "bulk_sender.h"
+#include "capture_session.h"
+#include "fake_transport.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+#include "test_support.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+using imterm::BulkSender;
+using imterm::test::FakeTransport;
+
+std::vector<uint8_t> Pattern(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    std::mt19937 random(3);
+    for (uint8_t& byte : bytes) {
+        byte = static_cast<uint8_t>(random());
+    }
+    return bytes;
+}
+
+bool WaitUntilDone(const BulkSender& sender)
+{
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (sender.IsRunning()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+template<typename Predicate>
+bool WaitFor(Predicate predicate)
+{
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+TEST(BulkSenderTest, SendsEverythingInWholeChunks)
+{
+    auto transport = std::make_shared<FakeTransport>();
+    BulkSender sender(transport);
+    const auto bytes = Pattern(100 * 1024 + 7);
+
+    ASSERT_TRUE(sender.Start(bytes, BulkSender::Pacing()));
+    ASSERT_TRUE(WaitUntilDone(sender));
+
+    EXPECT_EQ(transport->Written(), bytes);
+    const auto sizes = transport->WriteSizes();
+    EXPECT_EQ(sizes.size(), 101u);
+    EXPECT_EQ(sizes.front(), BulkSender::DefaultChunkSize);
+    const auto progress = sender.GetProgress();
+    EXPECT_EQ(progress.mOutcome, BulkSender::Outcome::Finished);
+    EXPECT_EQ(progress.mBytesSent, bytes.size());
+    EXPECT_EQ(progress.mTotalBytes, bytes.size());
+    EXPECT_GT(progress.mBytesPerSecond, 0.0);
+    EXPECT_EQ(sender.TakeError(), std::nullopt);
+}
+
+TEST(BulkSenderTest, SendsAMappedFile)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto bytes = Pattern(5000);
+    {
+        std::ofstream file(directory.Path() / "script.txt", std::ios::binary);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+    auto transport = std::make_shared<FakeTransport>();
+    BulkSender sender(transport);
+
+    ASSERT_TRUE(sender.Start(directory.Path() / "script.txt", BulkSender::Pacing()));
+    ASSERT_TRUE(WaitUntilDone(sender));
+    EXPECT_EQ(transport->Written(), bytes);
+    EXPECT_THROW(sender.Start(directory.Path() / "missing.txt", BulkSender::Pacing()), std::system_error);
+}
+
+TEST(BulkSenderTest, KeepsToTheRate)
+{
+    auto transport = std::make_shared<FakeTransport>();
+    BulkSender sender(transport);
+    BulkSender::Pacing pacing;
+    pacing.BytesPerMillisecond = 20.0;
+
+    ASSERT_TRUE(sender.Start(Pattern(2000), pacing));
+    ASSERT_TRUE(WaitUntilDone(sender));
+
+    // 2000 bytes at 20 per millisecond, in writes of at most 10 ms worth.
+    EXPECT_GE(sender.GetProgress().mElapsed, 95ms);
+    const auto sizes = transport->WriteSizes();
+    EXPECT_LE(*std::max_element(sizes.begin(), sizes.end()), 200u);
+    EXPECT_EQ(transport->Written().size(), 2000u);
+}
+
+TEST(BulkSenderTest, PausesAfterEachLineButTheLast)
+{
+    auto transport = std::make_shared<FakeTransport>();
+    BulkSender sender(transport);
+    BulkSender::Pacing pacing;
+    pacing.LineDelay = 30ms;
+
+    ASSERT_TRUE(sender.Start(imterm::test::Bytes("one\r\ntwo\rthree\n"), pacing));
+    ASSERT_TRUE(WaitUntilDone(sender));
+
+    EXPECT_GE(sender.GetProgress().mElapsed, 60ms);
+    EXPECT_EQ(transport->WriteSizes(), std::vector<size_t>({ 5, 4, 6 }));
+}
+
+TEST(BulkSenderTest, WaitsForThePromptAfterEachLine)
+{
+    auto transport = std::make_shared<FakeTransport>();
+    BulkSender sender(transport);
+    BulkSender::Pacing pacing;
+    pacing.Prompt = "esp> ";
+
+    ASSERT_TRUE(sender.Start(imterm::test::Bytes("nvs set a 1\nnvs set b 2\nreboot\n"), pacing));
+    ASSERT_TRUE(WaitFor([&] { return sender.GetProgress().mWaitingForPrompt; }));
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("nvs set a 1\n"));
+
+    // The echo alone is not the prompt; the prompt may arrive split.
+    sender.Observe(imterm::test::Bytes("nvs set a 1\r\nesp"));
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(transport->Written().size(), 12u);
+    sender.Observe(imterm::test::Bytes("> "));
+    ASSERT_TRUE(WaitFor([&] { return transport->Written().size() == 24; }));
+
+    sender.Observe(imterm::test::Bytes("nvs set b 2\r\nesp> "));
+    ASSERT_TRUE(WaitUntilDone(sender));
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("nvs set a 1\nnvs set b 2\nreboot\n"));
+    EXPECT_EQ(sender.GetProgress().mOutcome, BulkSender::Outcome::Finished);
+}
+
+TEST(BulkSenderTest, FailsWhenThePromptDoesNotCome)
+{
+    auto transport = std::make_shared<FakeTransport>();
+    BulkSender sender(transport);
+    BulkSender::Pacing pacing;
+    pacing.Prompt = "> ";
+    pacing.PromptTimeout = 20ms;
+
+    ASSERT_TRUE(sender.Start(imterm::test::Bytes("first\nsecond\n"), pacing));
+    ASSERT_TRUE(WaitUntilDone(sender));
+
+    EXPECT_EQ(sender.GetProgress().mOutcome, BulkSender::Outcome::Failed);
+    EXPECT_EQ(sender.GetProgress().mBytesSent, 6u);
+    const auto error = sender.TakeError();
+    ASSERT_TRUE(error);
+    EXPECT_NE(error->find("prompt"), std::string::npos);
+    EXPECT_EQ(sender.TakeError(), std::nullopt);
+}
+
+TEST(BulkSenderTest, StopsOnXoffUntilXon)
+{
+    auto transport = std::make_shared<FakeTransport>();
+    BulkSender sender(transport);
+    BulkSender::Pacing pacing;
+    pacing.ChunkSize = 100;
+    pacing.HonorXonXoff = true;
+
+    transport->SetWriteMode(FakeTransport::WriteMode::Hold);
+    ASSERT_TRUE(sender.Start(Pattern(1000), pacing));
+    ASSERT_TRUE(transport->WaitForWrites(1));
+    sender.Observe(imterm::test::Bytes({ 'o', 'k', BulkSender::Xoff }));
+    transport->SetWriteMode(FakeTransport::WriteMode::Accept);
+
+    // The write in progress finishes; no other starts.
+    ASSERT_TRUE(WaitFor([&] { return sender.GetProgress().mHeldByDevice; }));
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(sender.GetProgress().mBytesSent, 100u);
+
+    sender.Observe(imterm::test::Bytes({ BulkSender::Xon }));
+    ASSERT_TRUE(WaitUntilDone(sender));
+    EXPECT_EQ(transport->Written(), Pattern(1000));
+}
+
+TEST(BulkSenderTest, CancelsASendTheDeviceHoldsOff)
+{
+    auto transport = std::make_shared<FakeTransport>();
+    transport->SetWriteMode(FakeTransport::WriteMode::Refuse);
+    BulkSender sender(transport);
+
+    ASSERT_TRUE(sender.Start(Pattern(1000), BulkSender::Pacing()));
+    ASSERT_TRUE(WaitFor([&] { return sender.GetProgress().mHeldByDevice; }));
+    EXPECT_FALSE(sender.Start(Pattern(10), BulkSender::Pacing()));
+
+    sender.Cancel();
+    EXPECT_FALSE(sender.IsRunning());
+    const auto progress = sender.GetProgress();
+    EXPECT_EQ(progress.mOutcome, BulkSender::Outcome::Cancelled);
+    EXPECT_EQ(progress.mBytesSent, 0u);
+    EXPECT_FALSE(progress.mHeldByDevice);
+
+    // The next send starts afresh.
+    transport->SetWriteMode(FakeTransport::WriteMode::Accept);
+    ASSERT_TRUE(sender.Start(imterm::test::Bytes("again"), BulkSender::Pacing()));
+    ASSERT_TRUE(WaitUntilDone(sender));
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("again"));
+}
+
+TEST(BulkSenderTest, SessionPacesAgainstThePromptItReceives)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    auto state = std::make_shared<imterm::TerminalState>(data, imterm::TerminalState::NewLineMode::Strict);
+    state->SetViewportSize(24, 80);
+    auto transport = std::make_shared<FakeTransport>();
+    imterm::CaptureSession session(transport, state);
+    ASSERT_NE(session.GetBulkSender(), nullptr);
+    session.Start();
+
+    BulkSender::Pacing pacing;
+    pacing.Prompt = "> ";
+    BulkSender& sender = *session.GetBulkSender();
+    ASSERT_TRUE(sender.Start(imterm::test::Bytes("a\nb\nc\n"), pacing));
+
+    // Nobody pumps the session: the reader thread passes the prompt on.
+    for (const size_t sent : { 2u, 4u }) {
+        ASSERT_TRUE(WaitFor([&] { return sender.GetProgress().mWaitingForPrompt; }));
+        EXPECT_EQ(transport->Written().size(), sent);
+        transport->Push(imterm::test::Bytes("\r\n> "));
+        ASSERT_TRUE(WaitFor([&] { return transport->Written().size() > sent; }));
+    }
+    ASSERT_TRUE(WaitUntilDone(sender));
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("a\nb\nc\n"));
+
+    // Stopping the session cancels a send in progress.
+    transport->SetWriteMode(FakeTransport::WriteMode::Refuse);
+    ASSERT_TRUE(sender.Start(Pattern(100), BulkSender::Pacing()));
+    session.Stop();
+    EXPECT_EQ(sender.GetProgress().mOutcome, BulkSender::Outcome::Cancelled);
+}
+
+} // namespace
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture_recording.h"
+#include "capture_replay.h"
+#include "receive_journal.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+#include "test_support.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+using imterm::CaptureRecording;
+using imterm::CaptureReplay;
+
+struct Terminal {
+    Terminal()
+        : data(std::make_shared<imterm::TerminalData>())
+        , state(std::make_shared<imterm::TerminalState>(data, imterm::TerminalState::NewLineMode::Strict))
+    {
+        state->SetViewportSize(5, 40);
+    }
+
+    std::vector<std::string> Screen() const
+    {
+        const auto lines = data->GetTextLines();
+        return std::vector<std::string>(lines.size() > 5 ? lines.end() - 5 : lines.begin(), lines.end());
+    }
+
+    std::shared_ptr<imterm::TerminalData> data;
+    std::shared_ptr<imterm::TerminalState> state;
+};
+
+// Colored, cursor-addressed lines, so a snapshot boundary lands inside
+// escape sequences.
+std::vector<uint8_t> Stream(int lines)
+{
+    std::string text;
+    for (int line = 0; line < lines; ++line) {
+        text += "\x1b[3" + std::to_string(line % 8) + "mline " + std::to_string(line) + "\x1b[0m\r\n";
+        if (line % 7 == 0) {
+            text += "\x1b[2;3Hx\x1b[5;1H";
+        }
+    }
+    return imterm::test::Bytes(text);
+}
+
+std::shared_ptr<const CaptureRecording> Record(const std::filesystem::path& path, std::span<const uint8_t> bytes)
+{
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    file.close();
+    return std::make_shared<const CaptureRecording>(path);
+}
+
+CaptureReplay::Options SmallSnapshots()
+{
+    CaptureReplay::Options options;
+    options.SnapshotInterval = 97;
+    return options;
+}
+
+// The screen after applying the first count bytes directly.
+std::vector<std::string> Direct(std::span<const uint8_t> bytes, uint64_t count)
+{
+    Terminal terminal;
+    terminal.state->Input(bytes.first(static_cast<size_t>(count)));
+    return terminal.Screen();
+}
+
+TEST(CaptureReplayTest, FastReplayMatchesDirectInput)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto bytes = Stream(300);
+    Terminal terminal;
+    CaptureReplay replay(Record(directory.Path() / "capture", bytes), terminal.data, terminal.state, SmallSnapshots());
+
+    replay.Play(0.0);
+    size_t applied = 0;
+    while (replay.IsPlaying()) {
+        applied += replay.Update(1000);
+    }
+
+    EXPECT_EQ(applied, bytes.size());
+    EXPECT_TRUE(replay.AtEnd());
+    EXPECT_FALSE(replay.GetTimeUntilDue());
+    EXPECT_EQ(terminal.Screen(), Direct(bytes, bytes.size()));
+    EXPECT_EQ(replay.GetSnapshotCount(), bytes.size() / 97 + 1);
+}
+
+TEST(CaptureReplayTest, SeeksBackwardsAndForwards)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto bytes = Stream(300);
+    Terminal terminal;
+    CaptureReplay replay(Record(directory.Path() / "capture", bytes), terminal.data, terminal.state, SmallSnapshots());
+
+    for (const uint64_t offset : { uint64_t{ 5000 }, uint64_t{ 1234 }, uint64_t{ 97 }, uint64_t{ 0 },
+             uint64_t{ 4321 }, uint64_t{ 4400 }, uint64_t{ bytes.size() }, uint64_t{ 17 } }) {
+        replay.Seek(offset);
+        EXPECT_EQ(replay.GetPosition(), offset);
+        EXPECT_EQ(terminal.Screen(), Direct(bytes, offset)) << offset;
+    }
+}
+
+TEST(CaptureReplayTest, IndexingTakesEverySnapshot)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto bytes = Stream(2000);
+    Terminal terminal;
+    CaptureReplay replay(Record(directory.Path() / "capture", bytes), terminal.data, terminal.state, SmallSnapshots());
+
+    replay.StartIndexing();
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (replay.GetIndexedSize() < bytes.size()) {
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+        std::this_thread::sleep_for(1ms);
+    }
+    replay.StopIndexing();
+    EXPECT_EQ(replay.GetSnapshotCount(), bytes.size() / 97 + 1);
+
+    // Snapshots from the indexer restore the same screen as playback would.
+    replay.Seek(bytes.size() - 50);
+    EXPECT_EQ(terminal.Screen(), Direct(bytes, bytes.size() - 50));
+    replay.Seek(500);
+    EXPECT_EQ(terminal.Screen(), Direct(bytes, 500));
+}
+
+TEST(CaptureReplayTest, FollowsTheRecordedTimes)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto path = directory.Path() / "rx.journal";
+    const imterm::ReceiveJournal::Clock::time_point start{ 1000s };
+    {
+        imterm::ReceiveJournal::Options options;
+        options.KeepFile = true;
+        imterm::ReceiveJournal journal(path, options);
+        journal.Append(imterm::test::Bytes("first\r\n"), start);
+        journal.Append(imterm::test::Bytes("second\r\n"), start + 200ms);
+        journal.Append(imterm::test::Bytes("third"), start + 10s);
+    }
+
+    Terminal terminal;
+    auto recording = std::make_shared<const CaptureRecording>(path);
+    ASSERT_TRUE(recording->HasTimes());
+    CaptureReplay replay(recording, terminal.data, terminal.state);
+
+    replay.Play(1.0);
+    EXPECT_EQ(replay.Update(), 7U);
+    EXPECT_EQ(terminal.data->GetLine(0).GetTimestamp(), start);
+    EXPECT_EQ(replay.Update(), 0U);
+    const auto wait = replay.GetTimeUntilDue();
+    ASSERT_TRUE(wait);
+    EXPECT_GT(*wait, 100ms);
+    EXPECT_LE(*wait, 200ms + 1ns);
+
+    std::this_thread::sleep_for(*wait);
+    EXPECT_EQ(replay.Update(), 8U);
+    EXPECT_EQ(replay.GetPositionTime(), start + 10s);
+
+    // Seeking by time lands after every byte received by then.
+    replay.SeekToTime(start + 5s);
+    EXPECT_EQ(replay.GetPosition(), 15U);
+    replay.Play(100.0);
+    std::this_thread::sleep_for(*replay.GetTimeUntilDue());
+    EXPECT_EQ(replay.Update(), 5U);
+    EXPECT_FALSE(replay.IsPlaying());
+    EXPECT_EQ(terminal.data->GetTextLines(), std::vector<std::string>({ "first", "second", "third" }));
+}
+
+} // namespace
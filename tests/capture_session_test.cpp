@@ -0,0 +1,605 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "capture_session.h"
+#include "fake_transport.h"
+#include "receive_clock.h"
+#include "receive_journal.h"
+#include "receive_worker.h"
+#include "send_worker.h"
+#include "spsc_byte_ring.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+#include "test_support.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+template<typename Predicate>
+bool WaitFor(Predicate predicate)
+{
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+TEST(SpscByteRingTest, RejectsCapacityThatIsNotAPowerOfTwo)
+{
+    EXPECT_THROW(imterm::SpscByteRing(0), std::invalid_argument);
+    EXPECT_THROW(imterm::SpscByteRing(12), std::invalid_argument);
+}
+
+TEST(SpscByteRingTest, WrapsAroundAndReportsHighWaterMark)
+{
+    imterm::SpscByteRing ring(8);
+    std::vector<uint8_t> out(8);
+
+    EXPECT_EQ(ring.Write(imterm::test::Bytes("abcdef")), 6u);
+    EXPECT_EQ(ring.Read(std::span<uint8_t>(out.data(), 4)), 4u);
+    EXPECT_EQ(ring.Write(imterm::test::Bytes("ghijklmn")), 6u);
+    EXPECT_EQ(ring.Size(), 8u);
+    EXPECT_EQ(ring.HighWaterMark(), 8u);
+
+    // The unread bytes straddle the end of the buffer.
+    EXPECT_EQ(ring.Peek().size(), 4u);
+    EXPECT_EQ(ring.Read(out), 8u);
+    EXPECT_EQ(std::string(out.begin(), out.end()), "efghijkl");
+    EXPECT_TRUE(ring.Empty());
+}
+
+TEST(SpscByteRingTest, ReservedSpaceIsQueuedOnlyWhenCommitted)
+{
+    imterm::SpscByteRing ring(8);
+    std::vector<uint8_t> out(8);
+    EXPECT_EQ(ring.Write(imterm::test::Bytes("abcde")), 5u);
+    EXPECT_EQ(ring.Read(std::span<uint8_t>(out.data(), 3)), 3u);
+
+    // Free space runs to the end of the buffer first, then wraps.
+    auto space = ring.Reserve();
+    ASSERT_EQ(space.size(), 3u);
+    std::copy_n("fgh", 3, space.begin());
+    EXPECT_EQ(ring.Size(), 2u);
+    ring.Commit(2);
+    EXPECT_EQ(ring.Size(), 4u);
+
+    space = ring.Reserve(2);
+    ASSERT_EQ(space.size(), 1u);
+    space[0] = 'i';
+    ring.Commit(1);
+    space = ring.Reserve();
+    ASSERT_EQ(space.size(), 3u);
+    space[0] = 'j';
+    ring.Commit(1);
+    EXPECT_EQ(ring.HighWaterMark(), 6u);
+
+    EXPECT_EQ(ring.Read(out), 6u);
+    EXPECT_EQ(std::string(out.begin(), out.begin() + 6), "defgij");
+    ring.Commit(0);
+    EXPECT_TRUE(ring.Empty());
+}
+
+TEST(SpscByteRingTest, PeeksQueuedBytesAsTwoRunsAcrossTheEnd)
+{
+    imterm::SpscByteRing ring(8);
+    std::vector<uint8_t> out(8);
+    EXPECT_EQ(ring.Write(imterm::test::Bytes("abcdef")), 6u);
+    EXPECT_EQ(ring.Read(std::span<uint8_t>(out.data(), 5)), 5u);
+    EXPECT_EQ(ring.Write(imterm::test::Bytes("ghijk")), 5u);
+
+    auto runs = ring.PeekRuns();
+    EXPECT_EQ(std::string(runs[0].begin(), runs[0].end()), "fgh");
+    EXPECT_EQ(std::string(runs[1].begin(), runs[1].end()), "ijk");
+
+    runs = ring.PeekRuns(4);
+    EXPECT_EQ(runs[0].size(), 3u);
+    EXPECT_EQ(runs[1].size(), 1u);
+    ring.Consume(4);
+    runs = ring.PeekRuns();
+    EXPECT_EQ(std::string(runs[0].begin(), runs[0].end()), "jk");
+    EXPECT_TRUE(runs[1].empty());
+}
+
+TEST(SpscByteRingTest, TransfersEveryByteBetweenThreadsInOrder)
+{
+    constexpr size_t total = 1 << 18;
+    imterm::SpscByteRing ring(4096);
+
+    std::thread producer([&] {
+        std::vector<uint8_t> chunk(97);
+        size_t next = 0;
+        while (next < total) {
+            const size_t count = std::min(chunk.size(), total - next);
+            for (size_t i = 0; i < count; i++) {
+                chunk[i] = static_cast<uint8_t>(next + i);
+            }
+            size_t written = 0;
+            while (written < count) {
+                written += ring.Write(std::span<const uint8_t>(chunk.data() + written, count - written));
+            }
+            next += count;
+        }
+    });
+
+    size_t received = 0;
+    bool ordered = true;
+    std::vector<uint8_t> out(333);
+    while (received < total) {
+        const size_t count = ring.Read(out);
+        for (size_t i = 0; i < count; i++) {
+            ordered = ordered && out[i] == static_cast<uint8_t>(received + i);
+        }
+        received += count;
+    }
+    producer.join();
+
+    EXPECT_TRUE(ordered);
+    EXPECT_LE(ring.HighWaterMark(), ring.Capacity());
+}
+
+TEST(ReceiveWorkerTest, DrainsWithinTheByteBudget)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::ReceiveWorker worker(transport, 64);
+    worker.Start();
+
+    transport->Push(imterm::test::Bytes("0123456789"));
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == 10; }));
+
+    std::string drained;
+    auto append = [&](std::span<const uint8_t> bytes, imterm::ReceiveWorker::Timestamp) {
+        drained.append(bytes.begin(), bytes.end());
+    };
+    EXPECT_EQ(worker.Drain(4, append), 4u);
+    EXPECT_EQ(drained, "0123");
+    EXPECT_EQ(worker.Drain(100, append), 6u);
+    EXPECT_EQ(drained, "0123456789");
+
+    const auto stats = worker.GetStatistics();
+    EXPECT_EQ(stats.mBytesDelivered, 10u);
+    EXPECT_EQ(stats.mBytesDropped, 0u);
+    EXPECT_EQ(stats.mHighWaterMark, 10u);
+}
+
+TEST(ReceiveWorkerTest, PassesEachReadWithTheTimeItWasRead)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::ReceiveWorker worker(transport, 64);
+    worker.Start();
+
+    const auto before = std::chrono::system_clock::now();
+    transport->Push(imterm::test::Bytes("first"));
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == 5; }));
+    std::this_thread::sleep_for(20ms);
+    transport->Push(imterm::test::Bytes("second"));
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == 11; }));
+    const auto after = std::chrono::system_clock::now();
+    EXPECT_TRUE(worker.HasPendingBytes());
+
+    std::vector<std::pair<std::string, imterm::ReceiveWorker::Timestamp>> runs;
+    auto collect = [&](std::span<const uint8_t> bytes, imterm::ReceiveWorker::Timestamp time) {
+        runs.emplace_back(std::string(bytes.begin(), bytes.end()), time);
+    };
+    // A budget that ends inside a read leaves the rest with the same time.
+    EXPECT_EQ(worker.Drain(3, collect), 3u);
+    EXPECT_EQ(worker.Drain(100, collect), 8u);
+    EXPECT_FALSE(worker.HasPendingBytes());
+
+    ASSERT_EQ(runs.size(), 3u);
+    EXPECT_EQ(runs[0].first, "fir");
+    EXPECT_EQ(runs[1].first, "st");
+    EXPECT_EQ(runs[2].first, "second");
+    EXPECT_EQ(runs[0].second, runs[1].second);
+    EXPECT_GE(runs[2].second - runs[0].second, 15ms);
+    // Wall-clock times, within the scheduling slack of the system clock.
+    EXPECT_GE(runs[0].second, before - 1s);
+    EXPECT_LE(runs[2].second, after + 1s);
+}
+
+TEST(ReceiveWorkerTest, SharesTimesWhenReadsOutnumberTheirMarks)
+{
+    // A 64 KB ring keeps 256 marks; 400 one-byte reads overflow them.
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::ReceiveWorker worker(transport, 1 << 16);
+    worker.Start();
+
+    std::string sent;
+    for (int i = 0; i < 400; ++i) {
+        sent += static_cast<char>('a' + i % 26);
+        transport->Push(imterm::test::Bytes(sent.substr(sent.size() - 1)));
+        ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == sent.size(); }));
+    }
+
+    std::string drained;
+    std::vector<imterm::ReceiveWorker::Timestamp> times;
+    auto append = [&](std::span<const uint8_t> bytes, imterm::ReceiveWorker::Timestamp time) {
+        drained.append(bytes.begin(), bytes.end());
+        times.push_back(time);
+    };
+    ASSERT_TRUE(WaitFor([&] {
+        worker.Drain(1000, append);
+        return drained.size() == sent.size();
+    }));
+    EXPECT_EQ(drained, sent);
+    EXPECT_EQ(worker.GetStatistics().mBytesDropped, 0u);
+    // The reads after the 256th were merged into one mark.
+    EXPECT_EQ(times.size(), 257u);
+    EXPECT_TRUE(std::is_sorted(times.begin(), times.end()));
+}
+
+TEST(ReceiveClockTest, NeverGoesBackwards)
+{
+    imterm::ReceiveClock clock;
+    auto previous = clock.Now();
+    EXPECT_LE(std::chrono::abs(previous - std::chrono::system_clock::now()), 1s);
+    for (int i = 0; i < 100000; ++i) {
+        const auto now = clock.Now();
+        ASSERT_GE(now, previous);
+        previous = now;
+    }
+}
+
+TEST(ReceiveWorkerTest, CountsBytesThatDoNotFitAsDropped)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::ReceiveWorker worker(transport, 16);
+    worker.Start();
+
+    std::vector<uint8_t> burst(40, 'x');
+    transport->Push(burst);
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == 40; }));
+    worker.Stop();
+
+    const auto stats = worker.GetStatistics();
+    EXPECT_EQ(stats.mBuffered, 16u);
+    EXPECT_EQ(stats.mBytesDropped, 24u);
+    EXPECT_GE(stats.mOverflowEvents, 1u);
+    EXPECT_EQ(stats.mHighWaterMark, 16u);
+}
+
+TEST(ReceiveWorkerTest, WaitsForRoomInsteadOfDropping)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::ReceiveWorker worker(transport, 16);
+    worker.SetOverflowPolicy(imterm::ReceiveWorker::OverflowPolicy::Wait);
+    worker.Start();
+
+    std::vector<uint8_t> burst(40);
+    std::iota(burst.begin(), burst.end(), uint8_t(0));
+    transport->Push(burst);
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == 16; }));
+
+    std::vector<uint8_t> received;
+    const auto collect = [&](std::span<const uint8_t> bytes, imterm::ReceiveWorker::Timestamp) {
+        received.insert(received.end(), bytes.begin(), bytes.end());
+    };
+    ASSERT_TRUE(WaitFor([&] {
+        worker.Drain(SIZE_MAX, collect);
+        return received.size() == burst.size();
+    }));
+    worker.Stop();
+
+    EXPECT_EQ(received, burst);
+    const auto stats = worker.GetStatistics();
+    EXPECT_EQ(stats.mBytesDropped, 0u);
+    EXPECT_EQ(stats.mOverflowEvents, 0u);
+    EXPECT_EQ(stats.mHighWaterMark, 16u);
+}
+
+TEST(ReceiveWorkerTest, ReportsTransportFailureOnce)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::ReceiveWorker worker(transport);
+    worker.Start();
+
+    transport->Fail("port vanished");
+    ASSERT_TRUE(WaitFor([&] { return !worker.IsRunning(); }));
+
+    EXPECT_EQ(worker.TakeError(), std::optional<std::string>("port vanished"));
+    EXPECT_EQ(worker.TakeError(), std::nullopt);
+}
+
+TEST(ReceiveWorkerTest, NotifiesOnceUntilTheConsumerDrains)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::ReceiveWorker worker(transport);
+    std::atomic<int> notifications{ 0 };
+    worker.SetReceiveNotifier([&] { ++notifications; });
+    worker.Start();
+
+    transport->Push(imterm::test::Bytes("first"));
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == 5; }));
+    transport->Push(imterm::test::Bytes("second"));
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesReceived == 11; }));
+    EXPECT_EQ(notifications, 1);
+
+    auto ignore = [](std::span<const uint8_t>, imterm::ReceiveWorker::Timestamp) {};
+    EXPECT_EQ(worker.Drain(100, ignore), 11u);
+    transport->Push(imterm::test::Bytes("third"));
+    ASSERT_TRUE(WaitFor([&] { return notifications == 2; }));
+
+    // A failure wakes the consumer too, so it can report it.
+    worker.Drain(100, ignore);
+    transport->Fail("port vanished");
+    ASSERT_TRUE(WaitFor([&] { return notifications == 3; }));
+}
+
+TEST(SendWorkerTest, CoalescesBytesQueuedDuringAWrite)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::SendWorker worker(transport);
+    worker.Start();
+
+    // The device is busy with the first keystroke; the next ones must not
+    // wait for it.
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Hold);
+    EXPECT_EQ(worker.Send(imterm::test::Bytes("r")), 1u);
+    ASSERT_TRUE(transport->WaitForWrites(1));
+    for (const char key : std::string("eboot\r")) {
+        EXPECT_EQ(worker.Send(imterm::test::Bytes({ static_cast<uint8_t>(key) })), 1u);
+    }
+    EXPECT_EQ(worker.GetStatistics().mBuffered, 7u);
+
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Accept);
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesWritten == 7; }));
+    worker.Stop();
+
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("reboot\r"));
+    EXPECT_EQ(transport->WriteSizes(), std::vector<size_t>({ 1, 6 }));
+    const auto stats = worker.GetStatistics();
+    EXPECT_EQ(stats.mWrites, 2u);
+    EXPECT_EQ(stats.mBytesDropped, 0u);
+    EXPECT_EQ(stats.mBuffered, 0u);
+}
+
+TEST(SendWorkerTest, WritesQueuedBytesThatWrapInOneCall)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::SendWorker worker(transport, 16);
+    worker.Start();
+
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Hold);
+    worker.Send(imterm::test::Bytes("0123456789"));
+    ASSERT_TRUE(transport->WaitForWrites(1));
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Accept);
+    ASSERT_TRUE(WaitFor([&] { return !worker.HasPendingBytes(); }));
+
+    // Straddles the end of the ring.
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Hold);
+    worker.Send(imterm::test::Bytes("a"));
+    ASSERT_TRUE(transport->WaitForWrites(2));
+    worker.Send(imterm::test::Bytes("bcdefghijk"));
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Accept);
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesWritten == 21; }));
+
+    EXPECT_EQ(transport->WriteSizes(), std::vector<size_t>({ 10, 1, 10 }));
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("0123456789abcdefghijk"));
+}
+
+TEST(SendWorkerTest, CountsBytesThatDoNotFitAsDropped)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Hold);
+    imterm::SendWorker worker(transport, 16);
+    worker.Start();
+
+    EXPECT_EQ(worker.Send(std::vector<uint8_t>(12, 'a')), 12u);
+    ASSERT_TRUE(transport->WaitForWrites(1));
+    EXPECT_EQ(worker.Send(std::vector<uint8_t>(10, 'b')), 4u);
+
+    const auto stats = worker.GetStatistics();
+    EXPECT_EQ(stats.mBytesQueued, 16u);
+    EXPECT_EQ(stats.mBytesDropped, 6u);
+    EXPECT_EQ(stats.mHighWaterMark, 16u);
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Accept);
+}
+
+TEST(SendWorkerTest, DiscardsTheQueueWhenTheDeviceStopsTakingBytes)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Refuse);
+    imterm::SendWorker worker(transport);
+    worker.SetStallTimeout(20ms);
+    worker.Start();
+
+    worker.Send(imterm::test::Bytes("stale"));
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mStalls == 1; }));
+    EXPECT_FALSE(worker.HasPendingBytes());
+    EXPECT_EQ(worker.GetStatistics().mBytesDropped, 5u);
+
+    // Once the device reads again, only new input reaches it.
+    transport->SetWriteMode(imterm::test::FakeTransport::WriteMode::Accept);
+    worker.Send(imterm::test::Bytes("fresh"));
+    ASSERT_TRUE(WaitFor([&] { return worker.GetStatistics().mBytesWritten == 5; }));
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("fresh"));
+    EXPECT_EQ(worker.GetStatistics().mStalls, 1u);
+}
+
+TEST(SendWorkerTest, ReportsWriteFailureOnce)
+{
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::SendWorker worker(transport);
+    worker.Start();
+
+    transport->FailWrites("port vanished");
+    worker.Send(imterm::test::Bytes("x"));
+    ASSERT_TRUE(WaitFor([&] { return !worker.IsRunning(); }));
+
+    EXPECT_EQ(worker.TakeError(), std::optional<std::string>("port vanished"));
+    EXPECT_EQ(worker.TakeError(), std::nullopt);
+}
+
+TEST(CaptureSessionTest, PumpAppliesReceivedBytesToTheTerminal)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    auto state = std::make_shared<imterm::TerminalState>(
+        data, imterm::TerminalState::NewLineMode::Strict);
+    state->SetViewportSize(24, 80);
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::CaptureSession session(transport, state);
+    session.Start();
+
+    transport->Push(imterm::test::Bytes("boot\r\n\x1b[32mok"));
+    ASSERT_TRUE(WaitFor([&] { return session.GetReceiveStatistics().mBytesReceived == 13; }));
+
+    EXPECT_EQ(session.Pump(), 13u);
+    EXPECT_FALSE(session.HasPendingInput());
+    ASSERT_EQ(data->GetLineCount(), 2);
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "boot");
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(1)), "ok");
+}
+
+TEST(CaptureSessionTest, JournalRecordsTheBytesTheTerminalInterprets)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    auto state = std::make_shared<imterm::TerminalState>(
+        data, imterm::TerminalState::NewLineMode::Strict);
+    state->SetViewportSize(24, 80);
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::CaptureSession session(transport, state);
+    imterm::test::TemporaryDirectory directory;
+    auto journal = std::make_shared<imterm::ReceiveJournal>(directory.Path() / "rx.journal");
+    session.SetJournal(journal);
+    session.Start();
+
+    const auto bytes = imterm::test::Bytes({ 'a', 0, 0x1b, '[', '3', '1', 'm', 'b', '\r', '\n' });
+    transport->Push(bytes);
+    ASSERT_TRUE(WaitFor([&] { return session.GetReceiveStatistics().mBytesReceived == bytes.size(); }));
+    session.Pump();
+
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "ab");
+    std::vector<uint8_t> recorded(32);
+    recorded.resize(journal->Read(0, recorded));
+    EXPECT_EQ(recorded, bytes);
+    EXPECT_TRUE(journal->GetTime(0));
+}
+
+TEST(CaptureSessionTest, RestartsAfterStop)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    auto state = std::make_shared<imterm::TerminalState>(
+        data, imterm::TerminalState::NewLineMode::Strict);
+    state->SetViewportSize(24, 80);
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::CaptureSession session(transport, state);
+
+    session.Start();
+    session.Stop();
+    EXPECT_FALSE(session.IsReceiving());
+
+    session.Start();
+    transport->Push(imterm::test::Bytes("again"));
+    ASSERT_TRUE(WaitFor([&] { return session.GetReceiveStatistics().mBytesReceived == 5; }));
+    session.Pump();
+
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "again");
+}
+
+TEST(CaptureSessionTest, RepliesToDeviceReportsAfterKeystrokesSentBeforeThem)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    auto state = std::make_shared<imterm::TerminalState>(
+        data, imterm::TerminalState::NewLineMode::Strict);
+    state->SetViewportSize(24, 80);
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    imterm::CaptureSession session(transport, state);
+    ASSERT_TRUE(session.CanSend());
+    session.Start();
+
+    EXPECT_EQ(session.Send(imterm::test::Bytes("ls\r")), 3u);
+    transport->Push(imterm::test::Bytes("\x1b[5n\x1b[3;7H\x1b[6n"));
+    ASSERT_TRUE(WaitFor([&] { return session.GetReceiveStatistics().mBytesReceived == 14; }));
+    session.Pump();
+    EXPECT_FALSE(state->TerminalOutputAvailable());
+
+    ASSERT_TRUE(WaitFor([&] { return session.GetSendStatistics().mBytesWritten == 13; }));
+    EXPECT_EQ(transport->Written(), imterm::test::Bytes("ls\r\x1b[0n\x1b[3;7R"));
+    EXPECT_EQ(session.TakeSendError(), std::nullopt);
+}
+
+// Serves a pattern over and over in short reads without allocating, so the
+// allocation counter sees only the receive path.
+class RepeatingTransport : public imterm::Transport {
+public:
+    RepeatingTransport(std::vector<uint8_t> pattern, size_t readSize)
+        : mPattern(std::move(pattern)), mReadSize(readSize)
+    {
+    }
+
+    bool WaitReadable() override { return true; }
+
+    size_t Read(std::span<uint8_t> buffer) override
+    {
+        const size_t count = std::min(buffer.size(), mReadSize);
+        for (size_t i = 0; i < count; ++i) {
+            buffer[i] = mPattern[mOffset++ % mPattern.size()];
+        }
+        return count;
+    }
+
+private:
+    std::vector<uint8_t> mPattern;
+    size_t mReadSize;
+    size_t mOffset = 0;
+};
+
+TEST(CaptureSessionTest, ReceivePathAllocatesNothingOnceWarm)
+{
+    // A status line redrawn in place, with multibyte characters that reads of
+    // seven bytes cut at every position.
+    auto transport = std::make_shared<RepeatingTransport>(
+        imterm::test::Bytes("\rt=23.5 \xC2\xB0" "C \xE2\x9C\x93 \x1B[32mOK\x1B[0m \xF0\x9F\x98\x80"), 7);
+    auto data = std::make_shared<imterm::TerminalData>();
+    auto state = std::make_shared<imterm::TerminalState>(data, imterm::TerminalState::NewLineMode::Strict);
+    state->SetViewportSize(24, 80);
+    imterm::CaptureSession session(transport, state, 1 << 16);
+    session.SetOverflowPolicy(imterm::ReceiveWorker::OverflowPolicy::Wait);
+
+    // The journal adds a time mark per TimeResolution and maps a new chunk
+    // per ChunkSize; neither comes due during the measurement.
+    imterm::test::TemporaryDirectory directory;
+    imterm::ReceiveJournal::Options options;
+    options.ChunkSize = 16 << 20;
+    options.TimeResolution = std::chrono::hours(1);
+    session.SetJournal(std::make_shared<imterm::ReceiveJournal>(directory.Path() / "rx.journal", options));
+    session.Start();
+
+    size_t pumped = 0;
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    const auto pumpUntil = [&](size_t total) {
+        while (pumped < total && std::chrono::steady_clock::now() < deadline) {
+            pumped += session.Pump();
+        }
+    };
+    pumpUntil(1 << 19);
+
+    imterm::test::AllocationScope scope;
+    pumpUntil(4 << 20);
+    const uint64_t allocations = scope.Elapsed().mAllocations;
+    session.Stop();
+
+    ASSERT_GE(pumped, size_t{ 4 } << 20);
+    EXPECT_EQ(allocations, 0u);
+    EXPECT_EQ(session.GetReceiveStatistics().mBytesDropped, 0u);
+    EXPECT_EQ(data->GetLineCount(), 1u);
+    EXPECT_EQ(session.GetJournal()->GetSize(), session.GetReceiveStatistics().mBytesDelivered);
+}
+
+} // namespace
@@ -1,13 +1,95 @@
 #include <gtest/gtest.h>
 
+#include <array>
+#include <random>
+#include <span>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "escape_sequence_parser.h"
 
 namespace {
 
-using CommandData = std::vector<int>;
+using CommandData = EscapeSequenceParser::Arguments;
+using Token = EscapeSequenceParser::Token;
+using TokenKind = EscapeSequenceParser::TokenKind;
+
+std::span<const uint8_t> AsBytes(std::string_view text)
+{
+    return { reinterpret_cast<const uint8_t*>(text.data()), text.size() };
+}
+
+std::string Describe(const EscapeSequenceParser::ParseResult& result)
+{
+    std::string text = "seq " + std::string(1, static_cast<char>(result.mIdentifier))
+        + " mode " + std::to_string(static_cast<int>(result.mMode));
+    for (const int argument : result.mCommandData) {
+        text += " " + std::to_string(argument);
+    }
+    return text;
+}
+
+std::string Describe(EscapeSequenceParser::Error error)
+{
+    return "error " + std::to_string(static_cast<int>(error));
+}
+
+// Feeds input through the batch parser in chunks of the given sizes (the last
+// size repeats) and describes every byte drawn, sequence completed and
+// sequence abandoned, in order.
+std::vector<std::string> BatchEvents(std::span<const uint8_t> input, const std::vector<size_t>& chunkSizes)
+{
+    EscapeSequenceParser parser;
+    std::vector<std::string> events;
+    std::array<Token, 8> tokens;
+    size_t offset = 0;
+    for (size_t chunk = 0; offset < input.size(); ++chunk) {
+        const size_t size = std::min(chunkSizes[std::min(chunk, chunkSizes.size() - 1)], input.size() - offset);
+        auto remaining = input.subspan(offset, size);
+        offset += size;
+        while (!remaining.empty()) {
+            size_t count = 0;
+            const size_t consumed = parser.Parse(remaining, tokens, count);
+            for (size_t i = 0; i < count; ++i) {
+                const Token& token = tokens[i];
+                switch (token.mKind) {
+                case TokenKind::Text:
+                case TokenKind::Control:
+                    for (size_t j = 0; j < token.mLength; ++j) {
+                        events.push_back("out " + std::to_string(remaining[token.mOffset + j]));
+                    }
+                    break;
+                case TokenKind::Sequence:
+                    events.push_back(Describe(parser.GetSequence()));
+                    break;
+                case TokenKind::Malformed:
+                    events.push_back(Describe(token.mError));
+                    break;
+                }
+            }
+            remaining = remaining.subspan(consumed);
+        }
+    }
+    return events;
+}
+
+std::vector<std::string> ByteEvents(std::span<const uint8_t> input)
+{
+    EscapeSequenceParser parser;
+    std::vector<std::string> events;
+    for (const uint8_t byte : input) {
+        const auto& result = parser.Parse(byte);
+        if (result.mOutputChar) {
+            events.push_back("out " + std::to_string(result.mOutputChar));
+        }
+        else if (result.mStage == EscapeSequenceParser::Stage::Inactive) {
+            events.push_back(result.mError == EscapeSequenceParser::Error::None
+                ? Describe(result) : Describe(result.mError));
+        }
+    }
+    return events;
+}
 
 TEST(EscapeSequenceParserTest, OrdinaryBytesPassThrough)
 {
@@ -156,4 +238,74 @@ TEST(EscapeSequenceParserTest, ANewEscapeRestartsAMalformedPartialSequence)
     EXPECT_EQ(result.mCommandData, CommandData({31}));
 }
 
+TEST(EscapeSequenceParserTest, BatchParseEmitsTextControlAndSequenceTokens)
+{
+    EscapeSequenceParser parser;
+    std::array<Token, 8> tokens;
+    size_t count = 0;
+    const auto input = AsBytes("ab\r\n\x1B[31mcd");
+
+    EXPECT_EQ(parser.Parse(input, tokens, count), 9U);
+    ASSERT_EQ(count, 4U);
+    EXPECT_EQ(tokens[0].mKind, TokenKind::Text);
+    EXPECT_EQ(tokens[0].mOffset, 0U);
+    EXPECT_EQ(tokens[0].mLength, 2U);
+    EXPECT_EQ(tokens[1].mKind, TokenKind::Control);
+    EXPECT_EQ(tokens[1].mOffset, 2U);
+    EXPECT_EQ(tokens[2].mKind, TokenKind::Control);
+    EXPECT_EQ(tokens[3].mKind, TokenKind::Sequence);
+    EXPECT_EQ(tokens[3].mOffset, 8U);
+    EXPECT_EQ(parser.GetSequence().mIdentifier,
+        EscapeSequenceParser::EscapeIdentifier::m_SetGraphics);
+    EXPECT_EQ(parser.GetSequence().mCommandData, CommandData({31}));
+
+    EXPECT_EQ(parser.Parse(input.subspan(9), tokens, count), 2U);
+    ASSERT_EQ(count, 1U);
+    EXPECT_EQ(tokens[0].mKind, TokenKind::Text);
+    EXPECT_EQ(tokens[0].mLength, 2U);
+}
+
+TEST(EscapeSequenceParserTest, BatchParseActsOnLineControlsInsideASequence)
+{
+    EXPECT_EQ(BatchEvents(AsBytes("\x1B[3\n1m"), {64}),
+        (std::vector<std::string>{"out 10", "seq m mode 0 31"}));
+}
+
+TEST(EscapeSequenceParserTest, BatchParseReportsAbandonedSequences)
+{
+    const std::string badCsi = Describe(EscapeSequenceParser::Error::BadCsi);
+    const std::string badData = Describe(EscapeSequenceParser::Error::BadData);
+
+    EXPECT_EQ(BatchEvents(AsBytes("\x1B]x\x1B[3\tm"), {64}),
+        (std::vector<std::string>{badCsi, "out 120", badData, "out 109"}));
+}
+
+TEST(EscapeSequenceParserTest, BatchParseStopsWhenTheTokenBufferIsFull)
+{
+    EscapeSequenceParser parser;
+    std::array<Token, 2> tokens;
+    size_t count = 0;
+
+    EXPECT_EQ(parser.Parse(AsBytes("a\tb\tc"), tokens, count), 2U);
+    EXPECT_EQ(count, 2U);
+}
+
+TEST(EscapeSequenceParserTest, BatchParseMatchesByteAtATimeParse)
+{
+    // The byte-at-a-time parser has no notion of controls inside a sequence,
+    // so the inputs leave out the bytes the batch parser acts on there.
+    const std::string alphabet = "\x1B\x1B\x1B[[[?=?=;;0123456789mmHJhx \t\x7F\xC3\xA9";
+    std::mt19937 random(7);
+
+    for (int round = 0; round < 500; ++round) {
+        std::vector<uint8_t> input(1 + random() % 300);
+        for (uint8_t& byte : input) {
+            byte = static_cast<uint8_t>(alphabet[random() % alphabet.size()]);
+        }
+        const std::vector<size_t> chunks{1 + random() % 17, 1 + random() % 5, 1 + random() % 64};
+
+        ASSERT_EQ(BatchEvents(input, chunks), ByteEvents(input)) << "round " << round;
+    }
+}
+
 } // namespace
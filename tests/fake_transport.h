@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "transport.h"
+
+namespace imterm::test {
+
+// In-memory transport. Tests push bytes or a failure from the test thread; the
+// capture session's reader thread consumes them. Bytes the session writes are
+// collected for the test thread, which can also hold writes, to stand in for a
+// busy device, refuse them, as a device that stopped reading does, or fail them.
+class FakeTransport : public Transport {
+public:
+    enum class WriteMode {
+        Accept,
+        // Write() blocks until the mode changes.
+        Hold,
+        // Write() takes nothing.
+        Refuse
+    };
+
+    bool WaitReadable() override
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mReadable.wait_for(lock, std::chrono::milliseconds(5), [this] {
+            return !mPending.empty() || !mFailure.empty();
+        });
+        if (!mFailure.empty()) {
+            throw std::runtime_error(mFailure);
+        }
+        return !mPending.empty();
+    }
+
+    size_t Read(std::span<uint8_t> buffer) override
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const size_t count = std::min(buffer.size(), mPending.size());
+        std::copy_n(mPending.begin(), count, buffer.begin());
+        mPending.erase(mPending.begin(), mPending.begin() + count);
+        return count;
+    }
+
+    void Push(std::span<const uint8_t> bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPending.insert(mPending.end(), bytes.begin(), bytes.end());
+        }
+        mReadable.notify_one();
+    }
+
+    void Fail(std::string message)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFailure = std::move(message);
+        }
+        mReadable.notify_one();
+    }
+
+    bool Drained()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mPending.empty();
+    }
+
+    bool CanWrite() const override { return true; }
+
+    size_t Write(std::span<const std::span<const uint8_t>> buffers) override
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        ++mWritesStarted;
+        mWriteStarted.notify_all();
+        mWriteReleased.wait(lock, [this] { return mWriteMode != WriteMode::Hold; });
+        if (!mWriteFailure.empty()) {
+            throw std::runtime_error(mWriteFailure);
+        }
+        if (mWriteMode == WriteMode::Refuse) {
+            return 0;
+        }
+        size_t total = 0;
+        for (const auto& buffer : buffers) {
+            mWritten.insert(mWritten.end(), buffer.begin(), buffer.end());
+            total += buffer.size();
+        }
+        mWriteSizes.push_back(total);
+        return total;
+    }
+
+    void SetWriteMode(WriteMode mode)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mWriteMode = mode;
+        }
+        mWriteReleased.notify_all();
+    }
+
+    void FailWrites(std::string message)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWriteFailure = std::move(message);
+    }
+
+    // Waits until Write() has been called aCount times in all.
+    bool WaitForWrites(size_t count)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mWriteStarted.wait_for(lock, std::chrono::seconds(5), [&] { return mWritesStarted >= count; });
+    }
+
+    std::vector<uint8_t> Written()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mWritten;
+    }
+
+    // The bytes taken by each Write() that took any.
+    std::vector<size_t> WriteSizes()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mWriteSizes;
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mReadable;
+    std::deque<uint8_t> mPending;
+    std::string mFailure;
+
+    std::condition_variable mWriteStarted;
+    std::condition_variable mWriteReleased;
+    WriteMode mWriteMode = WriteMode::Accept;
+    std::string mWriteFailure;
+    size_t mWritesStarted = 0;
+    std::vector<uint8_t> mWritten;
+    std::vector<size_t> mWriteSizes;
+};
+
+} // namespace imterm::test
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <span>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+#include "capture_session.h"
+#include "file_transport.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+#include "test_support.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+using imterm::FileTransport;
+
+std::vector<uint8_t> Pattern(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    std::mt19937 random(5);
+    for (uint8_t& byte : bytes) {
+        byte = static_cast<uint8_t>(random());
+    }
+    return bytes;
+}
+
+void WriteFile(const std::filesystem::path& path, std::span<const uint8_t> bytes, std::ios::openmode mode = std::ios::trunc)
+{
+    std::ofstream file(path, std::ios::binary | mode);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+FileTransport::Options Quick()
+{
+    FileTransport::Options options;
+    options.PollInterval = 1ms;
+    return options;
+}
+
+// Reads like the capture session's reader thread until aCount bytes arrived
+// or the input ended.
+std::vector<uint8_t> ReadUntil(FileTransport& transport, size_t count)
+{
+    std::vector<uint8_t> received;
+    std::vector<uint8_t> chunk(1000);
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (received.size() < count && !transport.AtEnd() && std::chrono::steady_clock::now() < deadline) {
+        if (transport.WaitReadable()) {
+            const size_t read = transport.Read(chunk);
+            received.insert(received.end(), chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(read));
+        }
+    }
+    return received;
+}
+
+TEST(FileTransportTest, ReadsAFileToTheEnd)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto expected = Pattern(12345);
+    WriteFile(directory.Path() / "input", expected);
+
+    FileTransport transport(directory.Path() / "input", Quick());
+    EXPECT_EQ(ReadUntil(transport, SIZE_MAX), expected);
+    EXPECT_TRUE(transport.AtEnd());
+    EXPECT_FALSE(transport.WaitReadable());
+}
+
+TEST(FileTransportTest, FollowsAGrowingFile)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto expected = Pattern(3000);
+    const auto path = directory.Path() / "input";
+    WriteFile(path, std::span(expected).first(1000));
+
+    auto options = Quick();
+    options.Follow = true;
+    FileTransport transport(path, options);
+    EXPECT_EQ(ReadUntil(transport, 1000).size(), 1000u);
+
+    WriteFile(path, std::span(expected).subspan(1000), std::ios::app);
+    std::vector<uint8_t> received(expected.begin(), expected.begin() + 1000);
+    const auto rest = ReadUntil(transport, 2000);
+    received.insert(received.end(), rest.begin(), rest.end());
+    EXPECT_EQ(received, expected);
+    EXPECT_FALSE(transport.AtEnd());
+}
+
+TEST(FileTransportTest, ReportsAMissingFile)
+{
+    imterm::test::TemporaryDirectory directory;
+    EXPECT_THROW(FileTransport(directory.Path() / "missing"), std::system_error);
+}
+
+#if !defined(_WIN32)
+TEST(FileTransportTest, EndsWhenThePipeIsClosed)
+{
+    int ends[2];
+    ASSERT_EQ(pipe(ends), 0);
+    const auto expected = Pattern(100000);
+    std::thread writer([&] {
+        size_t written = 0;
+        while (written < expected.size()) {
+            const ssize_t count = write(ends[1], expected.data() + written, expected.size() - written);
+            if (count <= 0) {
+                break;
+            }
+            written += static_cast<size_t>(count);
+        }
+        close(ends[1]);
+    });
+
+    FileTransport transport(ends[0], Quick());
+    EXPECT_EQ(ReadUntil(transport, SIZE_MAX), expected);
+    writer.join();
+    EXPECT_TRUE(transport.AtEnd());
+    close(ends[0]);
+}
+#endif
+
+TEST(FileTransportTest, CaptureAppliesAFileLargerThanTheReceiveBuffer)
+{
+    imterm::test::TemporaryDirectory directory;
+    std::vector<uint8_t> text;
+    for (int line = 0; line < 2000; ++line) {
+        const std::string content = "line " + std::to_string(line) + "\r\n";
+        text.insert(text.end(), content.begin(), content.end());
+    }
+    WriteFile(directory.Path() / "input", text);
+
+    auto data = std::make_shared<imterm::TerminalData>();
+    auto state = std::make_shared<imterm::TerminalState>(data, imterm::TerminalState::NewLineMode::Strict);
+    state->SetViewportSize(24, 80);
+    auto transport = std::make_shared<FileTransport>(directory.Path() / "input", Quick());
+    imterm::CaptureSession session(transport, state, 1024);
+    session.SetOverflowPolicy(imterm::ReceiveWorker::OverflowPolicy::Wait);
+    session.Start();
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    for (;;) {
+        session.Pump();
+        const auto stats = session.GetReceiveStatistics();
+        if (transport->AtEnd() && stats.mBytesDelivered == stats.mBytesReceived) {
+            break;
+        }
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+        std::this_thread::sleep_for(1ms);
+    }
+    session.Stop();
+
+    EXPECT_EQ(session.GetReceiveStatistics().mBytesDropped, 0u);
+    ASSERT_EQ(data->GetLineCount(), 2001u);
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "line 0");
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(1999)), "line 1999");
+}
+
+} // namespace
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "line_layout_cache.h"
+#include "terminal_state.h"
+#include "test_support.h"
+
+namespace {
+
+// Every character measures 10 wide; spaces are 10 and tabs 4 spaces.
+constexpr imterm::LineLayoutMetrics Metrics{ 13.0f, 10.0f, 4 };
+
+class LineLayoutCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        data = std::make_shared<imterm::TerminalData>();
+        state = std::make_unique<imterm::TerminalState>(
+            data, imterm::TerminalState::NewLineMode::Strict);
+        state->SetViewportSize(4, 80);
+        measure = [this](std::string_view text) {
+            ++measured;
+            return 10.0f * static_cast<float>(text.size());
+        };
+    }
+
+    void Input(std::string_view text)
+    {
+        state->Input(imterm::test::Bytes(text));
+    }
+
+    std::string RunText(const imterm::LineLayout& layout, size_t run) const
+    {
+        const imterm::LineLayout::Run& r = layout.mRuns.at(run);
+        return layout.mText.substr(r.mBegin, r.mEnd - r.mBegin);
+    }
+
+    std::shared_ptr<imterm::TerminalData> data;
+    std::unique_ptr<imterm::TerminalState> state;
+    imterm::LineLayoutCache cache;
+    imterm::LineLayoutCache::MeasureText measure;
+    int measured = 0;
+};
+
+TEST_F(LineLayoutCacheTest, SplitsRunsAtColorsAndWhitespace)
+{
+    Input("ab\x1b[31mcd ef\x1b[0m\tg");
+    const imterm::Line& line = data->GetLine(0);
+
+    cache.BeginFrame(Metrics);
+    const imterm::LineLayout& layout = cache.Get(line, measure);
+
+    ASSERT_EQ(layout.mRuns.size(), 4U);
+    EXPECT_EQ(RunText(layout, 0), "ab");
+    EXPECT_EQ(RunText(layout, 1), "cd");
+    EXPECT_EQ(RunText(layout, 2), "ef");
+    EXPECT_EQ(RunText(layout, 3), "g");
+    EXPECT_FLOAT_EQ(layout.mRuns[0].mX, 0.0f);
+    EXPECT_FLOAT_EQ(layout.mRuns[1].mX, 20.0f);
+    EXPECT_FLOAT_EQ(layout.mRuns[2].mX, 50.0f);
+    // The tab after "ef" (ending at 70) runs to the next stop at 80.
+    EXPECT_FLOAT_EQ(layout.mRuns[3].mX, 80.0f);
+    EXPECT_EQ(layout.mRuns[0].mColorIndex, line.ColorAt(0));
+    EXPECT_EQ(layout.mRuns[1].mColorIndex, line.ColorAt(2));
+    EXPECT_NE(layout.mRuns[1].mColorIndex, layout.mRuns[0].mColorIndex);
+    EXPECT_EQ(layout.mRuns[3].mColorIndex, line.ColorAt(0));
+
+    ASSERT_EQ(layout.mBlanks.size(), 2U);
+    EXPECT_FALSE(layout.mBlanks[0].mTab);
+    EXPECT_FLOAT_EQ(layout.mBlanks[0].mX, 40.0f);
+    EXPECT_TRUE(layout.mBlanks[1].mTab);
+    EXPECT_FLOAT_EQ(layout.mBlanks[1].mX, 70.0f);
+    EXPECT_FLOAT_EQ(layout.mBlanks[1].mWidth, 10.0f);
+}
+
+TEST_F(LineLayoutCacheTest, KeepsMultibyteCharactersWhole)
+{
+    Input("a\xc3\xa9 \xe2\x82\xac");
+
+    cache.BeginFrame(Metrics);
+    const imterm::LineLayout& layout = cache.Get(data->GetLine(0), measure);
+
+    ASSERT_EQ(layout.mRuns.size(), 2U);
+    EXPECT_EQ(RunText(layout, 0), "a\xc3\xa9");
+    EXPECT_EQ(RunText(layout, 1), "\xe2\x82\xac");
+}
+
+TEST_F(LineLayoutCacheTest, ReusesUnchangedLinesWithoutMeasuring)
+{
+    Input("one \x1b[32mtwo\x1b[0m three\r\nfour");
+
+    cache.BeginFrame(Metrics);
+    cache.Get(data->GetLine(0), measure);
+    cache.Get(data->GetLine(1), measure);
+    const int firstFrame = measured;
+    EXPECT_GT(firstFrame, 0);
+
+    for (int frame = 0; frame < 3; ++frame) {
+        cache.BeginFrame(Metrics);
+        cache.Get(data->GetLine(0), measure);
+        cache.Get(data->GetLine(1), measure);
+    }
+    EXPECT_EQ(measured, firstFrame);
+
+    // Only the line that changed is laid out again.
+    Input(" five");
+    cache.BeginFrame(Metrics);
+    EXPECT_EQ(RunText(cache.Get(data->GetLine(0), measure), 1), "two");
+    EXPECT_EQ(measured, firstFrame);
+    const imterm::LineLayout& changed = cache.Get(data->GetLine(1), measure);
+    ASSERT_EQ(changed.mRuns.size(), 2U);
+    EXPECT_EQ(RunText(changed, 1), "five");
+    EXPECT_EQ(measured, firstFrame + 2);
+}
+
+TEST_F(LineLayoutCacheTest, FollowsLinesAsTheyScroll)
+{
+    Input("a\r\nb\r\nc\r\nd");
+    cache.BeginFrame(Metrics);
+    for (size_t line = 0; line < data->GetLineCount(); ++line) {
+        cache.Get(data->GetLine(line), measure);
+    }
+    const int firstFrame = measured;
+
+    // Removing the first line shifts every index; the layouts still match
+    // the lines because they are keyed on the line's generation.
+    data->RemoveLine(0);
+    cache.BeginFrame(Metrics);
+    for (size_t line = 0; line < data->GetLineCount(); ++line) {
+        const imterm::LineLayout& layout = cache.Get(data->GetLine(line), measure);
+        ASSERT_EQ(layout.mRuns.size(), 1U);
+        EXPECT_EQ(RunText(layout, 0), std::string(1, static_cast<char>('b' + line)));
+    }
+    EXPECT_EQ(measured, firstFrame);
+}
+
+TEST_F(LineLayoutCacheTest, NewMetricsOrUnusedLinesDropLayouts)
+{
+    Input("x");
+    cache.BeginFrame(Metrics);
+    cache.Get(data->GetLine(0), measure);
+    EXPECT_EQ(cache.size(), 1U);
+
+    imterm::LineLayoutMetrics larger = Metrics;
+    larger.mFontSize = 26.0f;
+    cache.BeginFrame(larger);
+    EXPECT_EQ(cache.size(), 0U);
+
+    // Layouts of lines no longer drawn are swept once they outnumber those
+    // in use.
+    for (int line = 0; line < 200; ++line) {
+        Input("\r\nline");
+        cache.Get(data->GetLine(data->GetLineCount() - 1), measure);
+    }
+    cache.BeginFrame(larger);
+    cache.Get(data->GetLine(data->GetLineCount() - 1), measure);
+    cache.BeginFrame(larger);
+    EXPECT_EQ(cache.size(), 1U);
+}
+
+} // namespace
@@ -0,0 +1,460 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "line_store.h"
+#include "test_support.h"
+
+namespace {
+
+using imterm::LineStore;
+using imterm::test::LineText;
+
+constexpr size_t Block = LineStore::BlockCapacity;
+
+// A line whose text is aNumber as eight digits, so every line is identifiable.
+imterm::Line NumberedLine(size_t aNumber)
+{
+    const auto digit = [aNumber](size_t aPlace) {
+        size_t value = aNumber;
+        for (size_t i = 0; i < aPlace; ++i) {
+            value /= 10;
+        }
+        return imterm::Glyph(static_cast<imterm::Char>('0' + value % 10), imterm::PaletteIndex::Default);
+    };
+    return imterm::Line{ digit(7), digit(6), digit(5), digit(4), digit(3), digit(2), digit(1), digit(0) };
+}
+
+size_t LineNumber(const imterm::Line& line)
+{
+    return std::stoul(LineText(line));
+}
+
+LineStore NumberedStore(size_t count)
+{
+    LineStore store;
+    for (size_t i = 0; i < count; ++i) {
+        store.push_back(NumberedLine(i));
+    }
+    return store;
+}
+
+void ExpectNumbers(const LineStore& store, const std::vector<size_t>& expected)
+{
+    ASSERT_EQ(store.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(LineNumber(store[i]), expected[i]) << "at index " << i;
+    }
+}
+
+std::vector<size_t> Range(size_t first, size_t last)
+{
+    std::vector<size_t> numbers;
+    for (size_t i = first; i < last; ++i) {
+        numbers.push_back(i);
+    }
+    return numbers;
+}
+
+TEST(LineStoreTest, AppendsAcrossBlocksInOrder)
+{
+    const LineStore store = NumberedStore(Block * 2 + 3);
+
+    EXPECT_EQ(store.BlockCount(), 3U);
+    ExpectNumbers(store, Range(0, Block * 2 + 3));
+    EXPECT_EQ(LineNumber(store.front()), 0U);
+    EXPECT_EQ(LineNumber(store.back()), Block * 2 + 2);
+}
+
+TEST(LineStoreTest, AppendingKeepsEarlierBlocksInPlace)
+{
+    LineStore store = NumberedStore(Block);
+    const imterm::Line* first = &store[0];
+
+    for (size_t i = 0; i < Block * 2; ++i) {
+        store.push_back(NumberedLine(Block + i));
+    }
+
+    EXPECT_EQ(&store[0], first);
+    EXPECT_EQ(LineNumber(*first), 0U);
+}
+
+TEST(LineStoreTest, InsertIntoFullBlockSplitsIt)
+{
+    LineStore store = NumberedStore(Block * 2);
+
+    store.insert(10, NumberedLine(90000000));
+    store.insert(Block + 5, NumberedLine(90000001));
+
+    std::vector<size_t> expected = Range(0, Block * 2);
+    expected.insert(expected.begin() + 10, 90000000);
+    expected.insert(expected.begin() + static_cast<std::ptrdiff_t>(Block + 5), 90000001);
+    ExpectNumbers(store, expected);
+    EXPECT_EQ(store.BlockCount(), 4U);
+}
+
+TEST(LineStoreTest, InsertAtEndAppends)
+{
+    LineStore store = NumberedStore(3);
+
+    store.insert(3, NumberedLine(3));
+
+    ExpectNumbers(store, Range(0, 4));
+    EXPECT_THROW(store.insert(5, NumberedLine(5)), std::out_of_range);
+}
+
+TEST(LineStoreTest, EraseSpanningBlocksDropsEmptiedBlocks)
+{
+    LineStore store = NumberedStore(Block * 3);
+
+    store.erase(Block - 2, Block * 2 + 2);
+
+    std::vector<size_t> expected = Range(0, Block - 2);
+    const std::vector<size_t> tail = Range(Block * 2 + 2, Block * 3);
+    expected.insert(expected.end(), tail.begin(), tail.end());
+    ExpectNumbers(store, expected);
+    EXPECT_EQ(store.BlockCount(), 2U);
+}
+
+TEST(LineStoreTest, ErasingThePrefixKeepsLookupsCorrect)
+{
+    // Removing the oldest lines is how scrollback is trimmed; afterwards no
+    // block starts on a multiple of the block size.
+    LineStore store = NumberedStore(Block * 3);
+
+    store.erase(0, 7);
+    store.push_back(NumberedLine(Block * 3));
+
+    ExpectNumbers(store, Range(7, Block * 3 + 1));
+}
+
+TEST(LineStoreTest, EraseEverythingThenAppend)
+{
+    LineStore store = NumberedStore(Block + 1);
+
+    store.erase(0, store.size());
+    EXPECT_TRUE(store.empty());
+    EXPECT_EQ(store.BlockCount(), 0U);
+
+    store.push_back(NumberedLine(42));
+    ExpectNumbers(store, { 42 });
+    EXPECT_THROW(store.erase(1, 0), std::out_of_range);
+    EXPECT_THROW(store.erase(0, 2), std::out_of_range);
+}
+
+TEST(LineStoreTest, ResizeAndClear)
+{
+    LineStore store(3);
+    EXPECT_EQ(store.size(), 3U);
+    EXPECT_TRUE(store[2].empty());
+
+    store.resize(Block + 10);
+    EXPECT_EQ(store.size(), Block + 10);
+    store.resize(1);
+    EXPECT_EQ(store.size(), 1U);
+
+    store.clear();
+    EXPECT_TRUE(store.empty());
+    EXPECT_EQ(store.BlockCount(), 0U);
+    EXPECT_EQ(store.GetHeapUsage(), 0U);
+}
+
+TEST(LineStoreTest, AtChecksBounds)
+{
+    LineStore store = NumberedStore(2);
+
+    EXPECT_EQ(LineNumber(store.at(1)), 1U);
+    EXPECT_THROW(store.at(2), std::out_of_range);
+}
+
+TEST(LineStoreTest, IteratorsAreRandomAccess)
+{
+    const LineStore store = NumberedStore(Block + 4);
+
+    size_t expected = 0;
+    for (const imterm::Line& line : store) {
+        ASSERT_EQ(LineNumber(line), expected++);
+    }
+    EXPECT_EQ(expected, store.size());
+
+    const auto middle = store.begin() + static_cast<std::ptrdiff_t>(Block);
+    EXPECT_EQ(LineNumber(*middle), Block);
+    EXPECT_EQ(store.end() - middle, 4);
+    EXPECT_LT(store.begin(), middle);
+    EXPECT_EQ(LineNumber(middle[-1]), Block - 1);
+}
+
+std::vector<size_t> SnapshotNumbers(const LineStore::Snapshot& snapshot)
+{
+    std::vector<size_t> numbers;
+    snapshot.ForEach(0, snapshot.size(), [&numbers](size_t index, const imterm::Line& line) {
+        EXPECT_EQ(index, numbers.size());
+        numbers.push_back(LineNumber(line));
+    });
+    return numbers;
+}
+
+TEST(LineStoreTest, SnapshotKeepsTheLinesItWasTakenWith)
+{
+    LineStore store = NumberedStore(Block * 3 + 5);
+    const LineStore::Snapshot snapshot = store.TakeSnapshot();
+    EXPECT_EQ(store.SealedBlockCount(), 3U);
+
+    // Writes to sealed blocks, the copied tail and the block structure.
+    store[7] = NumberedLine(77777);
+    store.insert(Block + 2, NumberedLine(88888));
+    store.erase(Block * 2, Block * 2 + 10);
+    store[store.size() - 1] = NumberedLine(99999);
+    store.push_back(NumberedLine(12345));
+    EXPECT_EQ(store.SealedBlockCount(), 0U);
+
+    ASSERT_EQ(snapshot.size(), Block * 3 + 5);
+    EXPECT_EQ(SnapshotNumbers(snapshot), Range(0, Block * 3 + 5));
+    EXPECT_EQ(LineNumber(snapshot.GetLine(Block * 3 + 4)), Block * 3 + 4);
+    EXPECT_THROW(snapshot.GetLine(Block * 3 + 5), std::out_of_range);
+    EXPECT_EQ(LineNumber(store[7]), 77777U);
+    EXPECT_EQ(LineNumber(store[Block + 2]), 88888U);
+    EXPECT_EQ(LineNumber(store.back()), 12345U);
+
+    // A partial range starting inside a block.
+    std::vector<size_t> partial;
+    snapshot.ForEach(Block - 2, Block + 1, [&partial](size_t, const imterm::Line& line) { partial.push_back(LineNumber(line)); });
+    EXPECT_EQ(partial, Range(Block - 2, Block + 1));
+}
+
+TEST(LineStoreTest, SealedBlocksAreTakenBackWithoutCopyingOnceNoSnapshotIsLeft)
+{
+    LineStore store = NumberedStore(Block * 2 + 1);
+    const imterm::Line* first = &store[0];
+    const imterm::Line* second = &store[Block];
+
+    {
+        LineStore::Snapshot snapshot = store.TakeSnapshot();
+        LineStore::Snapshot moved = std::move(snapshot);
+        // While the snapshot holds the block, the write goes to a copy.
+        EXPECT_NE(&store[0], first);
+        EXPECT_EQ(LineNumber(moved.GetLine(0)), 0U);
+    }
+
+    // Sealed again, then written with no snapshot left: the lines stay where
+    // they were.
+    store.TakeSnapshot();
+    EXPECT_EQ(store.SealedBlockCount(), 2U);
+    EXPECT_EQ(&store[Block], second);
+    EXPECT_EQ(store.SealedBlockCount(), 1U);
+
+    // Removing whole blocks from the end leaves a sealed, partial block
+    // last, and appending takes it back.
+    store.insert(1, NumberedLine(44444));
+    store.TakeSnapshot();
+    store.erase(Block + 1, store.size());
+    store.push_back(NumberedLine(55555));
+    std::vector<size_t> expected = Range(0, Block);
+    expected.insert(expected.begin() + 1, 44444);
+    expected.push_back(55555);
+    ExpectNumbers(store, expected);
+    EXPECT_EQ(store.SealedBlockCount(), 1U);
+}
+
+}
+
+namespace {
+
+// aNumber's digits with every other digit colored, so spilled lines carry
+// bytes, color runs and a timestamp of their own.
+imterm::Line ColoredLine(size_t aNumber)
+{
+    const std::string digits = LineText(NumberedLine(aNumber));
+    const auto glyph = [&](size_t aIndex) {
+        const auto color = aIndex % 2 == 0
+            ? static_cast<imterm::PaletteIndex>(static_cast<size_t>(imterm::PaletteIndex::Red) + (aNumber + aIndex) % 7)
+            : imterm::PaletteIndex::Default;
+        return imterm::Glyph(static_cast<imterm::Char>(digits[aIndex]), color);
+    };
+    return imterm::Line{ glyph(0), glyph(1), glyph(2), glyph(3), glyph(4), glyph(5), glyph(6), glyph(7) };
+}
+
+void ExpectSameLine(const imterm::Line& actual, const imterm::Line& expected)
+{
+    EXPECT_EQ(LineText(actual), LineText(expected));
+    EXPECT_EQ(actual.GetTimestamp(), expected.GetTimestamp());
+    EXPECT_EQ(actual.GetFirstTimestamp(), expected.GetFirstTimestamp());
+    const auto actualRuns = actual.GetAttributeRuns();
+    const auto expectedRuns = expected.GetAttributeRuns();
+    ASSERT_EQ(actualRuns.size(), expectedRuns.size());
+    for (size_t run = 0; run < actualRuns.size(); ++run) {
+        EXPECT_EQ(actualRuns[run].mStart, expectedRuns[run].mStart);
+        EXPECT_EQ(actualRuns[run].mColorIndex, expectedRuns[run].mColorIndex);
+    }
+}
+
+LineStore::SpillOptions SpillTo(const imterm::test::TemporaryDirectory& directory)
+{
+    LineStore::SpillOptions options;
+    options.Path = directory.Path() / "scrollback.spill";
+    options.HotLines = Block;
+    options.CachedBlocks = 2;
+    options.ChunkSize = 1;
+    return options;
+}
+
+}
+
+TEST(LineStoreSpillTest, ColdBlocksLeaveMemoryAndReadBackUnchanged)
+{
+    imterm::test::TemporaryDirectory directory;
+    LineStore store;
+    store.EnableSpill(SpillTo(directory));
+    EXPECT_THROW(store.EnableSpill(SpillTo(directory)), std::logic_error);
+
+    std::vector<imterm::Line> expected;
+    for (size_t i = 0; i < Block * 6 + 3; ++i) {
+        expected.push_back(ColoredLine(i));
+        store.push_back(imterm::Line(expected.back()));
+    }
+    // Every block before the last Block lines is cold; the last two blocks
+    // and the partial one stay in memory.
+    EXPECT_EQ(store.SpilledBlockCount(), 5U);
+    EXPECT_GT(store.GetSpillFileSize(), 0U);
+    EXPECT_LT(store.GetHeapUsage(), 3 * Block * sizeof(imterm::Line));
+
+    // Reads through a const store cycle blocks through the two-block cache
+    // without paging them back in.
+    const LineStore& reader = store;
+    for (size_t i : { size_t{ 0 }, Block * 3 + 1, Block - 1, Block * 5 + 7, Block * 2, size_t{ 5 } }) {
+        ExpectSameLine(reader[i], expected[i]);
+    }
+    size_t index = 0;
+    for (const imterm::Line& line : reader) {
+        ExpectSameLine(line, expected[index++]);
+    }
+    EXPECT_EQ(store.SpilledBlockCount(), 5U);
+    EXPECT_FALSE(store.TakeSpillError());
+    EXPECT_TRUE(std::filesystem::exists(directory.Path() / "scrollback.spill"));
+}
+
+TEST(LineStoreSpillTest, WritesPageSpilledBlocksBackIn)
+{
+    imterm::test::TemporaryDirectory directory;
+    LineStore store;
+    store.EnableSpill(SpillTo(directory));
+    for (size_t i = 0; i < Block * 5; ++i) {
+        store.push_back(NumberedLine(i));
+    }
+    std::vector<size_t> expected = Range(0, Block * 5);
+    ASSERT_EQ(store.SpilledBlockCount(), 3U);
+
+    // Replacing a line through the non-const accessor pages its block in.
+    store[10] = NumberedLine(99999);
+    expected[10] = 99999;
+    EXPECT_EQ(store.SpilledBlockCount(), 2U);
+
+    store.insert(Block + 5, NumberedLine(88888));
+    expected.insert(expected.begin() + static_cast<std::ptrdiff_t>(Block + 5), 88888);
+    EXPECT_EQ(store.SpilledBlockCount(), 1U);
+
+    store.erase(0, Block / 2);
+    expected.erase(expected.begin(), expected.begin() + static_cast<std::ptrdiff_t>(Block / 2));
+    ExpectNumbers(store, expected);
+
+    // New blocks push the paged-in ones back out.
+    for (size_t i = Block * 5; i < Block * 8; ++i) {
+        store.push_back(NumberedLine(i));
+        expected.push_back(i);
+    }
+    ExpectNumbers(store, expected);
+    EXPECT_GE(store.SpilledBlockCount(), 6U);
+
+    // Whole spilled blocks in the middle are dropped unread.
+    store.erase(Block * 2, Block * 6);
+    expected.erase(expected.begin() + static_cast<std::ptrdiff_t>(Block * 2),
+        expected.begin() + static_cast<std::ptrdiff_t>(Block * 6));
+    ExpectNumbers(store, expected);
+
+    store.clear();
+    EXPECT_EQ(store.SpilledBlockCount(), 0U);
+    store.push_back(NumberedLine(1));
+    ExpectNumbers(store, { 1 });
+}
+
+TEST(LineStoreSpillTest, CompressedBlocksStayInMemoryWithoutAFile)
+{
+    LineStore::SpillOptions options;
+    options.Compress = true;
+    options.HotLines = Block;
+    options.CachedBlocks = 1;
+    LineStore store;
+    store.EnableSpill(options);
+
+    std::vector<imterm::Line> expected;
+    for (size_t i = 0; i < Block * 4 + 3; ++i) {
+        expected.push_back(ColoredLine(i));
+        store.push_back(imterm::Line(expected.back()));
+    }
+    EXPECT_EQ(store.SpilledBlockCount(), 3U);
+    EXPECT_EQ(store.GetSpillFileSize(), 0U);
+
+    const LineStore::SpillStatistics written = store.GetSpillStatistics();
+    EXPECT_EQ(written.SpilledBlocks, 3U);
+    EXPECT_LT(written.StoredBytes * 2, written.EncodedBytes);
+    EXPECT_EQ(written.ReadBlocks, 0U);
+
+    // With one cached block, alternating between two blocks decodes each
+    // read.
+    const LineStore& reader = store;
+    for (size_t i : { size_t{ 3 }, Block + 3, size_t{ 4 }, Block * 2 + 1 }) {
+        ExpectSameLine(reader[i], expected[i]);
+    }
+    const LineStore::SpillStatistics read = store.GetSpillStatistics();
+    EXPECT_EQ(read.ReadBlocks, 4U);
+    EXPECT_GE(read.ReadTime, read.WorstReadTime);
+
+    store[Block] = NumberedLine(12345);
+    EXPECT_EQ(store.SpilledBlockCount(), 2U);
+    EXPECT_EQ(LineText(reader[Block]), LineText(NumberedLine(12345)));
+    ExpectSameLine(reader[Block * 2 + 7], expected[Block * 2 + 7]);
+}
+
+TEST(LineStoreSpillTest, SnapshotsReadSpilledBlocksAfterTheStoreIsGone)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto path = directory.Path() / "scrollback.spill";
+    std::vector<imterm::Line> expected;
+    LineStore::Snapshot snapshot;
+    LineStore::Snapshot packed;
+    {
+        LineStore store;
+        store.EnableSpill(SpillTo(directory));
+        LineStore::SpillOptions inMemory;
+        inMemory.Compress = true;
+        inMemory.HotLines = Block;
+        LineStore memoryStore;
+        memoryStore.EnableSpill(inMemory);
+        for (size_t i = 0; i < Block * 4 + 3; ++i) {
+            expected.push_back(ColoredLine(i));
+            store.push_back(imterm::Line(expected.back()));
+            memoryStore.push_back(imterm::Line(expected.back()));
+        }
+        ASSERT_EQ(store.SpilledBlockCount(), 3U);
+        snapshot = store.TakeSnapshot();
+        packed = memoryStore.TakeSnapshot();
+
+        // Paging a block back in and spilling new ones does not change what
+        // the snapshot reads.
+        store[0] = NumberedLine(99999);
+        for (size_t i = 0; i < Block * 2; ++i) {
+            store.push_back(NumberedLine(i));
+        }
+    }
+    EXPECT_TRUE(std::filesystem::exists(path));
+
+    ASSERT_EQ(snapshot.size(), expected.size());
+    snapshot.ForEach(0, snapshot.size(), [&expected](size_t index, const imterm::Line& line) { ExpectSameLine(line, expected[index]); });
+    packed.ForEach(0, packed.size(), [&expected](size_t index, const imterm::Line& line) { ExpectSameLine(line, expected[index]); });
+    snapshot = LineStore::Snapshot();
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
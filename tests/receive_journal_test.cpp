@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <span>
+#include <system_error>
+#include <vector>
+
+#include "receive_journal.h"
+#include "test_support.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+using imterm::ReceiveJournal;
+
+// Chunks of the smallest size, so a few hundred kilobytes span several.
+ReceiveJournal::Options SmallChunks()
+{
+    ReceiveJournal::Options options;
+    options.ChunkSize = 1;
+    return options;
+}
+
+std::vector<uint8_t> Pattern(size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    std::mt19937 random(7);
+    for (uint8_t& byte : bytes) {
+        byte = static_cast<uint8_t>(random());
+    }
+    return bytes;
+}
+
+TEST(ReceiveJournalTest, ReadsBackEveryByteAcrossChunks)
+{
+    imterm::test::TemporaryDirectory directory;
+    ReceiveJournal journal(directory.Path() / "rx.journal", SmallChunks());
+    ASSERT_EQ(journal.GetChunkSize(), 64U << 10);
+
+    const std::vector<uint8_t> expected = Pattern(journal.GetChunkSize() * 5 + 123);
+    std::mt19937 random(1);
+    for (size_t offset = 0; offset < expected.size();) {
+        const size_t count = std::min<size_t>(random() % 20000, expected.size() - offset);
+        journal.Append(std::span(expected).subspan(offset, count));
+        offset += count;
+    }
+    EXPECT_EQ(journal.GetSize(), expected.size());
+    EXPECT_EQ(journal.GetDroppedBytes(), 0U);
+
+    // Reads that cross chunk boundaries, revisit older chunks and run past
+    // the end.
+    std::vector<uint8_t> buffer(100000);
+    for (uint64_t offset : { uint64_t{ 0 }, uint64_t{ 65000 }, uint64_t{ 300000 }, uint64_t{ 1000 },
+             uint64_t{ 200000 }, expected.size() - 50, expected.size(), expected.size() + 10 }) {
+        const size_t count = journal.Read(offset, buffer);
+        const size_t available = offset < expected.size() ? expected.size() - offset : 0;
+        ASSERT_EQ(count, std::min(buffer.size(), available)) << offset;
+        EXPECT_TRUE(std::equal(buffer.begin(), buffer.begin() + count, expected.begin() + offset)) << offset;
+    }
+}
+
+TEST(ReceiveJournalTest, KeepsCoarseReceiveTimes)
+{
+    imterm::test::TemporaryDirectory directory;
+    ReceiveJournal journal(directory.Path() / "rx.journal");
+    const ReceiveJournal::Clock::time_point start{ 1000s };
+
+    journal.Append(imterm::test::Bytes("abc"), start);
+    journal.Append(imterm::test::Bytes("de"), start + 5ms);
+    journal.Append(imterm::test::Bytes("fg"), start + 30ms);
+    journal.Append({}, start + 60ms);
+
+    ASSERT_EQ(journal.GetTimeMarks().size(), 2U);
+    EXPECT_EQ(journal.GetTime(0), start);
+    EXPECT_EQ(journal.GetTime(4), start);
+    EXPECT_EQ(journal.GetTime(5), start + 30ms);
+    EXPECT_EQ(journal.GetTime(6), start + 30ms);
+    EXPECT_FALSE(journal.GetTime(7));
+}
+
+TEST(ReceiveJournalTest, CountsBytesBeyondTheLimitAsDropped)
+{
+    imterm::test::TemporaryDirectory directory;
+    ReceiveJournal::Options options = SmallChunks();
+    options.MaxBytes = 10;
+    ReceiveJournal journal(directory.Path() / "rx.journal", options);
+
+    journal.Append(imterm::test::Bytes("0123456"));
+    journal.Append(imterm::test::Bytes("789abc"));
+    journal.Append(imterm::test::Bytes("d"));
+
+    EXPECT_EQ(journal.GetSize(), 10U);
+    EXPECT_EQ(journal.GetDroppedBytes(), 4U);
+    EXPECT_FALSE(journal.TakeError());
+    std::vector<uint8_t> buffer(16);
+    ASSERT_EQ(journal.Read(0, buffer), 10U);
+    EXPECT_EQ(std::string(buffer.begin(), buffer.begin() + 10), "0123456789");
+}
+
+TEST(ReceiveJournalTest, RemovesOrTrimsTheFileWhenDestroyed)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto removed = directory.Path() / "removed.journal";
+    const auto kept = directory.Path() / "kept.journal";
+    {
+        ReceiveJournal journal(removed);
+        journal.Append(imterm::test::Bytes("data"));
+        EXPECT_TRUE(std::filesystem::exists(removed));
+    }
+    EXPECT_FALSE(std::filesystem::exists(removed));
+
+    {
+        ReceiveJournal::Options options = SmallChunks();
+        options.KeepFile = true;
+        ReceiveJournal journal(kept, options);
+        journal.Append(imterm::test::Bytes({ 'a', 0, 0x1B, '[', 'm' }));
+    }
+    EXPECT_EQ(imterm::test::ReadFile(kept), std::string("a\0\x1B[m", 5));
+
+    EXPECT_THROW(ReceiveJournal(directory.Path() / "missing" / "rx.journal"), std::system_error);
+}
+
+TEST(ReceiveJournalTest, KeepsTimeMarksNextToAKeptFile)
+{
+    imterm::test::TemporaryDirectory directory;
+    const auto path = directory.Path() / "kept.journal";
+    const ReceiveJournal::Clock::time_point start{ 1000s };
+    {
+        ReceiveJournal::Options options;
+        options.KeepFile = true;
+        ReceiveJournal journal(path, options);
+        journal.Append(imterm::test::Bytes("abc"), start);
+        journal.Append(imterm::test::Bytes("de"), start + 1500us);
+        journal.Append(imterm::test::Bytes("fg"), start + 20ms);
+    }
+
+    const auto marks = ReceiveJournal::LoadTimeMarks(path);
+    ASSERT_EQ(marks.size(), 2U);
+    EXPECT_EQ(marks[0].mOffset, 0U);
+    EXPECT_EQ(marks[0].mTime, start);
+    EXPECT_EQ(marks[1].mOffset, 5U);
+    EXPECT_EQ(marks[1].mTime, start + 20ms);
+    EXPECT_EQ(ReceiveJournal::FindTimeMark(marks, 4), &marks[0]);
+    EXPECT_EQ(ReceiveJournal::FindTimeMark(marks, 9), &marks[1]);
+
+    EXPECT_TRUE(ReceiveJournal::LoadTimeMarks(directory.Path() / "other.journal").empty());
+    {
+        ReceiveJournal journal(directory.Path() / "removed.journal");
+        journal.Append(imterm::test::Bytes("x"), start);
+    }
+    EXPECT_FALSE(std::filesystem::exists(ReceiveJournal::TimesPath(directory.Path() / "removed.journal")));
+}
+
+} // namespace
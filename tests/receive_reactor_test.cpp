@@ -0,0 +1,321 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "capture_session.h"
+#include "fake_transport.h"
+#include "file_transport.h"
+#include "receive_reactor.h"
+#include "receive_worker.h"
+#include "terminal_data.h"
+#include "terminal_state.h"
+#include "test_support.h"
+
+namespace {
+
+using namespace std::chrono_literals;
+using imterm::ReceiveReactor;
+using imterm::ReceiveWorker;
+
+std::vector<uint8_t> Pattern(size_t size, unsigned seed)
+{
+    std::vector<uint8_t> bytes(size);
+    std::mt19937 random(seed);
+    for (uint8_t& byte : bytes) {
+        byte = static_cast<uint8_t>(random());
+    }
+    return bytes;
+}
+
+template<typename Predicate>
+bool WaitFor(Predicate predicate)
+{
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+// Drains aWorker into aReceived until it holds aCount bytes.
+bool DrainUntil(ReceiveWorker& worker, std::vector<uint8_t>& received, size_t count, size_t budget = SIZE_MAX)
+{
+    return WaitFor([&] {
+        worker.Drain(budget, [&](std::span<const uint8_t> bytes, ReceiveWorker::Timestamp) {
+            received.insert(received.end(), bytes.begin(), bytes.end());
+        });
+        return received.size() >= count;
+    });
+}
+
+TEST(ReceiveReactorTest, KeepsAThreadForTransportsWithoutADescriptor)
+{
+    auto reactor = std::make_shared<ReceiveReactor>();
+    auto transport = std::make_shared<imterm::test::FakeTransport>();
+    ReceiveWorker worker(transport, 64);
+    worker.SetReactor(reactor);
+    worker.Start();
+
+    EXPECT_TRUE(worker.IsRunning());
+    EXPECT_FALSE(worker.OnReactor());
+    EXPECT_EQ(reactor->GetStatistics().mPorts, 0u);
+
+    transport->Push(imterm::test::Bytes("still read"));
+    std::vector<uint8_t> received;
+    ASSERT_TRUE(DrainUntil(worker, received, 10));
+    EXPECT_EQ(received, imterm::test::Bytes("still read"));
+}
+
+#if defined(__linux__)
+
+// Both ends of a pipe; the test writes, a FileTransport reads.
+class Pipe {
+public:
+    Pipe()
+    {
+        if (pipe(mEnds) != 0) {
+            throw std::system_error(errno, std::generic_category(), "pipe");
+        }
+    }
+
+    ~Pipe()
+    {
+        CloseWriter();
+        close(mEnds[0]);
+    }
+
+    Pipe(const Pipe&) = delete;
+    Pipe& operator=(const Pipe&) = delete;
+
+    int Reader() const { return mEnds[0]; }
+
+    void Write(std::span<const uint8_t> bytes)
+    {
+        size_t written = 0;
+        while (written < bytes.size()) {
+            const ssize_t count = write(mEnds[1], bytes.data() + written, bytes.size() - written);
+            if (count <= 0) {
+                throw std::system_error(errno, std::generic_category(), "write");
+            }
+            written += static_cast<size_t>(count);
+        }
+    }
+
+    void CloseWriter()
+    {
+        if (mEnds[1] >= 0) {
+            close(mEnds[1]);
+            mEnds[1] = -1;
+        }
+    }
+
+private:
+    int mEnds[2];
+};
+
+imterm::FileTransport::Options Quick()
+{
+    imterm::FileTransport::Options options;
+    options.PollInterval = 1ms;
+    return options;
+}
+
+TEST(ReceiveReactorTest, ServesManyPortsOnOneThread)
+{
+    constexpr size_t ports = 16;
+    constexpr size_t size = 20000;
+    auto reactor = std::make_shared<ReceiveReactor>();
+    std::vector<std::unique_ptr<Pipe>> pipes;
+    std::vector<std::unique_ptr<ReceiveWorker>> workers;
+    for (size_t i = 0; i < ports; ++i) {
+        pipes.push_back(std::make_unique<Pipe>());
+        workers.push_back(std::make_unique<ReceiveWorker>(
+            std::make_shared<imterm::FileTransport>(pipes.back()->Reader(), Quick()), 32 * 1024));
+        workers.back()->SetReactor(reactor);
+        workers.back()->Start();
+        EXPECT_TRUE(workers.back()->OnReactor());
+    }
+    EXPECT_EQ(reactor->GetStatistics().mPorts, ports);
+
+    for (size_t i = 0; i < ports; ++i) {
+        pipes[i]->Write(Pattern(size, static_cast<unsigned>(i)));
+    }
+    // Each port gets its own bytes, whole and in order.
+    for (size_t i = 0; i < ports; ++i) {
+        std::vector<uint8_t> received;
+        ASSERT_TRUE(DrainUntil(*workers[i], received, size));
+        EXPECT_EQ(received, Pattern(size, static_cast<unsigned>(i)));
+        EXPECT_EQ(workers[i]->GetStatistics().mBytesDropped, 0u);
+    }
+
+    for (auto& worker : workers) {
+        worker->Stop();
+        EXPECT_FALSE(worker->IsRunning());
+    }
+    EXPECT_EQ(reactor->GetStatistics().mPorts, 0u);
+}
+
+TEST(ReceiveReactorTest, IdlePortsDoNotWakeIt)
+{
+    auto reactor = std::make_shared<ReceiveReactor>();
+    std::vector<std::unique_ptr<Pipe>> pipes;
+    std::vector<std::unique_ptr<ReceiveWorker>> workers;
+    for (int i = 0; i < 16; ++i) {
+        pipes.push_back(std::make_unique<Pipe>());
+        workers.push_back(std::make_unique<ReceiveWorker>(
+            std::make_shared<imterm::FileTransport>(pipes.back()->Reader(), Quick()), 4096));
+        workers.back()->SetReactor(reactor);
+        workers.back()->Start();
+    }
+
+    std::this_thread::sleep_for(50ms);
+    EXPECT_EQ(reactor->GetStatistics().mWakeups, 0u);
+
+    // A line on one port costs a read of that port, not a look at all 16.
+    pipes[7]->Write(imterm::test::Bytes("boot ok\r\n"));
+    std::vector<uint8_t> received;
+    ASSERT_TRUE(DrainUntil(*workers[7], received, 9));
+    std::this_thread::sleep_for(20ms);
+    const auto stats = reactor->GetStatistics();
+    EXPECT_EQ(stats.mReads, 1u);
+    EXPECT_LE(stats.mWakeups, 2u);
+}
+
+TEST(ReceiveReactorTest, WaitsForRoomWithoutDropping)
+{
+    Pipe pipe;
+    auto reactor = std::make_shared<ReceiveReactor>();
+    auto transport = std::make_shared<imterm::FileTransport>(pipe.Reader(), Quick());
+    ReceiveWorker worker(transport, 1024);
+    worker.SetOverflowPolicy(ReceiveWorker::OverflowPolicy::Wait);
+    worker.SetReactor(reactor);
+    worker.Start();
+    ASSERT_TRUE(worker.OnReactor());
+
+    const auto expected = Pattern(200000, 11);
+    std::thread writer([&] {
+        pipe.Write(expected);
+        pipe.CloseWriter();
+    });
+
+    // A slow consumer: the reactor stops reading the port while its ring is
+    // full, and the pipe holds the writer back.
+    std::vector<uint8_t> received;
+    const bool complete = DrainUntil(worker, received, expected.size(), 300);
+    writer.join();
+    ASSERT_TRUE(complete);
+
+    EXPECT_EQ(received, expected);
+    EXPECT_EQ(worker.GetStatistics().mBytesDropped, 0u);
+    EXPECT_LE(worker.GetStatistics().mHighWaterMark, 1024u);
+}
+
+TEST(ReceiveReactorTest, StopsWaitingAtTheEndOfInput)
+{
+    Pipe pipe;
+    auto reactor = std::make_shared<ReceiveReactor>();
+    auto transport = std::make_shared<imterm::FileTransport>(pipe.Reader(), Quick());
+    ReceiveWorker worker(transport, 4096);
+    worker.SetReactor(reactor);
+    worker.Start();
+
+    pipe.Write(imterm::test::Bytes("last words"));
+    pipe.CloseWriter();
+    std::vector<uint8_t> received;
+    ASSERT_TRUE(DrainUntil(worker, received, 10));
+    ASSERT_TRUE(WaitFor([&] { return transport->AtEnd(); }));
+
+    // A closed pipe polls readable for ever; the port is no longer waited on.
+    const uint64_t wakeups = reactor->GetStatistics().mWakeups;
+    std::this_thread::sleep_for(30ms);
+    EXPECT_LE(reactor->GetStatistics().mWakeups, wakeups + 1);
+    EXPECT_TRUE(worker.IsRunning());
+    EXPECT_EQ(worker.TakeError(), std::nullopt);
+    EXPECT_EQ(received, imterm::test::Bytes("last words"));
+}
+
+TEST(ReceiveReactorTest, LeavesAndRejoinsOnStopAndStart)
+{
+    Pipe pipe;
+    auto reactor = std::make_shared<ReceiveReactor>();
+    ReceiveWorker worker(std::make_shared<imterm::FileTransport>(pipe.Reader(), Quick()), 4096);
+    worker.SetReactor(reactor);
+    worker.Start();
+
+    pipe.Write(imterm::test::Bytes("one"));
+    std::vector<uint8_t> received;
+    ASSERT_TRUE(DrainUntil(worker, received, 3));
+
+    worker.Stop();
+    EXPECT_FALSE(worker.IsRunning());
+    EXPECT_FALSE(worker.OnReactor());
+    EXPECT_EQ(reactor->GetStatistics().mPorts, 0u);
+
+    // Written while stopped; the pipe keeps it.
+    pipe.Write(imterm::test::Bytes("two"));
+    std::this_thread::sleep_for(10ms);
+    EXPECT_FALSE(worker.HasPendingBytes());
+
+    worker.Start();
+    EXPECT_TRUE(worker.OnReactor());
+    ASSERT_TRUE(DrainUntil(worker, received, 6));
+    EXPECT_EQ(received, imterm::test::Bytes("onetwo"));
+}
+
+TEST(ReceiveReactorTest, SessionsKeepTheirOwnTerminals)
+{
+    auto reactor = std::make_shared<ReceiveReactor>();
+    struct Port {
+        Pipe pipe;
+        std::shared_ptr<imterm::TerminalData> data = std::make_shared<imterm::TerminalData>();
+        std::shared_ptr<imterm::TerminalState> state;
+        std::unique_ptr<imterm::CaptureSession> session;
+    };
+    std::vector<std::unique_ptr<Port>> ports;
+    for (int i = 0; i < 4; ++i) {
+        auto port = std::make_unique<Port>();
+        port->state = std::make_shared<imterm::TerminalState>(port->data, imterm::TerminalState::NewLineMode::Strict);
+        port->state->SetViewportSize(24, 80);
+        port->session = std::make_unique<imterm::CaptureSession>(
+            std::make_shared<imterm::FileTransport>(port->pipe.Reader(), Quick()), port->state);
+        port->session->SetReactor(reactor);
+        port->session->Start();
+        ports.push_back(std::move(port));
+    }
+
+    for (int line = 0; line < 3; ++line) {
+        for (size_t i = 0; i < ports.size(); ++i) {
+            ports[i]->pipe.Write(imterm::test::Bytes("uart" + std::to_string(i) + " line " + std::to_string(line) + "\r\n"));
+        }
+    }
+    for (size_t i = 0; i < ports.size(); ++i) {
+        Port& port = *ports[i];
+        ASSERT_TRUE(WaitFor([&] {
+            port.session->Pump();
+            return port.data->GetLineCount() == 3;
+        }));
+        EXPECT_EQ(imterm::test::LineText(port.data->GetLine(0)), "uart" + std::to_string(i) + " line 0");
+        EXPECT_EQ(imterm::test::LineText(port.data->GetLine(2)), "uart" + std::to_string(i) + " line 2");
+        port.session->Stop();
+    }
+}
+
+#endif
+
+} // namespace
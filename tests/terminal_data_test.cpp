@@ -1,10 +1,19 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 #include "terminal_data.h"
+#include "terminal_state.h"
 #include "test_support.h"
 
 namespace {
@@ -15,7 +24,6 @@ TEST(TerminalDataTest, StartsWithOneEmptyLine)
 
     ASSERT_EQ(data.GetLineCount(), 1U);
     EXPECT_TRUE(data.GetLine(0).empty());
-    EXPECT_FALSE(data.IsTextChanged());
 }
 
 TEST(TerminalDataTest, GetTextTerminatesEveryStoredLine)
@@ -29,7 +37,6 @@ TEST(TerminalDataTest, GetTextTerminatesEveryStoredLine)
     // Characterization: GetText appends a newline for every stored line,
     // including the empty line created by the trailing input newline.
     EXPECT_EQ(data.GetText(), "first\nsecond\n\n");
-    EXPECT_TRUE(data.IsTextChanged());
 }
 
 TEST(TerminalDataTest, InsertsTextAndSplitsLines)
@@ -106,4 +113,403 @@ TEST(TerminalDataTest, TimestampTracksTheMostRecentContentMutation)
     EXPECT_GT(data.GetLine(0).GetTimestamp(), inputTimestamp);
 }
 
+std::vector<imterm::PaletteIndex> LineColors(const imterm::Line& line)
+{
+    std::vector<imterm::PaletteIndex> colors;
+    for (const imterm::Glyph& glyph : line) {
+        colors.push_back(glyph.mColorIndex);
+    }
+    return colors;
+}
+
+void InputText(imterm::TerminalData& data, size_t line, int& column,
+    imterm::PaletteIndex color, std::string_view text)
+{
+    for (const char character : text) {
+        data.InputGlyph(line, column, color, static_cast<uint8_t>(character));
+    }
+}
+
+TEST(TerminalDataTest, StoresOneAttributeRunPerColorChange)
+{
+    using imterm::PaletteIndex;
+    imterm::TerminalData data;
+    int column = 0;
+
+    InputText(data, 0, column, PaletteIndex::Green, "ok");
+    InputText(data, 0, column, PaletteIndex::Green, "!");
+    InputText(data, 0, column, PaletteIndex::Red, "x");
+
+    const imterm::Line& line = data.GetLine(0);
+    ASSERT_EQ(line.GetAttributeRuns().size(), 2U);
+    EXPECT_EQ(line.GetAttributeRuns()[1].mStart, 3U);
+    EXPECT_EQ(LineColors(line),
+        std::vector<PaletteIndex>({PaletteIndex::Green, PaletteIndex::Green,
+            PaletteIndex::Green, PaletteIndex::Red}));
+    EXPECT_EQ(line.at(3).mChar, 'x');
+    EXPECT_EQ(line.back().mColorIndex, PaletteIndex::Red);
+}
+
+TEST(TerminalDataTest, OverwritingAndErasingKeepNeighbouringColors)
+{
+    using imterm::PaletteIndex;
+    imterm::TerminalData data;
+    int column = 0;
+    InputText(data, 0, column, PaletteIndex::Blue, "abc");
+
+    column = 1;
+    data.InputGlyph(0, column, PaletteIndex::Yellow, 'B');
+    EXPECT_EQ(LineColors(data.GetLine(0)),
+        std::vector<PaletteIndex>({PaletteIndex::Blue, PaletteIndex::Yellow,
+            PaletteIndex::Blue}));
+    EXPECT_EQ(data.GetLine(0).GetAttributeRuns().size(), 3U);
+
+    data.EraseBytes(0, 1, 2);
+    EXPECT_EQ(imterm::test::LineText(data.GetLine(0)), "ac");
+    // Removing the only yellow byte merges the blue runs back together.
+    EXPECT_EQ(data.GetLine(0).GetAttributeRuns().size(), 1U);
+}
+
+TEST(TerminalDataTest, JoiningLinesKeepsTheColorsOfBothSides)
+{
+    using imterm::PaletteIndex;
+    imterm::TerminalData data;
+    data.EnsureLineExists(1);
+    int column = 0;
+    InputText(data, 0, column, PaletteIndex::Red, "r");
+    column = 0;
+    InputText(data, 1, column, PaletteIndex::Cyan, "c");
+    InputText(data, 1, column, PaletteIndex::Red, "R");
+
+    data.DeleteRange(Coordinates(0, 1), Coordinates(1, 0));
+
+    ASSERT_EQ(data.GetLineCount(), 1U);
+    EXPECT_EQ(imterm::test::LineText(data.GetLine(0)), "rcR");
+    EXPECT_EQ(LineColors(data.GetLine(0)),
+        std::vector<PaletteIndex>({PaletteIndex::Red, PaletteIndex::Cyan,
+            PaletteIndex::Red}));
+}
+
+TEST(TerminalDataTest, PackedLinesUseLessThanTwoBytesPerCharacter)
+{
+    imterm::TerminalData data;
+    const std::string text(200, 'x');
+
+    for (size_t line = 0; line < 200; ++line) {
+        int column = 0;
+        InputText(data, line, column, imterm::PaletteIndex::Default, text);
+        data.EnsureLineExists(line + 1);
+    }
+
+    const size_t received = 200 * text.size();
+    // One byte per character plus fixed per-line overhead; a Glyph cell was
+    // 12 bytes per character before packing.
+    EXPECT_LT(data.GetApproximateMemoryUsage(), received * 2);
+}
+
+// Column mapping of one line recomputed from the first byte, for comparison
+// with the lookups TerminalData answers from its cached line index.
+struct ReferenceColumns {
+    std::vector<size_t> mBytes;
+    std::vector<int> mColumns;
+
+    ReferenceColumns(const imterm::Line& line, int tabSize)
+    {
+        const auto bytes = line.GetBytes();
+        int column = 0;
+        for (size_t index = 0; index < bytes.size();) {
+            mBytes.push_back(index);
+            mColumns.push_back(column);
+            column = imterm::NextColumn(bytes[index], column, tabSize);
+            index += static_cast<size_t>(imterm::TerminalData::UTF8CharLength(
+                bytes[index], bytes.size() - index));
+        }
+        mBytes.push_back(bytes.size());
+        mColumns.push_back(column);
+    }
+
+    size_t Characters() const { return mBytes.size() - 1; }
+};
+
+void ExpectColumnLookupsMatch(const imterm::TerminalData& data, size_t lineIndex)
+{
+    const ReferenceColumns reference(data.GetLine(lineIndex), data.GetTabSize());
+    const int line = static_cast<int>(lineIndex);
+    const size_t characters = reference.Characters();
+    const int width = reference.mColumns.back();
+
+    ASSERT_EQ(data.GetLineMaxColumn(line), width);
+    ASSERT_EQ(data.GetLineCharacterCount(line), static_cast<int>(characters));
+
+    size_t covering = 0;
+    size_t starting = 0;
+    for (int column = 0; column <= width + 2; ++column) {
+        while (covering < characters && reference.mColumns[covering + 1] <= column) {
+            ++covering;
+        }
+        while (starting < characters && reference.mColumns[starting] < column) {
+            ++starting;
+        }
+        const imterm::BufferPosition position{lineIndex, imterm::RenderedColumn{column}};
+        ASSERT_EQ(data.GetByteOffset(position).mValue, reference.mBytes[covering])
+            << "column " << column;
+        ASSERT_EQ(data.GetByteOffsetAfter(position).mValue,
+            reference.mBytes[std::min(covering + 1, characters)]) << "column " << column;
+        ASSERT_EQ(data.GetCharacterIndex(Coordinates(line, column)),
+            static_cast<int>(reference.mBytes[starting])) << "column " << column;
+    }
+
+    size_t character = 0;
+    for (size_t byte = 0; byte <= reference.mBytes.back(); ++byte) {
+        while (character < characters && reference.mBytes[character] < byte) {
+            ++character;
+        }
+        ASSERT_EQ(data.GetCharacterColumn(line, static_cast<int>(byte)),
+            reference.mColumns[character]) << "byte " << byte;
+    }
+}
+
+TEST(TerminalDataTest, ColumnLookupsOnLongMixedLinesMatchAFullScan)
+{
+    imterm::TerminalData data;
+    std::string text;
+    for (int group = 0; group < 400; ++group) {
+        text += "ab\tc\xC3\xA9" "d\xE2\x82\xAC" "ef";
+    }
+    data.SetTextLines({text});
+    ExpectColumnLookupsMatch(data, 0);
+
+    int column = 1000;
+    data.InputBytes(0, column, imterm::PaletteIndex::Red, imterm::test::Bytes("\xE2\x82\xAC"));
+    ExpectColumnLookupsMatch(data, 0);
+
+    data.EraseBytes(0, 20, 2000);
+    ExpectColumnLookupsMatch(data, 0);
+
+    data.ReplaceBytesWithSpaces(0, 5, 9);
+    ExpectColumnLookupsMatch(data, 0);
+
+    data.SetTabSize(8);
+    ExpectColumnLookupsMatch(data, 0);
+
+    column = data.GetLineMaxColumn(0) + 300;
+    data.InputCharacters(0, column, imterm::PaletteIndex::Default,
+        imterm::test::Bytes("x\xC3\xA9y"));
+    ExpectColumnLookupsMatch(data, 0);
+
+    Coordinates where(0, 700);
+    data.InsertTextAt(where, "\t\xC3\xA9\tz");
+    ExpectColumnLookupsMatch(data, 0);
+}
+
+TEST(TerminalDataTest, CopiedLinesRebuildTheirColumnIndex)
+{
+    imterm::TerminalData data;
+    std::string text;
+    for (int group = 0; group < 200; ++group) {
+        text += "\xC3\xA9\t";
+    }
+    data.SetTextLines({text});
+    const int width = data.GetLineMaxColumn(0);
+
+    const imterm::Line copy = data.GetLine(0);
+    EXPECT_EQ(copy.EndStop(data.GetTabSize()).mColumn, width);
+    EXPECT_EQ(copy.StopAtColumn(width, data.GetTabSize()).mCharacter, 399U);
+}
+
+TEST(TerminalDataTest, ChangeTrackerReportsTheChangedRange)
+{
+    using Changed = imterm::TerminalData::ChangedSerials;
+    imterm::TerminalData data;
+    data.SetTextLines({"a", "b", "c", "d", "e"});
+    const uint64_t first = data.GetFirstLineSerial();
+    const auto tracker = data.AddChangeTracker();
+
+    int column = 1;
+    data.InputBytes(3, column, imterm::PaletteIndex::Default, imterm::test::Bytes("x"));
+    column = 1;
+    data.InputBytes(1, column, imterm::PaletteIndex::Default, imterm::test::Bytes("y"));
+    EXPECT_EQ(data.TakeChangedSerials(tracker), (Changed{ first + 1, first + 4 }));
+    EXPECT_EQ(data.TakeChangedSerials(tracker), std::nullopt);
+
+    // Lines after an insertion move, so the range runs to the end.
+    data.InsertLine(2);
+    EXPECT_EQ(data.TakeChangedSerials(tracker), (Changed{ first + 2, UINT64_MAX }));
+
+    // Each write gives the line a new generation.
+    const uint64_t generation = data.GetLine(0).GetGeneration();
+    column = 1;
+    data.InputBytes(0, column, imterm::PaletteIndex::Default, imterm::test::Bytes("z"));
+    EXPECT_GT(data.GetLine(0).GetGeneration(), generation);
+    EXPECT_EQ(data.GetLine(0).GetGeneration(), data.GetGeneration());
+    EXPECT_EQ(data.GetLine(2).GetGeneration(), 0U);
+}
+
+TEST(TerminalDataTest, TrimmingTheTopKeepsLineSerials)
+{
+    imterm::TerminalData data;
+    data.SetTextLines({"a", "b", "c", "d"});
+    const uint64_t first = data.GetFirstLineSerial();
+    const auto tracker = data.AddChangeTracker();
+
+    data.RemoveLine(0, 2);
+    EXPECT_EQ(data.GetFirstLineSerial(), first + 2);
+    EXPECT_EQ(data.TakeLowestChangedSerial(tracker), std::nullopt);
+
+    int column = 0;
+    data.InputBytes(1, column, imterm::PaletteIndex::Default, imterm::test::Bytes("x"));
+    data.InsertLine(2);
+    EXPECT_EQ(data.TakeLowestChangedSerial(tracker), first + 3);
+    EXPECT_EQ(data.TakeLowestChangedSerial(tracker), std::nullopt);
+
+    data.RemoveLine(1);
+    EXPECT_EQ(data.TakeLowestChangedSerial(tracker), first + 3);
+
+    // Replacing the text gives every new line a serial never used before.
+    data.SetText("new");
+    EXPECT_EQ(data.GetFirstLineSerial(), first + 4);
+    EXPECT_EQ(data.TakeLowestChangedSerial(tracker), first + 4);
+
+    data.RemoveChangeTracker(tracker);
+    EXPECT_THROW(data.TakeLowestChangedSerial(tracker), std::out_of_range);
+    EXPECT_EQ(data.AddChangeTracker(), tracker);
+}
+
+TEST(TerminalDataTest, WidestLineColumnFollowsWritesWithoutScanning)
+{
+    imterm::TerminalData data;
+    data.SetTextLines({"abc", "abcdefgh", ""});
+    EXPECT_EQ(data.GetWidestLineColumn(), 8);
+
+    int column = 0;
+    data.InputCharacters(2, column, imterm::PaletteIndex::Default, imterm::test::Bytes("0123456789"));
+    EXPECT_EQ(data.GetWidestLineColumn(), 10);
+
+    // A tab may count for a whole tab stop, so the width is an upper bound.
+    column = 0;
+    data.InputBytes(0, column, imterm::PaletteIndex::Default, imterm::test::Bytes("\t"));
+    EXPECT_GE(data.GetWidestLineColumn(), data.GetLineMaxColumn(0));
+
+    // Removing the widest line leaves the width; replacing the text resets it.
+    data.RemoveLine(2);
+    EXPECT_EQ(data.GetWidestLineColumn(), 10);
+    data.SetText("ab\nc");
+    EXPECT_EQ(data.GetWidestLineColumn(), 2);
+}
+
+TEST(TerminalDataTest, SnapshotKeepsTheTextItWasTakenWith)
+{
+    imterm::TerminalData data;
+    EXPECT_EQ(data.GetPublishedSnapshot(), nullptr);
+    data.SetText("first\nsecond\nthird");
+
+    data.PublishSnapshot();
+    const auto snapshot = data.GetPublishedSnapshot();
+    ASSERT_NE(snapshot, nullptr);
+    EXPECT_EQ(snapshot->GetText(), data.GetText());
+    EXPECT_EQ(snapshot->GetTextLines(), data.GetTextLines());
+    EXPECT_EQ(snapshot->GetFirstLineSerial(), data.GetFirstLineSerial());
+    EXPECT_EQ(snapshot->GetGeneration(), data.GetGeneration());
+
+    int column = 0;
+    data.InputBytes(1, column, imterm::PaletteIndex::Default, imterm::test::Bytes("new "));
+    data.RemoveLine(0);
+    EXPECT_EQ(snapshot->GetTextLines(), std::vector<std::string>({ "first", "second", "third" }));
+    EXPECT_EQ(data.GetLineCount(), 2U);
+    EXPECT_EQ(data.GetPublishedSnapshot(), snapshot);
+}
+
+// Line n reads "L", n as seven digits, a space and sixty copies of a letter
+// picked by n; a later rewrite replaces it with "U" and the upper case
+// letter. A torn line mixes the two or belongs to another index.
+std::string StressLine(size_t number, bool rewritten)
+{
+    char digits[8];
+    std::snprintf(digits, sizeof(digits), "%07zu", number % 10000000);
+    const char letter = static_cast<char>((rewritten ? 'A' : 'a') + number % 26);
+    return (rewritten ? "U" : "L") + std::string(digits) + " " + std::string(60, letter);
+}
+
+TEST(TerminalDataTest, ConcurrentReadersOfPublishedSnapshotsSeeWholeLines)
+{
+    constexpr size_t Lines = 30000;
+    constexpr size_t PublishEvery = 64;
+    constexpr int Readers = 4;
+
+    imterm::test::TemporaryDirectory directory;
+    auto data = std::make_shared<imterm::TerminalData>();
+    imterm::LineStore::SpillOptions spill;
+    spill.Path = directory.Path() / "scrollback.spill";
+    spill.HotLines = imterm::LineStore::BlockCapacity;
+    data->EnableSpill(spill);
+    imterm::TerminalState state(data, imterm::TerminalState::NewLineMode::Strict);
+    state.SetViewportSize(24, 80);
+
+    std::atomic<bool> done{ false };
+    std::atomic<size_t> checked{ 0 };
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < Readers; ++reader) {
+        readers.emplace_back([&] {
+            uint64_t lastGeneration = 0;
+            size_t lastCount = 0;
+            while (!done.load()) {
+                const auto snapshot = data->GetPublishedSnapshot();
+                if (!snapshot) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                EXPECT_GE(snapshot->GetGeneration(), lastGeneration);
+                EXPECT_GE(snapshot->GetLineCount(), lastCount);
+                lastGeneration = snapshot->GetGeneration();
+                lastCount = snapshot->GetLineCount();
+
+                // Snapshots are published between steps, so every line is
+                // whole. The last is the empty one after the cursor, except
+                // before the screen fills, when no line is made for it yet.
+                const size_t count = snapshot->GetLineCount();
+                snapshot->GetLines().ForEach(0, count, [&](size_t index, const imterm::Line& line) {
+                    const auto bytes = line.GetBytes();
+                    const std::string text(bytes.begin(), bytes.end());
+                    const uint64_t serial = snapshot->GetFirstLineSerial() + index;
+                    if (index + 1 == count && text.empty()) {
+                        return;
+                    }
+                    if (text != StressLine(serial, false) && text != StressLine(serial, true)) {
+                        ADD_FAILURE() << "line " << serial << " reads \"" << text << "\"";
+                    }
+                });
+                checked.fetch_add(count);
+            }
+        });
+    }
+
+    // One writer at full speed, in chunks that split lines and escape
+    // sequences, rewriting an earlier line every few steps so sealed blocks
+    // near the screen are written too.
+    std::mt19937 random(11);
+    for (size_t number = 0; number < Lines; ++number) {
+        std::string step = StressLine(number, false) + "\r\n";
+        if (number >= 30 && number % 5 == 0) {
+            step += "\x1b[3A\r" + StressLine(number - 2, true) + "\x1b[3B\r";
+        }
+        const auto bytes = imterm::test::Bytes(step);
+        const size_t split = random() % bytes.size();
+        state.Input(std::span(bytes).first(split));
+        state.Input(std::span(bytes).subspan(split));
+        if (number % PublishEvery == 0) {
+            data->PublishSnapshot();
+        }
+    }
+    data->PublishSnapshot();
+    done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_GT(data->GetLines().SpilledBlockCount(), 0U);
+    EXPECT_GT(checked.load(), 0U);
+    ASSERT_EQ(data->GetLineCount(), Lines + 1);
+    EXPECT_EQ(data->GetPublishedSnapshot()->GetText(), data->GetText());
+}
+
 } // namespace
@@ -1,8 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <string>
+#include <thread>
 
 #include "terminal_logger.h"
 #include "terminal_state.h"
@@ -10,6 +13,36 @@
 
 namespace {
 
+imterm::TerminalLogger::Options AsynchronousOptions()
+{
+    imterm::TerminalLogger::Options options;
+    options.Enabled = true;
+    options.LineNumbers = true;
+    options.TimeStamps = false;
+    options.Asynchronous = true;
+    return options;
+}
+
+// Logs lineCount numbered copies of "line" and returns the file contents
+// after Close().
+std::string LogNumberedLines(const std::filesystem::path& directory,
+    const imterm::TerminalLogger::Options& options, int lineCount)
+{
+    imterm::TerminalLogger logger(false, "numbered", ".log", directory, options);
+    const imterm::Line line{
+        imterm::Glyph('l', imterm::PaletteIndex::Default),
+        imterm::Glyph('i', imterm::PaletteIndex::Default),
+        imterm::Glyph('n', imterm::PaletteIndex::Default),
+        imterm::Glyph('e', imterm::PaletteIndex::Default)};
+    for (int number = 1; number <= lineCount; ++number) {
+        logger.Log(line, number);
+    }
+    logger.Close();
+    const std::string contents = imterm::test::ReadFile(directory / "numbered.log");
+    std::filesystem::remove(directory / "numbered.log");
+    return contents;
+}
+
 TEST(TerminalLoggerTest, WritesConfiguredLineFormat)
 {
     imterm::test::TemporaryDirectory directory;
@@ -215,4 +248,72 @@ TEST(TerminalLoggerTest, MultipleLoggerInstancesRemainIndependent)
     EXPECT_EQ(imterm::test::ReadFile(directory.Path() / "second.log"), "B\n");
 }
 
+TEST(TerminalLoggerTest, AsynchronousModeWritesTheSameLines)
+{
+    imterm::test::TemporaryDirectory directory;
+    imterm::TerminalLogger::Options synchronous = AsynchronousOptions();
+    synchronous.Asynchronous = false;
+    imterm::TerminalLogger::Options syncing = AsynchronousOptions();
+    syncing.DurabilityPolicy = imterm::TerminalLogger::Durability::SyncInterval;
+    syncing.SyncInterval = std::chrono::milliseconds(1);
+
+    const std::string expected = LogNumberedLines(directory.Path(), synchronous, 5000);
+
+    EXPECT_EQ(LogNumberedLines(directory.Path(), AsynchronousOptions(), 5000), expected);
+    EXPECT_EQ(LogNumberedLines(directory.Path(), syncing, 5000), expected);
+}
+
+TEST(TerminalLoggerTest, AFullQueueDelaysLinesInsteadOfDroppingThem)
+{
+    imterm::test::TemporaryDirectory directory;
+    imterm::TerminalLogger::Options options = AsynchronousOptions();
+    options.QueueCapacity = 8;
+    options.GroupCommitBytes = 4;
+
+    const std::string contents = LogNumberedLines(directory.Path(), options, 2000);
+
+    EXPECT_EQ(contents.find("1 line\n"), 0U);
+    EXPECT_NE(contents.find("\n2000 line\n"), std::string::npos);
+    EXPECT_EQ(contents.size(), LogNumberedLines(directory.Path(), AsynchronousOptions(), 2000).size());
+}
+
+TEST(TerminalLoggerTest, QueuedLinesAreCommittedAfterTheGroupInterval)
+{
+    imterm::test::TemporaryDirectory directory;
+    imterm::TerminalLogger::Options options = AsynchronousOptions();
+    options.GroupCommitInterval = std::chrono::milliseconds(5);
+    imterm::TerminalLogger logger(false, "interval", ".log", directory.Path(), options);
+    const imterm::Line line{ imterm::Glyph('x', imterm::PaletteIndex::Default) };
+
+    logger.Log(line, 1);
+
+    std::string contents;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (contents.empty() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        contents = imterm::test::ReadFile(directory.Path() / "interval.log");
+    }
+    EXPECT_EQ(contents, "1 x\n");
+}
+
+TEST(TerminalLoggerTest, AsynchronousCloseWritesThePendingTerminalLine)
+{
+    imterm::test::TemporaryDirectory directory;
+    imterm::TerminalLogger::Options options = AsynchronousOptions();
+    options.LineNumbers = false;
+    options.GroupCommitInterval = std::chrono::hours(1);
+    auto logger = std::make_shared<imterm::TerminalLogger>(
+        false, "async", ".log", directory.Path(), options);
+    auto data = std::make_shared<imterm::TerminalData>(logger);
+    imterm::TerminalState state(
+        data, imterm::TerminalState::NewLineMode::AddCrToLf);
+    state.SetViewportSize(1, 80);
+
+    state.Input(imterm::test::Bytes("first\nsecond"));
+    logger->Close();
+
+    EXPECT_EQ(imterm::test::ReadFile(directory.Path() / "async.log"),
+        "first\nsecond\n");
+}
+
 } // namespace
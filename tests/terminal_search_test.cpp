@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "terminal_data.h"
+#include "terminal_search.h"
+#include "test_support.h"
+
+namespace {
+
+using imterm::TerminalSearch;
+using imterm::test::LineText;
+
+constexpr size_t Chunk = TerminalSearch::ChunkLines;
+
+std::vector<TerminalSearch::Match> Search(TerminalSearch& search, const TerminalSearch::Query& query)
+{
+    while (!search.Update()) {
+    }
+    search.Start(query);
+    while (!search.GetProgress().mFinished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::vector<TerminalSearch::Match> matches;
+    search.GetMatches(0, UINT64_MAX, matches);
+    return matches;
+}
+
+// What a search of the current buffer must find, worked out line by line
+// with std::regex.
+std::vector<TerminalSearch::Match> Expected(const imterm::TerminalData& data, const TerminalSearch::Query& query)
+{
+    auto flags = std::regex::ECMAScript;
+    if (!query.mCaseSensitive) {
+        flags |= std::regex::icase;
+    }
+    const std::regex pattern(query.mRegex ? query.mText : std::regex_replace(query.mText, std::regex(R"([\^$\\.*+?()[\]{}|])"), R"(\$&)"), flags);
+
+    std::vector<TerminalSearch::Match> matches;
+    for (size_t index = 0; index < data.GetLineCount(); ++index) {
+        const std::string line = LineText(data.GetLine(index));
+        for (std::sregex_iterator match(line.begin(), line.end(), pattern), last; match != last; ++match) {
+            if (match->length() > 0) {
+                matches.push_back({ data.GetFirstLineSerial() + index,
+                    static_cast<uint32_t>(match->position()), static_cast<uint32_t>(match->length()) });
+            }
+        }
+    }
+    return matches;
+}
+
+std::vector<std::string> LogLines(size_t count)
+{
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < count; ++i) {
+        std::string line = "[" + std::to_string(i) + "] sensor ok";
+        if (i % 997 == 0) {
+            line += " ERROR code " + std::to_string(i % 13);
+        }
+        if (i % 1500 == 7) {
+            line += " Colour error Color";
+        }
+        if (i % 1500 == 700) {
+            line += " Color";
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+TEST(TerminalSearchTest, FindsEveryOccurrenceAcrossChunks)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    data->SetTextLines(LogLines(Chunk * 3 + 10));
+    TerminalSearch search(data);
+
+    const TerminalSearch::Query query{ "error" };
+    const auto matches = Search(search, query);
+
+    EXPECT_EQ(matches, Expected(*data, query));
+    EXPECT_EQ(matches.size(), 7U);
+    const TerminalSearch::Progress progress = search.GetProgress();
+    EXPECT_EQ(progress.mLinesSearched, data->GetLineCount());
+    EXPECT_EQ(progress.mMatches, matches.size());
+
+    const TerminalSearch::Query exact{ "ERROR", false, true };
+    EXPECT_EQ(Search(search, exact), Expected(*data, exact));
+    EXPECT_EQ(Search(search, exact).size(), 4U);
+}
+
+TEST(TerminalSearchTest, RegexResultsMatchALineByLineScan)
+{
+    // Patterns whose literal parts are optional or alternatives must not let
+    // the index skip chunks holding matches.
+    auto data = std::make_shared<imterm::TerminalData>();
+    data->SetTextLines(LogLines(Chunk * 4));
+    TerminalSearch search(data);
+
+    for (const char* pattern : { "colou?r", "Col(ou)?r", "ERROR code \\d+", "sensor|Colour",
+             "e{2}|rr", "\\[9\\d\\d\\]", "[CE]rror", "ok$", "^\\[1", "code [3-5]", "x*" }) {
+        for (bool caseSensitive : { false, true }) {
+            const TerminalSearch::Query query{ pattern, true, caseSensitive };
+            EXPECT_EQ(Search(search, query), Expected(*data, query)) << pattern << " case " << caseSensitive;
+        }
+    }
+    EXPECT_THROW(search.Start({ "(unclosed", true }), std::regex_error);
+}
+
+TEST(TerminalSearchTest, IndexFollowsEditsInsertionsAndTrimming)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    data->SetTextLines(LogLines(Chunk * 3));
+    TerminalSearch search(data);
+    const TerminalSearch::Query query{ "needle" };
+    EXPECT_TRUE(Search(search, query).empty());
+
+    // Edit a line inside a sealed chunk, insert another and trim the top.
+    int column = 3;
+    data->InputBytes(Chunk + 5, column, imterm::PaletteIndex::Default, imterm::test::Bytes("N"));
+    data->InputCharacters(Chunk + 5, column, imterm::PaletteIndex::Default, imterm::test::Bytes("eedle"));
+    data->InsertLine(static_cast<int>(Chunk * 2));
+    column = 0;
+    data->InputCharacters(Chunk * 2, column, imterm::PaletteIndex::Default, imterm::test::Bytes("needle needle"));
+    data->RemoveLine(0, static_cast<int>(Chunk / 2));
+    data->EnsureLineExists(data->GetLineCount() + 10);
+    column = 0;
+    data->InputCharacters(data->GetLineCount() - 1, column, imterm::PaletteIndex::Default, imterm::test::Bytes("last needle"));
+
+    const auto matches = Search(search, query);
+    EXPECT_EQ(matches, Expected(*data, query));
+    EXPECT_EQ(matches.size(), 4U);
+
+    data->RemoveLine(0, static_cast<int>(Chunk * 2));
+    const auto afterTrim = Search(search, query);
+    EXPECT_EQ(afterTrim, Expected(*data, query));
+    EXPECT_EQ(afterTrim.size(), 1U);
+
+    data->SetText("one needle\ntwo");
+    EXPECT_EQ(Search(search, query), Expected(*data, query));
+
+    // Cutting the buffer back to the middle of a sealed chunk reopens it.
+    data->SetTextLines(LogLines(Chunk * 2));
+    EXPECT_TRUE(Search(search, query).empty());
+    data->RemoveLine(static_cast<int>(Chunk + 10), static_cast<int>(Chunk * 2));
+    column = 0;
+    data->InputCharacters(Chunk + 9, column, imterm::PaletteIndex::Default, imterm::test::Bytes("needle"));
+    EXPECT_EQ(Search(search, query), Expected(*data, query));
+    EXPECT_EQ(Search(search, query).size(), 1U);
+}
+
+TEST(TerminalSearchTest, ResultsDescribeTheBufferWhenTheSearchStarted)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    data->SetTextLines(LogLines(Chunk * 8));
+    TerminalSearch search(data);
+    while (!search.Update()) {
+    }
+    const TerminalSearch::Query query{ "sensor ok" };
+    const auto expected = Expected(*data, query);
+
+    search.Start(query);
+    data->SetText("sensor ok\nmore");
+    search.Update();
+    data->RemoveLine(0);
+    while (!search.GetProgress().mFinished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::vector<TerminalSearch::Match> matches;
+    search.GetMatches(0, UINT64_MAX, matches);
+    EXPECT_EQ(matches, expected);
+}
+
+TEST(TerminalSearchTest, SearchesLinesTheIndexHasNotReached)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    data->SetTextLines(LogLines(Chunk * 4));
+    TerminalSearch search(data);
+    search.Update(Chunk * 2);
+
+    // An edit in a summarized chunk, not yet seen by Update(), must not
+    // let the old summary skip the chunk.
+    int column = 0;
+    data->InputCharacters(Chunk / 2, column, imterm::PaletteIndex::Default, imterm::test::Bytes("needle"));
+    column = 0;
+    data->InputCharacters(Chunk * 3, column, imterm::PaletteIndex::Default, imterm::test::Bytes("needle"));
+
+    const TerminalSearch::Query query{ "needle" };
+    search.Start(query);
+    while (!search.GetProgress().mFinished) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::vector<TerminalSearch::Match> matches;
+    search.GetMatches(0, UINT64_MAX, matches);
+    EXPECT_EQ(matches, Expected(*data, query));
+    EXPECT_EQ(matches.size(), 2U);
+    EXPECT_EQ(search.GetProgress().mLinesSearched, data->GetLineCount());
+}
+
+TEST(TerminalSearchTest, NavigationWrapsAroundTheResults)
+{
+    auto data = std::make_shared<imterm::TerminalData>();
+    data->SetTextLines({ "ab ab", "x", "ab" });
+    TerminalSearch search(data);
+    const uint64_t first = data->GetFirstLineSerial();
+
+    ASSERT_EQ(Search(search, { "ab" }).size(), 3U);
+
+    const auto next = [&](uint64_t line, uint32_t byte, bool forward) {
+        const auto match = search.FindNext(first + line, byte, forward);
+        return match ? std::pair(match->mLineSerial - first, match->mStart) : std::pair(UINT64_MAX, 0U);
+    };
+    EXPECT_EQ(next(0, 0, true), std::pair(uint64_t{ 0 }, 3U));
+    EXPECT_EQ(next(0, 3, true), std::pair(uint64_t{ 2 }, 0U));
+    EXPECT_EQ(next(1, 0, true), std::pair(uint64_t{ 2 }, 0U));
+    EXPECT_EQ(next(2, 0, true), std::pair(uint64_t{ 0 }, 0U));
+    EXPECT_EQ(next(2, 0, false), std::pair(uint64_t{ 0 }, 3U));
+    EXPECT_EQ(next(0, 0, false), std::pair(uint64_t{ 2 }, 0U));
+
+    std::vector<TerminalSearch::Match> visible;
+    search.GetMatches(first + 1, first + 3, visible);
+    ASSERT_EQ(visible.size(), 1U);
+    EXPECT_EQ(visible[0].mLineSerial, first + 2);
+
+    search.Cancel();
+    EXPECT_FALSE(search.FindNext(first, 0, true));
+    EXPECT_TRUE(Search(search, { "" }).empty());
+}
+
+} // namespace
@@ -1,11 +1,21 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <memory>
 #include <random>
 #include <span>
 #include <string>
+#include <tuple>
 #include <vector>
 
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "allocation_counter.h"
 #include "terminal_state.h"
 #include "test_support.h"
 
@@ -84,6 +94,25 @@ TEST_F(TerminalStateTest, QueuesDeviceStatusResponse)
     EXPECT_FALSE(state->TerminalOutputAvailable());
 }
 
+TEST_F(TerminalStateTest, QueuesRepliesBackToBackWithoutAllocatingOnceWarm)
+{
+    state->Input(imterm::test::Bytes("\x1B[5n\x1B[2;34H\x1B[6n"));
+    EXPECT_EQ(state->GetTerminalOutput(), imterm::test::Bytes("\x1B[0n\x1B[2;34R"));
+
+    const auto queries = imterm::test::Bytes("\x1B[6n\x1B[5n\x1B[6n");
+    state->Input(queries);
+    state->ClearTerminalOutput();
+
+    imterm::test::AllocationScope scope;
+    for (int i = 0; i < 1000; ++i) {
+        state->Input(queries);
+        ASSERT_EQ(state->PeekTerminalOutput().size(), 18U);
+        state->ClearTerminalOutput();
+    }
+    EXPECT_EQ(scope.Elapsed().mAllocations, 0U);
+    EXPECT_FALSE(state->TerminalOutputAvailable());
+}
+
 TEST_F(TerminalStateTest, MovesCursorAndPadsBeforeWriting)
 {
     state->Input(imterm::test::Bytes("\x1B[3CX"));
@@ -281,6 +310,41 @@ TEST_F(TerminalStateTest, BuffersEveryTruncatedUtf8Prefix)
     }
 }
 
+TEST_F(TerminalStateTest, TruncatedUtf8FollowedByOtherBytesMatchesWholeInput)
+{
+    // Cut-off characters followed by ASCII, a control byte and a new lead
+    // byte, with splits inside an escape sequence too, so completing the
+    // held-back character from the next input has to stop short or take
+    // bytes that are not continuations.
+    const auto input = imterm::test::Bytes(
+        "a\xE2\x82\xAC" "b\x1B[31mR\xF0\x9F\x98\x80\n\xE2x\xE2\xC2\xA2\xF0\x9F\r\xE2\x82");
+    const auto feed = [this](const std::vector<std::span<const uint8_t>>& parts) {
+        data = std::make_shared<imterm::TerminalData>();
+        state = std::make_unique<imterm::TerminalState>(data, imterm::TerminalState::NewLineMode::Strict);
+        state->SetViewportSize(3, 80);
+        for (const auto part : parts) {
+            state->Input(part);
+        }
+        std::vector<std::string> lines = data->GetTextLines();
+        std::string colors;
+        for (const imterm::Glyph& glyph : data->GetLine(0)) {
+            colors += std::to_string(static_cast<int>(glyph.mColorIndex)) + ' ';
+        }
+        lines.push_back(colors);
+        return lines;
+    };
+
+    const auto whole = feed({ input });
+    for (size_t split = 1; split < input.size(); ++split) {
+        EXPECT_EQ(feed({ std::span(input).first(split), std::span(input).subspan(split) }), whole) << "split=" << split;
+    }
+    std::vector<std::span<const uint8_t>> bytes;
+    for (size_t index = 0; index < input.size(); ++index) {
+        bytes.push_back(std::span(input).subspan(index, 1));
+    }
+    EXPECT_EQ(feed(bytes), whole);
+}
+
 TEST_F(TerminalStateTest, IgnoresUnknownSgrAndCsiCommands)
 {
     EXPECT_NO_THROW(state->Input(imterm::test::Bytes(
@@ -443,6 +507,91 @@ TEST_F(TerminalStateTest, ErasingBeyondAShortLineUsesValidatedIterators)
         "           Z");
 }
 
+TEST_F(TerminalStateTest, PlainTextPastTheLastColumnKeepsOnlyTheFinalCharacter)
+{
+    state->SetViewportSize(3, 10);
+
+    state->Input(imterm::test::Bytes("abcdefghijklmnop"));
+
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "abcdefghip");
+    EXPECT_EQ(state->getPosition(), Coordinates(0, 9));
+}
+
+TEST_F(TerminalStateTest, PlainTextOverwritesOnlyTheCharactersItCovers)
+{
+    state->Input(imterm::test::Bytes("h\xC3\xA9llo world\r\x1B[31mHE\xE2\x82\xAC"));
+
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "HE\xE2\x82\xAClo world");
+    EXPECT_EQ(data->GetLine(0)[0].mColorIndex, imterm::PaletteIndex::Red);
+    EXPECT_EQ(data->GetLine(0)[5].mColorIndex, imterm::PaletteIndex::Default);
+    EXPECT_EQ(state->getPosition(), Coordinates(0, 3));
+}
+
+TEST_F(TerminalStateTest, BulkInputMatchesByteAtATimeInput)
+{
+    const std::string input =
+        "I (120) boot: plain text run\r\n"
+        "\x1B[0;33mW (130) wifi: caf\xC3\xA9 \xE2\x82\xAC\x1B[0m\r\n"
+        "tab\tseparated\tcolumns\r\n"
+        "\x1B[2;4Hover\x1B[5Gwrite\x1B[1;1H\x1B[K\r\n"
+        "a line that is far wider than the narrow viewport used here\r\n"
+        "x\tabc\x1B[1Dyz\x7F\x1B[3Cdone\bB\r\n";
+
+    for (int columns : {80, 12}) {
+        const auto feed = [&](size_t chunkSize) {
+            auto chunkData = std::make_shared<imterm::TerminalData>();
+            imterm::TerminalState chunkState(
+                chunkData, imterm::TerminalState::NewLineMode::Strict);
+            chunkState.SetViewportSize(4, columns);
+            const auto bytes = imterm::test::Bytes(input);
+            for (size_t offset = 0; offset < bytes.size(); offset += chunkSize) {
+                chunkState.Input(std::span<const uint8_t>(bytes).subspan(
+                    offset, std::min(chunkSize, bytes.size() - offset)));
+            }
+            std::vector<std::vector<imterm::PaletteIndex>> colors;
+            for (const imterm::Line& line : chunkData->GetLines()) {
+                auto& lineColors = colors.emplace_back();
+                for (const imterm::Glyph glyph : line) {
+                    lineColors.push_back(glyph.mColorIndex);
+                }
+            }
+            return std::make_tuple(chunkData->GetTextLines(), colors,
+                chunkState.getPosition());
+        };
+
+        EXPECT_EQ(feed(input.size()), feed(1)) << "columns " << columns;
+        EXPECT_EQ(feed(input.size()), feed(7)) << "columns " << columns;
+    }
+}
+
+TEST_F(TerminalStateTest, SgrSequencesDoNotAllocate)
+{
+    // Colored logs carry an SGR sequence on every line; parsing, decoding,
+    // and applying them must not touch the heap.
+    std::string chunk;
+    const char* const sequences[] = {
+        "\x1B[0;31m", "\x1B[0m", "\x1B[m", "\x1B[1;33;44m", "\x1B[39;49m",
+        "\x1B[1;2;3;4;5;7;8;9;22;23;24;25;27;28;29;0m"};
+    for (int repeat = 0; repeat < 100; ++repeat) {
+        for (const char* sequence : sequences) {
+            chunk += sequence;
+        }
+    }
+    const auto bytes = imterm::test::Bytes(chunk);
+    const size_t sequencesPerChunk = 100 * std::size(sequences);
+    state->Input(bytes);
+
+    imterm::test::AllocationScope scope;
+    size_t fed = 0;
+    while (fed < 1'000'000) {
+        state->Input(bytes);
+        fed += sequencesPerChunk;
+    }
+
+    EXPECT_EQ(scope.Elapsed().mAllocations, 0U);
+    EXPECT_EQ(state->GetPaletteIndex(), imterm::PaletteIndex::Default);
+}
+
 TEST_F(TerminalStateTest, DeterministicRandomInputDoesNotCrashOrGrowWithoutBound)
 {
     state->SetViewportSize(5, 80);
@@ -462,4 +611,158 @@ TEST_F(TerminalStateTest, DeterministicRandomInputDoesNotCrashOrGrowWithoutBound
     EXPECT_LE(data->GetLineCount(), newlineCount + 5);
 }
 
+TEST_F(TerminalStateTest, StampsLinesWithTheTimeTheirBytesWereRead)
+{
+    const imterm::TerminalLine::Timestamp boot{ std::chrono::seconds(1000) };
+    const auto at = [&](int milliseconds) { return boot + std::chrono::milliseconds(milliseconds); };
+
+    state->Input(imterm::test::Bytes("rst:0x1 "), at(0));
+    state->Input(imterm::test::Bytes("boot:0x13\r\n"), at(5));
+    state->Input(imterm::test::Bytes("\r\nI (31) cpu"), at(40));
+    state->Input(imterm::test::Bytes("_start"), at(41));
+
+    ASSERT_EQ(data->GetLineCount(), 3U);
+    EXPECT_EQ(data->GetLine(0).GetFirstTimestamp(), at(0));
+    EXPECT_EQ(data->GetLine(0).GetTimestamp(), at(5));
+    // The blank line was never written.
+    EXPECT_EQ(data->GetLine(1).GetFirstTimestamp(), data->GetLine(1).GetTimestamp());
+    EXPECT_EQ(data->GetLine(2).GetFirstTimestamp(), at(40));
+    EXPECT_EQ(data->GetLine(2).GetTimestamp(), at(41));
+
+    // A line that is erased and rewritten starts over.
+    state->Input(imterm::test::Bytes("\r\x1b[2K"), at(50));
+    state->Input(imterm::test::Bytes("I (52) heap"), at(52));
+    EXPECT_EQ(data->GetLine(2).GetFirstTimestamp(), at(52));
+    EXPECT_EQ(data->GetLine(2).GetTimestamp(), at(52));
+
+    // Changes made outside Input() read the clock.
+    EXPECT_FALSE(data->GetReceiveTime());
+    int column = 0;
+    data->InputGlyph(0, column, imterm::PaletteIndex::Default, 'x');
+    EXPECT_GT(data->GetLine(0).GetTimestamp(), at(52));
+}
+
+TEST_F(TerminalStateTest, SpilledLinesKeepTheirReceiveTimes)
+{
+    imterm::test::TemporaryDirectory directory;
+    imterm::LineStore::SpillOptions options;
+    options.Path = directory.Path() / "scrollback.spill";
+    options.HotLines = imterm::LineStore::BlockCapacity;
+    options.CachedBlocks = 1;
+    options.ChunkSize = 1;
+    data->EnableSpill(options);
+
+    const imterm::TerminalLine::Timestamp start{ std::chrono::hours(1) };
+    const size_t lineCount = imterm::LineStore::BlockCapacity * 4;
+    for (size_t line = 0; line < lineCount; ++line) {
+        const auto time = start + std::chrono::microseconds(line * 1000);
+        state->Input(imterm::test::Bytes("line "), time);
+        state->Input(imterm::test::Bytes(std::to_string(line) + "\r\n"), time + std::chrono::microseconds(250));
+    }
+    ASSERT_GT(data->GetLines().SpilledBlockCount(), 0U);
+
+    for (const size_t line : { size_t(0), size_t(1), lineCount / 2 }) {
+        const auto time = start + std::chrono::microseconds(line * 1000);
+        EXPECT_EQ(data->GetLine(line).GetFirstTimestamp(), time);
+        EXPECT_EQ(data->GetLine(line).GetTimestamp(), time + std::chrono::microseconds(250));
+    }
+}
+
+TEST_F(TerminalStateTest, RestoredSnapshotContinuesMidSequence)
+{
+    // Stops inside an SGR sequence and inside a UTF-8 character.
+    const auto head = imterm::test::Bytes("one\r\n\x1b[31mtwo\x1b[1;");
+    const auto middle = imterm::test::Bytes({ '3', 'm', 0xC3 });
+    const auto tail = imterm::test::Bytes({ 0xA9, 'x', '\r', '\n', 't', 'h', 'r', 'e', 'e' });
+
+    state->Input(head);
+    state->Input(middle);
+    const auto snapshot = state->TakeSnapshot();
+    std::vector<imterm::Line> screen;
+    for (size_t line = 0; line < data->GetLineCount(); ++line) {
+        screen.push_back(data->GetLine(line));
+    }
+    state->Input(tail);
+    const auto expected = data->GetText();
+
+    state->Input(imterm::test::Bytes("\x1b[0mmore\r\n\x1b[2;5H"));
+    data->SetLines(screen);
+    state->RestoreSnapshot(snapshot);
+    state->Input(tail);
+
+    EXPECT_EQ(data->GetText(), expected);
+    EXPECT_TRUE(state->IsBold());
+    EXPECT_TRUE(state->IsItalic());
+}
+
+TEST_F(TerminalStateTest, DisabledBellIsIgnored)
+{
+    state->SetBellEnabled(false);
+    EXPECT_FALSE(state->IsBellEnabled());
+
+    state->Input(imterm::test::Bytes("a\ab"));
+
+    ASSERT_EQ(data->GetLineCount(), 1U);
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "ab");
+}
+
+#if defined(__linux__)
+[[maybe_unused]] size_t ResidentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0;
+    size_t resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+#endif
+
+// Ingests IMTERM_SOAK_MB megabytes of colored log, 128 by default; set it to
+// 20480 to reproduce a multi-day capture.
+TEST_F(TerminalStateTest, SpilledScrollbackKeepsResidentMemoryBounded)
+{
+#if !defined(__linux__)
+    GTEST_SKIP() << "resident memory is read from /proc";
+#elif defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+    GTEST_SKIP() << "sanitizers keep freed memory resident";
+#else
+    imterm::test::TemporaryDirectory directory;
+    imterm::LineStore::SpillOptions options;
+    options.Path = directory.Path() / "scrollback.spill";
+    options.ChunkSize = 1 << 20;
+    data->EnableSpill(options);
+
+    const char* soakMegabytes = std::getenv("IMTERM_SOAK_MB");
+    const uint64_t total = (soakMegabytes ? std::strtoull(soakMegabytes, nullptr, 10) : 128) << 20;
+
+    std::string log;
+    for (size_t line = 0; log.size() < (4U << 20); ++line) {
+        log += line % 10 == 0 ? "\x1b[0;33mW (" : "\x1b[0;32mI (";
+        log += std::to_string(line * 17);
+        log += ") wifi: connected to ap, rssi -45, free heap 183524\x1b[0m\r\n";
+    }
+    const auto bytes = std::span(reinterpret_cast<const uint8_t*>(log.data()), log.size());
+
+    // Compare against the footprint once the in-memory window has filled.
+    size_t settled = 0;
+    size_t peak = 0;
+    for (uint64_t ingested = 0; ingested < total; ingested += bytes.size()) {
+        for (size_t offset = 0; offset < bytes.size(); offset += 4096) {
+            state->Input(bytes.subspan(offset, std::min<size_t>(4096, bytes.size() - offset)));
+        }
+        const size_t resident = ResidentBytes();
+        if (ingested < (32U << 20)) {
+            settled = resident;
+        }
+        peak = std::max(peak, resident);
+    }
+
+    EXPECT_LT(peak, 200U << 20);
+    EXPECT_LT(peak - settled, 32U << 20);
+    EXPECT_GT(data->GetLines().SpilledBlockCount(), 0U);
+    EXPECT_FALSE(data->TakeSpillError());
+    EXPECT_EQ(imterm::test::LineText(data->GetLine(0)), "W (0) wifi: connected to ap, rssi -45, free heap 183524");
+#endif
+}
+
 } // namespace
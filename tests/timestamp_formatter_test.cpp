@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "timestamp_formatter.h"
+
+namespace {
+
+using imterm::TimestampFormatter;
+using imterm::TimestampResolution;
+
+// What the margin and the log showed before the formatter: strftime of
+// localtime, plus the fraction.
+std::string Reference(TimestampFormatter::Timestamp time, TimestampResolution resolution)
+{
+    const auto micros = std::chrono::floor<std::chrono::microseconds>(time.time_since_epoch());
+    const auto seconds = std::chrono::floor<std::chrono::seconds>(micros);
+    const std::time_t t = static_cast<std::time_t>(seconds.count());
+    char text[32];
+    std::strftime(text, sizeof(text), "%H:%M:%S", std::localtime(&t));
+    std::string result = text;
+    const long long fraction = (micros - seconds).count();
+    if (resolution == TimestampResolution::Milliseconds) {
+        std::snprintf(text, sizeof(text), ".%03lld", fraction / 1000);
+        result += text;
+    }
+    else if (resolution == TimestampResolution::Microseconds) {
+        std::snprintf(text, sizeof(text), ".%06lld", fraction);
+        result += text;
+    }
+    return result;
+}
+
+std::string Format(TimestampFormatter& formatter, TimestampFormatter::Timestamp time, TimestampResolution resolution)
+{
+    std::string result;
+    formatter.Append(time, resolution, result);
+    return result;
+}
+
+TimestampFormatter::Timestamp At(int64_t seconds, int64_t micros = 0)
+{
+    return TimestampFormatter::Timestamp(std::chrono::duration_cast<TimestampFormatter::Timestamp::duration>(
+        std::chrono::seconds(seconds) + std::chrono::microseconds(micros)));
+}
+
+#if !defined(_WIN32)
+// Sets TZ for the lifetime of the object.
+class ScopedTimeZone {
+public:
+    explicit ScopedTimeZone(const char* zone)
+    {
+        if (const char* previous = std::getenv("TZ")) {
+            mPrevious = previous;
+        }
+        setenv("TZ", zone, 1);
+        tzset();
+    }
+
+    ~ScopedTimeZone()
+    {
+        if (mPrevious) {
+            setenv("TZ", mPrevious->c_str(), 1);
+        }
+        else {
+            unsetenv("TZ");
+        }
+        tzset();
+    }
+
+    ScopedTimeZone(const ScopedTimeZone&) = delete;
+    ScopedTimeZone& operator=(const ScopedTimeZone&) = delete;
+
+private:
+    std::optional<std::string> mPrevious;
+};
+#endif
+
+TEST(TimestampFormatterTest, WritesEachResolution)
+{
+    TimestampFormatter formatter;
+    const auto time = At(1700000000, 123456);
+
+    const std::string seconds = Format(formatter, time, TimestampResolution::Seconds);
+    const std::string millis = Format(formatter, time, TimestampResolution::Milliseconds);
+    const std::string micros = Format(formatter, time, TimestampResolution::Microseconds);
+
+    EXPECT_EQ(seconds, Reference(time, TimestampResolution::Seconds));
+    EXPECT_EQ(millis, seconds + ".123");
+    EXPECT_EQ(micros, seconds + ".123456");
+    EXPECT_EQ(seconds.size(), TimestampFormatter::Length(TimestampResolution::Seconds));
+    EXPECT_EQ(millis.size(), TimestampFormatter::Length(TimestampResolution::Milliseconds));
+    EXPECT_EQ(micros.size(), TimestampFormatter::MaxLength);
+}
+
+TEST(TimestampFormatterTest, MatchesLocaltimeForRandomTimes)
+{
+    TimestampFormatter formatter;
+    std::mt19937_64 random(3);
+    std::uniform_int_distribution<int64_t> seconds(0, 4102444800); // 1970 to 2100
+    std::uniform_int_distribution<int64_t> micros(0, 999999);
+
+    for (int i = 0; i < 10000; ++i) {
+        const auto time = At(seconds(random), micros(random));
+        ASSERT_EQ(Format(formatter, time, TimestampResolution::Microseconds),
+            Reference(time, TimestampResolution::Microseconds));
+    }
+}
+
+TEST(TimestampFormatterTest, MatchesLocaltimeForConsecutiveTimes)
+{
+    // Lines arrive close together: the day's offset and the last second are
+    // reused, and must still roll over at each second and at midnight.
+    TimestampFormatter formatter;
+    const int64_t start = 1700000000 - 90000;
+    for (int64_t micros = 0; micros < int64_t(2 * 86400) * 1000000; micros += 7777777) {
+        const auto time = At(start, micros);
+        ASSERT_EQ(Format(formatter, time, TimestampResolution::Milliseconds),
+            Reference(time, TimestampResolution::Milliseconds));
+    }
+}
+
+TEST(TimestampFormatterTest, FloorsTimesBeforeTheEpoch)
+{
+    TimestampFormatter formatter;
+    const auto time = At(-1, 250000);
+    EXPECT_EQ(Format(formatter, time, TimestampResolution::Milliseconds),
+        Reference(time, TimestampResolution::Seconds) + ".250");
+}
+
+#if !defined(_WIN32)
+TEST(TimestampFormatterTest, FollowsDaylightSavingChanges)
+{
+    // US Eastern rules, without relying on installed zone files.
+    ScopedTimeZone zone("EST5EDT,M3.2.0,M11.1.0");
+    TimestampFormatter formatter;
+
+    // 2023-03-12 and 2023-11-05 at 00:00 UTC; both transitions happen later
+    // that day, local time.
+    for (const int64_t day : { int64_t(1678579200), int64_t(1699142400) }) {
+        for (int64_t second = day - 86400; second < day + 2 * 86400; second += 59) {
+            const auto time = At(second);
+            ASSERT_EQ(Format(formatter, time, TimestampResolution::Seconds),
+                Reference(time, TimestampResolution::Seconds)) << second;
+        }
+    }
+}
+
+TEST(TimestampFormatterTest, ResetPicksUpANewTimeZone)
+{
+    TimestampFormatter formatter;
+    const auto time = At(1700000000);
+    {
+        ScopedTimeZone zone("UTC0");
+        EXPECT_EQ(Format(formatter, time, TimestampResolution::Seconds), "22:13:20");
+    }
+    ScopedTimeZone zone("JST-9");
+    formatter.Reset();
+    EXPECT_EQ(Format(formatter, time, TimestampResolution::Seconds), "07:13:20");
+}
+#endif
+
+} // namespace